@@ -53,6 +53,11 @@ void AirbourneBoard::init_board()
 
   backup_sram_init();
 
+  // enable the DWT cycle counter for profiling
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   current_serial_ = &vcp_;    //uncomment this to switch to VCP as the main output
 }
 
@@ -73,6 +78,16 @@ uint64_t AirbourneBoard::clock_micros()
   return micros();
 }
 
+uint32_t AirbourneBoard::clock_cycles()
+{
+  return DWT->CYCCNT;
+}
+
+uint32_t AirbourneBoard::clock_cycles_per_us()
+{
+  return SystemCoreClock / 1000000;
+}
+
 void AirbourneBoard::clock_delay(uint32_t milliseconds)
 {
   delay(milliseconds);
@@ -133,6 +133,8 @@ public:
   uint32_t clock_millis() override;
   uint64_t clock_micros() override;
   void clock_delay(uint32_t milliseconds) override;
+  uint32_t clock_cycles() override;
+  uint32_t clock_cycles_per_us() override;
 
   // serial
   void serial_init(uint32_t baud_rate, uint32_t dev) override;
@@ -29,6 +29,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <cstdint>
+#include <cstring>
 
 #include "board.h"
 #include "mavlink.h"
@@ -36,6 +37,11 @@
 namespace rosflight_firmware
 {
 
+// Parameter batch commands, carried in ROSFLIGHT_CMD messages. The values are kept clear of the
+// ROSFLIGHT_CMD enum in the dialect so that ground stations can send them as raw command ids.
+static constexpr uint8_t ROSFLIGHT_CMD_PARAM_BATCH_BEGIN = 100;
+static constexpr uint8_t ROSFLIGHT_CMD_PARAM_BATCH_COMMIT = 101;
+
 Mavlink::Mavlink(Board &board) :
   board_(board)
 {}
@@ -48,10 +54,22 @@ void Mavlink::init(uint32_t baud_rate, uint32_t dev)
 
 void Mavlink::receive(void)
 {
-  while (board_.serial_bytes_available())
+  // parse in chunks, and at most RX_BYTES_PER_CALL per loop so that a burst of incoming traffic
+  // can't starve the control loop; whatever is left stays in the board's buffer for the next call
+  uint8_t chunk[RX_CHUNK_SIZE];
+  size_t budget = RX_BYTES_PER_CALL;
+  while (budget > 0)
   {
-    if (mavlink_parse_char(MAVLINK_COMM_0, board_.serial_read(), &in_buf_, &status_))
-      handle_mavlink_message();
+    size_t len = board_.serial_read_bulk(chunk, (budget < RX_CHUNK_SIZE) ? budget : RX_CHUNK_SIZE);
+    if (len == 0)
+      break;
+
+    for (size_t i = 0; i < len; i++)
+    {
+      if (mavlink_parse_char(MAVLINK_COMM_0, chunk[i], &in_buf_, &status_))
+        handle_mavlink_message();
+    }
+    budget -= len;
   }
 }
 
@@ -118,6 +136,12 @@ void Mavlink::send_command_ack(uint8_t system_id, Command command, bool success)
   case CommLinkInterface::Command::COMMAND_SEND_VERSION:
     rosflight_cmd = ROSFLIGHT_CMD_SEND_VERSION;
     break;
+  case CommLinkInterface::Command::COMMAND_PARAM_BATCH_BEGIN:
+    rosflight_cmd = static_cast<ROSFLIGHT_CMD>(ROSFLIGHT_CMD_PARAM_BATCH_BEGIN);
+    break;
+  case CommLinkInterface::Command::COMMAND_PARAM_BATCH_COMMIT:
+    rosflight_cmd = static_cast<ROSFLIGHT_CMD>(ROSFLIGHT_CMD_PARAM_BATCH_COMMIT);
+    break;
   }
 
   mavlink_message_t msg;
@@ -363,13 +387,103 @@ void Mavlink::send_battery_status(uint8_t system_id, float voltage, float curren
   send_message(msg);
 }
 
+// There is no dedicated profiling message in the ROSflight dialect, so each statistic is sent as a
+// NAMED_VALUE_FLOAT called "<stage>_<stat>" (e.g. "est_p99"), which fits the 10-character name field
+void Mavlink::send_loop_profile(uint8_t system_id,
+                                uint32_t timestamp_ms,
+                                const char *const stage_name,
+                                const Profiler::Stats &stats)
+{
+  const struct
+  {
+    const char *suffix;
+    float value;
+  } fields[] = {
+    {"_n",   static_cast<float>(stats.count)},
+    {"_min", stats.min_us},
+    {"_avg", stats.mean_us},
+    {"_p99", stats.p99_us},
+    {"_max", stats.max_us},
+    {"_ovr", static_cast<float>(stats.overruns)}
+  };
+
+  for (const auto &field : fields)
+  {
+    char name[MAVLINK_MSG_NAMED_VALUE_FLOAT_FIELD_NAME_LEN] = {};
+    strncpy(name, stage_name, sizeof(name) - 1);
+    strncat(name, field.suffix, sizeof(name) - strlen(name) - 1);
+    send_named_value_float(system_id, timestamp_ms, name, field.value);
+  }
+}
+
+// Also sent as NAMED_VALUE_FLOATs: the frequency and amplitude of peak i on the x axis are "fftx_f<i>"
+// and "fftx_a<i>"
+void Mavlink::send_gyro_spectrum(uint8_t system_id,
+                                 uint32_t timestamp_ms,
+                                 uint8_t axis,
+                                 const SpectrumAnalyzer::Peak *peaks,
+                                 size_t num_peaks)
+{
+  char name[MAVLINK_MSG_NAMED_VALUE_FLOAT_FIELD_NAME_LEN] = "fftx_f0";
+  name[3] = static_cast<char>('x' + axis);
+  for (size_t i = 0; i < num_peaks && i < 10; i++)
+  {
+    name[6] = static_cast<char>('0' + i);
+    name[5] = 'f';
+    send_named_value_float(system_id, timestamp_ms, name, peaks[i].frequency_hz);
+    name[5] = 'a';
+    send_named_value_float(system_id, timestamp_ms, name, peaks[i].amplitude);
+  }
+}
+
+void Mavlink::send_altitude(uint8_t system_id, uint32_t timestamp_ms, float altitude, float climb_rate)
+{
+  send_named_value_float(system_id, timestamp_ms, "alt", altitude);
+  send_named_value_float(system_id, timestamp_ms, "climb", climb_rate);
+}
+
 void Mavlink::send_message(const mavlink_message_t &msg)
 {
   if (initialized_)
   {
-    uint8_t data[MAVLINK_MAX_PACKET_LEN];
-    uint16_t len = mavlink_msg_to_send_buffer(data, &msg);
-    board_.serial_write(data, len);
+    // serialize straight into the transmit buffer; the whole loop's output goes out in flush()
+    uint8_t *data = tx_buffer_.reserve(MAVLINK_NUM_NON_PAYLOAD_BYTES + msg.len, message_priority(msg.msgid));
+    if (data != nullptr)
+      tx_buffer_.commit(mavlink_msg_to_send_buffer(data, &msg));
+  }
+}
+
+void Mavlink::flush()
+{
+  if (tx_buffer_.size() > 0)
+  {
+    board_.serial_write_batch(tx_buffer_.data(), tx_buffer_.size());
+    tx_buffer_.clear();
+  }
+}
+
+SerialTxBuffer::Priority Mavlink::message_priority(uint32_t msgid)
+{
+  switch (msgid)
+  {
+  // link management and replies to the ground station
+  case MAVLINK_MSG_ID_HEARTBEAT:
+  case MAVLINK_MSG_ID_ROSFLIGHT_STATUS:
+  case MAVLINK_MSG_ID_ROSFLIGHT_CMD_ACK:
+  case MAVLINK_MSG_ID_ROSFLIGHT_VERSION:
+  case MAVLINK_MSG_ID_ROSFLIGHT_HARD_ERROR:
+  case MAVLINK_MSG_ID_PARAM_VALUE:
+  case MAVLINK_MSG_ID_STATUSTEXT:
+  case MAVLINK_MSG_ID_TIMESYNC:
+    return SerialTxBuffer::PRIORITY_HIGH;
+  // debugging and monitoring
+  case MAVLINK_MSG_ID_NAMED_VALUE_INT:
+  case MAVLINK_MSG_ID_NAMED_VALUE_FLOAT:
+  case MAVLINK_MSG_ID_ROSFLIGHT_OUTPUT_RAW:
+  case MAVLINK_MSG_ID_RC_CHANNELS:
+    return SerialTxBuffer::PRIORITY_LOW;
+  default:
+    return SerialTxBuffer::PRIORITY_NORMAL;
   }
 }
 
@@ -457,6 +571,12 @@ void Mavlink::handle_msg_rosflight_cmd(const mavlink_message_t *const msg)
   case ROSFLIGHT_CMD_SEND_VERSION:
     command = CommLinkInterface::Command::COMMAND_SEND_VERSION;
     break;
+  case ROSFLIGHT_CMD_PARAM_BATCH_BEGIN:
+    command = CommLinkInterface::Command::COMMAND_PARAM_BATCH_BEGIN;
+    break;
+  case ROSFLIGHT_CMD_PARAM_BATCH_COMMIT:
+    command = CommLinkInterface::Command::COMMAND_PARAM_BATCH_COMMIT;
+    break;
   default: // unsupported command; report failure then return without calling command callback
     mavlink_message_t out_msg;
     mavlink_msg_rosflight_cmd_ack_pack(msg->sysid, compid_, &out_msg, cmd.command, ROSFLIGHT_CMD_FAILED);
@@ -542,6 +662,9 @@ void Mavlink::handle_msg_offboard_control(const mavlink_message_t *const msg)
   case MODE_ROLL_PITCH_YAWRATE_THROTTLE:
     control.mode = CommLinkInterface::OffboardControl::Mode::ROLL_PITCH_YAWRATE_THROTTLE;
     break;
+  case MODE_ROLL_PITCH_YAWRATE_ALTITUDE:
+    control.mode = CommLinkInterface::OffboardControl::Mode::ROLL_PITCH_YAWRATE_ALTITUDE;
+    break;
   default:
     // invalid mode; ignore message and return without calling callback
     return;
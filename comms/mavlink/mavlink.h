@@ -44,6 +44,7 @@
 
 #include "interface/comm_link.h"
 #include "board.h"
+#include "serial_tx_buffer.h"
 
 namespace rosflight_firmware
 {
@@ -56,6 +57,7 @@ public:
   Mavlink(Board& board);
   void init(uint32_t baud_rate, uint32_t dev) override;
   void receive() override;
+  void flush() override;
 
   void send_attitude_quaternion(uint8_t system_id,
                                 uint64_t timestamp_us,
@@ -101,11 +103,22 @@ public:
   void send_gnss_raw(uint8_t system_id, const GNSSRaw& data) override;
   void send_error_data(uint8_t system_id, const StateManager::BackupData& error_data) override;
   void send_battery_status(uint8_t system_id, float voltage, float current) override;
+  void send_loop_profile(uint8_t system_id,
+                         uint32_t timestamp_ms,
+                         const char *const stage_name,
+                         const Profiler::Stats &stats) override;
+  void send_gyro_spectrum(uint8_t system_id,
+                          uint32_t timestamp_ms,
+                          uint8_t axis,
+                          const SpectrumAnalyzer::Peak *peaks,
+                          size_t num_peaks) override;
+  void send_altitude(uint8_t system_id, uint32_t timestamp_ms, float altitude, float climb_rate) override;
 
   inline void set_listener(ListenerInterface * listener) override { listener_ = listener; }
 
 private:
   void send_message(const mavlink_message_t &msg);
+  static SerialTxBuffer::Priority message_priority(uint32_t msgid);
 
   void handle_msg_param_request_list(const mavlink_message_t *const msg);
   void handle_msg_param_request_read(const mavlink_message_t *const msg);
@@ -119,9 +132,14 @@ private:
   void handle_msg_heartbeat(const mavlink_message_t * const msg);
   void handle_mavlink_message();
 
+  // 256 bytes per 1 kHz loop is well above what a 921600 baud link can deliver
+  static constexpr size_t RX_CHUNK_SIZE = 64;
+  static constexpr size_t RX_BYTES_PER_CALL = 256;
+
   Board& board_;
 
   uint32_t compid_ = 250;
+  SerialTxBuffer tx_buffer_;
   mavlink_message_t in_buf_;
   mavlink_status_t status_;
   bool initialized_ = false;
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_ALTITUDE_ESTIMATOR_H
+#define ROSFLIGHT_FIRMWARE_ALTITUDE_ESTIMATOR_H
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Fixed-gain estimator of altitude and climb rate from vertical acceleration and altitude
+ *        measurements
+ *
+ * A third-order complementary filter: the vertical acceleration is integrated twice, and the error
+ * to the latest altitude measurement pulls the altitude, the climb rate and a vertical accel bias
+ * toward it, with gains set by one time constant per measurement source. Measurements come from
+ * the barometer or, close to the ground, from a downward range sensor. While the range sensor is in
+ * use the offset of the barometer from it is learned, so switching between them doesn't make the
+ * altitude jump. Everything is relative to the first measurement's reference (the calibrated
+ * ground level for the barometer).
+ */
+class AltitudeEstimator
+{
+public:
+  struct Params
+  {
+    float baro_time_constant;  // s, longer trusts the barometer less
+    float range_time_constant; // s
+  };
+
+  AltitudeEstimator();
+
+  void set_params(const Params &params);
+
+  /**
+   * @brief Forgets the estimate. The next measurement restarts it.
+   */
+  void reset();
+
+  /**
+   * @brief Propagates over dt seconds with the vertical acceleration in m/s^2, positive up and
+   *        without gravity
+   */
+  void predict(float accel_up, float dt);
+
+  /**
+   * @brief Corrects toward a barometric altitude in m, applied over dt seconds
+   */
+  void correct_baro(float altitude, float dt);
+
+  /**
+   * @brief Corrects toward a height above ground in m from a range sensor, applied over dt seconds
+   */
+  void correct_range(float height, float dt);
+
+  /**
+   * @brief Learns the barometer offset while range corrections are in use, without correcting
+   */
+  void track_baro(float altitude, float dt);
+
+  inline bool initialized() const { return initialized_; }
+  inline float altitude() const { return altitude_; }
+  inline float climb_rate() const { return climb_rate_; }
+  inline float accel_bias() const { return accel_bias_; }
+
+private:
+  Params params_;
+  bool initialized_;
+  float altitude_;
+  float climb_rate_;
+  float accel_bias_;
+  float baro_offset_; // barometric altitude minus the estimate's reference
+
+  void correct(float measurement, float time_constant, float dt);
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_ALTITUDE_ESTIMATOR_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_ATTITUDE_EKF_H
+#define ROSFLIGHT_FIRMWARE_ATTITUDE_EKF_H
+
+#include <cstdint>
+
+#include <turbomath/turbomath.h>
+
+#include "sym_matrix.h"
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Multiplicative extended Kalman filter for attitude and gyro bias, optionally accel bias
+ *
+ * The attitude is kept as a quaternion and the filter estimates a small rotation error about it,
+ * expressed in the body frame, together with the gyro bias (6 states) and, if enabled, the accel
+ * bias (9 states). Gyro measurements propagate the state. Accelerometer measurements of gravity,
+ * heading measurements and external attitude measurements correct it, one axis at a time, so no
+ * matrix is inverted.
+ * The covariance is a packed SymMatrix and the propagation only touches the blocks that change.
+ */
+class AttitudeEkf
+{
+public:
+  static constexpr uint8_t NUM_STATES = 9; // attitude error, gyro bias, accel bias
+
+  struct Params
+  {
+    float gyro_noise;       // gyro white noise density (rad/s/sqrt(Hz))
+    float gyro_bias_noise;  // gyro bias random walk (rad/s^2/sqrt(Hz))
+    float accel_noise;      // accelerometer measurement noise (m/s^2)
+    float accel_bias_noise; // accel bias random walk (m/s^3/sqrt(Hz))
+    float attitude_noise;   // external attitude measurement noise (rad)
+    float heading_noise;    // heading measurement noise (rad)
+    bool estimate_accel_bias;
+  };
+
+  AttitudeEkf();
+
+  /**
+   * @brief Changes the noise settings. Switching the accel bias states on or off resets them.
+   */
+  void set_params(const Params &params);
+
+  /**
+   * @brief Restarts the filter from the given estimate with the initial uncertainty
+   */
+  void reset(const turbomath::Quaternion &attitude, const turbomath::Vector &gyro_bias);
+  void reset_gyro_bias();
+
+  /**
+   * @brief Propagates the attitude with a bias-corrected gyro measurement over dt seconds
+   */
+  void predict(const turbomath::Vector &gyro, float dt);
+
+  /**
+   * @brief Corrects roll, pitch (and the biases) with a measurement of gravity in m/s^2, which
+   *        reads (0, 0, -9.81) when level
+   */
+  void update_accel(const turbomath::Vector &accel);
+
+  /**
+   * @brief Corrects the full attitude with an external attitude measurement
+   */
+  void update_attitude(const turbomath::Quaternion &attitude);
+
+  /**
+   * @brief Corrects the heading (and the gyro bias about the vertical) with a measured heading
+   *        error in rad: the rotation about the world z axis from the estimate to the measurement
+   */
+  void update_heading(float error);
+
+  inline const turbomath::Quaternion &attitude() const { return attitude_; }
+  inline const turbomath::Vector &gyro_bias() const { return gyro_bias_; }
+  inline const turbomath::Vector &accel_bias() const { return accel_bias_; }
+
+  /**
+   * @brief Covariance element; states are ordered attitude error, gyro bias, accel bias
+   */
+  float covariance(uint8_t i, uint8_t j) const;
+
+private:
+  static constexpr uint8_t ATTITUDE = 0;
+  static constexpr uint8_t GYRO_BIAS = 3;
+  static constexpr uint8_t ACCEL_BIAS = 6;
+
+  Params params_;
+  turbomath::Quaternion attitude_;
+  turbomath::Vector gyro_bias_;
+  turbomath::Vector accel_bias_;
+
+  // Only one of these is in use, depending on params_.estimate_accel_bias
+  SymMatrix<6> P6_;
+  SymMatrix<9> P9_;
+
+  static float initial_variance(uint8_t state);
+  void reset_covariance();
+  void reset_accel_bias();
+  template <uint8_t N> void propagate_covariance(SymMatrix<N> &P, const turbomath::Vector &rate, float dt);
+  template <uint8_t N> void update_axis(SymMatrix<N> &P, const float h[N], float residual, float variance,
+                                        float dx[N]);
+  template <uint8_t N> void fuse_accel(SymMatrix<N> &P, const turbomath::Vector &accel);
+  template <uint8_t N> void fuse_attitude(SymMatrix<N> &P, const turbomath::Vector &error);
+  template <uint8_t N> void fuse_heading(SymMatrix<N> &P, float error);
+  void apply_correction(const float *dx, bool has_accel_bias);
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_ATTITUDE_EKF_H
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_ATTITUDE_HISTORY_H
+#define ROSFLIGHT_FIRMWARE_ATTITUDE_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <turbomath/turbomath.h>
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Fixed-size ring buffer of past attitude estimates, keyed by IMU time
+ *
+ * Lets a delayed measurement be compared with the attitude at the time it was taken. Entries are
+ * kept at least PERIOD_US apart, and the newest entry always holds the latest attitude, so the
+ * buffer covers at least (SIZE - 2)*PERIOD_US of history whatever the attitude update rate is.
+ * Older entries are overwritten when the buffer is full.
+ */
+class AttitudeHistory
+{
+public:
+  static constexpr uint32_t MAX_DELAY_US = 120000; // largest EXT_ATT_DELAY
+  static constexpr uint32_t MARGIN_US = 20000;     // for arrival jitter and the IMU sample lag
+  static constexpr uint32_t PERIOD_US = 4000;
+  static constexpr size_t SIZE = (MAX_DELAY_US + MARGIN_US)/PERIOD_US + 2;
+
+  AttitudeHistory();
+
+  void reset();
+
+  /**
+   * @brief Records the attitude estimate at time_us, which must not be older than the last one
+   */
+  void record(uint64_t time_us, const turbomath::Quaternion &q);
+
+  /**
+   * @brief Finds the attitude at time_us, interpolated between the entries around it
+   * @return false if time_us is older than the history. Times after the newest entry get the
+   *         newest attitude.
+   */
+  bool lookup(uint64_t time_us, turbomath::Quaternion *q) const;
+
+  inline size_t count() const { return count_; }
+
+private:
+  struct Entry
+  {
+    uint64_t time_us;
+    turbomath::Quaternion q;
+  };
+
+  Entry entries_[SIZE];
+  size_t newest_;
+  size_t count_;
+
+  inline size_t older(size_t i) const { return (i == 0) ? SIZE - 1 : i - 1; }
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_ATTITUDE_HISTORY_H
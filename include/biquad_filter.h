@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_BIQUAD_FILTER_H
+#define ROSFLIGHT_FIRMWARE_BIQUAD_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Cascade of second-order IIR sections filtering the three axes of a vector sensor
+ *
+ * Every stage holds its own coefficients for each axis, so a notch can track a different frequency
+ * on each axis. Coefficients and state are stored axis-contiguous (structure of arrays, padded to
+ * four lanes) so the per-sample update is the same straight-line arithmetic on every lane. Designing
+ * coefficients takes trigonometry and is meant to happen on parameter changes, or at the update
+ * rate of a frequency tracker, not on every sample.
+ *
+ * The stages are stored by FixedBiquadFilterBank, which is sized for the number of stages a user
+ * needs, so that a single-stage filter doesn't carry RAM for MAX_STAGES.
+ */
+class BiquadFilterBank
+{
+public:
+  static constexpr uint8_t MAX_STAGES = 4; // the most stages any bank can hold
+  static constexpr uint8_t NUM_AXES = 3;
+
+  /**
+   * @brief Normalized coefficients of y = b0*x + b1*x[-1] + b2*x[-2] - a1*y[-1] - a2*y[-2]
+   */
+  struct Coefficients
+  {
+    float b0;
+    float b1;
+    float b2;
+    float a1;
+    float a2;
+  };
+
+  /**
+   * @brief Second-order low-pass section
+   * @param q 0.7071 gives a Butterworth response; see butterworth_q() for higher orders
+   * @return A passthrough section if the cutoff is not between 0 and the Nyquist frequency
+   */
+  static Coefficients lowpass(float cutoff_hz, float sample_hz, float q);
+
+  /**
+   * @brief Notch section with unity gain away from the center frequency
+   * @param q Center frequency over the -3 dB bandwidth
+   * @return A passthrough section if the center is not between 0 and the Nyquist frequency
+   */
+  static Coefficients notch(float center_hz, float sample_hz, float q);
+
+  static Coefficients passthrough();
+
+  /**
+   * @brief Q of stage `stage` of a Butterworth low-pass made of `num_stages` sections
+   */
+  static float butterworth_q(uint8_t stage, uint8_t num_stages);
+
+  /**
+   * @brief Removes every stage
+   */
+  void clear();
+
+  /**
+   * @brief Appends a stage with the same coefficients on every axis
+   * @return Index of the new stage, or MAX_STAGES if the bank is full
+   */
+  uint8_t add_stage(const Coefficients &coefficients);
+
+  /**
+   * @brief Replaces the coefficients of one axis of a stage, keeping its state
+   */
+  void set_coefficients(uint8_t stage, uint8_t axis, const Coefficients &coefficients);
+
+  inline uint8_t num_stages() const { return num_stages_; }
+  inline uint8_t capacity() const { return capacity_; }
+
+  /**
+   * @brief Sets the state of every stage to its steady state for a constant input
+   */
+  void reset(const float value[NUM_AXES]);
+
+  /**
+   * @brief Filters one sample
+   */
+  void apply(const float input[NUM_AXES], float output[NUM_AXES]);
+
+protected:
+  static constexpr uint8_t LANES = 4;
+
+  struct Stage
+  {
+    alignas(16) float b0[LANES];
+    alignas(16) float b1[LANES];
+    alignas(16) float b2[LANES];
+    alignas(16) float a1[LANES];
+    alignas(16) float a2[LANES];
+    alignas(16) float z1[LANES];
+    alignas(16) float z2[LANES];
+  };
+
+  BiquadFilterBank(Stage *stages, uint8_t capacity);
+
+private:
+  // the stages live in the derived class, so a bank can't be copied
+  BiquadFilterBank(const BiquadFilterBank &) = delete;
+  BiquadFilterBank &operator=(const BiquadFilterBank &) = delete;
+
+  Stage *stages_;
+  uint8_t capacity_;
+  uint8_t num_stages_;
+};
+
+template <uint8_t NumStages>
+class FixedBiquadFilterBank : public BiquadFilterBank
+{
+  static_assert(NumStages > 0 && NumStages <= MAX_STAGES, "unsupported number of biquad stages");
+
+public:
+  FixedBiquadFilterBank() : BiquadFilterBank(storage_, NumStages) {}
+
+private:
+  Stage storage_[NumStages];
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_BIQUAD_FILTER_H
@@ -36,6 +36,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "esc_protocol.h"
+#include "mixer.h"
 #include "sensors.h"
 #include "state_manager.h"
 
@@ -61,6 +63,11 @@ public:
   virtual uint64_t clock_micros() = 0;
   virtual void clock_delay(uint32_t milliseconds) = 0;
 
+  // Optional free-running cycle counter used for profiling (allowed to wrap). Boards without one
+  // fall back to the microsecond clock.
+  virtual uint32_t clock_cycles() { return static_cast<uint32_t>(clock_micros()); }
+  virtual uint32_t clock_cycles_per_us() { return 1; }
+
 // serial
   virtual void serial_init(uint32_t baud_rate, uint32_t dev) = 0;
   virtual void serial_write(const uint8_t *src, size_t len) = 0;
@@ -68,12 +75,43 @@ public:
   virtual uint8_t serial_read() = 0;
   virtual void serial_flush() = 0;
 
+  // Reads up to len received bytes into dest and returns how many were read. Boards that can copy
+  // straight out of their receive buffer should override this.
+  virtual size_t serial_read_bulk(uint8_t *dest, size_t len)
+  {
+    size_t available = serial_bytes_available();
+    if (len > available)
+      len = available;
+    for (size_t i = 0; i < len; i++)
+      dest[i] = serial_read();
+    return len;
+  }
+
+  // Writes everything queued during one loop and starts the transfer. Boards with DMA transmit can
+  // override this to send the whole batch in one transfer. The data must be copied or sent before
+  // returning.
+  virtual void serial_write_batch(const uint8_t *src, size_t len)
+  {
+    serial_write(src, len);
+    serial_flush();
+  }
+
 // sensors
   virtual void sensors_init() = 0;
   virtual uint16_t num_sensor_errors()  = 0;
 
   virtual bool new_imu_data() = 0;
   virtual bool imu_read(float accel[3], float *temperature, float gyro[3], uint64_t *time) = 0;
+
+  // Reads up to max_samples buffered IMU samples, oldest first, and returns how many were read.
+  // Boards whose IMU has a hardware FIFO should override this to drain it in one transfer.
+  virtual size_t imu_read_fifo(ImuSample *samples, size_t max_samples)
+  {
+    if (max_samples == 0 || !new_imu_data())
+      return 0;
+    ImuSample &sample = samples[0];
+    return imu_read(sample.accel, &sample.temperature, sample.gyro, &sample.time_us) ? 1 : 0;
+  }
   virtual void imu_not_responding_error() = 0;
 
   virtual bool mag_present() = 0;
@@ -117,11 +155,47 @@ public:
   virtual void pwm_disable() = 0;
   virtual void pwm_write(uint8_t channel, float value) = 0;
 
+  // Writes one mixer update: values[i] goes to channel i if types[i] is a servo or motor, and
+  // other channels are left alone. Values are already clamped to [0, 1]. Boards whose timers can
+  // preload all compare registers and latch them on one update event should override this, so the
+  // outputs change together instead of one channel at a time.
+  virtual void pwm_write_all(const float *values, const Mixer::output_type_t *types, size_t count)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (types[i] == Mixer::S || types[i] == Mixer::M)
+        pwm_write(static_cast<uint8_t>(i), values[i]);
+    }
+  }
+
+  // Optional digital ESC outputs. esc_init switches the channels in channel_mask to the given
+  // protocol. It returns false if the board can't do that, and those motors then stay on analog
+  // PWM. esc_write gets one encoded frame per output channel, starting at channel 0, and should
+  // start sending them all together. Frames for channels outside the mask are ignored. Boards that
+  // receive ESC telemetry return the latest report for a channel from esc_telemetry_read.
+  virtual bool esc_init(EscProtocol /* protocol */, uint16_t /* channel_mask */) { return false; }
+  virtual void esc_write(const uint16_t * /* frames */, size_t /* count */) {}
+  virtual bool esc_telemetry_read(uint8_t /* channel */, EscTelemetry * /* telemetry */) { return false; }
+
 // non-volatile memory
   virtual void memory_init() = 0;
   virtual bool memory_read(void *dest, size_t len) = 0;
   virtual bool memory_write(const void *src, size_t len) = 0;
 
+  // Optional access to two equally sized flash sectors, used by the log-structured parameter store.
+  // Writes only clear bits (as flash programming does) and erasing sets a whole sector to 0xFF.
+  // Boards that return a size of 0 keep storing parameters through memory_read/memory_write.
+  virtual size_t memory_sector_size() { return 0; }
+  virtual bool memory_sector_read(uint8_t /* sector */, size_t /* offset */, void * /* dest */, size_t /* len */)
+  {
+    return false;
+  }
+  virtual bool memory_sector_write(uint8_t /* sector */, size_t /* offset */, const void * /* src */, size_t /* len */)
+  {
+    return false;
+  }
+  virtual bool memory_sector_erase(uint8_t /* sector */) { return false; }
+
 // LEDs
   virtual void led0_on() = 0;
   virtual void led0_off() = 0;
@@ -33,7 +33,6 @@
 #define ROSFLIGHT_FIRMWARE_COMM_MANAGER_H
 
 #include <cstdint>
-#include <functional>
 
 #include "interface/comm_link.h"
 #include "interface/param_listener.h"
@@ -47,13 +46,14 @@ class ROSflight;
 
 class CommManager : public CommLinkInterface::ListenerInterface, public ParamListenerInterface
 {
-private:
+public:
   enum StreamId
   {
     STREAM_ID_HEARTBEAT,
     STREAM_ID_STATUS,
 
     STREAM_ID_ATTITUDE,
+    STREAM_ID_ALTITUDE,
 
     STREAM_ID_IMU,
     STREAM_ID_DIFF_PRESSURE,
@@ -66,10 +66,28 @@ private:
     STREAM_ID_GNSS,
     STREAM_ID_GNSS_RAW,
     STREAM_ID_RC_RAW,
+    STREAM_ID_LOOP_PROFILE,
+    STREAM_ID_GYRO_SPECTRUM,
     STREAM_ID_LOW_PRIORITY,
     STREAM_COUNT
   };
 
+  struct StreamStats
+  {
+    uint32_t requested_rate_hz;
+    float achieved_rate_hz; // over the last complete one-second window
+    uint32_t deferred;      // loops in which the stream was due but held back for link capacity
+  };
+
+private:
+  enum StreamPriority : uint8_t
+  {
+    STREAM_PRIORITY_HIGH,
+    STREAM_PRIORITY_NORMAL,
+    STREAM_PRIORITY_LOW,
+    STREAM_PRIORITY_COUNT
+  };
+
   enum OffboardControlMode
   {
     MODE_PASS_THROUGH,
@@ -83,6 +101,11 @@ private:
   ROSflight& RF_;
   CommLinkInterface& comm_link_;
   uint8_t send_params_index_;
+  uint32_t param_value_pending_[(PARAMS_COUNT + 31)/32] = {};
+  bool param_batch_open_ = false; // batch opened by the ground station
+  uint32_t param_batch_time_ms_ = 0; // when it was opened or last changed
+  uint8_t next_profile_stage_ = 0;
+  uint8_t next_spectrum_axis_ = 0;
   bool initialized_ = false;
   bool connected_ = false;
 
@@ -117,19 +140,52 @@ private:
   StateManager::BackupData backup_data_buffer_;
   bool have_backup_data_ = false;
 
+  // returns true if a message was sent
+  typedef bool (CommManager::*SendFunction)(void);
+
   class Stream
   {
   public:
-    Stream(uint32_t period_us, std::function<void(void)> send_function);
+    Stream(uint32_t period_us, uint16_t size_bytes, StreamPriority priority, bool fixed_rate,
+           SendFunction send_function);
 
-    void stream(uint64_t now_us);
+    bool send(CommManager &comm_manager, uint64_t now_us);
     void set_rate(uint32_t rate_hz);
 
     uint32_t period_us_;
     uint64_t next_time_us_;
-    std::function<void(void)> send_function_;
+    uint16_t size_bytes_; // approximate size of one send on the wire
+    StreamPriority priority_;
+    bool fixed_rate_; // sends every period, rather than only when there is new data
+    uint32_t sent_ = 0;
+    uint32_t deferred_ = 0;
+    float achieved_rate_hz_ = 0.0f;
+    SendFunction send_function_;
   };
 
+  // link capacity shared by the streams, replenished as time passes
+  static constexpr uint32_t LINK_BURST_US = 2000;
+  static constexpr uint32_t RATE_WINDOW_US = 1000000;
+  float link_bytes_per_us_ = 0.0f;
+  float link_burst_bytes_ = 0.0f;
+  float link_budget_bytes_ = 0.0f;
+  uint64_t last_stream_us_ = 0;
+  uint64_t rate_window_start_us_ = 0;
+  bool link_oversubscribed_ = false;
+
+  // indices of the active streams, kept as a binary min-heap on next send time
+  uint8_t schedule_[STREAM_COUNT];
+  uint8_t schedule_size_ = 0;
+
+  bool scheduled_before(uint8_t a, uint8_t b) const;
+  void schedule_push(uint8_t stream_id);
+  uint8_t schedule_pop(void);
+  void rebuild_schedule(void);
+
+  void update_link_capacity(void);
+  void check_link_load(void);
+  void update_achieved_rates(uint64_t now_us);
+
   void update_system_id(uint16_t param_id);
 
   void param_request_list_callback(uint8_t target_system) override;
@@ -144,42 +200,50 @@ private:
   void external_attitude_callback(const turbomath::Quaternion &q) override;
   void heartbeat_callback() override;
 
-  void send_heartbeat(void);
-  void send_status(void);
-  void send_attitude(void);
-  void send_imu(void);
-  void send_output_raw(void);
-  void send_rc_raw(void);
-  void send_diff_pressure(void);
-  void send_baro(void);
-  void send_sonar(void);
-  void send_mag(void);
-  void send_battery_status(void);
-  void send_gnss(void);
-  void send_gnss_raw(void);
-  void send_low_priority(void);
+  bool send_heartbeat(void);
+  bool send_status(void);
+  bool send_attitude(void);
+  bool send_altitude(void);
+  bool send_imu(void);
+  bool send_output_raw(void);
+  bool send_rc_raw(void);
+  bool send_diff_pressure(void);
+  bool send_baro(void);
+  bool send_sonar(void);
+  bool send_mag(void);
+  bool send_battery_status(void);
+  bool send_gnss(void);
+  bool send_gnss_raw(void);
+  bool send_loop_profile(void);
+  bool send_gyro_spectrum(void);
+  bool send_low_priority(void);
 
   // Debugging Utils
   void send_named_value_int(const char *const name, int32_t value);
 //    void send_named_command_struct(const char *const name, control_t command_struct);
 
-  void send_next_param(void);
+  bool send_next_param(void);
 
+  // sizes are the MAVLink v1 encoded lengths (8 bytes of framing plus payload)
+  //     period, size, priority, fixed rate
   Stream streams_[STREAM_COUNT] = {
-    Stream(0,     [this]{this->send_heartbeat();}),
-    Stream(0,     [this]{this->send_status();}),
-    Stream(0,     [this]{this->send_attitude();}),
-    Stream(0,     [this]{this->send_imu();}),
-    Stream(0,     [this]{this->send_diff_pressure();}),
-    Stream(0,     [this]{this->send_baro();}),
-    Stream(0,     [this]{this->send_sonar();}),
-    Stream(0,     [this]{this->send_mag();}),
-    Stream(0,     [this]{this->send_battery_status();}),
-    Stream(0,     [this]{this->send_output_raw();}),
-    Stream(0,     [this]{this->send_gnss();}),
-    Stream(0,     [this]{this->send_gnss_raw();}),
-    Stream(0,     [this]{this->send_rc_raw();}),
-    Stream(20000, [this]{this->send_low_priority();})
+    Stream(0,     17,  STREAM_PRIORITY_HIGH,   true,  &CommManager::send_heartbeat),
+    Stream(0,     18,  STREAM_PRIORITY_HIGH,   true,  &CommManager::send_status),
+    Stream(0,     40,  STREAM_PRIORITY_NORMAL, true,  &CommManager::send_attitude),
+    Stream(0,     52,  STREAM_PRIORITY_NORMAL, true,  &CommManager::send_altitude),
+    Stream(0,     44,  STREAM_PRIORITY_NORMAL, true,  &CommManager::send_imu),
+    Stream(0,     20,  STREAM_PRIORITY_NORMAL, false, &CommManager::send_diff_pressure),
+    Stream(0,     20,  STREAM_PRIORITY_NORMAL, false, &CommManager::send_baro),
+    Stream(0,     21,  STREAM_PRIORITY_NORMAL, false, &CommManager::send_sonar),
+    Stream(0,     20,  STREAM_PRIORITY_NORMAL, false, &CommManager::send_mag),
+    Stream(0,     16,  STREAM_PRIORITY_NORMAL, false, &CommManager::send_battery_status),
+    Stream(0,     72,  STREAM_PRIORITY_LOW,    true,  &CommManager::send_output_raw),
+    Stream(0,     78,  STREAM_PRIORITY_LOW,    false, &CommManager::send_gnss),
+    Stream(0,     78,  STREAM_PRIORITY_LOW,    false, &CommManager::send_gnss_raw),
+    Stream(0,     50,  STREAM_PRIORITY_LOW,    true,  &CommManager::send_rc_raw),
+    Stream(0,     156, STREAM_PRIORITY_LOW,    true,  &CommManager::send_loop_profile),
+    Stream(0,     156, STREAM_PRIORITY_LOW,    true,  &CommManager::send_gyro_spectrum),
+    Stream(20000, 92,  STREAM_PRIORITY_HIGH,   false, &CommManager::send_low_priority)
   };
 
   // the time of week stamp for the last sent GNSS message, to prevent re-sending
@@ -195,13 +259,19 @@ public:
   void receive(void);
   void stream();
   void send_param_value(uint16_t param_id);
+  void queue_param_value(uint16_t param_id);
   void set_streaming_rate(uint8_t stream_id, int16_t param_id);
   void update_status();
+  inline bool param_batch_open() const { return param_batch_open_; }
   void log(CommLinkInterface::LogSeverity severity, const char *fmt, ...);
 
   void send_parameter_list();
   void send_named_value_float(const char *const name, float value);
 
+  StreamStats stream_stats(StreamId stream_id) const;
+  uint32_t link_capacity_bytes_per_s(void) const;
+  uint32_t link_load_bytes_per_s(void) const;
+
   void send_backup_data(const StateManager::BackupData &backup_data);
 };
 
@@ -50,6 +50,7 @@ typedef enum
   ANGLE,        // Channel command is in angle mode (mrad)
   THROTTLE,     // Channel is direcly controlling throttle max/1000
   PASSTHROUGH,  // Channel directly passes PWM input to the mixer
+  ALTITUDE,     // Channel command is a target altitude above the takeoff point (m), held by the controller
 } control_type_t;
 
 typedef struct
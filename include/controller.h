@@ -67,6 +67,7 @@ public:
 
   void calculate_equilbrium_torque_from_rc();
   void param_change_callback(uint16_t param_id) override;
+  void param_change_batch_callback(const uint16_t *param_ids, size_t num_ids) override;
 
 private:
   class PID
@@ -76,6 +77,11 @@ private:
     void init(float kp, float ki, float kd, float max, float min, float tau);
     float run(float dt, float x, float x_c, bool update_integrator);
     float run(float dt, float x, float x_c, bool update_integrator, float xdot);
+    // Output of the last run() with only the derivative term updated
+    float damp(float xdot) const;
+    // Clears the integrator and derivative so a loop that was idle starts from x without a kick
+    void reset(float x);
+    inline void set_limits(float max, float min) { max_ = max; min_ = min; }
 
   private:
     float kp_;
@@ -89,16 +95,24 @@ private:
     float differentiator_;
     float prev_x_;
     float tau_;
+
+    float u_; // unsaturated output and derivative of the last run()
+    float xdot_;
   };
 
   ROSflight &RF_;
 
+  void update_equilibrium_torque();
   turbomath::Vector run_pid_loops(uint32_t dt,
+                                  uint32_t angle_dt,
                                   const Estimator::State &state,
                                   const control_t &command,
-                                  bool update_integrators);
+                                  bool update_integrators,
+                                  bool update_angle);
+  float run_altitude_loop(uint32_t dt_us, const Estimator::State &state, float altitude_c, bool update_integrators);
 
   Output output_;
+  turbomath::Vector equilibrium_torque_;
 
   PID roll_;
   PID roll_rate_;
@@ -106,7 +120,20 @@ private:
   PID pitch_rate_;
   PID yaw_rate_;
 
+  // Altitude hold: the altitude loop commands a climb rate and the climb rate loop a vertical
+  // acceleration, which becomes throttle around the hover throttle
+  PID altitude_;
+  PID climb_rate_;
+  float hover_throttle_;
+  bool altitude_held_;
+
   uint64_t prev_time_us_;
+
+  // The angle loops run when the estimator updates the attitude. In between, only the rate
+  // damping of their last output follows the gyro.
+  uint64_t prev_angle_time_us_;
+  bool roll_angle_held_;
+  bool pitch_angle_held_;
 };
 
 } // namespace rosflight_firmware
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_ESC_PROTOCOL_H
+#define ROSFLIGHT_FIRMWARE_ESC_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rosflight_firmware
+{
+
+enum EscProtocol : uint8_t
+{
+  ESC_PROTOCOL_PWM = 0,
+  ESC_PROTOCOL_DSHOT150 = 1,
+  ESC_PROTOCOL_DSHOT300 = 2,
+  ESC_PROTOCOL_DSHOT600 = 3,
+  ESC_PROTOCOL_COUNT
+};
+
+/**
+ * @brief Latest telemetry reported by a digital ESC
+ */
+struct EscTelemetry
+{
+  uint32_t erpm;
+  float voltage;
+  float current;
+  int16_t temperature_c;
+};
+
+/**
+ * @brief Encoding of DShot frames
+ *
+ * A frame is 16 bits sent MSB first: an 11 bit value, a telemetry request bit, and a 4 bit
+ * checksum. Values 1-47 are ESC commands and 48-2047 are throttle, with 0 meaning motor stop.
+ */
+namespace dshot
+{
+
+static constexpr uint16_t THROTTLE_MIN = 48;
+static constexpr uint16_t THROTTLE_MAX = 2047;
+static constexpr uint8_t FRAME_BITS = 16;
+
+/**
+ * @brief Bit rate of a DShot protocol in bits per second, or 0 for analog PWM
+ */
+uint32_t bit_rate(EscProtocol protocol);
+
+/**
+ * @brief Maps a motor command in [0, 1] to a frame value; anything at or below 0 stops the motor
+ */
+uint16_t throttle_value(float throttle);
+
+/**
+ * @brief Packs a value and telemetry request into a frame with its checksum
+ */
+uint16_t encode_frame(uint16_t value, bool request_telemetry);
+
+/**
+ * @brief Unpacks a frame
+ * @return False if the checksum doesn't match
+ */
+bool decode_frame(uint16_t frame, uint16_t *value, bool *request_telemetry);
+
+/**
+ * @brief Encodes the throttle of several channels at once
+ * @param telemetry_channel Channel that requests telemetry in this frame, or count for none
+ */
+void encode_throttles(const float throttle[], size_t count, size_t telemetry_channel, uint16_t frames[]);
+
+/**
+ * @brief Expands a frame into one timer compare value per bit, as loaded by DMA on the targets
+ * @param one_ticks High time of a 1 bit, in timer ticks (75% of the bit period)
+ * @param zero_ticks High time of a 0 bit, in timer ticks (37.5% of the bit period)
+ */
+void frame_to_pulses(uint16_t frame, uint16_t one_ticks, uint16_t zero_ticks, uint16_t pulses[FRAME_BITS]);
+
+} // namespace dshot
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_ESC_PROTOCOL_H
@@ -38,6 +38,10 @@
 
 #include <turbomath/turbomath.h>
 
+#include "altitude_estimator.h"
+#include "attitude_ekf.h"
+#include "attitude_history.h"
+#include "biquad_filter.h"
 #include "interface/param_listener.h"
 
 namespace rosflight_firmware
@@ -56,6 +60,8 @@ public:
     float roll;
     float pitch;
     float yaw;
+    float altitude;   // m above the calibrated ground level (or the ground, from a range sensor)
+    float climb_rate; // m/s, positive up
     uint64_t timestamp_us;
   };
 
@@ -63,11 +69,22 @@ public:
 
   inline const State &state() const { return state_; }
 
+  // True if the last run() updated the attitude, not just the angular velocity
+  inline bool attitude_updated() const { return attitude_updated_; }
+
+  // True if the altitude has been corrected by a barometer or range measurement recently
+  bool altitude_valid() const;
+
   inline const turbomath::Vector& bias()
   {
       return bias_;
   }
 
+  inline const AttitudeEkf &ekf() const { return ekf_; }
+
+  // Number of external attitude measurements dropped for being older than the attitude history
+  inline uint32_t extatt_dropped() const { return extatt_dropped_; }
+
   inline const turbomath::Vector& accLPF()
   {
       return accel_LPF_;
@@ -80,20 +97,77 @@ public:
 
   void init();
   void param_change_callback(uint16_t param_id) override;
+  void param_change_batch_callback(const uint16_t *param_ids, size_t num_ids) override;
   void run();
   void reset_state();
   void reset_adaptive_bias();
-  void set_external_attitude_update(const turbomath::Quaternion &q);
+
+  /**
+   * @brief Queues an external attitude measurement for the next attitude update
+   *
+   * The measurement is compared with the attitude estimate at timestamp_us, the IMU time it was
+   * taken at, and carried forward by the rotation estimated since then. Measurements older than the
+   * attitude history (a little over the largest EXT_ATT_DELAY) are dropped and counted.
+   */
+  void set_external_attitude_update(const turbomath::Quaternion &q, uint64_t timestamp_us);
+
+  /**
+   * @brief Moves the gyro notch on one axis, e.g. to track a motor noise peak
+   * @param sample_hz Rate at which the filtered gyro is updated, as measured by the caller. It
+   * overrides FILTER_RATE_HZ for the notch, which would misplace it if the loop runs at another rate.
+   * @return false if no notch is configured (GYRO_NOTCH_HZ is 0 and DYN_NOTCH is not set)
+   */
+  bool set_gyro_notch_center(uint8_t axis, float center_hz, float sample_hz);
 
 private:
+  // Attitude filter settings, cached from params
+  struct FilterParams
+  {
+    float kp_acc;
+    float kp_ext;
+    float kp_mag;
+    float ki;
+    uint64_t init_time_us;
+    float accel_alpha;
+    float gyro_xy_alpha;
+    float gyro_z_alpha;
+    float accel_lower_bound_sqrd; // squared accel norm bounds of the "non-accelerated" state
+    float accel_upper_bound_sqrd;
+    float mag_margin;  // allowed fractional deviation of the mag field strength from its average
+    float mag_north_x; // horizontal direction of magnetic north in the world frame (declination)
+    float mag_north_y;
+    bool use_acc;
+    bool use_mag;
+    bool use_quad_int;
+    bool use_mat_exp;
+    bool use_ekf;
+    bool fixed_wing;
+    uint32_t attitude_divisor; // attitude is propagated on every Nth IMU sample
+    float sample_rate_hz; // rate the filters are designed for, FILTER_RATE_HZ until it is measured
+    float gyro_notch_q;
+    float range_max; // range sensor readings up to this are used for altitude (m)
+    bool gyro_biquad; // biquad banks replace the single-pole alpha filters when a cutoff is set
+    bool accel_biquad;
+  };
+
   const turbomath::Vector g_ = {0.0f, 0.0f, -1.0f};
 
   ROSflight &RF_;
   State state_;
+  FilterParams filter_params_;
 
   uint64_t last_time_;
   uint64_t last_acc_update_us_;
   uint64_t last_extatt_update_us_;
+  uint64_t last_mag_update_us_;
+  uint64_t last_altitude_update_us_;
+  uint64_t last_mag_time_; // Sensors::Data::mag_time of the last mag sample used
+  float mag_norm_ref_;     // running average of the mag field strength, 0 until the first sample
+
+  uint32_t attitude_count_;
+  float attitude_dt_;
+  turbomath::Vector attitude_gyro_sum_;
+  bool attitude_updated_;
 
   turbomath::Vector w1_;
   turbomath::Vector w2_;
@@ -103,18 +177,43 @@ private:
   turbomath::Vector accel_LPF_;
   turbomath::Vector gyro_LPF_;
 
+  AttitudeEkf ekf_;
+  AltitudeEstimator altitude_;
+
+  FixedBiquadFilterBank<3> gyro_filter_; // up to two low-pass stages and the notch
+  FixedBiquadFilterBank<1> accel_filter_;
+  uint8_t gyro_notch_stage_; // BiquadFilterBank::MAX_STAGES if there is no notch
+  uint64_t filter_rate_start_us_;
+  uint32_t filter_rate_samples_;
+
   turbomath::Vector w_acc_;
 
   bool extatt_update_next_run_;
   turbomath::Quaternion q_extatt_;
-
+  uint64_t extatt_time_us_;
+  bool extatt_dropping_;
+  uint32_t extatt_dropped_;
+  AttitudeHistory attitude_history_;
+
+  void update_filter_params();
+  void reset_filter_rate();
+  void measure_filter_rate(uint64_t now_us);
+  void build_filter_banks();
   void run_LPF();
+  void run_alpha_LPF_accel();
+  void run_alpha_LPF_gyro();
+
+  void run_complementary_filter(const turbomath::Vector &gyro, float dt, uint64_t now_us);
+  void run_ekf(const turbomath::Vector &gyro, float dt, uint64_t now_us);
+  void run_altitude(float dt, uint64_t now_us);
 
   bool can_use_accel() const;
   bool can_use_extatt() const;
+  bool align_extatt(const turbomath::Quaternion &q_now, uint64_t now_us);
+  bool mag_heading_error(const turbomath::Quaternion &q, float *error);
   turbomath::Vector accel_correction() const;
   turbomath::Vector extatt_correction() const;
-  turbomath::Vector smoothed_gyro_measurement();
+  turbomath::Vector smoothed_gyro_measurement(const turbomath::Vector &gyro);
   void integrate_angular_rate(turbomath::Quaternion& quat,
           const turbomath::Vector& omega, const float dt) const;
   void quaternion_to_dcm(const turbomath::Quaternion& q, turbomath::Vector& X,
@@ -38,6 +38,7 @@
 
 #include "param.h"
 #include "board.h"
+#include "profiler.h"
 #include "sensors.h"
 #include "state_manager.h"
 
@@ -68,7 +69,9 @@ public:
     COMMAND_RC_CALIBRATION,
     COMMAND_REBOOT,
     COMMAND_REBOOT_TO_BOOTLOADER,
-    COMMAND_SEND_VERSION
+    COMMAND_SEND_VERSION,
+    COMMAND_PARAM_BATCH_BEGIN,
+    COMMAND_PARAM_BATCH_COMMIT
   };
 
   struct OffboardControl
@@ -77,7 +80,8 @@ public:
     {
       PASS_THROUGH,
       ROLLRATE_PITCHRATE_YAWRATE_THROTTLE,
-      ROLL_PITCH_YAWRATE_THROTTLE
+      ROLL_PITCH_YAWRATE_THROTTLE,
+      ROLL_PITCH_YAWRATE_ALTITUDE
     };
 
     struct Channel
@@ -135,6 +139,9 @@ public:
     virtual void init(uint32_t baud_rate, uint32_t dev) = 0;
     virtual void receive() = 0;
 
+    // hands everything queued by the send functions to the serial port
+    virtual void flush() = 0;
+
     // send functions
 
     virtual void send_attitude_quaternion(uint8_t system_id,
@@ -182,6 +189,16 @@ public:
     virtual void send_gnss_raw(uint8_t system_id, const GNSSRaw &data) = 0;
     virtual void send_error_data(uint8_t system_id, const StateManager::BackupData &error_data) = 0;
     virtual void send_battery_status(uint8_t system_id,float voltage, float current) = 0;
+    virtual void send_loop_profile(uint8_t system_id,
+                                   uint32_t timestamp_ms,
+                                   const char *const stage_name,
+                                   const Profiler::Stats &stats) = 0;
+    virtual void send_gyro_spectrum(uint8_t system_id,
+                                    uint32_t timestamp_ms,
+                                    uint8_t axis,
+                                    const SpectrumAnalyzer::Peak *peaks,
+                                    size_t num_peaks) = 0;
+    virtual void send_altitude(uint8_t system_id, uint32_t timestamp_ms, float altitude, float climb_rate) = 0;
 
     // register listener
     virtual void set_listener(ListenerInterface *listener) = 0;
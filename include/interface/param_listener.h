@@ -32,6 +32,7 @@
 #ifndef ROSFLIGHT_FIRMWARE_INTERFACE_PARAM_LISTENER_H
 #define ROSFLIGHT_FIRMWARE_INTERFACE_PARAM_LISTENER_H
 
+#include <cstddef>
 #include <cstdint>
 
 namespace rosflight_firmware
@@ -41,6 +42,19 @@ class ParamListenerInterface
 {
 public:
   virtual void param_change_callback(uint16_t param_id) = 0;
+
+  /**
+   * @brief Called once when a batch of parameter changes is committed
+   * Listeners whose callbacks do expensive re-initialization can override this to do it once per
+   * batch. The default forwards each id to param_change_callback.
+   * @param param_ids The IDs of the parameters that changed
+   * @param num_ids The length of the param_ids array
+   */
+  virtual void param_change_batch_callback(const uint16_t *param_ids, size_t num_ids)
+  {
+    for (size_t i = 0; i < num_ids; i++)
+      param_change_callback(param_ids[i]);
+  }
 };
 
 } // namespace rosflight_firmware
@@ -36,6 +36,7 @@
 #include <cstdint>
 #include <cstdbool>
 
+#include "esc_protocol.h"
 #include "interface/param_listener.h"
 
 namespace rosflight_firmware
@@ -65,6 +66,7 @@ public:
     TRICOPTER = 9,
     FIXEDWING = 10,
     PASSTHROUGH = 11,
+    CUSTOM = 12,
     NUM_MIXERS,
     INVALID_MIXER = 255
   };
@@ -87,6 +89,14 @@ public:
     uint32_t default_pwm_rate;
   } mixer_t;
 
+  // how mix_output() fits commands that would saturate the motors
+  enum SaturationMode
+  {
+    SATURATION_SCALE = 0,    // scale every output down by the largest one
+    SATURATION_PRIORITY = 1, // keep roll/pitch, then yaw, lowering thrust as needed
+    SATURATION_AIRMODE = 2,  // as SATURATION_PRIORITY, but thrust may also be raised
+  };
+
   typedef struct
   {
     output_type_t type;
@@ -98,18 +108,96 @@ public:
     aux_channel_t channel[NUM_TOTAL_OUTPUTS];
   } aux_command_t;
 
+  /**
+   * @brief Mixing matrix in the layout used by mix(), one row per command axis
+   *
+   * The columns of outputs the mixer doesn't use are zeroed, so every output can be computed the
+   * same way without branching on its type.
+   */
+  struct MixingMatrix
+  {
+    alignas(16) float F[NUM_MIXER_OUTPUTS];
+    alignas(16) float x[NUM_MIXER_OUTPUTS];
+    alignas(16) float y[NUM_MIXER_OUTPUTS];
+    alignas(16) float z[NUM_MIXER_OUTPUTS];
+    alignas(16) float motor[NUM_MIXER_OUTPUTS]; // 1 for motor outputs, 0 otherwise
+
+    // motor-only thrust column and the inverses of the thrust and yaw columns (0 where an output
+    // doesn't respond), used to desaturate without dividing
+    alignas(16) float motor_F[NUM_MIXER_OUTPUTS];
+    alignas(16) float inv_motor_F[NUM_MIXER_OUTPUTS];
+    alignas(16) float inv_motor_z[NUM_MIXER_OUTPUTS];
+  };
+
+  /**
+   * @brief Builds the mixing matrix for a mixer definition
+   */
+  static void load_matrix(const mixer_t &mixer, MixingMatrix &matrix);
+
+  /**
+   * @brief Mixes a command into all mixer outputs, scaling them down uniformly if any exceeds 1
+   */
+  static void mix(const MixingMatrix &matrix, float F, float x, float y, float z,
+                  float outputs[NUM_MIXER_OUTPUTS]);
+
+  /**
+   * @brief Mixes a command, giving up thrust, then yaw, then roll/pitch to keep the motors in range
+   *
+   * Thrust is shifted along the thrust column to fit roll, pitch and yaw. If that is not enough,
+   * yaw is reduced, and roll and pitch are scaled down only if they alone exceed the motor range.
+   * Unless allow_thrust_increase is set, thrust is only ever lowered. Only motor outputs are
+   * desaturated, and the work is a fixed number of passes over the outputs.
+   */
+  static void mix_prioritized(const MixingMatrix &matrix, float F, float x, float y, float z,
+                              bool allow_thrust_increase, float outputs[NUM_MIXER_OUTPUTS]);
+
 private:
+  // Motor and servo output settings, cached from params
+  struct OutputParams
+  {
+    float motor_idle_throttle;
+    bool spin_motors_when_armed;
+    bool fixed_wing;
+    float aileron_sign;
+    float elevator_sign;
+    float rudder_sign;
+    SaturationMode saturation_mode;
+    bool esc_telemetry;
+  };
+
   ROSflight& RF_;
 
+  OutputParams output_params_;
+  MixingMatrix mixing_;
   float raw_outputs_[NUM_TOTAL_OUTPUTS];
-  float outputs_[NUM_TOTAL_OUTPUTS];
+  alignas(16) float outputs_[NUM_TOTAL_OUTPUTS];
   aux_command_t aux_command_;
   output_type_t combined_output_type_[NUM_TOTAL_OUTPUTS];
 
-  void write_motor(uint8_t index, float value);
-  void write_servo(uint8_t index, float value);
-
-  const mixer_t esc_calibration_mixing =
+  // motors driven by digital ESCs are collected during a mix and sent to the board together
+  bool esc_digital_ = false;
+  uint16_t esc_channel_mask_ = 0;
+  uint8_t esc_telemetry_channel_ = 0;
+  float esc_throttle_[NUM_MIXER_OUTPUTS];
+  uint16_t esc_frames_[NUM_MIXER_OUTPUTS];
+
+  // what is handed to Board::pwm_write_all; channels on digital ESCs are marked NONE
+  float pwm_values_[NUM_TOTAL_OUTPUTS];
+  output_type_t pwm_types_[NUM_TOTAL_OUTPUTS];
+
+  void update_output_params();
+  void load_custom_mixer();
+
+  static float inverse_gain(float gain);
+  static float desaturation_gain(const float inv_direction[NUM_MIXER_OUTPUTS], const float outputs[NUM_MIXER_OUTPUTS]);
+  static float minimize_saturation(const float direction[NUM_MIXER_OUTPUTS], const float inv_direction[NUM_MIXER_OUTPUTS],
+                                   float outputs[NUM_MIXER_OUTPUTS], float min_gain, float max_gain);
+  void init_esc();
+  void write_esc_frames();
+  void write_outputs();
+
+  // The built-in mixers are static so that they live in flash rather than in every Mixer's RAM
+  static constexpr mixer_t esc_calibration_mixing =
   {
     {M, M, M, M, M, M, NONE, NONE},
     { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}, // F Mix
@@ -119,7 +207,7 @@ private:
     490
   };
 
-  const mixer_t quadcopter_plus_mixing =
+  static constexpr mixer_t quadcopter_plus_mixing =
   {
     {M, M, M, M, NONE, NONE, NONE, NONE}, // output_type
 
@@ -130,7 +218,7 @@ private:
     490
   };
 
-  const mixer_t quadcopter_x_mixing =
+  static constexpr mixer_t quadcopter_x_mixing =
   {
     {M, M, M, M, NONE, NONE, NONE, NONE}, // output_type
 
@@ -141,7 +229,7 @@ private:
     490
   };
 
-  const mixer_t hex_plus_mixing =
+  static constexpr mixer_t hex_plus_mixing =
   {
     {M, M, M, M, M, M, M, M}, // output_type
 
@@ -152,7 +240,7 @@ private:
     490
   };
 
-  const mixer_t hex_x_mixing =
+  static constexpr mixer_t hex_x_mixing =
   {
     {M, M, M, M, M, M, M, M}, // output_type
 
@@ -163,7 +251,7 @@ private:
     490
   };
 
-  const mixer_t octocopter_plus_mixing =
+  static constexpr mixer_t octocopter_plus_mixing =
   {
     {M, M, M, M, M, M, M, M}, // output_type
 
@@ -174,7 +262,7 @@ private:
     490
   };
 
-  const mixer_t octocopter_x_mixing =
+  static constexpr mixer_t octocopter_x_mixing =
   {
     {M, M, M, M, M, M, M, M}, // output_type
 
@@ -185,7 +273,7 @@ private:
     490
   };
 
-  const mixer_t Y6_mixing =
+  static constexpr mixer_t Y6_mixing =
   {
     {M, M, M, M, M, M, NONE, NONE}, // output_type
 
@@ -196,7 +284,7 @@ private:
     490
   };
 
-  const mixer_t X8_mixing =
+  static constexpr mixer_t X8_mixing =
   {
     {M, M, M, M, M, M, M, M}, // output_type
 
@@ -207,7 +295,7 @@ private:
     490
   };
 
-  const mixer_t tricopter_mixing =
+  static constexpr mixer_t tricopter_mixing =
   {
     {M, M, M, S, NONE, NONE, NONE, NONE}, // output_type
 
@@ -218,7 +306,7 @@ private:
     490
   };
 
-  const mixer_t fixedwing_mixing =
+  static constexpr mixer_t fixedwing_mixing =
   {
     {S, S, M, S, S, M, NONE, NONE},
 
@@ -229,7 +317,7 @@ private:
     50
   };
 
-  const mixer_t passthrough_mixing =
+  static constexpr mixer_t passthrough_mixing =
   {
     {NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE},
 
@@ -240,6 +328,9 @@ private:
     50
   };
 
+  // loaded from the MIX_* parameters
+  mixer_t custom_mixing_;
+
   const mixer_t *mixer_to_use_;
 
   const mixer_t *array_of_mixers_[NUM_MIXERS] =
@@ -255,7 +346,8 @@ private:
     &X8_mixing,
     &tricopter_mixing,
     &fixedwing_mixing,
-    &passthrough_mixing
+    &passthrough_mixing,
+    &custom_mixing_
   };
 
 public:
@@ -265,8 +357,14 @@ public:
   void init_mixing();
   void mix_output();
   void param_change_callback(uint16_t param_id) override;
+  void param_change_batch_callback(const uint16_t *param_ids, size_t num_ids) override;
   void set_new_aux_command(aux_command_t new_aux_command);
   inline const float* get_outputs() const {return raw_outputs_;}
+  inline bool esc_digital() const { return esc_digital_; }
+  inline const mixer_t* get_mixer(uint8_t mixer_id) const
+  {
+    return (mixer_id < NUM_MIXERS) ? array_of_mixers_[mixer_id] : nullptr;
+  }
 };
 
 } // namespace rosflight_firmware
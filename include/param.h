@@ -37,6 +37,14 @@
 
 #include "interface/param_listener.h"
 
+#include "param_store.h"
+
+// The log-structured parameter store needs a board that implements Board::memory_sector_*. None of
+// the flight controller boards do yet, so it is only built in where enabled (the unit tests do).
+#ifndef ROSFLIGHT_PARAM_STORE
+#define ROSFLIGHT_PARAM_STORE 0
+#endif
+
 namespace rosflight_firmware
 {
 
@@ -67,6 +75,9 @@ enum : uint16_t
 
   PARAM_STREAM_OUTPUT_RAW_RATE,
   PARAM_STREAM_RC_RAW_RATE,
+  PARAM_STREAM_LOOP_PROFILE_RATE,
+  PARAM_STREAM_GYRO_SPECTRUM_RATE,
+  PARAM_STREAM_ALTITUDE_RATE,
 
 
   /********************************/
@@ -100,6 +111,13 @@ enum : uint16_t
 
   PARAM_PID_TAU,
 
+  PARAM_PID_ALT_P,
+  PARAM_PID_CLIMB_P,
+  PARAM_PID_CLIMB_I,
+  PARAM_PID_CLIMB_D,
+  PARAM_HOVER_THROTTLE,
+  PARAM_ALT_MAX_CLIMB,
+
   /*************************/
   /*** PWM CONFIGURATION ***/
   /*************************/
@@ -107,6 +125,8 @@ enum : uint16_t
   PARAM_MOTOR_IDLE_THROTTLE,
   PARAM_FAILSAFE_THROTTLE,
   PARAM_SPIN_MOTORS_WHEN_ARMED,
+  PARAM_MOTOR_PROTOCOL,
+  PARAM_ESC_TELEMETRY,
 
   /*******************************/
   /*** ESTIMATOR CONFIGURATION ***/
@@ -115,17 +135,43 @@ enum : uint16_t
   PARAM_FILTER_KP_ACC,
   PARAM_FILTER_KI,
   PARAM_FILTER_KP_EXT,
+  PARAM_EXT_ATT_DELAY,
   PARAM_FILTER_ACCEL_MARGIN,
 
   PARAM_FILTER_USE_QUAD_INT,
   PARAM_FILTER_USE_MAT_EXP,
   PARAM_FILTER_USE_ACC,
+  PARAM_ATTITUDE_DIVISOR,
+  PARAM_FILTER_USE_EKF,
+  PARAM_EKF_GYRO_NOISE,
+  PARAM_EKF_GYRO_BIAS_NOISE,
+  PARAM_EKF_ACCEL_NOISE,
+  PARAM_EKF_ACCEL_BIAS,
+  PARAM_EKF_ACCEL_BIAS_NOISE,
+  PARAM_EKF_ATTITUDE_NOISE,
+  PARAM_FILTER_USE_MAG,
+  PARAM_FILTER_KP_MAG,
+  PARAM_FILTER_MAG_MARGIN,
+  PARAM_EKF_HEADING_NOISE,
+  PARAM_ALT_BARO_TAU,
+  PARAM_ALT_RANGE_TAU,
+  PARAM_ALT_RANGE_MAX,
 
   PARAM_CALIBRATE_GYRO_ON_ARM,
 
   PARAM_GYRO_XY_ALPHA,
   PARAM_GYRO_Z_ALPHA,
   PARAM_ACC_ALPHA,
+  PARAM_FILTER_SAMPLE_RATE,
+  PARAM_GYRO_LPF_CUTOFF,
+  PARAM_GYRO_LPF_STAGES,
+  PARAM_GYRO_NOTCH_CENTER,
+  PARAM_GYRO_NOTCH_Q,
+  PARAM_ACC_LPF_CUTOFF,
+  PARAM_GYRO_FFT_ENABLE,
+  PARAM_GYRO_FFT_MIN_FREQ,
+  PARAM_DYN_NOTCH_ENABLE,
+  PARAM_DYN_NOTCH_MIN_AMP,
 
   PARAM_GYRO_X_BIAS,
   PARAM_GYRO_Y_BIAS,
@@ -149,6 +195,7 @@ enum : uint16_t
   PARAM_MAG_X_BIAS,
   PARAM_MAG_Y_BIAS,
   PARAM_MAG_Z_BIAS,
+  PARAM_MAG_DECLINATION,
 
   PARAM_BARO_BIAS,
   PARAM_GROUND_LEVEL,
@@ -189,6 +236,7 @@ enum : uint16_t
   /*** FRAME CONFIGURATION ***/
   /***************************/
   PARAM_MIXER,
+  PARAM_MIXER_SATURATION_MODE,
 
   PARAM_FIXED_WING,
   PARAM_ELEVATOR_REVERSE,
@@ -199,6 +247,54 @@ enum : uint16_t
   PARAM_FC_PITCH,
   PARAM_FC_YAW,
 
+  /********************/
+  /*** CUSTOM MIXER ***/
+  /********************/
+  PARAM_MIXER_CUSTOM_TYPE_0,
+  PARAM_MIXER_CUSTOM_TYPE_1,
+  PARAM_MIXER_CUSTOM_TYPE_2,
+  PARAM_MIXER_CUSTOM_TYPE_3,
+  PARAM_MIXER_CUSTOM_TYPE_4,
+  PARAM_MIXER_CUSTOM_TYPE_5,
+  PARAM_MIXER_CUSTOM_TYPE_6,
+  PARAM_MIXER_CUSTOM_TYPE_7,
+
+  PARAM_MIXER_CUSTOM_F_0,
+  PARAM_MIXER_CUSTOM_F_1,
+  PARAM_MIXER_CUSTOM_F_2,
+  PARAM_MIXER_CUSTOM_F_3,
+  PARAM_MIXER_CUSTOM_F_4,
+  PARAM_MIXER_CUSTOM_F_5,
+  PARAM_MIXER_CUSTOM_F_6,
+  PARAM_MIXER_CUSTOM_F_7,
+
+  PARAM_MIXER_CUSTOM_X_0,
+  PARAM_MIXER_CUSTOM_X_1,
+  PARAM_MIXER_CUSTOM_X_2,
+  PARAM_MIXER_CUSTOM_X_3,
+  PARAM_MIXER_CUSTOM_X_4,
+  PARAM_MIXER_CUSTOM_X_5,
+  PARAM_MIXER_CUSTOM_X_6,
+  PARAM_MIXER_CUSTOM_X_7,
+
+  PARAM_MIXER_CUSTOM_Y_0,
+  PARAM_MIXER_CUSTOM_Y_1,
+  PARAM_MIXER_CUSTOM_Y_2,
+  PARAM_MIXER_CUSTOM_Y_3,
+  PARAM_MIXER_CUSTOM_Y_4,
+  PARAM_MIXER_CUSTOM_Y_5,
+  PARAM_MIXER_CUSTOM_Y_6,
+  PARAM_MIXER_CUSTOM_Y_7,
+
+  PARAM_MIXER_CUSTOM_Z_0,
+  PARAM_MIXER_CUSTOM_Z_1,
+  PARAM_MIXER_CUSTOM_Z_2,
+  PARAM_MIXER_CUSTOM_Z_3,
+  PARAM_MIXER_CUSTOM_Z_4,
+  PARAM_MIXER_CUSTOM_Z_5,
+  PARAM_MIXER_CUSTOM_Z_6,
+  PARAM_MIXER_CUSTOM_Z_7,
+
   /********************/
   /*** ARMING SETUP ***/
   /********************/
@@ -217,6 +313,11 @@ enum : uint16_t
   PARAM_BATTERY_VOLTAGE_ALPHA,
   PARAM_BATTERY_CURRENT_ALPHA,
 
+  /*****************/
+  /*** PROFILING ***/
+  /*****************/
+  PARAM_LOOP_BUDGET_US,
+
   // keep track of size of params array
   PARAMS_COUNT
 };
@@ -263,6 +364,23 @@ private:
   void init_param_float(uint16_t id, const char name[PARAMS_NAME_LENGTH], float value);
   uint8_t compute_checksum(void);
 
+#if ROSFLIGHT_PARAM_STORE
+  // log-structured flash storage, used instead of memory_read/memory_write when the board supports it
+  ParamStore store_;
+  int32_t persisted_[PARAMS_COUNT];
+#endif
+
+  // parameter ids ordered by name, for binary search in lookup_param_id
+  uint16_t sorted_ids_[PARAMS_COUNT];
+  void build_name_index(void);
+
+  // batched changes
+  uint8_t batch_depth_;
+  uint32_t dirty_[(PARAMS_COUNT + 31)/32];
+  uint16_t changed_ids_[PARAMS_COUNT];
+  void mark_dirty(uint16_t id);
+  void notify_listeners(const uint16_t *ids, size_t num_ids);
+
   ParamListenerInterface *const * listeners_;
   size_t num_listeners_;
 
@@ -307,6 +425,35 @@ public:
    */
   void change_callback(uint16_t id);
 
+  /**
+   * @brief Calls the change callback for every parameter, for when all values were replaced at once
+   */
+  void change_callback_all(void);
+
+  /**
+   * @brief Starts a batch of parameter changes
+   * While a batch is open, stage_param_int and stage_param_float only store the new value and mark
+   * it dirty. Listener callbacks and PARAM_VALUE messages are deferred to commit_batch(). Changes
+   * made with set_param_int and set_param_float, which the firmware uses for its own writes, still
+   * take effect immediately. Batches nest, and only the outermost commit_batch() takes effect.
+   */
+  void begin_batch(void);
+
+  /**
+   * @brief Ends a batch of parameter changes
+   * Each listener receives a single param_change_batch_callback() with every id that changed, and
+   * one PARAM_VALUE per changed id is queued for the low priority stream.
+   */
+  void commit_batch(void);
+
+  /**
+   * @brief Whether a batch of parameter changes is currently open
+   */
+  inline bool batch_active(void) const
+  {
+    return batch_depth_ > 0;
+  }
+
   /**
    * @brief Gets the id of a parameter from its name
    * @param name The name of the parameter
@@ -373,6 +520,22 @@ public:
    */
   bool set_param_float(uint16_t id, float value);
 
+  /**
+   * @brief Sets the value of an integer parameter on behalf of the ground station
+   * Same as set_param_int, except that the change is deferred to commit_batch() while a batch is
+   * open
+   * @return True if a parameter value was changed, false otherwise
+   */
+  bool stage_param_int(uint16_t id, int32_t value);
+
+  /**
+   * @brief Sets the value of a floating point parameter on behalf of the ground station
+   * Same as set_param_float, except that the change is deferred to commit_batch() while a batch is
+   * open
+   * @return True if a parameter value was changed, false otherwise
+   */
+  bool stage_param_float(uint16_t id, float value);
+
   /**
    * @brief Sets the value of a parameter by name and calls the parameter change callback
    * @param name The name of the parameter
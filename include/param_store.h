@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_PARAM_STORE_H
+#define ROSFLIGHT_FIRMWARE_PARAM_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rosflight_firmware
+{
+
+class Board;
+
+/**
+ * @brief Append-only, log-structured storage for parameter values
+ *
+ * Uses the two flash sectors exposed through Board::memory_sector_*. The active sector starts with a
+ * header, followed by one record per saved value change. A save appends records only for values that
+ * changed since the last save. When the active sector is full, all values are compacted into the
+ * other sector, so erases alternate between the two. Each record and the header carry their own
+ * checksum. A torn record from an interrupted write is skipped on replay, and an interrupted
+ * compaction leaves the previous sector in use.
+ *
+ * Parameter names and types are not stored. They come from the firmware defaults, and the header
+ * records the firmware version so that a log written by different firmware is not replayed.
+ */
+class ParamStore
+{
+public:
+  explicit ParamStore(Board &board);
+
+  /**
+   * @brief Whether the board provides flash sectors large enough to hold count values
+   */
+  bool available(uint16_t count);
+
+  /**
+   * @brief Finds the newest valid sector written by this firmware version
+   * @return True if a sector was found; replay() may then be called
+   */
+  bool open(uint32_t version, uint16_t count);
+
+  /**
+   * @brief Replays the log of the sector found by open() into values
+   * @param values Array of count raw parameter values, updated in place
+   * @param persisted Array of count values that receives a copy of the stored state
+   */
+  void replay(int32_t values[], int32_t persisted[], uint16_t count);
+
+  /**
+   * @brief Persists the values that differ from persisted, compacting into the other sector if needed
+   * @param values Current raw parameter values
+   * @param persisted Values known to be in flash; updated as records are written
+   * @return True if successful, false otherwise
+   */
+  bool save(uint32_t version, const int32_t values[], int32_t persisted[], uint16_t count);
+
+  inline uint32_t compactions() const { return compactions_; }
+  inline size_t bytes_free() const { return sector_size_ > append_offset_ ? sector_size_ - append_offset_ : 0; }
+
+private:
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t version;
+    uint16_t count;
+    uint16_t chk;
+  };
+
+  struct Record
+  {
+    uint16_t id;
+    uint16_t chk;
+    int32_t value;
+  };
+
+  static constexpr uint32_t MAGIC = 0x50524D4C;
+  static constexpr uint8_t NUM_SECTORS = 2;
+  static constexpr uint8_t NO_SECTOR = 0xFF;
+  static constexpr size_t READ_CHUNK_RECORDS = 16;
+
+  bool read_header(uint8_t sector, Header *header);
+  bool compact(uint32_t version, const int32_t values[], int32_t persisted[], uint16_t count);
+
+  static uint16_t header_checksum(const Header &header);
+  static uint16_t record_checksum(const Record &record);
+  static bool record_erased(const Record &record);
+
+  Board &board_;
+  size_t sector_size_ = 0;
+  uint8_t active_sector_ = NO_SECTOR;
+  uint32_t sequence_ = 0;
+  size_t append_offset_ = 0;
+  uint32_t compactions_ = 0;
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_PARAM_STORE_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_PROFILER_H
+#define ROSFLIGHT_FIRMWARE_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "interface/param_listener.h"
+
+// The p99 histograms take about 1.3 KB of RAM. Targets without room for them build with
+// ROSFLIGHT_PROFILER_HISTOGRAM=0, and then report the max in place of the p99.
+#ifndef ROSFLIGHT_PROFILER_HISTOGRAM
+#define ROSFLIGHT_PROFILER_HISTOGRAM 1
+#endif
+
+namespace rosflight_firmware
+{
+
+class ROSflight;
+
+/**
+ * @brief Per-stage timing statistics for the main loop
+ *
+ * Each stage of ROSflight::run() is timed with Board::clock_cycles(). For every stage the
+ * profiler keeps the sample count, min, max, mean, an approximate 99th percentile (from a
+ * log-spaced histogram with two buckets per octave) and the number of overruns. An overrun
+ * is charged to the stage that was executing when the main loop exceeded PARAM_LOOP_BUDGET_US,
+ * so the overrun counts show which subsystem pushed the loop over its budget.
+ */
+class Profiler : public ParamListenerInterface
+{
+public:
+  enum Stage
+  {
+    STAGE_SENSORS,
+    STAGE_ESTIMATOR,
+    STAGE_CONTROLLER,
+    STAGE_MIXER,
+    STAGE_COMM_STREAM,
+    STAGE_COMM_RECEIVE,
+    STAGE_STATE_MANAGER,
+    STAGE_RC,
+    STAGE_COMMAND_MANAGER,
+    STAGE_LOOP, // the entire main loop
+    STAGE_COUNT
+  };
+
+  struct Stats
+  {
+    uint32_t count;
+    float min_us;
+    float mean_us;
+    float p99_us;
+    float max_us;
+    uint32_t overruns;
+  };
+
+  /**
+   * @brief Receives each stage time as it is recorded, for tools that want every sample rather
+   * than the summary statistics (e.g. the SIL benchmark)
+   */
+  class Listener
+  {
+  public:
+    virtual void stage_timed(Stage stage, uint32_t cycles) = 0;
+  };
+
+  Profiler(ROSflight &rf);
+
+  void init();
+  void param_change_callback(uint16_t param_id) override;
+
+  void start_loop();
+  void end_stage(Stage stage);
+  void end_loop();
+
+  Stats stats(Stage stage) const;
+  void reset(Stage stage);
+
+  static const char *stage_name(Stage stage);
+
+  inline void set_listener(Listener *listener) { listener_ = listener; }
+
+private:
+  static constexpr int NUM_BUCKETS = 64;
+
+  struct StageData
+  {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t overruns;
+#if ROSFLIGHT_PROFILER_HISTOGRAM
+    uint16_t histogram[NUM_BUCKETS];
+#endif
+  };
+
+  ROSflight &RF_;
+
+  StageData stages_[STAGE_COUNT];
+  uint32_t cycles_per_us_ = 1;
+  uint32_t budget_cycles_ = 0;
+  uint32_t loop_start_ = 0;
+  uint32_t stage_start_ = 0;
+  bool over_budget_ = false;
+  Listener *listener_ = nullptr;
+
+  void record(Stage stage, uint32_t cycles);
+  static int bucket(uint32_t cycles);
+  static uint32_t bucket_upper_bound(int bucket);
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_PROFILER_H
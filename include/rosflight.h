@@ -47,6 +47,7 @@
 #include "mixer.h"
 #include "state_manager.h"
 #include "command_manager.h"
+#include "profiler.h"
 
 namespace rosflight_firmware
 {
@@ -69,6 +70,7 @@ public:
   RC rc_;
   Sensors sensors_;
   StateManager state_manager_;
+  Profiler profiler_;
 
   uint32_t loop_time_us;
 
@@ -85,7 +87,7 @@ public:
   uint32_t get_loop_time_us();
 
 private:
-  static constexpr size_t num_param_listeners_ = 7;
+  static constexpr size_t num_param_listeners_ = 8;
   ParamListenerInterface * const param_listeners_[num_param_listeners_] = {
     &comm_manager_,
     &command_manager_,
@@ -93,7 +95,8 @@ private:
     &estimator_,
     &mixer_,
     &rc_,
-    &sensors_
+    &sensors_,
+    &profiler_
   };
 };
 
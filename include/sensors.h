@@ -39,6 +39,7 @@
 #include <turbomath/turbomath.h>
 
 #include "interface/param_listener.h"
+#include "spectrum_analyzer.h"
 
 namespace rosflight_firmware
 {
@@ -124,6 +125,15 @@ struct GNSSRaw
   }
 };
 
+// One accelerometer and gyro sample, in the IMU frame and units of imu_read()
+struct ImuSample
+{
+  float accel[3];
+  float gyro[3];
+  float temperature;
+  uint64_t time_us;
+};
+
 class ROSflight;
 
 class Sensors : public ParamListenerInterface
@@ -157,6 +167,7 @@ public:
     GNSSRaw gnss_raw;
 
     turbomath::Vector mag = {0, 0, 0};
+    uint64_t mag_time = 0; // board time of the last mag read (us), 0 before the first one
 
     bool baro_present = false;
     bool mag_present = false;
@@ -173,10 +184,16 @@ public:
   inline const Data &data() const { return data_; }
   void get_filtered_IMU(turbomath::Vector &accel, turbomath::Vector &gyro, uint64_t &stamp_us);
 
+#if ROSFLIGHT_GYRO_SPECTRUM
+  // Vibration peaks of the corrected gyro, updated while GYRO_FFT is set
+  inline const SpectrumAnalyzer &gyro_spectrum() const { return gyro_spectrum_; }
+#endif
+
   // function declarations
   void init();
   bool run();
   void param_change_callback(uint16_t param_id) override;
+  void param_change_batch_callback(const uint16_t *param_ids, size_t num_ids) override;
 
   // Calibration Functions
   bool start_imu_calibration(void);
@@ -184,6 +201,7 @@ public:
   bool start_baro_calibration(void);
   bool start_diff_pressure_calibration(void);
   bool gyro_calibration_complete(void);
+  inline bool baro_calibration_complete(void) const { return baro_calibrated_; }
 
   inline bool should_send_imu_data(void)
   {
@@ -206,6 +224,7 @@ private:
   static const float BARO_MAX_CALIBRATION_VARIANCE;
   static const float DIFF_PRESSURE_MAX_CALIBRATION_VARIANCE;
   static constexpr uint32_t BATTERY_MONITOR_UPDATE_PERIOD_MS = 10;
+  static constexpr size_t IMU_FIFO_SIZE = 16; // samples read per loop, enough for 8 kHz at 500 Hz
 
   class OutlierFilter
   {
@@ -232,30 +251,52 @@ private:
     NUM_LOW_PRIORITY_SENSORS
   };
 
+  // IMU and mag calibration and board orientation, cached from params
+  struct CalibrationParams
+  {
+    turbomath::Vector accel_bias;
+    turbomath::Vector accel_temp_comp;
+    turbomath::Vector gyro_bias;
+    turbomath::Vector mag_bias;
+    float mag_soft_iron[3][3];
+    float fcu_rotation[3][3]; // PARAM_FC_ROLL/PITCH/YAW as a matrix, rows of fcu_orientation.rotate()
+  };
+
   ROSflight &rf_;
 
   Data data_;
+  CalibrationParams cal_;
+
+  ImuSample imu_fifo_[IMU_FIFO_SIZE];
 
-  float accel_[3] = {0, 0, 0};
-  float gyro_[3] = {0, 0, 0};
+#if ROSFLIGHT_GYRO_SPECTRUM
+  SpectrumAnalyzer gyro_spectrum_;
+#endif
+  bool gyro_fft_enabled_ = false;
+  bool dyn_notch_enabled_ = false;
+  float dyn_notch_min_amplitude_ = 0.0f;
 
   bool calibrating_acc_flag_ = false;
   bool calibrating_gyro_flag_ = false;
   uint8_t next_sensor_to_update_ = BAROMETER;
   void init_imu();
+  void update_calibration_params(void);
   void calibrate_accel(void);
   void calibrate_gyro(void);
   void calibrate_baro(void);
   void calibrate_diff_pressure(void);
-  void correct_imu(void);
   void correct_mag(void);
   void correct_baro(void);
   void correct_diff_pressure(void);
   bool update_imu(void);
+  void calibrate_imu_batch(size_t count);
+  void correct_imu_batch(size_t count);
   void update_battery_monitor(void);
   void update_other_sensors(void);
   void look_for_disabled_sensors(void);
   void update_battery_monitor_multipliers(void);
+  void update_gyro_spectrum_params(void);
+  void update_gyro_spectrum(bool got_imu);
   uint32_t last_time_look_for_disarmed_sensors_ = 0;
   uint32_t last_imu_update_ms_ = 0;
 
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_SERIAL_TX_BUFFER_H
+#define ROSFLIGHT_FIRMWARE_SERIAL_TX_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Boards short on RAM build with a smaller buffer (see boards/breezy/Makefile). It is split between
+// the priorities in quarters, so keep it a multiple of 4 and big enough for the largest message at
+// low priority.
+#ifndef ROSFLIGHT_SERIAL_TX_BUFFER_SIZE
+#define ROSFLIGHT_SERIAL_TX_BUFFER_SIZE 1024
+#endif
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Contiguous transmit buffer that collects one loop's worth of outgoing messages
+ *
+ * Messages are serialized directly into the buffer (reserve() / commit()). The whole buffer is
+ * then handed to the board in a single write and cleared. When space runs short, lower priority
+ * messages are dropped first. Each priority may only fill the buffer up to its own limit, so there
+ * is always room left for higher priority traffic.
+ */
+class SerialTxBuffer
+{
+public:
+  enum Priority : uint8_t
+  {
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+    PRIORITY_COUNT
+  };
+
+  static constexpr size_t CAPACITY = ROSFLIGHT_SERIAL_TX_BUFFER_SIZE;
+  static_assert(CAPACITY % 4 == 0 && CAPACITY >= 256, "unsupported serial transmit buffer size");
+
+  /**
+   * @brief Reserves contiguous space for a message
+   * @param max_len Upper bound on the serialized length of the message
+   * @param priority Priority of the message, used to decide whether it is dropped
+   * @return Pointer to max_len writable bytes, or nullptr if the message must be dropped
+   */
+  uint8_t *reserve(size_t max_len, Priority priority);
+
+  /**
+   * @brief Commits the message written into the last reserved space
+   * @param len Actual serialized length, at most the max_len passed to reserve()
+   */
+  void commit(size_t len);
+
+  /**
+   * @brief Copies a serialized message into the buffer
+   * @return True if the message was queued, false if it was dropped
+   */
+  bool push(const uint8_t *src, size_t len, Priority priority);
+
+  inline const uint8_t *data() const { return buf_; }
+  inline size_t size() const { return len_; }
+  inline void clear() { len_ = 0; }
+
+  inline uint32_t dropped(Priority priority) const { return dropped_[priority]; }
+
+private:
+  // fraction of the buffer (in 1/4ths) that each priority is allowed to fill
+  static constexpr size_t LIMIT_QUARTERS[PRIORITY_COUNT] = {2, 3, 4};
+
+  uint8_t buf_[CAPACITY];
+  size_t len_ = 0;
+  size_t reserved_ = 0;
+  uint32_t dropped_[PRIORITY_COUNT] = {0, 0, 0};
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_SERIAL_TX_BUFFER_H
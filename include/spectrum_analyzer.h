@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_SPECTRUM_ANALYZER_H
+#define ROSFLIGHT_FIRMWARE_SPECTRUM_ANALYZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The analyzer takes about 3.5 KB of RAM. Targets without room for it build with
+// ROSFLIGHT_GYRO_SPECTRUM=0, which leaves it out of Sensors.
+#ifndef ROSFLIGHT_GYRO_SPECTRUM
+#define ROSFLIGHT_GYRO_SPECTRUM 1
+#endif
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Finds the dominant vibration frequencies of a three-axis signal
+ *
+ * Samples are collected into frames of FFT_SIZE with 50% overlap. Each frame is Hann windowed and
+ * transformed with a real FFT (a half-size complex radix-2 FFT followed by a split step), and the
+ * largest local maxima of the magnitude spectrum are reported with their frequency interpolated
+ * between bins. The transform is done in small steps, one per call to update(), so that no single
+ * loop iteration pays for a whole FFT. A frame takes STEPS_PER_FRAME calls. Samples keep being
+ * collected while a frame is processed, in the same ring buffer. If the next frame fills before the
+ * previous one is done, it is skipped and collection starts over once the ring has room again.
+ */
+class SpectrumAnalyzer
+{
+public:
+  static constexpr size_t FFT_SIZE = 128;
+  static constexpr size_t NUM_BINS = FFT_SIZE / 2 + 1;
+  static constexpr uint8_t NUM_AXES = 3;
+  static constexpr uint8_t NUM_PEAKS = 3;
+
+  struct Peak
+  {
+    float frequency_hz;
+    float amplitude; // of the sinusoid at this frequency, in the units of the input
+  };
+
+  SpectrumAnalyzer();
+
+  /**
+   * @brief Discards collected samples and results and sets the lowest frequency reported as a peak
+   */
+  void init(float min_frequency_hz);
+
+  /**
+   * @brief Adds one sample. The sample rate is measured from the timestamps of each frame.
+   */
+  void add_sample(const float value[NUM_AXES], uint64_t time_us);
+
+  /**
+   * @brief Does one step of work on the pending frame, if there is one
+   * @return true if this step finished a frame and new peaks are available
+   */
+  bool update();
+
+  /**
+   * @brief Peaks of the last finished frame on one axis, largest first. Unused entries have zero
+   * frequency and amplitude.
+   */
+  inline const Peak *peaks(uint8_t axis) const { return peaks_[axis]; }
+
+  inline float sample_rate_hz() const { return result_sample_rate_hz_; }
+  inline uint32_t num_results() const { return num_results_; }
+
+  /**
+   * @brief Calls to update() needed to process one frame
+   */
+  static constexpr uint8_t STEPS_PER_FRAME = NUM_AXES * (1 + 6 + 2); // window, FFT stages, split, peaks
+
+private:
+  static constexpr size_t HALF_SIZE = FFT_SIZE / 2; // size of the complex FFT
+  static constexpr uint8_t LOG2_HALF_SIZE = 6;
+  static constexpr size_t RING_SIZE = FFT_SIZE + HALF_SIZE; // a frame and the next half frame
+
+  enum Step : uint8_t
+  {
+    STEP_WINDOW,
+    STEP_FFT_STAGE,
+    STEP_SPLIT = STEP_FFT_STAGE + LOG2_HALF_SIZE,
+    STEP_PEAKS,
+    STEP_IDLE
+  };
+
+  // cos(2*pi*k/FFT_SIZE), which also gives the sines and the window, and the bit-reversal
+  // permutation, computed once in the constructor
+  float cos_table_[HALF_SIZE + 1];
+  uint8_t bit_reverse_[HALF_SIZE];
+
+  // Samples, written around the ring. The frame being processed is read straight out of it while
+  // the next one is collected behind it.
+  float input_[NUM_AXES][RING_SIZE];
+  size_t input_next_; // where the next sample goes
+  size_t input_count_; // samples in the frame being collected
+  uint64_t input_start_us_; // time of its first sample
+  uint64_t input_half_us_; // time of its middle sample, where the next frame starts
+
+  // frame being processed
+  size_t frame_start_;
+  float frame_sample_rate_hz_;
+  float re_[HALF_SIZE];
+  float im_[HALF_SIZE];
+  float power_[NUM_BINS]; // squared magnitude of each bin
+  uint8_t axis_;
+  uint8_t step_;
+
+  float min_frequency_hz_;
+  Peak frame_peaks_[NUM_AXES][NUM_PEAKS];
+  Peak peaks_[NUM_AXES][NUM_PEAKS];
+  float result_sample_rate_hz_;
+  uint32_t num_results_;
+
+  void start_frame(uint64_t last_us);
+  float sin_table(size_t k) const;
+  float window(size_t n) const;
+  void window_and_pack();
+  void fft_stage(uint8_t stage);
+  void split_spectrum();
+  void find_peaks();
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_SPECTRUM_ANALYZER_H
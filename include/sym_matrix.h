@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_SYM_MATRIX_H
+#define ROSFLIGHT_FIRMWARE_SYM_MATRIX_H
+
+#include <cstdint>
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Fixed-size symmetric matrix, such as a filter covariance, stored as its packed lower triangle
+ *
+ * Row i holds elements (i, 0) to (i, i), so an N x N matrix takes N*(N+1)/2 floats and updates keep
+ * it exactly symmetric. N is a template parameter, so every loop has a constant trip count and is
+ * unrolled by the compiler, and nothing is allocated. The packed layout also means that the leading
+ * M x M block of a matrix is stored in its first M*(M+1)/2 elements.
+ */
+template <uint8_t N>
+class SymMatrix
+{
+public:
+  static constexpr uint8_t DIM = N;
+  static constexpr uint16_t SIZE = N * (N + 1) / 2;
+
+  static constexpr uint16_t index(uint8_t i, uint8_t j)
+  {
+    return (i >= j) ? static_cast<uint16_t>(i * (i + 1) / 2 + j) : static_cast<uint16_t>(j * (j + 1) / 2 + i);
+  }
+
+  float operator()(uint8_t i, uint8_t j) const { return data_[index(i, j)]; }
+  float &operator()(uint8_t i, uint8_t j) { return data_[index(i, j)]; }
+
+  void set_zero()
+  {
+    for (uint16_t k = 0; k < SIZE; k++)
+      data_[k] = 0.0f;
+  }
+
+  /**
+   * @brief Sets a diagonal matrix
+   */
+  void set_diagonal(const float diagonal[N])
+  {
+    set_zero();
+    for (uint8_t i = 0; i < N; i++)
+      data_[index(i, i)] = diagonal[i];
+  }
+
+  /**
+   * @brief Adds value to count consecutive diagonal elements starting at (first, first)
+   */
+  void add_diagonal(uint8_t first, uint8_t count, float value)
+  {
+    for (uint8_t i = first; i < first + count; i++)
+      data_[index(i, i)] += value;
+  }
+
+  /**
+   * @brief Zeroes row and column i except for the diagonal, which is set to value
+   */
+  void reset_row(uint8_t i, float value)
+  {
+    for (uint8_t j = 0; j < N; j++)
+      data_[index(i, j)] = 0.0f;
+    data_[index(i, i)] = value;
+  }
+
+  /**
+   * @brief Multiplies row and column i by scale (so the diagonal element by scale^2). This is
+   *        D*M*D for a diagonal D, so it keeps M positive definite.
+   */
+  void scale_row(uint8_t i, float scale)
+  {
+    for (uint8_t j = 0; j < N; j++)
+      data_[index(i, j)] *= scale;
+    data_[index(i, i)] *= scale;
+  }
+
+  /**
+   * @brief out = M * x
+   */
+  void multiply(const float x[N], float out[N]) const
+  {
+    // walks the packed rows in order, each off-diagonal element contributes to two outputs
+    const float *row = data_;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      float sum = row[i] * x[i];
+      for (uint8_t j = 0; j < i; j++)
+      {
+        sum += row[j] * x[j];
+        out[j] += row[j] * x[i];
+      }
+      out[i] = sum;
+      row += i + 1;
+    }
+  }
+
+  /**
+   * @brief M += scale * v * v^T
+   */
+  void rank_one_update(const float v[N], float scale)
+  {
+    float *element = data_;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      float scaled = scale * v[i];
+      for (uint8_t j = 0; j <= i; j++)
+        *element++ += scaled * v[j];
+    }
+  }
+
+  float *data() { return data_; }
+  const float *data() const { return data_; }
+
+private:
+  float data_[SIZE];
+};
+
+template <uint8_t N> constexpr uint8_t SymMatrix<N>::DIM;
+template <uint8_t N> constexpr uint16_t SymMatrix<N>::SIZE;
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_SYM_MATRIX_H
@@ -31,6 +31,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <math.h>
+
 #include <turbomath/turbomath.h>
 
 namespace turbomath
@@ -192,10 +194,7 @@ Quaternion Quaternion::operator *(const Quaternion& q) const
 
 Quaternion& Quaternion::operator *=(const Quaternion& q)
 {
-  w = w*q.w - x*q.x - y*q.y - z*q.z;
-  x = w*q.x + x*q.w - y*q.z + z*q.y;
-  y = w*q.y + x*q.z + y*q.w - z*q.x;
-  z = w*q.z - x*q.y + y*q.x + z*q.w;
+  *this = (*this) * q;
   return *this;
 }
 
@@ -253,12 +252,10 @@ Quaternion& Quaternion::from_two_unit_vectors(const Vector& u, const Vector& v)
 Quaternion& Quaternion::from_RPY(float roll, float pitch, float yaw)
 {
   // p 259 of "Small unmanned aircraft: Theory and Practice" by Randy Beard and Tim McLain
-  float cp = turbomath::cos(roll/2.0);
-  float sp = turbomath::sin(roll/2.0);
-  float ct = turbomath::cos(pitch/2.0);
-  float st = turbomath::sin(pitch/2.0);
-  float cs = turbomath::cos(yaw/2.0);
-  float ss = turbomath::sin(yaw/2.0);
+  float cp, sp, ct, st, cs, ss;
+  turbomath::sin_cos(roll/2.0f, &sp, &cp);
+  turbomath::sin_cos(pitch/2.0f, &st, &ct);
+  turbomath::sin_cos(yaw/2.0f, &ss, &cs);
 
   w = cs*ct*cp + ss*st*sp;
   x = cs*ct*sp - ss*st*cp;
@@ -282,6 +279,34 @@ Vector Quaternion::boxminus(const Quaternion &q) const
   return log(dq);
 }
 
+Quaternion Quaternion::boxplus(const Vector &delta) const
+{
+  return (*this) * exp_map(delta, 1.0f);
+}
+
+Quaternion Quaternion::exp_map(const Vector &omega, float dt)
+{
+  // half angle theta/2 = |omega|*dt/2
+  float half_dt = 0.5f * dt;
+  float sqrd_half_angle = omega.sqrd_norm() * half_dt * half_dt;
+
+  float c, s_over_w; // cos(theta/2) and sin(theta/2)/|omega|
+  if (sqrd_half_angle < 0.01f)
+  {
+    // Taylor series, truncation error below 2e-9 for theta/2 < 0.1
+    c = 1.0f - sqrd_half_angle * (0.5f - sqrd_half_angle * (1.0f/24.0f));
+    s_over_w = half_dt * (1.0f - sqrd_half_angle * (1.0f/6.0f - sqrd_half_angle * (1.0f/120.0f)));
+  }
+  else
+  {
+    float half_angle = sqrtf(sqrd_half_angle);
+    float s;
+    sin_cos(half_angle, &s, &c);
+    s_over_w = s * half_dt / half_angle;
+  }
+  return Quaternion(c, s_over_w*omega.x, s_over_w*omega.y, s_over_w*omega.z);
+}
+
 void Quaternion::get_RPY(float *roll, float *pitch, float *yaw) const
 {
   *roll = turbomath::atan2(2.0f * (w*x + y*z), 1.0f - 2.0f * (x*x + y*y));
@@ -291,57 +316,6 @@ void Quaternion::get_RPY(float *roll, float *pitch, float *yaw) const
 
 
 
-#ifndef M_PI
-#define M_PI 3.14159265359
-#endif
-
-static const float atan_max_x = 1.000000;
-static const float atan_min_x = 0.000000;
-static const float atan_scale_factor = 41720.240162;
-static const int16_t atan_num_entries = 125;
-static const int16_t atan_lookup_table[125] = {
-0,	334,	667,	1001,	1335,	1668,	2001,	2334,	2666,	2999,
-3331,	3662,	3993,	4323,	4653,	4983,	5311,	5639,	5967,	6293,
-6619,	6944,	7268,	7592,	7914,	8235,	8556,	8875,	9194,	9511,
-9827,	10142,	10456,	10768,	11080,	11390,	11699,	12006,	12313,	12617,
-12921,	13223,	13524,	13823,	14120,	14417,	14711,	15005,	15296,	15586,
-15875,	16162,	16447,	16731,	17013,	17293,	17572,	17849,	18125,	18399,
-18671,	18941,	19210,	19477,	19742,	20006,	20268,	20528,	20786,	21043,
-21298,	21551,	21802,	22052,	22300,	22546,	22791,	23034,	23275,	23514,
-23752,	23988,	24222,	24454,	24685,	24914,	25142,	25367,	25591,	25814,
-26034,	26253,	26471,	26686,	26900,	27113,	27324,	27533,	27740,	27946,
-28150,	28353,	28554,	28754,	28952,	29148,	29343,	29537,	29728,	29919,
-30108,	30295,	30481,	30665,	30848,	31030,	31210,	31388,	31566,	31741,
-31916,	32089,	32260,	32431,	32599,	};
-
-static const float asin_max_x = 1.000000;
-static const float asin_min_x = 0.000000;
-static const float asin_scale_factor = 20860.120081;
-static const int16_t asin_num_entries = 200;
-static const int16_t asin_lookup_table[200] = {
-0,	104,	209,	313,	417,	522,	626,	730,	835,	939,
-1043,	1148,	1252,	1357,	1461,	1566,	1671,	1775,	1880,	1985,
-2090,	2194,	2299,	2404,	2509,	2614,	2720,	2825,	2930,	3035,
-3141,	3246,	3352,	3458,	3564,	3669,	3775,	3881,	3988,	4094,
-4200,	4307,	4413,	4520,	4627,	4734,	4841,	4948,	5056,	5163,
-5271,	5379,	5487,	5595,	5703,	5811,	5920,	6029,	6138,	6247,
-6356,	6465,	6575,	6685,	6795,	6905,	7015,	7126,	7237,	7348,
-7459,	7570,	7682,	7794,	7906,	8019,	8131,	8244,	8357,	8471,
-8584,	8698,	8812,	8927,	9042,	9157,	9272,	9388,	9504,	9620,
-9737,	9854,	9971,	10089,	10207,	10325,	10444,	10563,	10682,	10802,
-10922,	11043,	11164,	11285,	11407,	11530,	11652,	11776,	11899,	12024,
-12148,	12273,	12399,	12525,	12652,	12779,	12907,	13035,	13164,	13293,
-13424,	13554,	13686,	13817,	13950,	14083,	14217,	14352,	14487,	14623,
-14760,	14898,	15036,	15176,	15316,	15457,	15598,	15741,	15885,	16029,
-16175,	16321,	16469,	16618,	16767,	16918,	17070,	17224,	17378,	17534,
-17691,	17849,	18009,	18170,	18333,	18497,	18663,	18830,	19000,	19171,
-19343,	19518,	19695,	19874,	20055,	20239,	20424,	20613,	20803,	20997,
-21194,	21393,	21596,	21802,	22012,	22225,	22443,	22664,	22891,	23122,
-23359,	23601,	23849,	24104,	24366,	24637,	24916,	25204,	25504,	25816,
-26143,	26485,	26847,	27232,	27644,	28093,	28588,	29149,	29814,	30680,
-};
-
-
 static const float max_pressure = 106598.405011;
 static const float min_pressure = 69681.635473;
 static const float pressure_scale_factor = 10.754785;
@@ -369,150 +343,170 @@ static const int16_t pressure_lookup_table[200] = {
 -3026,	-3187,	-3347,	-3507,	-3667,	-3827,	-3987,	-4146,	-4305,	-4464,
 };
 
-static const float sin_max_x = 3.141593;
-static const float sin_min_x = 0.000000;
-static const float sin_scale_factor = 32767.000000;
-static const int16_t sin_num_entries = 125;
-static const int16_t sin_lookup_table[125] = {
-0,	823,	1646,	2468,	3289,	4107,	4922,	5735,	6544,	7349,
-8149,	8944,	9733,	10516,	11293,	12062,	12824,	13578,	14323,	15059,
-15786,	16502,	17208,	17904,	18588,	19260,	19920,	20568,	21202,	21823,
-22431,	23024,	23602,	24166,	24715,	25247,	25764,	26265,	26749,	27216,
-27666,	28099,	28513,	28910,	29289,	29648,	29990,	30312,	30615,	30899,
-31163,	31408,	31633,	31837,	32022,	32187,	32331,	32454,	32558,	32640,
-32702,	32744,	32764,	32764,	32744,	32702,	32640,	32558,	32454,	32331,
-32187,	32022,	31837,	31633,	31408,	31163,	30899,	30615,	30312,	29990,
-29648,	29289,	28910,	28513,	28099,	27666,	27216,	26749,	26265,	25764,
-25247,	24715,	24166,	23602,	23024,	22431,	21823,	21202,	20568,	19920,
-19260,	18588,	17904,	17208,	16502,	15786,	15059,	14323,	13578,	12824,
-12062,	11293,	10516,	9733,	8944,	8149,	7349,	6544,	5735,	4922,
-4107,	3289,	2468,	1646,	823
+// The trig functions reduce their argument with arithmetic and selects only, then evaluate a
+// minimax polynomial (fitted with the Remez exchange algorithm on the reduced range). They use no
+// tables and have no data-dependent branches, so they cost the same for every input and the
+// compiler is free to interleave or vectorize several calls.
+
+static const float PI_F = 3.14159265f;
+static const float PI_2_F = 1.57079633f;
+static const float TWO_OVER_PI_F = 0.636619772f;
+
+// pi/2 split in three parts (Cody-Waite), so that x - k*pi/2 is exact for |k| < 2^16
+static const float PI_2_PART1 = 1.5703125f;
+static const float PI_2_PART2 = 4.837512969970703125e-4f;
+static const float PI_2_PART3 = 7.54978995489188216e-8f;
+
+// sin(r) = r + r^3*S(r^2) and cos(r) = 1 - r^2/2 + r^4*C(r^2) on [-pi/4, pi/4]
+static const float SIN_S1 = -1.666665461e-1f;
+static const float SIN_S2 = 8.332160762e-3f;
+static const float SIN_S3 = -1.951528319e-4f;
+static const float COS_C1 = 4.166664568e-2f;
+static const float COS_C2 = -1.388731625e-3f;
+static const float COS_C3 = 2.443315706e-5f;
+
+// atan(t) = t*A(t^2) on [0, 1]
+static const float ATAN_A0 = 9.999999864e-1f;
+static const float ATAN_A1 = -3.333309396e-1f;
+static const float ATAN_A2 = 1.999305412e-1f;
+static const float ATAN_A3 = -1.420713375e-1f;
+static const float ATAN_A4 = 1.065467782e-1f;
+static const float ATAN_A5 = -7.533677051e-2f;
+static const float ATAN_A6 = 4.303938038e-2f;
+static const float ATAN_A7 = -1.628301610e-2f;
+static const float ATAN_A8 = 2.903554626e-3f;
+
+// asin(s) = s + s^3*B(s^2) on [0, 1/2]
+static const float ASIN_B0 = 1.666675248e-1f;
+static const float ASIN_B1 = 7.495297646e-2f;
+static const float ASIN_B2 = 4.547037557e-2f;
+static const float ASIN_B3 = 2.417951658e-2f;
+static const float ASIN_B4 = 4.216630532e-2f;
+
+// Branch-free float helpers. Compilers tend to turn a conditional expression on floats back into a
+// branch, which mispredicts on random inputs, so selects and signs are done on the bit patterns.
+union FloatBits
+{
+  float f;
+  uint32_t u;
 };
 
-float fsign(float y)
+static const uint32_t SIGN_BIT = 0x80000000u;
+
+static inline uint32_t bits(float x)
 {
-  return (0.0f < y) - (y < 0.0f);
+  FloatBits b;
+  b.f = x;
+  return b.u;
 }
 
-float cos(float x)
+static inline float from_bits(uint32_t u)
 {
-  return sin(M_PI/2.0 - x);
+  FloatBits b;
+  b.u = u;
+  return b.f;
 }
 
-float sin(float x)
+// condition ? a : b
+static inline float select(bool condition, float a, float b)
 {
-  // wrap down to +/x PI
-  while (x > M_PI)
-    x -= 2.0*M_PI;
-
-  while (x <= -M_PI)
-    x += 2.0*M_PI;
-
-  // sin is symmetric
-  if (x < 0)
-    return -1.0*sin(-x);
+  uint32_t mask = 0u - static_cast<uint32_t>(condition);
+  return from_bits((bits(a) & mask) | (bits(b) & ~mask));
+}
 
-  // wrap onto (0, PI)
-  if (x > M_PI)
-    return -1.0*sin(x - M_PI);
+static inline float abs_bits(float x)
+{
+  return from_bits(bits(x) & ~SIGN_BIT);
+}
 
-  // Now, all we have left is the range 0 to PI, use the lookup table
-  float t = (x - sin_min_x)/(sin_max_x - sin_min_x) * static_cast<float>(sin_num_entries);
-  int16_t index = static_cast<int16_t>(t);
-  float delta_x = t - index;
+// negate x if the sign bit of s is set
+static inline float xor_sign(float x, uint32_t s)
+{
+  return from_bits(bits(x) ^ (s & SIGN_BIT));
+}
 
-  if (index >= sin_num_entries)
-      return sin_lookup_table[sin_num_entries - 1]/sin_scale_factor;
-  else if (index < sin_num_entries - 1)
-      return sin_lookup_table[index]/sin_scale_factor + delta_x * (sin_lookup_table[index + 1] - sin_lookup_table[index])/sin_scale_factor;
-  else
-      return sin_lookup_table[index]/sin_scale_factor + delta_x * (sin_lookup_table[index] - sin_lookup_table[index - 1])/sin_scale_factor;
+static inline float atan_unit(float t)
+{
+  float u = t*t;
+  return t*(ATAN_A0 + u*(ATAN_A1 + u*(ATAN_A2 + u*(ATAN_A3 + u*(ATAN_A4 + u*(ATAN_A5 + u*(ATAN_A6
+            + u*(ATAN_A7 + u*ATAN_A8))))))));
 }
 
+float fsign(float y)
+{
+  return (0.0f < y) - (y < 0.0f);
+}
 
-float atan(float x)
+void sin_cos(float x, float *s, float *c)
 {
-  // atan is symmetric
-  if (x < 0)
-  {
-    return -1.0*atan(-1.0*x);
-  }
-  // This uses a sweet identity to wrap the domain of atan onto (0,1)
-  if (x > 1.0)
-  {
-    return M_PI/2.0 - atan(1.0/x);
-  }
+  // x = k*pi/2 + r with |r| <= pi/4, so sin and cos of x are +/- sin or cos of r by quadrant
+  float half = from_bits(bits(0.5f) | (bits(x) & SIGN_BIT));
+  int32_t k = static_cast<int32_t>(x*TWO_OVER_PI_F + half);
+  float kf = static_cast<float>(k);
+  float r = ((x - kf*PI_2_PART1) - kf*PI_2_PART2) - kf*PI_2_PART3;
+  float r2 = r*r;
 
-  float t = (x - atan_min_x)/(atan_max_x - atan_min_x) * static_cast<float>(atan_num_entries);
-  int16_t index = static_cast<int16_t>(t);
-  float delta_x = t - index;
+  float sin_r = r + r*r2*(SIN_S1 + r2*(SIN_S2 + r2*SIN_S3));
+  float cos_r = 1.0f - 0.5f*r2 + r2*r2*(COS_C1 + r2*(COS_C2 + r2*COS_C3));
 
-  if (index >= atan_num_entries)
-      return atan_lookup_table[atan_num_entries-1]/atan_scale_factor;
-  else if (index < atan_num_entries - 1)
-      return atan_lookup_table[index]/atan_scale_factor + delta_x * (atan_lookup_table[index + 1] - atan_lookup_table[index])/atan_scale_factor;
-  else
-      return atan_lookup_table[index]/atan_scale_factor + delta_x * (atan_lookup_table[index] - atan_lookup_table[index - 1])/atan_scale_factor;
+  uint32_t quadrant = static_cast<uint32_t>(k);
+  bool odd = (quadrant & 1u) != 0;
+  *s = xor_sign(select(odd, cos_r, sin_r), quadrant << 30);
+  *c = xor_sign(select(odd, sin_r, cos_r), (quadrant + 1u) << 30);
 }
 
-
-float atan2(float y, float x)
+float sin(float x)
 {
-  // algorithm from wikipedia: https://en.wikipedia.org/wiki/Atan2
-  if (x == 0.0)
-  {
-    if (y < 0.0)
-    {
-      return - M_PI/2.0;
-    }
-    else if ( y > 0.0)
-    {
-      return M_PI/2.0;
-    }
-    else
-    {
-      return 0.0;
-    }
-  }
-
-  float arctan = atan(y/x);
+  float s, c;
+  sin_cos(x, &s, &c);
+  return s;
+}
 
-  if (x < 0.0)
-  {
-    if ( y < 0)
-    {
-      return arctan - M_PI;
-    }
-    else
-    {
-      return arctan + M_PI;
-    }
-  }
+float cos(float x)
+{
+  float s, c;
+  sin_cos(x, &s, &c);
+  return c;
+}
 
-  else
-  {
-      return arctan;
-  }
+float atan(float x)
+{
+  // atan(x) = pi/2 - atan(1/x) folds |x| > 1 onto [0, 1]
+  float a = abs_bits(x);
+  bool inverted = a > 1.0f;
+  float t = select(inverted, 1.0f/a, a);
+  float angle = atan_unit(t);
+  angle = select(inverted, PI_2_F - angle, angle);
+  return xor_sign(angle, bits(x));
 }
 
+float atan2(float y, float x)
+{
+  // atan of the smaller over the larger magnitude, then unfolded into the right octant
+  float ax = abs_bits(x);
+  float ay = abs_bits(y);
+  bool steep = ay > ax;
+  float num = select(steep, ax, ay);
+  float den = select(steep, ay, ax);
+  float t = num/select(den > 0.0f, den, 1.0f);
+  float angle = atan_unit(t);
+  angle = select(steep, PI_2_F - angle, angle);
+  angle = select(x < 0.0f, PI_F - angle, angle);
+  return select(y < 0.0f, -angle, angle);
+}
 
 float asin(float x)
 {
-  if (x < 0.0)
-  {
-    return -1.0*asin(-1.0*x);
-  }
-
-  float t = (x - asin_min_x)/(asin_max_x - asin_min_x) * static_cast<float>(asin_num_entries);
-  int16_t index = static_cast<int16_t>(t);
-  float delta_x = t - index;
-
-  if (index >= asin_num_entries)
-      return asin_lookup_table[asin_num_entries - 1]/asin_scale_factor;
-  else if (index < asin_num_entries - 1)
-      return asin_lookup_table[index]/asin_scale_factor + delta_x * (asin_lookup_table[index + 1] - asin_lookup_table[index])/asin_scale_factor;
-  else
-      return asin_lookup_table[index]/asin_scale_factor + delta_x * (asin_lookup_table[index] - asin_lookup_table[index - 1])/asin_scale_factor;
+  // asin(a) = pi/2 - 2*asin(sqrt((1 - a)/2)) folds a > 1/2 onto [0, 1/2]. Inputs slightly
+  // outside [-1, 1] (e.g. from rounding in get_RPY) are clamped.
+  float a = abs_bits(x);
+  a = select(a > 1.0f, 1.0f, a);
+  bool folded = a > 0.5f;
+  float z = select(folded, 0.5f*(1.0f - a), a*a);
+  float s = select(folded, sqrtf(z), a);
+  float angle = s + s*z*(ASIN_B0 + z*(ASIN_B1 + z*(ASIN_B2 + z*(ASIN_B3 + z*ASIN_B4))));
+  angle = select(folded, PI_2_F - 2.0f*angle, angle);
+  return xor_sign(angle, bits(x));
 }
 
 float alt(float press)
@@ -525,7 +519,7 @@ float alt(float press)
     float delta_x = t - index;
 
     if (index >= pressure_num_entries)
-        return asin_lookup_table[pressure_num_entries - 1]/pressure_scale_factor;
+        return pressure_lookup_table[pressure_num_entries - 1]/pressure_scale_factor;
     else if (index < pressure_num_entries - 1)
         return pressure_lookup_table[index]/pressure_scale_factor + delta_x * (pressure_lookup_table[index + 1] - pressure_lookup_table[index])/pressure_scale_factor;
     else
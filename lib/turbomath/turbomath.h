@@ -39,9 +39,15 @@
 namespace turbomath
 {
 
-// float-based wrappers
+// Polynomial approximations of the float trig functions, without tables or branches. Maximum
+// errors against correctly rounded results, measured by turbomath_bench:
+//   sin, cos, sin_cos   1.6 ulp for |x| <= pi, 9e-8 absolute for |x| <= 200
+//   atan                2 ulp
+//   atan2               2.3 ulp
+//   asin                2.4 ulp on [-1, 1]; inputs outside are clamped
 float cos(float x);
 float sin(float x);
+void sin_cos(float x, float *s, float *c); // both for the price of one
 float asin(float x);
 float atan2(float y, float x);
 float atan(float x);
@@ -117,6 +123,12 @@ public:
   Quaternion operator* (const Quaternion& q) const;
   Quaternion& operator*= (const Quaternion& q);
   Vector boxminus(const Quaternion& q) const;
+  Quaternion boxplus(const Vector& delta) const;
+
+  // Rotation by the angle-axis vector omega*dt, i.e. the quaternion exponential of omega*dt/2.
+  // Small rotations use a Taylor series, so propagating body rates at high rates needs no sqrt or
+  // trig. exp_map(log(q), 1) == q.
+  static Quaternion exp_map(const Vector& omega, float dt);
   static Vector log(const Quaternion &q)
   {
     Vector v{q.x, q.y, q.z};
@@ -135,6 +147,7 @@ public:
   }
 
   Vector operator-(const Quaternion& q) const {return boxminus(q);}
+  Quaternion operator+(const Vector& delta) const {return boxplus(delta);}
 };
 
 } // namespace turbomath
@@ -31,6 +31,7 @@ MAVLINK_SRC = mavlink.cpp
 VPATH		:= $(VPATH):$(ROSFLIGHT_DIR):$(ROSFLIGHT_DIR)/src
 ROSFLIGHT_SRC = rosflight.cpp \
                 param.cpp \
+                param_store.cpp \
                 sensors.cpp \
                 state_manager.cpp \
                 estimator.cpp \
@@ -39,6 +40,14 @@ ROSFLIGHT_SRC = rosflight.cpp \
                 command_manager.cpp \
                 rc.cpp \
                 mixer.cpp \
+                profiler.cpp \
+                serial_tx_buffer.cpp \
+                esc_protocol.cpp \
+                biquad_filter.cpp \
+                spectrum_analyzer.cpp \
+                attitude_ekf.cpp \
+                altitude_estimator.cpp \
+                attitude_history.cpp \
                 nanoprintf.cpp
 
 # Math Source Files
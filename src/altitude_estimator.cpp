@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "altitude_estimator.h"
+
+namespace rosflight_firmware
+{
+
+namespace
+{
+constexpr float BARO_OFFSET_TIME_CONSTANT = 5.0f; // s
+}
+
+AltitudeEstimator::AltitudeEstimator() :
+  params_{2.0f, 0.5f}
+{
+  reset();
+}
+
+void AltitudeEstimator::set_params(const Params &params)
+{
+  params_ = params;
+}
+
+void AltitudeEstimator::reset()
+{
+  initialized_ = false;
+  altitude_ = 0.0f;
+  climb_rate_ = 0.0f;
+  accel_bias_ = 0.0f;
+  baro_offset_ = 0.0f;
+}
+
+void AltitudeEstimator::predict(float accel_up, float dt)
+{
+  if (!initialized_ || dt <= 0.0f)
+    return;
+
+  const float accel = accel_up - accel_bias_;
+  altitude_ += (climb_rate_ + 0.5f * accel * dt) * dt;
+  climb_rate_ += accel * dt;
+}
+
+void AltitudeEstimator::correct_baro(float altitude, float dt)
+{
+  correct(altitude - baro_offset_, params_.baro_time_constant, dt);
+}
+
+void AltitudeEstimator::correct_range(float height, float dt)
+{
+  correct(height, params_.range_time_constant, dt);
+}
+
+void AltitudeEstimator::track_baro(float altitude, float dt)
+{
+  if (!initialized_)
+    return;
+  baro_offset_ += (altitude - altitude_ - baro_offset_) * dt / BARO_OFFSET_TIME_CONSTANT;
+}
+
+void AltitudeEstimator::correct(float measurement, float time_constant, float dt)
+{
+  if (!initialized_)
+  {
+    altitude_ = measurement;
+    climb_rate_ = 0.0f;
+    accel_bias_ = 0.0f;
+    initialized_ = true;
+    return;
+  }
+  if (time_constant <= 0.0f || dt <= 0.0f)
+    return;
+
+  // Gains of a third-order complementary filter with all three poles at -1/time_constant
+  const float k1 = 3.0f / time_constant;
+  const float k2 = k1 / time_constant;
+  const float k3 = k2 / (3.0f * time_constant);
+
+  const float error = measurement - altitude_;
+  altitude_ += k1 * error * dt;
+  climb_rate_ += k2 * error * dt;
+  accel_bias_ -= k3 * error * dt;
+}
+
+} // namespace rosflight_firmware
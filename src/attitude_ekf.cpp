@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <math.h>
+
+#include "attitude_ekf.h"
+
+namespace rosflight_firmware
+{
+
+namespace
+{
+constexpr float GRAVITY = 9.80665f;
+constexpr float INITIAL_ATTITUDE_STD = 0.5f;   // rad
+constexpr float INITIAL_GYRO_BIAS_STD = 0.05f; // rad/s
+constexpr float INITIAL_ACCEL_BIAS_STD = 0.5f; // m/s^2
+constexpr float MIN_VARIANCE = 1e-10f;
+}
+
+constexpr uint8_t AttitudeEkf::NUM_STATES;
+constexpr uint8_t AttitudeEkf::ATTITUDE;
+constexpr uint8_t AttitudeEkf::GYRO_BIAS;
+constexpr uint8_t AttitudeEkf::ACCEL_BIAS;
+
+AttitudeEkf::AttitudeEkf() :
+  params_{0.005f, 1e-4f, 0.5f, 1e-3f, 0.02f, 0.05f, false}
+{
+  reset(turbomath::Quaternion(), turbomath::Vector());
+}
+
+void AttitudeEkf::set_params(const Params &params)
+{
+  bool had_accel_bias = params_.estimate_accel_bias;
+  params_ = params;
+  if (params.estimate_accel_bias == had_accel_bias)
+    return;
+
+  // The attitude and gyro bias block is the leading 6x6 block of the 9-state covariance, and so
+  // the first SymMatrix<6>::SIZE elements of both
+  if (params.estimate_accel_bias)
+  {
+    for (uint16_t k = 0; k < SymMatrix<6>::SIZE; k++)
+      P9_.data()[k] = P6_.data()[k];
+    reset_accel_bias();
+  }
+  else
+  {
+    for (uint16_t k = 0; k < SymMatrix<6>::SIZE; k++)
+      P6_.data()[k] = P9_.data()[k];
+    accel_bias_ = turbomath::Vector();
+  }
+}
+
+void AttitudeEkf::reset(const turbomath::Quaternion &attitude, const turbomath::Vector &gyro_bias)
+{
+  attitude_ = attitude;
+  gyro_bias_ = gyro_bias;
+  accel_bias_ = turbomath::Vector();
+  reset_covariance();
+}
+
+float AttitudeEkf::initial_variance(uint8_t state)
+{
+  float std = (state < GYRO_BIAS) ? INITIAL_ATTITUDE_STD
+                                  : (state < ACCEL_BIAS) ? INITIAL_GYRO_BIAS_STD : INITIAL_ACCEL_BIAS_STD;
+  return std * std;
+}
+
+void AttitudeEkf::reset_covariance()
+{
+  float diagonal[NUM_STATES];
+  for (uint8_t i = 0; i < NUM_STATES; i++)
+    diagonal[i] = initial_variance(i);
+  P6_.set_diagonal(diagonal);
+  P9_.set_diagonal(diagonal);
+}
+
+void AttitudeEkf::reset_gyro_bias()
+{
+  gyro_bias_ = turbomath::Vector();
+  for (uint8_t i = GYRO_BIAS; i < GYRO_BIAS + 3; i++)
+  {
+    P6_.reset_row(i, initial_variance(i));
+    P9_.reset_row(i, initial_variance(i));
+  }
+}
+
+void AttitudeEkf::reset_accel_bias()
+{
+  accel_bias_ = turbomath::Vector();
+  for (uint8_t i = ACCEL_BIAS; i < ACCEL_BIAS + 3; i++)
+    P9_.reset_row(i, initial_variance(i));
+}
+
+float AttitudeEkf::covariance(uint8_t i, uint8_t j) const
+{
+  if (params_.estimate_accel_bias)
+    return P9_(i, j);
+  return (i < ACCEL_BIAS && j < ACCEL_BIAS) ? P6_(i, j) : 0.0f;
+}
+
+void AttitudeEkf::predict(const turbomath::Vector &gyro, float dt)
+{
+  if (dt <= 0.0f)
+    return;
+
+  turbomath::Vector rate = gyro - gyro_bias_;
+  // (turbomath multiplies in the opposite order to the Hamilton product q * exp(rate*dt))
+  attitude_ = turbomath::Quaternion::exp_map(rate, dt) * attitude_;
+  attitude_.normalize();
+
+  if (params_.estimate_accel_bias)
+    propagate_covariance(P9_, rate, dt);
+  else
+    propagate_covariance(P6_, rate, dt);
+}
+
+template <uint8_t N>
+void AttitudeEkf::propagate_covariance(SymMatrix<N> &P, const turbomath::Vector &rate, float dt)
+{
+  // The attitude error evolves as d(dtheta)/dt = -rate x dtheta - d(gyro bias), so the attitude
+  // rows of the transition matrix F are [A, -dt*I, 0] with A = I - [rate*dt]x, and all other rows
+  // are the identity. Only the attitude rows and columns of F*P*F^T differ from P.
+  const float wx = rate.x * dt;
+  const float wy = rate.y * dt;
+  const float wz = rate.z * dt;
+  const float A[3][3] = {{1.0f, wz, -wy},
+                         {-wz, 1.0f, wx},
+                         {wy, -wx, 1.0f}};
+
+  // T = (attitude rows of F) * P
+  float T[3][N];
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    for (uint8_t k = 0; k < N; k++)
+      T[i][k] = A[i][0] * P(0, k) + A[i][1] * P(1, k) + A[i][2] * P(2, k) - dt * P(GYRO_BIAS + i, k);
+  }
+
+  // attitude/bias cross terms are T itself, the attitude block is T * (attitude rows of F)^T
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    for (uint8_t k = GYRO_BIAS; k < N; k++)
+      P(i, k) = T[i][k];
+    for (uint8_t l = 0; l <= i; l++)
+      P(i, l) = T[i][0] * A[l][0] + T[i][1] * A[l][1] + T[i][2] * A[l][2] - dt * T[i][GYRO_BIAS + l];
+  }
+
+  P.add_diagonal(ATTITUDE, 3, params_.gyro_noise * params_.gyro_noise * dt);
+  P.add_diagonal(GYRO_BIAS, 3, params_.gyro_bias_noise * params_.gyro_bias_noise * dt);
+  if (N > ACCEL_BIAS)
+    P.add_diagonal(ACCEL_BIAS, 3, params_.accel_bias_noise * params_.accel_bias_noise * dt);
+
+  // Yaw, and the gyro bias about the gravity vector, are not observable from the accelerometer, so
+  // their variance would grow without bound and swamp the float precision of the observable
+  // states. Cap every variance at its initial value.
+  for (uint8_t i = 0; i < N; i++)
+  {
+    const float max_variance = initial_variance(i);
+    if (P(i, i) > max_variance)
+      P.scale_row(i, sqrtf(max_variance / P(i, i)));
+  }
+}
+
+void AttitudeEkf::update_accel(const turbomath::Vector &accel)
+{
+  if (params_.estimate_accel_bias)
+    fuse_accel(P9_, accel);
+  else
+    fuse_accel(P6_, accel);
+}
+
+template <uint8_t N>
+void AttitudeEkf::fuse_accel(SymMatrix<N> &P, const turbomath::Vector &accel)
+{
+  // Predicted measurement: gravity in the body frame plus the accel bias. Perturbing the attitude
+  // by dtheta changes it by gravity x dtheta, so the attitude columns of H are [gravity]x.
+  turbomath::Vector v = attitude_.rotate(turbomath::Vector(0.0f, 0.0f, -GRAVITY));
+  turbomath::Vector residual = accel - v;
+  if (N > ACCEL_BIAS)
+    residual -= accel_bias_;
+
+  const float H[3][3] = {{0.0f, -v.z, v.y},
+                         {v.z, 0.0f, -v.x},
+                         {-v.y, v.x, 0.0f}};
+  const float r[3] = {residual.x, residual.y, residual.z};
+  const float variance = params_.accel_noise * params_.accel_noise;
+
+  float dx[N] = {};
+  for (uint8_t m = 0; m < 3; m++)
+  {
+    float h[N] = {H[m][0], H[m][1], H[m][2]};
+    for (uint8_t j = ACCEL_BIAS; j < N; j++)
+      h[j] = (j == ACCEL_BIAS + m) ? 1.0f : 0.0f;
+    update_axis(P, h, r[m], variance, dx);
+  }
+  apply_correction(dx, N > ACCEL_BIAS);
+}
+
+void AttitudeEkf::update_attitude(const turbomath::Quaternion &attitude)
+{
+  // body-frame rotation from the estimate to the measurement, the Hamilton product q^-1 * q_meas
+  turbomath::Quaternion dq = attitude * attitude_.inverse();
+  dq.normalize();
+  turbomath::Vector error = turbomath::Quaternion::log(dq);
+
+  if (params_.estimate_accel_bias)
+    fuse_attitude(P9_, error);
+  else
+    fuse_attitude(P6_, error);
+}
+
+template <uint8_t N>
+void AttitudeEkf::fuse_attitude(SymMatrix<N> &P, const turbomath::Vector &error)
+{
+  const float r[3] = {error.x, error.y, error.z};
+  const float variance = params_.attitude_noise * params_.attitude_noise;
+
+  float dx[N] = {};
+  for (uint8_t m = 0; m < 3; m++)
+  {
+    float h[N] = {};
+    h[ATTITUDE + m] = 1.0f;
+    update_axis(P, h, r[m], variance, dx);
+  }
+  apply_correction(dx, N > ACCEL_BIAS);
+}
+
+void AttitudeEkf::update_heading(float error)
+{
+  if (params_.estimate_accel_bias)
+    fuse_heading(P9_, error);
+  else
+    fuse_heading(P6_, error);
+}
+
+template <uint8_t N>
+void AttitudeEkf::fuse_heading(SymMatrix<N> &P, float error)
+{
+  // A heading change is a rotation about the world z axis, which points along this body-frame
+  // vector. Only the attitude columns of H are nonzero.
+  const turbomath::Vector down = attitude_.rotate(turbomath::Vector(0.0f, 0.0f, 1.0f));
+  float h[N] = {down.x, down.y, down.z};
+  float dx[N] = {};
+  update_axis(P, h, error, params_.heading_noise * params_.heading_noise, dx);
+  apply_correction(dx, N > ACCEL_BIAS);
+}
+
+template <uint8_t N>
+void AttitudeEkf::update_axis(SymMatrix<N> &P, const float h[N], float residual, float variance, float dx[N])
+{
+  // Scalar Kalman update. Earlier axes of the same measurement have already moved the estimate by
+  // dx, so the residual is taken about that.
+  float ph[N];
+  P.multiply(h, ph);
+  float s = variance;
+  for (uint8_t j = 0; j < N; j++)
+  {
+    s += h[j] * ph[j];
+    residual -= h[j] * dx[j];
+  }
+  // h*P*h^T < 0 means rounding has made P indefinite; don't amplify it
+  if (!(s >= variance) || variance <= 0.0f)
+    return;
+
+  const float inv_s = 1.0f / s;
+  for (uint8_t j = 0; j < N; j++)
+    dx[j] += ph[j] * residual * inv_s;
+  P.rank_one_update(ph, -inv_s);
+
+  // Long runs of updates without process noise can round a variance below zero. Decorrelating that
+  // state keeps P positive definite.
+  for (uint8_t j = 0; j < N; j++)
+  {
+    if (!(P(j, j) >= MIN_VARIANCE))
+      P.reset_row(j, MIN_VARIANCE);
+  }
+}
+
+void AttitudeEkf::apply_correction(const float *dx, bool has_accel_bias)
+{
+  turbomath::Vector dtheta(dx[ATTITUDE], dx[ATTITUDE + 1], dx[ATTITUDE + 2]);
+  attitude_ = turbomath::Quaternion::exp_map(dtheta, 1.0f) * attitude_;
+  attitude_.normalize();
+  gyro_bias_ += turbomath::Vector(dx[GYRO_BIAS], dx[GYRO_BIAS + 1], dx[GYRO_BIAS + 2]);
+  if (has_accel_bias)
+    accel_bias_ += turbomath::Vector(dx[ACCEL_BIAS], dx[ACCEL_BIAS + 1], dx[ACCEL_BIAS + 2]);
+}
+
+} // namespace rosflight_firmware
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "attitude_history.h"
+
+namespace rosflight_firmware
+{
+
+constexpr uint32_t AttitudeHistory::MAX_DELAY_US;
+constexpr uint32_t AttitudeHistory::MARGIN_US;
+constexpr uint32_t AttitudeHistory::PERIOD_US;
+constexpr size_t AttitudeHistory::SIZE;
+
+AttitudeHistory::AttitudeHistory()
+{
+  reset();
+}
+
+void AttitudeHistory::reset()
+{
+  newest_ = SIZE - 1;
+  count_ = 0;
+}
+
+void AttitudeHistory::record(uint64_t time_us, const turbomath::Quaternion &q)
+{
+  // The newest entry follows the latest attitude until it is a full period after the one before it,
+  // and is then kept
+  if (count_ < 2 || entries_[newest_].time_us >= entries_[older(newest_)].time_us + PERIOD_US)
+  {
+    newest_ = (newest_ + 1) % SIZE;
+    if (count_ < SIZE)
+      count_++;
+  }
+  entries_[newest_].time_us = time_us;
+  entries_[newest_].q = q;
+}
+
+bool AttitudeHistory::lookup(uint64_t time_us, turbomath::Quaternion *q) const
+{
+  if (count_ == 0)
+    return false;
+
+  size_t i = newest_;
+  if (time_us >= entries_[i].time_us)
+  {
+    *q = entries_[i].q;
+    return true;
+  }
+
+  // walk back to the newest entry at or before time_us
+  for (size_t n = 1; n < count_; n++)
+  {
+    size_t j = older(i);
+    const Entry &a = entries_[j];
+    if (time_us >= a.time_us)
+    {
+      // normalized linear interpolation, which is close enough to slerp over a few milliseconds
+      const Entry &b = entries_[i];
+      float t = static_cast<float>(time_us - a.time_us) / static_cast<float>(b.time_us - a.time_us);
+      float sign = (a.q.w*b.q.w + a.q.x*b.q.x + a.q.y*b.q.y + a.q.z*b.q.z < 0.0f) ? -1.0f : 1.0f;
+      q->w = (1.0f - t)*a.q.w + sign*t*b.q.w;
+      q->x = (1.0f - t)*a.q.x + sign*t*b.q.x;
+      q->y = (1.0f - t)*a.q.y + sign*t*b.q.y;
+      q->z = (1.0f - t)*a.q.z + sign*t*b.q.z;
+      q->normalize();
+      return true;
+    }
+    i = j;
+  }
+  return false;
+}
+
+} // namespace rosflight_firmware
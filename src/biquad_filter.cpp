@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <math.h>
+
+#include "biquad_filter.h"
+
+namespace rosflight_firmware
+{
+
+namespace
+{
+constexpr float PI = 3.14159265f;
+constexpr float MAX_NYQUIST_FRACTION = 0.95f; // keep designed frequencies clear of Nyquist
+}
+
+constexpr uint8_t BiquadFilterBank::MAX_STAGES;
+constexpr uint8_t BiquadFilterBank::NUM_AXES;
+constexpr uint8_t BiquadFilterBank::LANES;
+
+BiquadFilterBank::Coefficients BiquadFilterBank::lowpass(float cutoff_hz, float sample_hz, float q)
+{
+  if (cutoff_hz <= 0.0f || sample_hz <= 0.0f || q <= 0.0f || cutoff_hz >= 0.5f * sample_hz * MAX_NYQUIST_FRACTION)
+    return passthrough();
+
+  // Bilinear transform designs from R. Bristow-Johnson's Audio EQ Cookbook
+  float w0 = 2.0f * PI * cutoff_hz / sample_hz;
+  float cos_w0 = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * q);
+  float inv_a0 = 1.0f / (1.0f + alpha);
+
+  Coefficients c;
+  c.b0 = 0.5f * (1.0f - cos_w0) * inv_a0;
+  c.b1 = (1.0f - cos_w0) * inv_a0;
+  c.b2 = c.b0;
+  c.a1 = -2.0f * cos_w0 * inv_a0;
+  c.a2 = (1.0f - alpha) * inv_a0;
+  return c;
+}
+
+BiquadFilterBank::Coefficients BiquadFilterBank::notch(float center_hz, float sample_hz, float q)
+{
+  if (center_hz <= 0.0f || sample_hz <= 0.0f || q <= 0.0f || center_hz >= 0.5f * sample_hz * MAX_NYQUIST_FRACTION)
+    return passthrough();
+
+  float w0 = 2.0f * PI * center_hz / sample_hz;
+  float cos_w0 = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * q);
+  float inv_a0 = 1.0f / (1.0f + alpha);
+
+  Coefficients c;
+  c.b0 = inv_a0;
+  c.b1 = -2.0f * cos_w0 * inv_a0;
+  c.b2 = inv_a0;
+  c.a1 = c.b1;
+  c.a2 = (1.0f - alpha) * inv_a0;
+  return c;
+}
+
+BiquadFilterBank::Coefficients BiquadFilterBank::passthrough()
+{
+  Coefficients c = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  return c;
+}
+
+float BiquadFilterBank::butterworth_q(uint8_t stage, uint8_t num_stages)
+{
+  // poles of an order 2n Butterworth filter pair up at angles (2k + 1)*pi/(4n) from the real axis
+  return 1.0f / (2.0f * cosf(PI * static_cast<float>(2 * stage + 1) / static_cast<float>(4 * num_stages)));
+}
+
+BiquadFilterBank::BiquadFilterBank(Stage *stages, uint8_t capacity) :
+  stages_(stages),
+  capacity_(capacity)
+{
+  clear();
+}
+
+void BiquadFilterBank::clear()
+{
+  num_stages_ = 0;
+}
+
+uint8_t BiquadFilterBank::add_stage(const Coefficients &coefficients)
+{
+  if (num_stages_ >= capacity_)
+    return MAX_STAGES;
+
+  uint8_t stage = num_stages_++;
+  for (uint8_t axis = 0; axis < LANES; axis++)
+  {
+    set_coefficients(stage, axis, coefficients);
+    stages_[stage].z1[axis] = 0.0f;
+    stages_[stage].z2[axis] = 0.0f;
+  }
+  return stage;
+}
+
+void BiquadFilterBank::set_coefficients(uint8_t stage, uint8_t axis, const Coefficients &coefficients)
+{
+  if (stage >= num_stages_ || axis >= LANES)
+    return;
+
+  Stage &s = stages_[stage];
+  s.b0[axis] = coefficients.b0;
+  s.b1[axis] = coefficients.b1;
+  s.b2[axis] = coefficients.b2;
+  s.a1[axis] = coefficients.a1;
+  s.a2[axis] = coefficients.a2;
+}
+
+void BiquadFilterBank::reset(const float value[NUM_AXES])
+{
+  float x[LANES] = {value[0], value[1], value[2], 0.0f};
+  for (uint8_t stage = 0; stage < num_stages_; stage++)
+  {
+    Stage &s = stages_[stage];
+    for (uint8_t i = 0; i < LANES; i++)
+    {
+      // a constant input x settles at y = x*(b0 + b1 + b2)/(1 + a1 + a2)
+      float y = x[i] * (s.b0[i] + s.b1[i] + s.b2[i]) / (1.0f + s.a1[i] + s.a2[i]);
+      s.z2[i] = s.b2[i] * x[i] - s.a2[i] * y;
+      s.z1[i] = y - s.b0[i] * x[i];
+      x[i] = y;
+    }
+  }
+}
+
+void BiquadFilterBank::apply(const float input[NUM_AXES], float output[NUM_AXES])
+{
+  float x[LANES] = {input[0], input[1], input[2], 0.0f};
+  for (uint8_t stage = 0; stage < num_stages_; stage++)
+  {
+    // transposed direct form II, the same operations on every lane
+    Stage &s = stages_[stage];
+    for (uint8_t i = 0; i < LANES; i++)
+    {
+      float y = s.b0[i] * x[i] + s.z1[i];
+      s.z1[i] = s.b1[i] * x[i] - s.a1[i] * y + s.z2[i];
+      s.z2[i] = s.b2[i] * x[i] - s.a2[i] * y;
+      x[i] = y;
+    }
+  }
+  output[0] = x[0];
+  output[1] = x[1];
+  output[2] = x[2];
+}
+
+} // namespace rosflight_firmware
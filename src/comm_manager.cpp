@@ -40,6 +40,13 @@
 namespace rosflight_firmware
 {
 
+namespace
+{
+// A ground station parameter batch that goes this long without a change, because the link dropped
+// or the commit was lost, is committed
+constexpr uint32_t PARAM_BATCH_TIMEOUT_MS = 1000;
+}
+
 CommManager::LogMessageBuffer::LogMessageBuffer()
 {
   memset(buffer_, 0, sizeof(buffer_));
@@ -88,10 +95,12 @@ void CommManager::init()
   send_params_index_ = PARAMS_COUNT;
 
   update_system_id(PARAM_SYSTEM_ID);
+  update_link_capacity();
   set_streaming_rate(STREAM_ID_HEARTBEAT, PARAM_STREAM_HEARTBEAT_RATE);
   set_streaming_rate(STREAM_ID_STATUS, PARAM_STREAM_STATUS_RATE);
   set_streaming_rate(STREAM_ID_IMU, PARAM_STREAM_IMU_RATE);
   set_streaming_rate(STREAM_ID_ATTITUDE, PARAM_STREAM_ATTITUDE_RATE);
+  set_streaming_rate(STREAM_ID_ALTITUDE, PARAM_STREAM_ALTITUDE_RATE);
   set_streaming_rate(STREAM_ID_DIFF_PRESSURE, PARAM_STREAM_AIRSPEED_RATE);
   set_streaming_rate(STREAM_ID_BARO, PARAM_STREAM_BARO_RATE);
   set_streaming_rate(STREAM_ID_SONAR, PARAM_STREAM_SONAR_RATE);
@@ -101,8 +110,16 @@ void CommManager::init()
   set_streaming_rate(STREAM_ID_BATTERY_STATUS, PARAM_STREAM_BATTERY_STATUS_RATE);
   set_streaming_rate(STREAM_ID_SERVO_OUTPUT_RAW, PARAM_STREAM_OUTPUT_RAW_RATE);
   set_streaming_rate(STREAM_ID_RC_RAW, PARAM_STREAM_RC_RAW_RATE);
+  set_streaming_rate(STREAM_ID_LOOP_PROFILE, PARAM_STREAM_LOOP_PROFILE_RATE);
+  set_streaming_rate(STREAM_ID_GYRO_SPECTRUM, PARAM_STREAM_GYRO_SPECTRUM_RATE);
+
+  last_stream_us_ = RF_.board_.clock_micros();
+  rate_window_start_us_ = last_stream_us_;
+  link_budget_bytes_ = link_burst_bytes_;
+  rebuild_schedule();
 
   initialized_ = true;
+  check_link_load();
 }
 
 void CommManager::param_change_callback(uint16_t param_id)
@@ -112,6 +129,10 @@ void CommManager::param_change_callback(uint16_t param_id)
   case PARAM_SYSTEM_ID:
     update_system_id(param_id);
     break;
+  case PARAM_BAUD_RATE:
+    update_link_capacity();
+    check_link_load();
+    break;
   case PARAM_STREAM_HEARTBEAT_RATE:
     set_streaming_rate(STREAM_ID_HEARTBEAT, param_id);
     break;
@@ -124,6 +145,9 @@ void CommManager::param_change_callback(uint16_t param_id)
   case PARAM_STREAM_ATTITUDE_RATE:
     set_streaming_rate(STREAM_ID_ATTITUDE, param_id);
     break;
+  case PARAM_STREAM_ALTITUDE_RATE:
+    set_streaming_rate(STREAM_ID_ALTITUDE, param_id);
+    break;
   case PARAM_STREAM_AIRSPEED_RATE:
     set_streaming_rate(STREAM_ID_DIFF_PRESSURE, param_id);
     break;
@@ -151,6 +175,12 @@ void CommManager::param_change_callback(uint16_t param_id)
   case PARAM_STREAM_BATTERY_STATUS_RATE:
     set_streaming_rate(STREAM_ID_BATTERY_STATUS, param_id);
     break;
+  case PARAM_STREAM_LOOP_PROFILE_RATE:
+    set_streaming_rate(STREAM_ID_LOOP_PROFILE, param_id);
+    break;
+  case PARAM_STREAM_GYRO_SPECTRUM_RATE:
+    set_streaming_rate(STREAM_ID_GYRO_SPECTRUM, param_id);
+    break;
   default:
     // do nothing
     break;
@@ -223,7 +253,8 @@ void CommManager::param_set_int_callback(uint8_t target_system, const char* cons
 
     if (id < PARAMS_COUNT && RF_.params_.get_param_type(id) == PARAM_TYPE_INT32)
     {
-      RF_.params_.set_param_int(id, param_value);
+      RF_.params_.stage_param_int(id, param_value);
+      param_batch_time_ms_ = RF_.board_.clock_millis();
     }
   }
 }
@@ -236,7 +267,8 @@ void CommManager::param_set_float_callback(uint8_t target_system, const char* co
 
     if (id < PARAMS_COUNT && RF_.params_.get_param_type(id) == PARAM_TYPE_FLOAT)
     {
-      RF_.params_.set_param_float(id, param_value);
+      RF_.params_.stage_param_float(id, param_value);
+      param_batch_time_ms_ = RF_.board_.clock_millis();
     }
   }
 }
@@ -247,8 +279,8 @@ void CommManager::command_callback(CommLinkInterface::Command command)
   bool reboot_flag = false;
   bool reboot_to_bootloader_flag = false;
 
-  // None of these actions can be performed if we are armed
-  if (RF_.state_manager_.state().armed)
+  // None of these actions can be performed if we are armed (except closing an open parameter batch)
+  if (RF_.state_manager_.state().armed && command != CommLinkInterface::Command::COMMAND_PARAM_BATCH_COMMIT)
   {
     result = false;
   }
@@ -259,12 +291,15 @@ void CommManager::command_callback(CommLinkInterface::Command command)
     {
     case CommLinkInterface::Command::COMMAND_READ_PARAMS:
       result = RF_.params_.read();
+      if (result)
+        RF_.params_.change_callback_all();
       break;
     case CommLinkInterface::Command::COMMAND_WRITE_PARAMS:
       result = RF_.params_.write();
       break;
     case CommLinkInterface::Command::COMMAND_SET_PARAM_DEFAULTS:
       RF_.params_.set_defaults();
+      RF_.params_.change_callback_all();
       break;
     case CommLinkInterface::Command::COMMAND_ACCEL_CALIBRATION:
       result = RF_.sensors_.start_imu_calibration();
@@ -290,17 +325,29 @@ void CommManager::command_callback(CommLinkInterface::Command command)
     case CommLinkInterface::Command::COMMAND_SEND_VERSION:
       comm_link_.send_version(sysid_, GIT_VERSION_STRING);
       break;
+    case CommLinkInterface::Command::COMMAND_PARAM_BATCH_BEGIN:
+      if (!param_batch_open_)
+        RF_.params_.begin_batch();
+      param_batch_open_ = true;
+      param_batch_time_ms_ = RF_.board_.clock_millis();
+      break;
+    case CommLinkInterface::Command::COMMAND_PARAM_BATCH_COMMIT:
+      result = param_batch_open_;
+      if (param_batch_open_)
+        RF_.params_.commit_batch();
+      param_batch_open_ = false;
+      break;
     }
   }
 
   comm_link_.send_command_ack(sysid_, command, result);
+  comm_link_.flush();
 
   if (reboot_flag || reboot_to_bootloader_flag)
   {
     RF_.board_.clock_delay(20);
     RF_.board_.board_reset(reboot_to_bootloader_flag);
   }
-  RF_.board_.serial_flush();
 }
 
 void CommManager::timesync_callback(int64_t tc1, int64_t ts1)
@@ -357,6 +404,12 @@ void CommManager::offboard_control_callback(const CommLinkInterface::OffboardCon
     new_offboard_command.z.type = RATE;
     new_offboard_command.F.type = THROTTLE;
     break;
+  case CommLinkInterface::OffboardControl::Mode::ROLL_PITCH_YAWRATE_ALTITUDE:
+    new_offboard_command.x.type = ANGLE;
+    new_offboard_command.y.type = ANGLE;
+    new_offboard_command.z.type = RATE;
+    new_offboard_command.F.type = ALTITUDE;
+    break;
   }
 
   // Tell the command_manager that we have a new command we need to mux
@@ -396,7 +449,16 @@ void CommManager::aux_command_callback(const CommLinkInterface::AuxCommand &comm
 
 void CommManager::external_attitude_callback(const turbomath::Quaternion &q)
 {
-  RF_.estimator_.set_external_attitude_update(q);
+  // The message carries no timestamp, so the time it was measured at is its arrival time less the
+  // configured latency of the measurement pipeline
+  uint64_t now_us = RF_.board_.clock_micros();
+  int32_t delay_ms = RF_.params_.get_param_int(PARAM_EXT_ATT_DELAY);
+  if (delay_ms < 0)
+    delay_ms = 0;
+  uint64_t delay_us = static_cast<uint64_t>(delay_ms) * 1000;
+  if (delay_us > AttitudeHistory::MAX_DELAY_US)
+    delay_us = AttitudeHistory::MAX_DELAY_US;
+  RF_.estimator_.set_external_attitude_update(q, (now_us > delay_us) ? now_us - delay_us : 0);
 }
 
 void CommManager::heartbeat_callback(void)
@@ -420,7 +482,17 @@ void CommManager::heartbeat_callback(void)
 // function definitions
 void CommManager::receive(void)
 {
+  // coalesce all parameter sets parsed in this call, so listeners run once per changed id set
+  RF_.params_.begin_batch();
   comm_link_.receive();
+  RF_.params_.commit_batch();
+
+  if (param_batch_open_ && RF_.board_.clock_millis() > param_batch_time_ms_ + PARAM_BATCH_TIMEOUT_MS)
+  {
+    RF_.params_.commit_batch();
+    param_batch_open_ = false;
+    log(CommLinkInterface::LogSeverity::LOG_WARNING, "Parameter batch timed out, committed");
+  }
 }
 
 void CommManager::log(CommLinkInterface::LogSeverity severity, const char *fmt, ...)
@@ -442,19 +514,22 @@ void CommManager::log(CommLinkInterface::LogSeverity severity, const char *fmt,
   }
 }
 
-void CommManager::send_heartbeat(void)
+bool CommManager::send_heartbeat(void)
 {
   comm_link_.send_heartbeat(sysid_, static_cast<bool>(RF_.params_.get_param_int(PARAM_FIXED_WING)));
+  return true;
 }
 
-void CommManager::send_status(void)
+bool CommManager::send_status(void)
 {
   if (!initialized_)
-    return;
+    return false;
 
   uint8_t control_mode = 0;
   if (RF_.params_.get_param_int(PARAM_FIXED_WING))
     control_mode = MODE_PASS_THROUGH;
+  else if (RF_.command_manager_.combined_control().F.type == ALTITUDE)
+    control_mode = MODE_ROLL_PITCH_YAWRATE_ALTITUDE;
   else if (RF_.command_manager_.combined_control().x.type == ANGLE)
     control_mode = MODE_ROLL_PITCH_YAWRATE_THROTTLE;
   else
@@ -469,18 +544,30 @@ void CommManager::send_status(void)
                          control_mode,
                          RF_.board_.num_sensor_errors(),
                          RF_.get_loop_time_us());
+  return true;
 }
 
 
-void CommManager::send_attitude(void)
+bool CommManager::send_attitude(void)
 {
   comm_link_.send_attitude_quaternion(sysid_,
                                       RF_.estimator_.state().timestamp_us,
                                       RF_.estimator_.state().attitude,
                                       RF_.estimator_.state().angular_velocity);
+  return true;
+}
+
+bool CommManager::send_altitude(void)
+{
+  if (!RF_.estimator_.altitude_valid())
+    return false;
+
+  comm_link_.send_altitude(sysid_, RF_.board_.clock_millis(), RF_.estimator_.state().altitude,
+                           RF_.estimator_.state().climb_rate);
+  return true;
 }
 
-void CommManager::send_imu(void)
+bool CommManager::send_imu(void)
 {
   turbomath::Vector acc, gyro;
   uint64_t stamp_us;
@@ -490,17 +577,18 @@ void CommManager::send_imu(void)
                       acc,
                       gyro,
                       RF_.sensors_.data().imu_temperature);
-
+  return true;
 }
 
-void CommManager::send_output_raw(void)
+bool CommManager::send_output_raw(void)
 {
   comm_link_.send_output_raw(sysid_,
                              RF_.board_.clock_millis(),
                              RF_.mixer_.get_outputs());
+  return true;
 }
 
-void CommManager::send_rc_raw(void)
+bool CommManager::send_rc_raw(void)
 {
   // TODO better mechanism for retreiving RC (through RC module, not PWM-specific)
   uint16_t channels[8] = { static_cast<uint16_t>(RF_.board_.rc_read(0)*1000 + 1000),
@@ -512,9 +600,10 @@ void CommManager::send_rc_raw(void)
                            static_cast<uint16_t>(RF_.board_.rc_read(6)*1000 + 1000),
                            static_cast<uint16_t>(RF_.board_.rc_read(7)*1000 + 1000) };
   comm_link_.send_rc_raw(sysid_, RF_.board_.clock_millis(), channels);
+  return true;
 }
 
-void CommManager::send_diff_pressure(void)
+bool CommManager::send_diff_pressure(void)
 {
   if (RF_.sensors_.data().diff_pressure_valid)
   {
@@ -522,10 +611,12 @@ void CommManager::send_diff_pressure(void)
                                   RF_.sensors_.data().diff_pressure_velocity,
                                   RF_.sensors_.data().diff_pressure,
                                   RF_.sensors_.data().diff_pressure_temp);
+    return true;
   }
+  return false;
 }
 
-void CommManager::send_baro(void)
+bool CommManager::send_baro(void)
 {
   if (RF_.sensors_.data().baro_valid)
   {
@@ -533,10 +624,12 @@ void CommManager::send_baro(void)
                          RF_.sensors_.data().baro_altitude,
                          RF_.sensors_.data().baro_pressure,
                          RF_.sensors_.data().baro_temperature);
+    return true;
   }
+  return false;
 }
 
-void CommManager::send_sonar(void)
+bool CommManager::send_sonar(void)
 {
   if (RF_.sensors_.data().sonar_range_valid)
   {
@@ -545,19 +638,27 @@ void CommManager::send_sonar(void)
                           RF_.sensors_.data().sonar_range,
                           8.0,
                           0.25);
+    return true;
   }
+  return false;
 }
 
-void CommManager::send_mag(void)
+bool CommManager::send_mag(void)
 {
-  if (RF_.sensors_.data().mag_present)
-    comm_link_.send_mag(sysid_, RF_.sensors_.data().mag);
+  if (!RF_.sensors_.data().mag_present)
+    return false;
+
+  comm_link_.send_mag(sysid_, RF_.sensors_.data().mag);
+  return true;
 }
-void CommManager::send_battery_status(void)
+bool CommManager::send_battery_status(void)
 {
-  if(RF_.sensors_.data().battery_monitor_present)
-    comm_link_.send_battery_status(sysid_, RF_.sensors_.data().battery_voltage,
-        RF_.sensors_.data().battery_current);
+  if (!RF_.sensors_.data().battery_monitor_present)
+    return false;
+
+  comm_link_.send_battery_status(sysid_, RF_.sensors_.data().battery_voltage,
+                                 RF_.sensors_.data().battery_current);
+  return true;
 }
 
 void CommManager::send_backup_data(const StateManager::BackupData& backup_data)
@@ -574,7 +675,7 @@ void CommManager::send_backup_data(const StateManager::BackupData& backup_data)
 
 }
 
-void CommManager::send_gnss(void)
+bool CommManager::send_gnss(void)
 {
   const GNSSData& gnss_data = RF_.sensors_.data().gnss_data;
 
@@ -584,11 +685,13 @@ void CommManager::send_gnss(void)
     {
       comm_link_.send_gnss(sysid_, gnss_data);
       last_sent_gnss_tow_ = gnss_data.time_of_week;
+      return true;
     }
   }
+  return false;
 }
 
-void CommManager::send_gnss_raw()
+bool CommManager::send_gnss_raw(void)
 {
   const GNSSRaw& gnss_raw = RF_.sensors_.data().gnss_raw;
 
@@ -598,13 +701,43 @@ void CommManager::send_gnss_raw()
     {
       comm_link_.send_gnss_raw(sysid_, RF_.sensors_.data().gnss_raw);
       last_sent_gnss_raw_tow_ = gnss_raw.time_of_week;
+      return true;
     }
   }
+  return false;
 }
 
-void CommManager::send_low_priority(void)
+// Sends the statistics of one main loop stage per call, then starts a new measurement window for it
+bool CommManager::send_loop_profile(void)
 {
-  send_next_param();
+  Profiler::Stage stage = static_cast<Profiler::Stage>(next_profile_stage_);
+  comm_link_.send_loop_profile(sysid_, RF_.board_.clock_millis(), Profiler::stage_name(stage),
+                               RF_.profiler_.stats(stage));
+  RF_.profiler_.reset(stage);
+  next_profile_stage_ = (next_profile_stage_ + 1) % Profiler::STAGE_COUNT;
+  return true;
+}
+
+// Sends the vibration peaks of one gyro axis per call, once the analyzer has produced a result
+bool CommManager::send_gyro_spectrum(void)
+{
+#if ROSFLIGHT_GYRO_SPECTRUM
+  const SpectrumAnalyzer &spectrum = RF_.sensors_.gyro_spectrum();
+  if (spectrum.num_results() == 0)
+    return false;
+
+  comm_link_.send_gyro_spectrum(sysid_, RF_.board_.clock_millis(), next_spectrum_axis_,
+                                spectrum.peaks(next_spectrum_axis_), SpectrumAnalyzer::NUM_PEAKS);
+  next_spectrum_axis_ = (next_spectrum_axis_ + 1) % SpectrumAnalyzer::NUM_AXES;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool CommManager::send_low_priority(void)
+{
+  bool sent = send_next_param();
 
   // send buffered log messages
   if (connected_ && !log_buffer_.empty())
@@ -612,23 +745,191 @@ void CommManager::send_low_priority(void)
     const LogMessageBuffer::LogMessage& msg = log_buffer_.oldest();
     comm_link_.send_log_message(sysid_, msg.severity, msg.msg);
     log_buffer_.pop();
+    sent = true;
   }
+  return sent;
 }
 
 // function definitions
 void CommManager::stream()
 {
   uint64_t time_us = RF_.board_.clock_micros();
-  for (int i = 0; i < STREAM_COUNT; i++)
+
+  // replenish the link budget for the time since the last call
+  link_budget_bytes_ += static_cast<float>(time_us - last_stream_us_) * link_bytes_per_us_;
+  if (link_budget_bytes_ > link_burst_bytes_)
+    link_budget_bytes_ = link_burst_bytes_;
+  last_stream_us_ = time_us;
+
+  // take everything that is due off the schedule
+  uint8_t due[STREAM_COUNT];
+  uint8_t due_count = 0;
+  while (schedule_size_ > 0 && streams_[schedule_[0]].next_time_us_ <= time_us)
+    due[due_count++] = schedule_pop();
+
+  if (due_count > 0)
   {
-    streams_[i].stream(time_us);
+    // order by priority, keeping table order within a priority
+    for (uint8_t i = 1; i < due_count; i++)
+    {
+      uint8_t id = due[i];
+      uint8_t j = i;
+      for (; j > 0 && (streams_[due[j-1]].priority_ > streams_[id].priority_
+                       || (streams_[due[j-1]].priority_ == streams_[id].priority_ && due[j-1] > id)); j--)
+        due[j] = due[j-1];
+      due[j] = id;
+    }
+
+    // high priority streams always go out (and may borrow against the budget), everything else waits
+    // until the link has room for it
+    for (uint8_t i = 0; i < due_count; i++)
+    {
+      Stream &stream = streams_[due[i]];
+      if (stream.priority_ != STREAM_PRIORITY_HIGH && link_budget_bytes_ < stream.size_bytes_)
+        stream.deferred_++;
+      else if (stream.send(*this, time_us))
+        link_budget_bytes_ -= stream.size_bytes_;
+    }
+
+    // deferred streams go back unchanged, so they are retried on the next call
+    for (uint8_t i = 0; i < due_count; i++)
+      schedule_push(due[i]);
   }
-  RF_.board_.serial_flush();
+
+  update_achieved_rates(time_us);
+  comm_link_.flush();
 }
 
 void CommManager::set_streaming_rate(uint8_t stream_id, int16_t param_id)
 {
-  streams_[stream_id].set_rate(RF_.params_.get_param_int(param_id));
+  Stream &stream = streams_[stream_id];
+  stream.set_rate(RF_.params_.get_param_int(param_id));
+
+  // spread the streams across their period so they don't all come due in the same loop
+  stream.next_time_us_ = RF_.board_.clock_micros() + stream.period_us_ * stream_id / STREAM_COUNT;
+  rebuild_schedule();
+
+  if (initialized_)
+    check_link_load();
+}
+
+bool CommManager::scheduled_before(uint8_t a, uint8_t b) const
+{
+  return streams_[a].next_time_us_ < streams_[b].next_time_us_;
+}
+
+void CommManager::schedule_push(uint8_t stream_id)
+{
+  uint8_t i = schedule_size_++;
+  while (i > 0)
+  {
+    uint8_t parent = static_cast<uint8_t>((i - 1) / 2);
+    if (!scheduled_before(stream_id, schedule_[parent]))
+      break;
+    schedule_[i] = schedule_[parent];
+    i = parent;
+  }
+  schedule_[i] = stream_id;
+}
+
+uint8_t CommManager::schedule_pop(void)
+{
+  uint8_t top = schedule_[0];
+  uint8_t last = schedule_[--schedule_size_];
+  uint8_t i = 0;
+  while (true)
+  {
+    uint8_t child = static_cast<uint8_t>(2*i + 1);
+    if (child >= schedule_size_)
+      break;
+    if (child + 1 < schedule_size_ && scheduled_before(schedule_[child + 1], schedule_[child]))
+      child++;
+    if (!scheduled_before(schedule_[child], last))
+      break;
+    schedule_[i] = schedule_[child];
+    i = child;
+  }
+  schedule_[i] = last;
+  return top;
+}
+
+void CommManager::rebuild_schedule(void)
+{
+  // streams with a rate of zero are left off the schedule entirely
+  schedule_size_ = 0;
+  for (uint8_t i = 0; i < STREAM_COUNT; i++)
+  {
+    if (streams_[i].period_us_ > 0)
+      schedule_push(i);
+  }
+}
+
+void CommManager::update_link_capacity(void)
+{
+  // 10 bits on the wire for each byte (start, 8 data, stop)
+  uint32_t baud_rate = static_cast<uint32_t>(RF_.params_.get_param_int(PARAM_BAUD_RATE));
+  link_bytes_per_us_ = static_cast<float>(baud_rate) / 10.0f / 1e6f;
+
+  // the burst must fit the largest message, or that stream could never be sent
+  link_burst_bytes_ = link_bytes_per_us_ * LINK_BURST_US;
+  for (int i = 0; i < STREAM_COUNT; i++)
+  {
+    if (streams_[i].size_bytes_ > link_burst_bytes_)
+      link_burst_bytes_ = streams_[i].size_bytes_;
+  }
+  if (link_budget_bytes_ > link_burst_bytes_)
+    link_budget_bytes_ = link_burst_bytes_;
+}
+
+void CommManager::check_link_load(void)
+{
+  bool oversubscribed = link_load_bytes_per_s() > link_capacity_bytes_per_s();
+  if (oversubscribed && !link_oversubscribed_)
+    log(CommLinkInterface::LogSeverity::LOG_WARNING, "Stream rates exceed link (%u of %u B/s)",
+        link_load_bytes_per_s(), link_capacity_bytes_per_s());
+  link_oversubscribed_ = oversubscribed;
+}
+
+void CommManager::update_achieved_rates(uint64_t now_us)
+{
+  uint64_t elapsed_us = now_us - rate_window_start_us_;
+  if (elapsed_us < RATE_WINDOW_US)
+    return;
+
+  for (int i = 0; i < STREAM_COUNT; i++)
+  {
+    streams_[i].achieved_rate_hz_ = static_cast<float>(streams_[i].sent_) * 1e6f / static_cast<float>(elapsed_us);
+    streams_[i].sent_ = 0;
+  }
+  rate_window_start_us_ = now_us;
+}
+
+CommManager::StreamStats CommManager::stream_stats(StreamId stream_id) const
+{
+  const Stream &stream = streams_[stream_id];
+  StreamStats stats;
+  stats.requested_rate_hz = (stream.period_us_ == 0) ? 0 : 1000000/stream.period_us_;
+  stats.achieved_rate_hz = stream.achieved_rate_hz_;
+  stats.deferred = stream.deferred_;
+  return stats;
+}
+
+uint32_t CommManager::link_capacity_bytes_per_s(void) const
+{
+  return static_cast<uint32_t>(link_bytes_per_us_ * 1e6f + 0.5f);
+}
+
+uint32_t CommManager::link_load_bytes_per_s(void) const
+{
+  // streams that only send on new data are bounded by their sensor, not by the configured rate, so
+  // only fixed-rate streams are counted here
+  uint32_t load = 0;
+  for (int i = 0; i < STREAM_COUNT; i++)
+  {
+    if (streams_[i].fixed_rate_ && streams_[i].period_us_ > 0)
+      load += streams_[i].size_bytes_ * (1000000/streams_[i].period_us_);
+  }
+  return load;
 }
 
 void CommManager::send_named_value_int(const char *const name, int32_t value)
@@ -641,34 +942,60 @@ void CommManager::send_named_value_float(const char *const name, float value)
   comm_link_.send_named_value_float(sysid_, RF_.board_.clock_millis(), name, value);
 }
 
-void CommManager::send_next_param(void)
+void CommManager::queue_param_value(uint16_t param_id)
 {
+  if (param_id < PARAMS_COUNT)
+    param_value_pending_[param_id / 32] |= (1u << (param_id % 32));
+}
+
+bool CommManager::send_next_param(void)
+{
+  // echoes of individually changed params go out before the rest of the list
+  for (uint16_t word = 0; word < (PARAMS_COUNT + 31)/32; word++)
+  {
+    if (param_value_pending_[word] != 0)
+    {
+      uint16_t bit = 0;
+      while (!(param_value_pending_[word] & (1u << bit)))
+        bit++;
+      param_value_pending_[word] &= ~(1u << bit);
+      send_param_value(static_cast<uint16_t>(word*32 + bit));
+      return true;
+    }
+  }
+
   if (send_params_index_ < PARAMS_COUNT)
   {
     send_param_value(static_cast<uint16_t>(send_params_index_));
     send_params_index_++;
+    return true;
   }
+  return false;
 }
 
-CommManager::Stream::Stream(uint32_t period_us, std::function<void(void)> send_function) :
+CommManager::Stream::Stream(uint32_t period_us, uint16_t size_bytes, StreamPriority priority, bool fixed_rate,
+                            SendFunction send_function) :
   period_us_(period_us),
   next_time_us_(0),
+  size_bytes_(size_bytes),
+  priority_(priority),
+  fixed_rate_(fixed_rate),
   send_function_(send_function)
 {}
 
-void CommManager::Stream::stream(uint64_t now_us)
+bool CommManager::Stream::send(CommManager &comm_manager, uint64_t now_us)
 {
-  if (period_us_ > 0 && now_us >= next_time_us_)
+  // if you fall behind, skip messages
+  do
   {
-    // if you fall behind, skip messages
-    do
-    {
-      next_time_us_ += period_us_;
-    }
-    while(next_time_us_ < now_us);
-
-    send_function_();
+    next_time_us_ += period_us_;
   }
+  while(next_time_us_ < now_us);
+
+  bool sent = (comm_manager.*send_function_)();
+  if (sent)
+    sent_++;
+  return sent;
 }
 
 void CommManager::Stream::set_rate(uint32_t rate_hz)
@@ -211,8 +211,9 @@ bool CommandManager::do_throttle_muxing(void)
   {
     if (muxes[MUX_F].onboard->active)
     {
-      // Check if the parameter flag is set to have us always take the smaller throttle
-      if (RF_.params_.get_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE))
+      // Check if the parameter flag is set to have us always take the smaller throttle. An altitude
+      // command is not a throttle, so the controller applies that limit to its output instead.
+      if (RF_.params_.get_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE) && muxes[MUX_F].onboard->type != ALTITUDE)
       {
         override_this_channel = (muxes[MUX_F].rc->value < muxes[MUX_F].onboard->value);
       }
@@ -41,6 +41,14 @@
 namespace rosflight_firmware
 {
 
+namespace
+{
+constexpr float GRAVITY = 9.80665f;
+constexpr float MIN_THRUST_COS_TILT = 0.5f; // tilt compensation of altitude hold stops growing at 60 degrees
+constexpr float MIN_HOVER_THROTTLE = 0.05f; // altitude hold divides by the hover throttle
+constexpr float MAX_HOVER_THROTTLE = 0.95f;
+} // namespace
+
 Controller::Controller(ROSflight &rf) :
   RF_(rf)
 {
@@ -49,6 +57,10 @@ Controller::Controller(ROSflight &rf) :
 void Controller::init()
 {
   prev_time_us_ = 0;
+  prev_angle_time_us_ = 0;
+  roll_angle_held_ = false;
+  pitch_angle_held_ = false;
+  altitude_held_ = false;
 
   float max = RF_.params_.get_param_float(PARAM_MAX_COMMAND);
   float min = -max;
@@ -74,6 +86,27 @@ void Controller::init()
                  RF_.params_.get_param_float(PARAM_PID_YAW_RATE_I),
                  RF_.params_.get_param_float(PARAM_PID_YAW_RATE_D),
                  max, min, tau);
+
+  float max_climb = RF_.params_.get_param_float(PARAM_ALT_MAX_CLIMB);
+  hover_throttle_ = RF_.params_.get_param_float(PARAM_HOVER_THROTTLE);
+  if (!(hover_throttle_ >= MIN_HOVER_THROTTLE)) // also catches NaN
+    hover_throttle_ = MIN_HOVER_THROTTLE;
+  else if (hover_throttle_ > MAX_HOVER_THROTTLE)
+    hover_throttle_ = MAX_HOVER_THROTTLE;
+  altitude_.init(RF_.params_.get_param_float(PARAM_PID_ALT_P), 0.0f, 0.0f, max_climb, -max_climb, tau);
+  climb_rate_.init(RF_.params_.get_param_float(PARAM_PID_CLIMB_P),
+                   RF_.params_.get_param_float(PARAM_PID_CLIMB_I),
+                   RF_.params_.get_param_float(PARAM_PID_CLIMB_D),
+                   GRAVITY*(1.0f/hover_throttle_ - 1.0f), -GRAVITY, tau);
+
+  update_equilibrium_torque();
+}
+
+void Controller::update_equilibrium_torque()
+{
+  equilibrium_torque_.x = RF_.params_.get_param_float(PARAM_X_EQ_TORQUE);
+  equilibrium_torque_.y = RF_.params_.get_param_float(PARAM_Y_EQ_TORQUE);
+  equilibrium_torque_.z = RF_.params_.get_param_float(PARAM_Z_EQ_TORQUE);
 }
 
 void Controller::run()
@@ -82,6 +115,7 @@ void Controller::run()
   if (prev_time_us_ == 0)
   {
     prev_time_us_ = RF_.estimator_.state().timestamp_us;
+    prev_angle_time_us_ = prev_time_us_;
     return;
   }
 
@@ -93,18 +127,37 @@ void Controller::run()
   }
   prev_time_us_ = RF_.estimator_.state().timestamp_us;
 
+  bool update_angle = RF_.estimator_.attitude_updated();
+  uint32_t angle_dt_us = 0;
+  if (update_angle)
+  {
+    angle_dt_us = prev_time_us_ - prev_angle_time_us_;
+    prev_angle_time_us_ = prev_time_us_;
+  }
+
+  const control_t &command = RF_.command_manager_.combined_control();
+
+  // An altitude command is turned into throttle first, so the checks below see the throttle
+  float throttle = command.F.value;
+  if (command.F.type == ALTITUDE)
+    throttle = run_altitude_loop(dt_us, RF_.estimator_.state(), command.F.value,
+                                 RF_.state_manager_.state().armed && dt_us < 10000);
+  else
+    altitude_held_ = false;
+
   // Check if integrators should be updated
   //! @todo better way to figure out if throttle is high
-  bool update_integrators = (RF_.state_manager_.state().armed) && (RF_.command_manager_.combined_control().F.value > 0.1f) && dt_us < 10000;
+  bool update_integrators = (RF_.state_manager_.state().armed) && (throttle > 0.1f) && dt_us < 10000;
 
   // Run the PID loops
-  turbomath::Vector pid_output = run_pid_loops(dt_us, RF_.estimator_.state(), RF_.command_manager_.combined_control(), update_integrators);
+  turbomath::Vector pid_output = run_pid_loops(dt_us, angle_dt_us, RF_.estimator_.state(), command,
+                                               update_integrators, update_angle);
 
   // Add feedforward torques
-  output_.x = pid_output.x + RF_.params_.get_param_float(PARAM_X_EQ_TORQUE);
-  output_.y = pid_output.y + RF_.params_.get_param_float(PARAM_Y_EQ_TORQUE);
-  output_.z = pid_output.z + RF_.params_.get_param_float(PARAM_Z_EQ_TORQUE);
-  output_.F = RF_.command_manager_.combined_control().F.value;
+  output_.x = pid_output.x + equilibrium_torque_.x;
+  output_.y = pid_output.y + equilibrium_torque_.y;
+  output_.z = pid_output.z + equilibrium_torque_.z;
+  output_.F = throttle;
 }
 
 void Controller::calculate_equilbrium_torque_from_rc()
@@ -135,7 +188,9 @@ void Controller::calculate_equilbrium_torque_from_rc()
     // dt is zero, so what this really does is applies the P gain with the settings
     // your RC transmitter, which if it flies level is a really good guess for
     // the static offset torques
-    turbomath::Vector pid_output = run_pid_loops(0, fake_state, RF_.command_manager_.rc_control(), false);
+    turbomath::Vector pid_output = run_pid_loops(0, 0, fake_state, RF_.command_manager_.rc_control(), false, true);
+    roll_angle_held_ = false;
+    pitch_angle_held_ = false;
 
     // the output from the controller is going to be the static offsets
     RF_.params_.set_param_float(PARAM_X_EQ_TORQUE, pid_output.x + RF_.params_.get_param_float(PARAM_X_EQ_TORQUE));
@@ -153,55 +208,90 @@ void Controller::calculate_equilbrium_torque_from_rc()
 
 void Controller::param_change_callback(uint16_t param_id)
 {
-  switch (param_id)
+  param_change_batch_callback(&param_id, 1);
+}
+
+void Controller::param_change_batch_callback(const uint16_t *param_ids, size_t num_ids)
+{
+  bool reinit = false;
+  bool update_torque = false;
+  for (size_t i = 0; i < num_ids; i++)
   {
-  case PARAM_PID_ROLL_ANGLE_P:
-  case PARAM_PID_ROLL_ANGLE_I:
-  case PARAM_PID_ROLL_ANGLE_D:
-  case PARAM_PID_ROLL_RATE_P:
-  case PARAM_PID_ROLL_RATE_I:
-  case PARAM_PID_ROLL_RATE_D:
-  case PARAM_PID_PITCH_ANGLE_P:
-  case PARAM_PID_PITCH_ANGLE_I:
-  case PARAM_PID_PITCH_ANGLE_D:
-  case PARAM_PID_PITCH_RATE_P:
-  case PARAM_PID_PITCH_RATE_I:
-  case PARAM_PID_PITCH_RATE_D:
-  case PARAM_PID_YAW_RATE_P:
-  case PARAM_PID_YAW_RATE_I:
-  case PARAM_PID_YAW_RATE_D:
-  case PARAM_MAX_COMMAND:
-  case PARAM_PID_TAU:
-    init();
-    break;
-  default:
-    // do nothing
-    break;
+    switch (param_ids[i])
+    {
+    case PARAM_PID_ROLL_ANGLE_P:
+    case PARAM_PID_ROLL_ANGLE_I:
+    case PARAM_PID_ROLL_ANGLE_D:
+    case PARAM_PID_ROLL_RATE_P:
+    case PARAM_PID_ROLL_RATE_I:
+    case PARAM_PID_ROLL_RATE_D:
+    case PARAM_PID_PITCH_ANGLE_P:
+    case PARAM_PID_PITCH_ANGLE_I:
+    case PARAM_PID_PITCH_ANGLE_D:
+    case PARAM_PID_PITCH_RATE_P:
+    case PARAM_PID_PITCH_RATE_I:
+    case PARAM_PID_PITCH_RATE_D:
+    case PARAM_PID_YAW_RATE_P:
+    case PARAM_PID_YAW_RATE_I:
+    case PARAM_PID_YAW_RATE_D:
+    case PARAM_MAX_COMMAND:
+    case PARAM_PID_TAU:
+    case PARAM_PID_ALT_P:
+    case PARAM_PID_CLIMB_P:
+    case PARAM_PID_CLIMB_I:
+    case PARAM_PID_CLIMB_D:
+    case PARAM_HOVER_THROTTLE:
+    case PARAM_ALT_MAX_CLIMB:
+      reinit = true;
+      break;
+    case PARAM_X_EQ_TORQUE:
+    case PARAM_Y_EQ_TORQUE:
+    case PARAM_Z_EQ_TORQUE:
+      update_torque = true;
+      break;
+    default:
+      // do nothing
+      break;
+    }
   }
+
+  if (reinit)
+    init();
+  else if (update_torque)
+    update_equilibrium_torque();
 }
 
-turbomath::Vector Controller::run_pid_loops(uint32_t dt_us, const Estimator::State &state, const control_t &command, bool update_integrators)
+turbomath::Vector Controller::run_pid_loops(uint32_t dt_us, uint32_t angle_dt_us, const Estimator::State &state,
+                                            const control_t &command, bool update_integrators, bool update_angle)
 {
   // Based on the control types coming from the command manager, run the appropriate PID loops
   turbomath::Vector out;
 
   float dt = 1e-6*dt_us;
+  float angle_dt = 1e-6*angle_dt_us;
 
   // ROLL
+  // An angle loop that wasn't running yet is started right away, without integrating.
   if (command.x.type == RATE)
     out.x = roll_rate_.run(dt, state.angular_velocity.x, command.x.value, update_integrators);
+  else if (command.x.type == ANGLE && (update_angle || !roll_angle_held_))
+    out.x = roll_.run(angle_dt, state.roll, command.x.value, update_integrators, state.angular_velocity.x);
   else if (command.x.type == ANGLE)
-    out.x = roll_.run(dt, state.roll, command.x.value, update_integrators, state.angular_velocity.x);
+    out.x = roll_.damp(state.angular_velocity.x);
   else
     out.x = command.x.value;
+  roll_angle_held_ = (command.x.type == ANGLE);
 
   // PITCH
   if (command.y.type == RATE)
     out.y = pitch_rate_.run(dt, state.angular_velocity.y, command.y.value, update_integrators);
+  else if (command.y.type == ANGLE && (update_angle || !pitch_angle_held_))
+    out.y = pitch_.run(angle_dt, state.pitch, command.y.value, update_integrators, state.angular_velocity.y);
   else if (command.y.type == ANGLE)
-    out.y = pitch_.run(dt, state.pitch, command.y.value, update_integrators, state.angular_velocity.y);
+    out.y = pitch_.damp(state.angular_velocity.y);
   else
     out.y = command.y.value;
+  pitch_angle_held_ = (command.y.type == ANGLE);
 
   // YAW
   if (command.z.type == RATE)
@@ -212,6 +302,47 @@ turbomath::Vector Controller::run_pid_loops(uint32_t dt_us, const Estimator::Sta
   return out;
 }
 
+float Controller::run_altitude_loop(uint32_t dt_us, const Estimator::State &state, float altitude_c,
+                                    bool update_integrators)
+{
+  // Without an altitude estimate there is nothing to close the loop on, so hand the throttle back
+  // to the stick (the failsafe command replaces it if RC is lost) and start over once it is back
+  if (!RF_.estimator_.altitude_valid())
+  {
+    altitude_held_ = false;
+    return RF_.command_manager_.rc_control().F.value;
+  }
+
+  if (!altitude_held_)
+  {
+    altitude_.reset(state.altitude);
+    climb_rate_.reset(state.climb_rate);
+    altitude_held_ = true;
+  }
+
+  // With MIN_THROTTLE set, the throttle stick limits the output as it does for throttle commands
+  float max_throttle = 1.0f;
+  if (RF_.params_.get_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE))
+    max_throttle = RF_.command_manager_.rc_control().F.value;
+
+  // Thrust scales with throttle and only its vertical part lifts the vehicle. Limiting the climb
+  // rate loop to the acceleration that the throttle range gives at this tilt keeps its integrator
+  // from winding up when the output saturates.
+  const turbomath::Quaternion &q = state.attitude;
+  float cos_tilt = 1.0f - 2.0f*(q.x*q.x + q.y*q.y);
+  if (cos_tilt < MIN_THRUST_COS_TILT)
+    cos_tilt = MIN_THRUST_COS_TILT;
+  float max_accel = GRAVITY*(max_throttle*cos_tilt/hover_throttle_ - 1.0f);
+  climb_rate_.set_limits((max_accel > -GRAVITY) ? max_accel : -GRAVITY, -GRAVITY);
+
+  float dt = 1e-6*dt_us;
+  float climb_rate_c = altitude_.run(dt, state.altitude, altitude_c, false, state.climb_rate);
+  float accel_c = climb_rate_.run(dt, state.climb_rate, climb_rate_c, update_integrators);
+
+  float throttle = hover_throttle_*(1.0f + accel_c/GRAVITY)/cos_tilt;
+  return (throttle > max_throttle) ? max_throttle : (throttle < 0.0f) ? 0.0f : throttle;
+}
+
 Controller::PID::PID() :
   kp_(0.0f),
   ki_(0.0f),
@@ -221,7 +352,9 @@ Controller::PID::PID() :
   integrator_(0.0f),
   differentiator_(0.0f),
   prev_x_(0.0f),
-  tau_(0.05)
+  tau_(0.05),
+  u_(0.0f),
+  xdot_(0.0f)
 {}
 
 void Controller::PID::init(float kp, float ki, float kd, float max, float min, float tau)
@@ -282,15 +415,37 @@ float Controller::PID::run(float dt, float x, float x_c, bool update_integrator,
 
   // sum three terms
   float u = p_term - d_term + i_term;
+  u_ = u;
+  xdot_ = xdot;
 
   // Integrator anti-windup
   //// Include reference to Dr. Beard's notes here
   float u_sat = (u > max_) ? max_ : (u < min_) ? min_ : u;
-  if (u != u_sat && fabs(i_term) > fabs(u - p_term + d_term) && ki_ > 0.0f)
+  if (u != u_sat && fabs(i_term) > fabs(u_sat - p_term + d_term) && ki_ > 0.0f)
+  {
     integrator_ = (u_sat - p_term + d_term)/ki_;
+    u_ = u_sat;
+  }
 
   // Set output
   return u_sat;
 }
 
+void Controller::PID::reset(float x)
+{
+  integrator_ = 0.0f;
+  differentiator_ = 0.0f;
+  prev_x_ = x;
+  u_ = 0.0f;
+  xdot_ = 0.0f;
+}
+
+float Controller::PID::damp(float xdot) const
+{
+  float u = u_;
+  if (kd_ > 0.0f)
+    u -= kd_ * (xdot - xdot_);
+  return (u > max_) ? max_ : (u < min_) ? min_ : u;
+}
+
 } // namespace rosflight_firmware
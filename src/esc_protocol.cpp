@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "esc_protocol.h"
+
+namespace rosflight_firmware
+{
+
+namespace dshot
+{
+
+uint32_t bit_rate(EscProtocol protocol)
+{
+  switch (protocol)
+  {
+  case ESC_PROTOCOL_DSHOT150:
+    return 150000;
+  case ESC_PROTOCOL_DSHOT300:
+    return 300000;
+  case ESC_PROTOCOL_DSHOT600:
+    return 600000;
+  default:
+    return 0;
+  }
+}
+
+uint16_t throttle_value(float throttle)
+{
+  if (throttle <= 0.0f)
+    return 0;
+  if (throttle >= 1.0f)
+    return THROTTLE_MAX;
+  return static_cast<uint16_t>(THROTTLE_MIN + throttle * (THROTTLE_MAX - THROTTLE_MIN) + 0.5f);
+}
+
+uint16_t encode_frame(uint16_t value, bool request_telemetry)
+{
+  uint16_t packet = static_cast<uint16_t>(((value & 0x07FF) << 1) | (request_telemetry ? 1 : 0));
+  uint16_t checksum = (packet ^ (packet >> 4) ^ (packet >> 8)) & 0x0F;
+  return static_cast<uint16_t>((packet << 4) | checksum);
+}
+
+bool decode_frame(uint16_t frame, uint16_t *value, bool *request_telemetry)
+{
+  uint16_t packet = frame >> 4;
+  *value = packet >> 1;
+  *request_telemetry = packet & 1;
+  return encode_frame(*value, *request_telemetry) == frame;
+}
+
+void encode_throttles(const float throttle[], size_t count, size_t telemetry_channel, uint16_t frames[])
+{
+  for (size_t i = 0; i < count; i++)
+    frames[i] = encode_frame(throttle_value(throttle[i]), i == telemetry_channel);
+}
+
+void frame_to_pulses(uint16_t frame, uint16_t one_ticks, uint16_t zero_ticks, uint16_t pulses[FRAME_BITS])
+{
+  for (uint8_t bit = 0; bit < FRAME_BITS; bit++)
+    pulses[bit] = (frame & (0x8000 >> bit)) ? one_ticks : zero_ticks;
+}
+
+} // namespace dshot
+
+} // namespace rosflight_firmware
@@ -35,8 +35,22 @@
 namespace rosflight_firmware
 {
 
+namespace
+{
+constexpr float MAG_NORM_ALPHA = 0.001f;         // weight of each mag sample in the field strength average
+constexpr float MAG_MIN_HORIZONTAL_SQRD = 0.01f; // smallest usable horizontal share of the squared field
+constexpr float MAG_MAX_DT = 0.1f;               // longest time one mag correction is integrated over (s)
+constexpr float RANGE_MIN = 0.25f;               // closest usable range reading (m)
+constexpr float RANGE_MIN_COS_TILT = 0.866f;     // range readings are used up to 30 degrees of tilt
+constexpr uint64_t ALTITUDE_TIMEOUT_US = 500000;
+constexpr uint64_t FILTER_RATE_WINDOW_US = 500000; // time the filter update rate is averaged over
+constexpr float FILTER_RATE_TOLERANCE = 0.1f;      // the filters are redesigned beyond this rate error
+}
+
 Estimator::Estimator(ROSflight &_rf):
-  RF_(_rf)
+  RF_(_rf),
+  state_(),
+  filter_params_()
 {}
 
 void Estimator::reset_state()
@@ -54,6 +68,10 @@ void Estimator::reset_state()
   state_.pitch = 0.0f;
   state_.yaw = 0.0f;
 
+  state_.altitude = 0.0f;
+  state_.climb_rate = 0.0f;
+  altitude_.reset();
+
   w1_.x = 0.0f;
   w1_.y = 0.0f;
   w1_.z = 0.0f;
@@ -74,9 +92,19 @@ void Estimator::reset_state()
   gyro_LPF_.y = 0;
   gyro_LPF_.z = 0;
 
+  float accel[3] = {accel_LPF_.x, accel_LPF_.y, accel_LPF_.z};
+  float gyro[3] = {gyro_LPF_.x, gyro_LPF_.y, gyro_LPF_.z};
+  accel_filter_.reset(accel);
+  gyro_filter_.reset(gyro);
+
   state_.timestamp_us = RF_.board_.clock_micros();
 
   extatt_update_next_run_ = false;
+  extatt_dropping_ = false;
+  extatt_dropped_ = 0;
+  attitude_history_.reset();
+
+  ekf_.reset(state_.attitude, bias_);
 
   // Clear the unhealthy estimator flag
   RF_.state_manager_.clear_error(StateManager::ERROR_UNHEALTHY_ESTIMATOR);
@@ -87,41 +115,283 @@ void Estimator::reset_adaptive_bias()
   bias_.x = 0;
   bias_.y = 0;
   bias_.z = 0;
+  ekf_.reset_gyro_bias();
 }
 
 void Estimator::init()
 {
+  update_filter_params();
+  reset_filter_rate();
+  build_filter_banks();
   last_time_ = 0;
   last_acc_update_us_ = 0;
   last_extatt_update_us_ = 0;
+  last_mag_update_us_ = 0;
+  last_mag_time_ = 0;
+  last_altitude_update_us_ = 0;
+  mag_norm_ref_ = 0.0f;
+  attitude_count_ = 0;
+  attitude_dt_ = 0.0f;
+  attitude_gyro_sum_ = turbomath::Vector();
+  attitude_updated_ = false;
   reset_state();
 }
 
 void Estimator::param_change_callback(uint16_t param_id)
 {
-  (void) param_id;
+  param_change_batch_callback(&param_id, 1);
+}
+
+void Estimator::param_change_batch_callback(const uint16_t *param_ids, size_t num_ids)
+{
+  bool update = false;
+  bool rebuild_filters = false;
+  for (size_t i = 0; i < num_ids; i++)
+  {
+    switch (param_ids[i])
+    {
+    case PARAM_FILTER_KP_ACC:
+    case PARAM_FILTER_KP_EXT:
+    case PARAM_FILTER_KI:
+    case PARAM_INIT_TIME:
+    case PARAM_ACC_ALPHA:
+    case PARAM_GYRO_XY_ALPHA:
+    case PARAM_GYRO_Z_ALPHA:
+    case PARAM_FILTER_ACCEL_MARGIN:
+    case PARAM_FILTER_USE_ACC:
+    case PARAM_FILTER_USE_QUAD_INT:
+    case PARAM_FILTER_USE_MAT_EXP:
+    case PARAM_FIXED_WING:
+    case PARAM_ATTITUDE_DIVISOR:
+    case PARAM_FILTER_USE_EKF:
+    case PARAM_EKF_GYRO_NOISE:
+    case PARAM_EKF_GYRO_BIAS_NOISE:
+    case PARAM_EKF_ACCEL_NOISE:
+    case PARAM_EKF_ACCEL_BIAS:
+    case PARAM_EKF_ACCEL_BIAS_NOISE:
+    case PARAM_EKF_ATTITUDE_NOISE:
+    case PARAM_FILTER_USE_MAG:
+    case PARAM_FILTER_KP_MAG:
+    case PARAM_FILTER_MAG_MARGIN:
+    case PARAM_EKF_HEADING_NOISE:
+    case PARAM_MAG_DECLINATION:
+    case PARAM_ALT_BARO_TAU:
+    case PARAM_ALT_RANGE_TAU:
+    case PARAM_ALT_RANGE_MAX:
+      update = true;
+      break;
+    // Rebuilding the filter banks moves a tracked notch back to GYRO_NOTCH_HZ, so only do it when
+    // they change
+    case PARAM_FILTER_SAMPLE_RATE:
+      reset_filter_rate();
+      rebuild_filters = true;
+      break;
+    case PARAM_GYRO_LPF_CUTOFF:
+    case PARAM_GYRO_LPF_STAGES:
+    case PARAM_GYRO_NOTCH_CENTER:
+    case PARAM_GYRO_NOTCH_Q:
+    case PARAM_ACC_LPF_CUTOFF:
+    case PARAM_DYN_NOTCH_ENABLE:
+      rebuild_filters = true;
+      break;
+    default:
+      // do nothing
+      break;
+    }
+  }
+
+  if (update)
+    update_filter_params();
+  if (rebuild_filters)
+    build_filter_banks();
+}
+
+void Estimator::update_filter_params()
+{
+  filter_params_.kp_acc = RF_.params_.get_param_float(PARAM_FILTER_KP_ACC);
+  filter_params_.kp_ext = RF_.params_.get_param_float(PARAM_FILTER_KP_EXT);
+  filter_params_.kp_mag = RF_.params_.get_param_float(PARAM_FILTER_KP_MAG);
+  filter_params_.ki = RF_.params_.get_param_float(PARAM_FILTER_KI);
+  filter_params_.init_time_us = static_cast<uint64_t>(RF_.params_.get_param_int(PARAM_INIT_TIME))*1000;
+
+  filter_params_.accel_alpha = RF_.params_.get_param_float(PARAM_ACC_ALPHA);
+  filter_params_.gyro_xy_alpha = RF_.params_.get_param_float(PARAM_GYRO_XY_ALPHA);
+  filter_params_.gyro_z_alpha = RF_.params_.get_param_float(PARAM_GYRO_Z_ALPHA);
+
+  // Establish allowed acceleration deviation from 1g (i.e., non-accelerated flight).
+  const float margin = RF_.params_.get_param_float(PARAM_FILTER_ACCEL_MARGIN);
+  filter_params_.accel_lower_bound_sqrd = (1.0f - margin)*(1.0f - margin)*9.80665f*9.80665f;
+  filter_params_.accel_upper_bound_sqrd = (1.0f + margin)*(1.0f + margin)*9.80665f*9.80665f;
+
+  filter_params_.use_acc = RF_.params_.get_param_int(PARAM_FILTER_USE_ACC);
+  filter_params_.use_mag = RF_.params_.get_param_int(PARAM_FILTER_USE_MAG);
+  filter_params_.mag_margin = RF_.params_.get_param_float(PARAM_FILTER_MAG_MARGIN);
+  const float declination = RF_.params_.get_param_float(PARAM_MAG_DECLINATION);
+  filter_params_.mag_north_x = turbomath::cos(declination);
+  filter_params_.mag_north_y = turbomath::sin(declination);
+  filter_params_.use_quad_int = RF_.params_.get_param_int(PARAM_FILTER_USE_QUAD_INT);
+  filter_params_.use_mat_exp = RF_.params_.get_param_int(PARAM_FILTER_USE_MAT_EXP);
+  filter_params_.fixed_wing = RF_.params_.get_param_int(PARAM_FIXED_WING);
+  int32_t divisor = RF_.params_.get_param_int(PARAM_ATTITUDE_DIVISOR);
+  filter_params_.attitude_divisor = (divisor > 1) ? static_cast<uint32_t>(divisor) : 1;
+
+  // Switching to the EKF picks up from the current estimate
+  bool use_ekf = RF_.params_.get_param_int(PARAM_FILTER_USE_EKF);
+  if (use_ekf && !filter_params_.use_ekf)
+    ekf_.reset(state_.attitude, bias_);
+  filter_params_.use_ekf = use_ekf;
+
+  AttitudeEkf::Params ekf_params;
+  ekf_params.gyro_noise = RF_.params_.get_param_float(PARAM_EKF_GYRO_NOISE);
+  ekf_params.gyro_bias_noise = RF_.params_.get_param_float(PARAM_EKF_GYRO_BIAS_NOISE);
+  ekf_params.accel_noise = RF_.params_.get_param_float(PARAM_EKF_ACCEL_NOISE);
+  ekf_params.accel_bias_noise = RF_.params_.get_param_float(PARAM_EKF_ACCEL_BIAS_NOISE);
+  ekf_params.attitude_noise = RF_.params_.get_param_float(PARAM_EKF_ATTITUDE_NOISE);
+  ekf_params.heading_noise = RF_.params_.get_param_float(PARAM_EKF_HEADING_NOISE);
+  ekf_params.estimate_accel_bias = RF_.params_.get_param_int(PARAM_EKF_ACCEL_BIAS);
+  ekf_.set_params(ekf_params);
+
+  AltitudeEstimator::Params altitude_params;
+  altitude_params.baro_time_constant = RF_.params_.get_param_float(PARAM_ALT_BARO_TAU);
+  altitude_params.range_time_constant = RF_.params_.get_param_float(PARAM_ALT_RANGE_TAU);
+  altitude_.set_params(altitude_params);
+  filter_params_.range_max = RF_.params_.get_param_float(PARAM_ALT_RANGE_MAX);
+}
+
+void Estimator::reset_filter_rate()
+{
+  filter_params_.sample_rate_hz = static_cast<float>(RF_.params_.get_param_int(PARAM_FILTER_SAMPLE_RATE));
+  filter_rate_samples_ = 0;
+}
+
+void Estimator::measure_filter_rate(uint64_t now_us)
+{
+  // run_LPF() filters one sample per loop (the mean of an IMU FIFO batch where there is one), so the
+  // filters have to be designed for the loop rate rather than the IMU's output rate. FILTER_RATE_HZ is
+  // only the starting guess; the filters are redesigned once the measured rate is known to differ.
+  if (filter_rate_samples_++ == 0)
+  {
+    filter_rate_start_us_ = now_us;
+    return;
+  }
+  const uint64_t elapsed_us = now_us - filter_rate_start_us_;
+  if (elapsed_us < FILTER_RATE_WINDOW_US)
+    return;
+
+  const float measured_hz = static_cast<float>(filter_rate_samples_ - 1) * 1e6f / static_cast<float>(elapsed_us);
+  filter_rate_samples_ = 1;
+  filter_rate_start_us_ = now_us;
+  if (turbomath::fabs(measured_hz - filter_params_.sample_rate_hz) > FILTER_RATE_TOLERANCE * filter_params_.sample_rate_hz)
+  {
+    filter_params_.sample_rate_hz = measured_hz;
+    if (filter_params_.gyro_biquad || filter_params_.accel_biquad)
+      build_filter_banks();
+  }
+}
+
+void Estimator::build_filter_banks()
+{
+  const float sample_hz = filter_params_.sample_rate_hz;
+  float gyro_cutoff_hz = RF_.params_.get_param_float(PARAM_GYRO_LPF_CUTOFF);
+  float notch_hz = RF_.params_.get_param_float(PARAM_GYRO_NOTCH_CENTER);
+  float accel_cutoff_hz = RF_.params_.get_param_float(PARAM_ACC_LPF_CUTOFF);
+  filter_params_.gyro_notch_q = RF_.params_.get_param_float(PARAM_GYRO_NOTCH_Q);
+
+  // Coefficients are only designed here, so run_LPF() is the bare filter update. The new filters
+  // start from the current filtered values, so a param change doesn't kick the estimate.
+  gyro_filter_.clear();
+  gyro_notch_stage_ = BiquadFilterBank::MAX_STAGES;
+  if (gyro_cutoff_hz > 0.0f)
+  {
+    uint8_t num_stages = (RF_.params_.get_param_int(PARAM_GYRO_LPF_STAGES) > 1) ? 2 : 1;
+    for (uint8_t i = 0; i < num_stages; i++)
+      gyro_filter_.add_stage(BiquadFilterBank::lowpass(gyro_cutoff_hz, sample_hz,
+                                                       BiquadFilterBank::butterworth_q(i, num_stages)));
+  }
+  // the dynamic notch starts at GYRO_NOTCH_HZ, or as a passthrough until a peak is found
+  if (notch_hz > 0.0f || RF_.params_.get_param_int(PARAM_DYN_NOTCH_ENABLE))
+    gyro_notch_stage_ = gyro_filter_.add_stage(BiquadFilterBank::notch(notch_hz, sample_hz,
+                                                                       filter_params_.gyro_notch_q));
+  filter_params_.gyro_biquad = (gyro_filter_.num_stages() > 0);
+
+  accel_filter_.clear();
+  if (accel_cutoff_hz > 0.0f)
+    accel_filter_.add_stage(BiquadFilterBank::lowpass(accel_cutoff_hz, sample_hz, BiquadFilterBank::butterworth_q(0, 1)));
+  filter_params_.accel_biquad = (accel_filter_.num_stages() > 0);
+
+  float accel[3] = {accel_LPF_.x, accel_LPF_.y, accel_LPF_.z};
+  float gyro[3] = {gyro_LPF_.x, gyro_LPF_.y, gyro_LPF_.z};
+  accel_filter_.reset(accel);
+  gyro_filter_.reset(gyro);
+}
+
+bool Estimator::set_gyro_notch_center(uint8_t axis, float center_hz, float sample_hz)
+{
+  if (gyro_notch_stage_ >= BiquadFilterBank::MAX_STAGES || axis >= BiquadFilterBank::NUM_AXES)
+    return false;
+
+  gyro_filter_.set_coefficients(gyro_notch_stage_, axis,
+                                BiquadFilterBank::notch(center_hz, sample_hz, filter_params_.gyro_notch_q));
+  return true;
 }
 
 void Estimator::run_LPF()
 {
-  float alpha_acc = RF_.params_.get_param_float(PARAM_ACC_ALPHA);
+  if (filter_params_.accel_biquad)
+  {
+    const turbomath::Vector &raw_accel = RF_.sensors_.data().accel;
+    float in[3] = {raw_accel.x, raw_accel.y, raw_accel.z};
+    float out[3];
+    accel_filter_.apply(in, out);
+    accel_LPF_.x = out[0];
+    accel_LPF_.y = out[1];
+    accel_LPF_.z = out[2];
+  }
+  else
+  {
+    run_alpha_LPF_accel();
+  }
+
+  if (filter_params_.gyro_biquad)
+  {
+    const turbomath::Vector &raw_gyro = RF_.sensors_.data().gyro;
+    float in[3] = {raw_gyro.x, raw_gyro.y, raw_gyro.z};
+    float out[3];
+    gyro_filter_.apply(in, out);
+    gyro_LPF_.x = out[0];
+    gyro_LPF_.y = out[1];
+    gyro_LPF_.z = out[2];
+  }
+  else
+  {
+    run_alpha_LPF_gyro();
+  }
+}
+
+void Estimator::run_alpha_LPF_accel()
+{
+  float alpha_acc = filter_params_.accel_alpha;
   const turbomath::Vector &raw_accel = RF_.sensors_.data().accel;
   accel_LPF_.x = (1.0f-alpha_acc)*raw_accel.x + alpha_acc*accel_LPF_.x;
   accel_LPF_.y = (1.0f-alpha_acc)*raw_accel.y + alpha_acc*accel_LPF_.y;
   accel_LPF_.z = (1.0f-alpha_acc)*raw_accel.z + alpha_acc*accel_LPF_.z;
+}
 
-  float alpha_gyro_xy = RF_.params_.get_param_float(PARAM_GYRO_XY_ALPHA);
-  float alpha_gyro_z = RF_.params_.get_param_float(PARAM_GYRO_Z_ALPHA);
+void Estimator::run_alpha_LPF_gyro()
+{
+  float alpha_gyro_xy = filter_params_.gyro_xy_alpha;
+  float alpha_gyro_z = filter_params_.gyro_z_alpha;
   const turbomath::Vector &raw_gyro = RF_.sensors_.data().gyro;
   gyro_LPF_.x = (1.0f-alpha_gyro_xy)*raw_gyro.x + alpha_gyro_xy*gyro_LPF_.x;
   gyro_LPF_.y = (1.0f-alpha_gyro_xy)*raw_gyro.y + alpha_gyro_xy*gyro_LPF_.y;
   gyro_LPF_.z = (1.0f-alpha_gyro_z)*raw_gyro.z + alpha_gyro_z*gyro_LPF_.z;
 }
 
-void Estimator::set_external_attitude_update(const turbomath::Quaternion &q)
+void Estimator::set_external_attitude_update(const turbomath::Quaternion &q, uint64_t timestamp_us)
 {
   extatt_update_next_run_ = true;
   q_extatt_ = q;
+  extatt_time_us_ = timestamp_us;
 }
 
 void Estimator::run()
@@ -132,11 +402,13 @@ void Estimator::run()
   //
 
   const uint64_t now_us = RF_.sensors_.data().imu_time;
+  attitude_updated_ = false;
   if (last_time_ == 0)
   {
     last_time_ = now_us;
     last_acc_update_us_ = now_us;
     last_extatt_update_us_ = now_us;
+    last_mag_update_us_ = now_us;
     return;
   }
   else if (now_us < last_time_)
@@ -149,19 +421,68 @@ void Estimator::run()
 
   RF_.state_manager_.clear_error(StateManager::ERROR_TIME_GOING_BACKWARDS);
 
-  float dt = (now_us - last_time_) * 1e-6f;
+  attitude_dt_ += (now_us - last_time_) * 1e-6f;
   last_time_ = now_us;
   state_.timestamp_us = now_us;
 
   // Low-pass filter accel and gyro measurements
+  measure_filter_rate(now_us);
   run_LPF();
 
+  // The rate loops only need the angular velocity on every sample. The attitude is propagated over
+  // the accumulated time on every Nth sample, with the mean rate of the samples in between.
+  attitude_gyro_sum_ += gyro_LPF_;
+  if (++attitude_count_ < filter_params_.attitude_divisor)
+  {
+    state_.angular_velocity = gyro_LPF_ - bias_;
+    return;
+  }
+  float dt = attitude_dt_;
+  turbomath::Vector gyro = attitude_gyro_sum_ / static_cast<float>(attitude_count_);
+  attitude_count_ = 0;
+  attitude_dt_ = 0.0f;
+  attitude_gyro_sum_ = turbomath::Vector();
+  attitude_updated_ = true;
+
+  if (filter_params_.use_ekf)
+    run_ekf(gyro, dt, now_us);
+  else
+    run_complementary_filter(gyro, dt, now_us);
+
+  //
+  // Post-Processing
+  //
+
+  attitude_history_.record(now_us, state_.attitude);
+
+  // Extract Euler Angles for controller
+  state_.attitude.get_RPY(&state_.roll, &state_.pitch, &state_.yaw);
+
+  run_altitude(dt, now_us);
+
+  // Save off adjust gyro measurements with estimated biases for control
+  state_.angular_velocity = gyro_LPF_ - bias_;
+
+  // If it has been more than 0.5 seconds since the accel update ran and we
+  // are supposed to be getting them then trigger an unhealthy estimator error.
+  if (filter_params_.use_acc && now_us > 500000 + last_acc_update_us_ && !filter_params_.fixed_wing)
+  {
+    RF_.state_manager_.set_error(StateManager::ERROR_UNHEALTHY_ESTIMATOR);
+  }
+  else
+  {
+    RF_.state_manager_.clear_error(StateManager::ERROR_UNHEALTHY_ESTIMATOR);
+  }
+}
+
+void Estimator::run_complementary_filter(const turbomath::Vector &gyro, float dt, uint64_t now_us)
+{
   //
   // Gyro Correction Term (werr)
   //
 
   float kp = 0.0f;
-  float ki = RF_.params_.get_param_float(PARAM_FILTER_KI);
+  float ki = filter_params_.ki;
 
   turbomath::Vector w_err;
 
@@ -169,17 +490,36 @@ void Estimator::run()
   {
     // Get error estimated by accelerometer measurement
     w_err = accel_correction();
-    kp = RF_.params_.get_param_float(PARAM_FILTER_KP_ACC);
+    kp = filter_params_.kp_acc;
 
     last_acc_update_us_ = now_us;
   }
 
-  if (can_use_extatt())
+  // Heading error from the magnetometer, only on the runs that see a new mag sample. It has its
+  // own gain, and like the external attitude correction it is scaled for the time since the last
+  // one. An external attitude measurement already corrects the heading, so it takes precedence.
+  float kp_mag = 0.0f;
+  turbomath::Vector w_mag;
+  float heading_error;
+  if (!can_use_extatt() && mag_heading_error(state_.attitude, &heading_error))
+  {
+    float magDt = (now_us - last_mag_update_us_) * 1e-6f;
+    if (magDt > MAG_MAX_DT)
+      magDt = MAG_MAX_DT;
+    const float scaleDt = (dt > 0) ? (magDt / dt) : 0.0f;
+    // the error is a rotation about the world z axis; express it in the body frame
+    w_mag = state_.attitude.rotate(turbomath::Vector(0.0f, 0.0f, heading_error * scaleDt));
+    kp_mag = filter_params_.kp_mag;
+
+    last_mag_update_us_ = now_us;
+  }
+
+  if (can_use_extatt() && align_extatt(state_.attitude, now_us))
   {
     // Get error estimated by external attitude measurement. Overwrite any
     // correction based on the accelerometer (assumption: extatt is better).
     w_err = extatt_correction();
-    kp = RF_.params_.get_param_float(PARAM_FILTER_KP_EXT);
+    kp = filter_params_.kp_ext;
 
     // the angular rate correction from external attitude updates occur at a
     // different rate than IMU updates, so it needs to be integrated with a
@@ -194,10 +534,11 @@ void Estimator::run()
   }
 
   // Crank up the gains for the first few seconds for quick convergence
-  if (now_us < static_cast<uint64_t>(RF_.params_.get_param_int(PARAM_INIT_TIME))*1000)
+  if (now_us < filter_params_.init_time_us)
   {
-    kp = RF_.params_.get_param_float(PARAM_FILTER_KP_ACC)*10.0f;
-    ki = RF_.params_.get_param_float(PARAM_FILTER_KI)*10.0f;
+    kp = filter_params_.kp_acc*10.0f;
+    kp_mag *= 10.0f;
+    ki = filter_params_.ki*10.0f;
   }
 
   //
@@ -206,46 +547,91 @@ void Estimator::run()
 
   // Integrate biases driven by measured angular error
   // eq 47b Mahony Paper, using correction term w_err found above
-  bias_ -= ki*w_err*dt;
+  bias_ -= ki*(w_err + w_mag)*dt;
 
   // Build the composite omega vector for kinematic propagation
   // This the stuff inside the p function in eq. 47a - Mahony Paper
-  turbomath::Vector wbar = smoothed_gyro_measurement();
-  turbomath::Vector wfinal = wbar - bias_ + kp * w_err;
+  turbomath::Vector wbar = smoothed_gyro_measurement(gyro);
+  turbomath::Vector wfinal = wbar - bias_ + kp * w_err + kp_mag * w_mag;
 
   //
   // Propagate Dynamics
   //
 
   integrate_angular_rate(state_.attitude, wfinal, dt);
+}
 
-  //
-  // Post-Processing
-  //
+void Estimator::run_ekf(const turbomath::Vector &gyro, float dt, uint64_t now_us)
+{
+  ekf_.predict(smoothed_gyro_measurement(gyro), dt);
 
-  // Extract Euler Angles for controller
-  state_.attitude.get_RPY(&state_.roll, &state_.pitch, &state_.yaw);
+  if (can_use_accel())
+  {
+    ekf_.update_accel(accel_LPF_);
+    last_acc_update_us_ = now_us;
+  }
 
-  // Save off adjust gyro measurements with estimated biases for control
-  state_.angular_velocity = gyro_LPF_ - bias_;
+  float heading_error;
+  if (!can_use_extatt() && mag_heading_error(ekf_.attitude(), &heading_error))
+  {
+    ekf_.update_heading(heading_error);
+    last_mag_update_us_ = now_us;
+  }
 
-  // If it has been more than 0.5 seconds since the accel update ran and we
-  // are supposed to be getting them then trigger an unhealthy estimator error.
-  if (RF_.params_.get_param_int(PARAM_FILTER_USE_ACC) && now_us > 500000 + last_acc_update_us_
-      && !RF_.params_.get_param_int(PARAM_FIXED_WING))
+  if (can_use_extatt() && align_extatt(ekf_.attitude(), now_us))
   {
-    RF_.state_manager_.set_error(StateManager::ERROR_UNHEALTHY_ESTIMATOR);
+    ekf_.update_attitude(q_extatt_);
+    last_extatt_update_us_ = now_us;
+    extatt_update_next_run_ = false;
   }
-  else
+
+  state_.attitude = ekf_.attitude();
+  bias_ = ekf_.gyro_bias();
+}
+
+void Estimator::run_altitude(float dt, uint64_t now_us)
+{
+  const Sensors::Data &data = RF_.sensors_.data();
+
+  // vertical specific force in the world (NED) frame, without gravity and positive up
+  const turbomath::Vector accel_world = state_.attitude.inverse().rotate(accel_LPF_);
+  altitude_.predict(-accel_world.z - 9.80665f, dt);
+
+  // A downward range sensor measures the height above ground along the body z axis, whose vertical
+  // component is the bottom-right element of the rotation matrix
+  const turbomath::Quaternion &q = state_.attitude;
+  const float cos_tilt = 1.0f - 2.0f*(q.x*q.x + q.y*q.y);
+  const bool use_range = data.sonar_range_valid && data.sonar_range >= RANGE_MIN
+                         && data.sonar_range <= filter_params_.range_max && cos_tilt > RANGE_MIN_COS_TILT;
+  // the barometric altitude is only relative to the ground once the baro is calibrated
+  const bool use_baro = data.baro_valid && RF_.sensors_.baro_calibration_complete();
+
+  if (use_range)
   {
-    RF_.state_manager_.clear_error(StateManager::ERROR_UNHEALTHY_ESTIMATOR);
+    altitude_.correct_range(data.sonar_range*cos_tilt, dt);
+    if (use_baro)
+      altitude_.track_baro(data.baro_altitude, dt);
+  }
+  else if (use_baro)
+  {
+    altitude_.correct_baro(data.baro_altitude, dt);
   }
+  if (use_range || use_baro)
+    last_altitude_update_us_ = now_us;
+
+  state_.altitude = altitude_.altitude();
+  state_.climb_rate = altitude_.climb_rate();
+}
+
+bool Estimator::altitude_valid() const
+{
+  return altitude_.initialized() && state_.timestamp_us < last_altitude_update_us_ + ALTITUDE_TIMEOUT_US;
 }
 
 bool Estimator::can_use_accel() const
 {
   // if we are not using accel, just bail
-  if (!RF_.params_.get_param_int(PARAM_FILTER_USE_ACC)) return false;
+  if (!filter_params_.use_acc) return false;
 
   // current magnitude of LPF'd accelerometer
   const float a_sqrd_norm = accel_LPF_.sqrd_norm();
@@ -253,15 +639,12 @@ bool Estimator::can_use_accel() const
   // Ideally, gyros would never drift and we would never have to use the accelerometer.
   // Since gyros do drift, we can use the accelerometer (in a non-accelerated state) as
   // another estimate of roll/pitch angles and to make gyro biases observable (except r).
-  // Since there is noise, we give some margin to what a "non-accelerated state" means.
-  // Establish allowed acceleration deviation from 1g (i.e., non-accelerated flight).
-  const float margin = RF_.params_.get_param_float(PARAM_FILTER_ACCEL_MARGIN);
-  const float lowerbound = (1.0f - margin)*(1.0f - margin)*9.80665f*9.80665f;
-  const float upperbound = (1.0f + margin)*(1.0f + margin)*9.80665f*9.80665f;
+  // Since there is noise, we give some margin to what a "non-accelerated state" means
+  // (see update_filter_params()).
 
   // if the magnitude of the accel measurement is close to 1g, we can use the
   // accelerometer to correct roll and pitch and estimate gyro biases.
-  return (lowerbound < a_sqrd_norm && a_sqrd_norm < upperbound);
+  return (filter_params_.accel_lower_bound_sqrd < a_sqrd_norm && a_sqrd_norm < filter_params_.accel_upper_bound_sqrd);
 }
 
 bool Estimator::can_use_extatt() const
@@ -269,6 +652,59 @@ bool Estimator::can_use_extatt() const
   return extatt_update_next_run_;
 }
 
+bool Estimator::align_extatt(const turbomath::Quaternion &q_now, uint64_t now_us)
+{
+  if (extatt_time_us_ >= now_us)
+    return true;
+
+  // Mocap and VIO attitudes arrive tens of milliseconds late. Instead of comparing the measurement
+  // with the current estimate, compare it with the estimate at the time it was taken: applying the
+  // rotation the filter has propagated since then to the measurement leaves the same error, now
+  // expressed in the current body frame.
+  turbomath::Quaternion q_then;
+  if (!attitude_history_.lookup(extatt_time_us_, &q_then))
+  {
+    // warn once when measurements start falling outside the history, not on every one
+    if (!extatt_dropping_)
+      RF_.comm_manager_.log(CommLinkInterface::LogSeverity::LOG_WARNING, "External attitude too old, dropped");
+    extatt_dropping_ = true;
+    extatt_dropped_++;
+    extatt_update_next_run_ = false;
+    return false;
+  }
+  extatt_dropping_ = false;
+  q_extatt_ = q_now * q_then.inverse() * q_extatt_;
+  q_extatt_.normalize();
+  return true;
+}
+
+bool Estimator::mag_heading_error(const turbomath::Quaternion &q, float *error)
+{
+  const Sensors::Data &data = RF_.sensors_.data();
+  if (!filter_params_.use_mag || !data.mag_present || data.mag_time == last_mag_time_)
+    return false;
+  last_mag_time_ = data.mag_time;
+
+  // Motor currents and nearby metal change the strength of the measured field. Skip samples whose
+  // strength is far from the running average, which follows slow changes.
+  const float norm = data.mag.norm();
+  if (mag_norm_ref_ <= 0.0f)
+    mag_norm_ref_ = norm;
+  const bool consistent = turbomath::fabs(norm - mag_norm_ref_) <= filter_params_.mag_margin*mag_norm_ref_;
+  mag_norm_ref_ += MAG_NORM_ALPHA*(norm - mag_norm_ref_);
+  if (!consistent || norm <= 0.0f)
+    return false;
+
+  // The heading error is the angle between the horizontal part of the field in the world frame and
+  // magnetic north. Only its sine is used, so roll and pitch are left alone and no atan2 is needed.
+  const turbomath::Vector m = q.inverse().rotate(data.mag);
+  const float horizontal_sqrd = m.x*m.x + m.y*m.y;
+  if (horizontal_sqrd < MAG_MIN_HORIZONTAL_SQRD*norm*norm)
+    return false;
+  *error = (m.x*filter_params_.mag_north_y - m.y*filter_params_.mag_north_x)*turbomath::inv_sqrt(horizontal_sqrd);
+  return true;
+}
+
 turbomath::Vector Estimator::accel_correction() const
 {
   // turn measurement into a unit vector
@@ -315,20 +751,20 @@ turbomath::Vector Estimator::extatt_correction() const
   return w_ext;
 }
 
-turbomath::Vector Estimator::smoothed_gyro_measurement()
+turbomath::Vector Estimator::smoothed_gyro_measurement(const turbomath::Vector &gyro)
 {
   turbomath::Vector wbar;
-  if (RF_.params_.get_param_int(PARAM_FILTER_USE_QUAD_INT))
+  if (filter_params_.use_quad_int)
   {
     // Quadratic Interpolation (Eq. 14 Casey Paper)
     // this step adds 12 us on the STM32F10x chips
-    wbar = (w2_/-12.0f) + w1_*(8.0f/12.0f) + gyro_LPF_ * (5.0f/12.0f);
+    wbar = (w2_/-12.0f) + w1_*(8.0f/12.0f) + gyro * (5.0f/12.0f);
     w2_ = w1_;
-    w1_ = gyro_LPF_;
+    w1_ = gyro;
   }
   else
   {
-    wbar = gyro_LPF_;
+    wbar = gyro;
   }
 
   return wbar;
@@ -342,28 +778,20 @@ void Estimator::integrate_angular_rate(turbomath::Quaternion& quat,
   const float sqrd_norm_w = omega.sqrd_norm();
   if (sqrd_norm_w == 0.0f) return;
 
-  // for convenience
-  const float &p = omega.x, &q = omega.y, &r = omega.z;
-
-  if (RF_.params_.get_param_int(PARAM_FILTER_USE_MAT_EXP))
+  if (filter_params_.use_mat_exp)
   {
     // Matrix Exponential Approximation (From Attitude Representation and Kinematic
     // Propagation for Low-Cost UAVs by Robert T. Casey)
     // (Eq. 12 Casey Paper)
-    // This adds 90 us on STM32F10x chips
-    float norm_w = sqrtf(sqrd_norm_w);
-    float t1 = cosf((norm_w*dt)/2.0f);
-    float t2 = 1.0f/norm_w * sinf((norm_w*dt)/2.0f);
-    quat.w = t1*quat.w + t2*(-p*quat.x - q*quat.y - r*quat.z);
-    quat.x = t1*quat.x + t2*( p*quat.w + r*quat.y - q*quat.z);
-    quat.y = t1*quat.y + t2*( q*quat.w - r*quat.x + p*quat.z);
-    quat.z = t1*quat.z + t2*( r*quat.w + q*quat.x - p*quat.y);
+    // (turbomath multiplies in the opposite order to the paper)
+    quat = turbomath::Quaternion::exp_map(omega, dt) * quat;
     quat.normalize();
   }
   else
   {
     // Euler Integration
     // (Eq. 47a Mahony Paper)
+    const float &p = omega.x, &q = omega.y, &r = omega.z;
     turbomath::Quaternion qdot(0.5f * (-p*quat.x - q*quat.y - r*quat.z),
                                0.5f * ( p*quat.w + r*quat.y - q*quat.z),
                                0.5f * ( q*quat.w - r*quat.x + p*quat.z),
@@ -31,6 +31,7 @@
 
 
 #include <stdint.h>
+#include <limits>
 
 #include "mixer.h"
 #include "rosflight.h"
@@ -38,6 +39,19 @@
 namespace rosflight_firmware
 {
 
+constexpr Mixer::mixer_t Mixer::esc_calibration_mixing;
+constexpr Mixer::mixer_t Mixer::quadcopter_plus_mixing;
+constexpr Mixer::mixer_t Mixer::quadcopter_x_mixing;
+constexpr Mixer::mixer_t Mixer::hex_plus_mixing;
+constexpr Mixer::mixer_t Mixer::hex_x_mixing;
+constexpr Mixer::mixer_t Mixer::octocopter_plus_mixing;
+constexpr Mixer::mixer_t Mixer::octocopter_x_mixing;
+constexpr Mixer::mixer_t Mixer::Y6_mixing;
+constexpr Mixer::mixer_t Mixer::X8_mixing;
+constexpr Mixer::mixer_t Mixer::tricopter_mixing;
+constexpr Mixer::mixer_t Mixer::fixedwing_mixing;
+constexpr Mixer::mixer_t Mixer::passthrough_mixing;
+
 Mixer::Mixer(ROSflight &_rf) :
   RF_(_rf)
 {
@@ -46,26 +60,252 @@ Mixer::Mixer(ROSflight &_rf) :
 
 void Mixer::init()
 {
+  update_output_params();
+  load_custom_mixer();
   init_mixing();
 }
 
 void Mixer::param_change_callback(uint16_t param_id)
 {
-  switch (param_id)
+  param_change_batch_callback(&param_id, 1);
+}
+
+void Mixer::param_change_batch_callback(const uint16_t *param_ids, size_t num_ids)
+{
+  bool mixing = false;
+  bool pwm = false;
+  bool outputs = false;
+  bool custom = false;
+  for (size_t i = 0; i < num_ids; i++)
+  {
+    switch (param_ids[i])
+    {
+    case PARAM_MIXER:
+      mixing = true;
+      break;
+    case PARAM_MOTOR_PWM_SEND_RATE:
+    case PARAM_RC_TYPE:
+    case PARAM_MOTOR_PROTOCOL:
+      pwm = true;
+      break;
+    case PARAM_MOTOR_IDLE_THROTTLE:
+    case PARAM_SPIN_MOTORS_WHEN_ARMED:
+    case PARAM_FIXED_WING:
+    case PARAM_AILERON_REVERSE:
+    case PARAM_ELEVATOR_REVERSE:
+    case PARAM_RUDDER_REVERSE:
+    case PARAM_MIXER_SATURATION_MODE:
+    case PARAM_ESC_TELEMETRY:
+      outputs = true;
+      break;
+    default:
+      if (param_ids[i] >= PARAM_MIXER_CUSTOM_TYPE_0 && param_ids[i] <= PARAM_MIXER_CUSTOM_Z_7)
+        custom = true;
+      break;
+    }
+  }
+
+  if (outputs)
+    update_output_params();
+  if (custom)
   {
-  case PARAM_MIXER:
+    load_custom_mixer();
+    // output types and the default PWM rate may have changed, so set up the outputs again too
+    if (mixer_to_use_ == &custom_mixing_)
+      mixing = true;
+  }
+  // init_mixing() includes init_PWM()
+  if (mixing)
     init_mixing();
-    break;
-  case PARAM_MOTOR_PWM_SEND_RATE:
-  case PARAM_RC_TYPE:
+  else if (pwm)
     init_PWM();
-    break;
-  default:
-    // do nothing
-    break;
+}
+
+void Mixer::update_output_params()
+{
+  output_params_.motor_idle_throttle = RF_.params_.get_param_float(PARAM_MOTOR_IDLE_THROTTLE);
+  output_params_.spin_motors_when_armed = RF_.params_.get_param_int(PARAM_SPIN_MOTORS_WHEN_ARMED);
+  output_params_.fixed_wing = RF_.params_.get_param_int(PARAM_FIXED_WING);
+  output_params_.aileron_sign = RF_.params_.get_param_int(PARAM_AILERON_REVERSE) ? -1.0f : 1.0f;
+  output_params_.elevator_sign = RF_.params_.get_param_int(PARAM_ELEVATOR_REVERSE) ? -1.0f : 1.0f;
+  output_params_.rudder_sign = RF_.params_.get_param_int(PARAM_RUDDER_REVERSE) ? -1.0f : 1.0f;
+
+  int32_t saturation_mode = RF_.params_.get_param_int(PARAM_MIXER_SATURATION_MODE);
+  output_params_.saturation_mode = (saturation_mode >= SATURATION_SCALE && saturation_mode <= SATURATION_AIRMODE)
+                                   ? static_cast<SaturationMode>(saturation_mode) : SATURATION_SCALE;
+  output_params_.esc_telemetry = RF_.params_.get_param_int(PARAM_ESC_TELEMETRY);
+}
+
+void Mixer::load_custom_mixer()
+{
+  bool has_motors = false;
+  for (uint8_t i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    int32_t type = RF_.params_.get_param_int(PARAM_MIXER_CUSTOM_TYPE_0 + i);
+    custom_mixing_.output_type[i] = (type >= NONE && type <= G) ? static_cast<output_type_t>(type) : NONE;
+    has_motors |= (custom_mixing_.output_type[i] == M);
+
+    custom_mixing_.F[i] = RF_.params_.get_param_float(PARAM_MIXER_CUSTOM_F_0 + i);
+    custom_mixing_.x[i] = RF_.params_.get_param_float(PARAM_MIXER_CUSTOM_X_0 + i);
+    custom_mixing_.y[i] = RF_.params_.get_param_float(PARAM_MIXER_CUSTOM_Y_0 + i);
+    custom_mixing_.z[i] = RF_.params_.get_param_float(PARAM_MIXER_CUSTOM_Z_0 + i);
+  }
+  custom_mixing_.default_pwm_rate = has_motors ? 490 : 50;
+}
+
+void Mixer::load_matrix(const mixer_t &mixer, MixingMatrix &matrix)
+{
+  for (uint8_t i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    float used = (mixer.output_type[i] == NONE) ? 0.0f : 1.0f;
+    matrix.F[i] = used * mixer.F[i];
+    matrix.x[i] = used * mixer.x[i];
+    matrix.y[i] = used * mixer.y[i];
+    matrix.z[i] = used * mixer.z[i];
+    matrix.motor[i] = (mixer.output_type[i] == M) ? 1.0f : 0.0f;
+
+    matrix.motor_F[i] = matrix.motor[i] * mixer.F[i];
+    matrix.inv_motor_F[i] = inverse_gain(matrix.motor_F[i]);
+    matrix.inv_motor_z[i] = inverse_gain(matrix.motor[i] * mixer.z[i]);
   }
 }
 
+void Mixer::mix(const MixingMatrix &matrix, float F, float x, float y, float z,
+                float outputs[NUM_MIXER_OUTPUTS])
+{
+  // Matrix multiply to mix outputs. Unused outputs have zero gains, so they come out as zero and
+  // never set the scale. Mixing into a local array lets the compiler vectorize without having to
+  // prove that outputs doesn't alias the matrix.
+  alignas(16) float mixed[NUM_MIXER_OUTPUTS];
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+    mixed[i] = F*matrix.F[i] + x*matrix.x[i] + y*matrix.y[i] + z*matrix.z[i];
+
+  // saturate outputs to maintain controllability even during aggressive maneuvers. The halves are
+  // compared lane by lane first to shorten the dependency chain.
+  constexpr int HALF = NUM_MIXER_OUTPUTS / 2;
+  float lane_max[HALF];
+  for (int i = 0; i < HALF; i++)
+    lane_max[i] = (mixed[i + HALF] > mixed[i]) ? mixed[i + HALF] : mixed[i];
+  float max_output = 1.0f;
+  for (int i = 0; i < HALF; i++)
+    max_output = (lane_max[i] > max_output) ? lane_max[i] : max_output;
+
+  // scale all outputs by scale factor (this is 1.0, unless we saturated)
+  float scale_factor = 1.0f/max_output;
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+    outputs[i] = mixed[i] * scale_factor;
+}
+
+float Mixer::inverse_gain(float gain)
+{
+  // outputs that (nearly) don't move along a direction can't be desaturated by it
+  return (gain > 1e-6f || gain < -1e-6f) ? 1.0f/gain : 0.0f;
+}
+
+float Mixer::desaturation_gain(const float inv_direction[NUM_MIXER_OUTPUTS], const float outputs[NUM_MIXER_OUTPUTS])
+{
+  // the gain along the direction that brings the worst output below 0 and the worst above 1 back
+  // to the limit, summed
+  float min_gain = 0.0f;
+  float max_gain = 0.0f;
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    float below = (outputs[i] < 0.0f) ? -outputs[i] : 0.0f;
+    float above = (outputs[i] > 1.0f) ? 1.0f - outputs[i] : 0.0f;
+    float gain = (below + above) * inv_direction[i];
+    min_gain = (gain < min_gain) ? gain : min_gain;
+    max_gain = (gain > max_gain) ? gain : max_gain;
+  }
+  return min_gain + max_gain;
+}
+
+float Mixer::minimize_saturation(const float direction[NUM_MIXER_OUTPUTS], const float inv_direction[NUM_MIXER_OUTPUTS],
+                                 float outputs[NUM_MIXER_OUTPUTS], float min_gain, float max_gain)
+{
+  // The first step moves the worst output back into range. If outputs are saturated at both ends,
+  // the second step splits what is left between them. The total gain is kept within the bounds.
+  // direction must be zero wherever inv_direction is.
+  float gain = 0.0f;
+  for (int step = 0; step < 2; step++)
+  {
+    float step_gain = desaturation_gain(inv_direction, outputs);
+    if (step_gain == 0.0f)
+      break;
+    if (step > 0)
+      step_gain *= 0.5f;
+
+    if (gain + step_gain > max_gain)
+      step_gain = max_gain - gain;
+    else if (gain + step_gain < min_gain)
+      step_gain = min_gain - gain;
+
+    for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+      outputs[i] += step_gain * direction[i];
+    gain += step_gain;
+  }
+  return gain;
+}
+
+void Mixer::mix_prioritized(const MixingMatrix &matrix, float F, float x, float y, float z,
+                            bool allow_thrust_increase, float outputs[NUM_MIXER_OUTPUTS])
+{
+  alignas(16) float roll_pitch[NUM_MIXER_OUTPUTS];
+  alignas(16) float yaw[NUM_MIXER_OUTPUTS];
+  alignas(16) float motor_yaw[NUM_MIXER_OUTPUTS];
+  alignas(16) float inv_motor_yaw[NUM_MIXER_OUTPUTS];
+  float inv_z = inverse_gain(z);
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    roll_pitch[i] = x*matrix.x[i] + y*matrix.y[i];
+    yaw[i] = z*matrix.z[i];
+    motor_yaw[i] = matrix.motor[i] * yaw[i];
+    inv_motor_yaw[i] = inv_z * matrix.inv_motor_z[i];
+  }
+
+  // if roll and pitch alone need more than the full motor range, scale them down to fit and leave
+  // nothing for yaw
+  float roll_pitch_max = 0.0f;
+  float roll_pitch_min = 0.0f;
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    float value = roll_pitch[i] * matrix.motor[i];
+    roll_pitch_max = (value > roll_pitch_max) ? value : roll_pitch_max;
+    roll_pitch_min = (value < roll_pitch_min) ? value : roll_pitch_min;
+  }
+  float roll_pitch_span = roll_pitch_max - roll_pitch_min;
+  float roll_pitch_scale = (roll_pitch_span > 1.0f) ? 1.0f/roll_pitch_span : 1.0f;
+  float yaw_scale = (roll_pitch_span > 1.0f) ? 0.0f : 1.0f;
+
+  alignas(16) float mixed[NUM_MIXER_OUTPUTS];
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+    mixed[i] = F*matrix.F[i] + roll_pitch_scale*roll_pitch[i] + yaw_scale*yaw[i];
+
+  // most of the time no motor is saturated and there is nothing more to do
+  float lowest = 0.0f;
+  float highest = 0.0f;
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    float value = mixed[i] * matrix.motor[i];
+    lowest = (value < lowest) ? value : lowest;
+    highest = (value > highest) ? value : highest;
+  }
+  if (lowest >= 0.0f && highest <= 1.0f)
+  {
+    for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+      outputs[i] = mixed[i];
+    return;
+  }
+
+  // thrust gives way first, then yaw; thrust then moves again to recentre what is left
+  const float unbounded = std::numeric_limits<float>::max();
+  float max_thrust_gain = allow_thrust_increase ? unbounded : 0.0f;
+  float thrust_gain = minimize_saturation(matrix.motor_F, matrix.inv_motor_F, mixed, -unbounded, max_thrust_gain);
+  minimize_saturation(motor_yaw, inv_motor_yaw, mixed, -yaw_scale, 0.0f);
+  minimize_saturation(matrix.motor_F, matrix.inv_motor_F, mixed, -unbounded, max_thrust_gain - thrust_gain);
+
+  for (int i = 0; i < NUM_MIXER_OUTPUTS; i++)
+    outputs[i] = mixed[i];
+}
 
 void Mixer::init_mixing()
 {
@@ -85,6 +325,7 @@ void Mixer::init_mixing()
   else
   {
     mixer_to_use_ = array_of_mixers_[mixer_choice];
+    load_matrix(*mixer_to_use_, mixing_);
   }
 
 
@@ -110,48 +351,90 @@ void Mixer::init_PWM()
     RF_.board_.pwm_init(50, 0);
   else
     RF_.board_.pwm_init(refresh_rate, off_pwm);
+
+  init_esc();
 }
 
+void Mixer::init_esc()
+{
+  int32_t protocol = RF_.params_.get_param_int(PARAM_MOTOR_PROTOCOL);
+  if (protocol <= ESC_PROTOCOL_PWM || protocol >= ESC_PROTOCOL_COUNT || mixer_to_use_ == nullptr)
+  {
+    esc_digital_ = false;
+    return;
+  }
+
+  esc_channel_mask_ = 0;
+  for (uint8_t i = 0; i < NUM_MIXER_OUTPUTS; i++)
+  {
+    esc_throttle_[i] = 0.0f;
+    if (mixer_to_use_->output_type[i] == M)
+      esc_channel_mask_ |= (1u << i);
+  }
 
-void Mixer::write_motor(uint8_t index, float value)
+  esc_digital_ = RF_.board_.esc_init(static_cast<EscProtocol>(protocol), esc_channel_mask_);
+  if (!esc_digital_)
+    RF_.comm_manager_.log(CommLinkInterface::LogSeverity::LOG_WARNING, "Digital ESCs unsupported, using PWM");
+}
+
+void Mixer::write_esc_frames()
 {
-  if (RF_.state_manager_.state().armed)
+  // telemetry is requested from one motor per frame, in turn
+  size_t telemetry_channel = NUM_MIXER_OUTPUTS;
+  if (output_params_.esc_telemetry && esc_channel_mask_ != 0)
   {
-    if (value > 1.0)
-    {
-      value = 1.0;
-    }
-    else if (value < RF_.params_.get_param_float(PARAM_MOTOR_IDLE_THROTTLE)
-             && RF_.params_.get_param_int(PARAM_SPIN_MOTORS_WHEN_ARMED))
-    {
-      value = RF_.params_.get_param_float(PARAM_MOTOR_IDLE_THROTTLE);
-    }
-    else if (value < 0.0)
+    do
     {
-      value = 0.0;
+      esc_telemetry_channel_ = (esc_telemetry_channel_ + 1) % NUM_MIXER_OUTPUTS;
     }
+    while (!(esc_channel_mask_ & (1u << esc_telemetry_channel_)));
+    telemetry_channel = esc_telemetry_channel_;
   }
-  else
-  {
-    value = 0.0;
-  }
-  raw_outputs_[index] = value;
-  RF_.board_.pwm_write(index, raw_outputs_[index]);
+
+  dshot::encode_throttles(esc_throttle_, NUM_MIXER_OUTPUTS, telemetry_channel, esc_frames_);
+  RF_.board_.esc_write(esc_frames_, NUM_MIXER_OUTPUTS);
 }
 
 
-void Mixer::write_servo(uint8_t index, float value)
+void Mixer::write_outputs()
 {
-  if (value > 1.0)
+  // motors are held at zero while disarmed and at idle (if enabled) while armed
+  float motor_min = 0.0f;
+  float motor_max = 0.0f;
+  if (RF_.state_manager_.state().armed)
   {
-    value = 1.0;
+    motor_max = 1.0f;
+    if (output_params_.spin_motors_when_armed)
+      motor_min = output_params_.motor_idle_throttle;
   }
-  else if (value < -1.0)
+
+  for (uint8_t i = 0; i < NUM_TOTAL_OUTPUTS; i++)
   {
-    value = -1.0;
+    float value = outputs_[i];
+    output_type_t type = combined_output_type_[i];
+    if (type == S)
+    {
+      value = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+      raw_outputs_[i] = value;
+      pwm_values_[i] = value * 0.5f + 0.5f;
+    }
+    else if (type == M)
+    {
+      value = (value > motor_max) ? motor_max : ((value < motor_min) ? motor_min : value);
+      raw_outputs_[i] = value;
+      pwm_values_[i] = value;
+      if (esc_digital_ && (esc_channel_mask_ & (1u << i)))
+      {
+        esc_throttle_[i] = value;
+        type = NONE;
+      }
+    }
+    pwm_types_[i] = type;
   }
-  raw_outputs_[index] = value;
-  RF_.board_.pwm_write(index, raw_outputs_[index] * 0.5 + 0.5);
+
+  RF_.board_.pwm_write_all(pwm_values_, pwm_types_, NUM_TOTAL_OUTPUTS);
+  if (esc_digital_)
+    write_esc_frames();
 }
 
 void Mixer::set_new_aux_command(aux_command_t new_aux_command)
@@ -166,16 +449,15 @@ void Mixer::set_new_aux_command(aux_command_t new_aux_command)
 void Mixer::mix_output()
 {
   Controller::Output commands = RF_.controller_.output();
-  float max_output = 1.0f;
 
   // Reverse fixed-wing channels just before mixing if we need to
-  if (RF_.params_.get_param_int(PARAM_FIXED_WING))
+  if (output_params_.fixed_wing)
   {
-    commands.x *= RF_.params_.get_param_int(PARAM_AILERON_REVERSE) ? -1 : 1;
-    commands.y *= RF_.params_.get_param_int(PARAM_ELEVATOR_REVERSE) ? -1 : 1;
-    commands.z *= RF_.params_.get_param_int(PARAM_RUDDER_REVERSE) ? -1 : 1;
+    commands.x *= output_params_.aileron_sign;
+    commands.y *= output_params_.elevator_sign;
+    commands.z *= output_params_.rudder_sign;
   }
-  else if (commands.F < RF_.params_.get_param_float(PARAM_MOTOR_IDLE_THROTTLE))
+  else if (commands.F < output_params_.motor_idle_throttle)
   {
     // For multirotors, disregard yaw commands if throttle is low to prevent motor spin-up while arming/disarming
     commands.z = 0.0;
@@ -184,35 +466,11 @@ void Mixer::mix_output()
   if (mixer_to_use_ == nullptr)
     return;
 
-  for (uint8_t i = 0; i < NUM_MIXER_OUTPUTS; i++)
-  {
-    if (mixer_to_use_->output_type[i] != NONE)
-    {
-      // Matrix multiply to mix outputs
-      outputs_[i] = (commands.F*mixer_to_use_->F[i] + commands.x*mixer_to_use_->x[i] +
-                                 commands.y*mixer_to_use_->y[i] + commands.z*mixer_to_use_->z[i]);
-
-      // Save off the largest control output if it is greater than 1.0 for future scaling
-      if (outputs_[i] > max_output)
-      {
-        max_output = outputs_[i];
-      }
-    }
-  }
-
-  // saturate outputs to maintain controllability even during aggressive maneuvers
-  float scale_factor = 1.0;
-  if (max_output > 1.0)
-  {
-    scale_factor = 1.0/max_output;
-  }
-
-  // Perform Motor Output Scaling
-  for (uint8_t i = 0; i < NUM_MIXER_OUTPUTS; i++)
-  {
-      // scale all motor outputs by scale factor (this is usually 1.0, unless we saturated)
-      outputs_[i] *= scale_factor;
-  }
+  if (output_params_.saturation_mode == SATURATION_SCALE)
+    mix(mixing_, commands.F, commands.x, commands.y, commands.z, outputs_);
+  else
+    mix_prioritized(mixing_, commands.F, commands.x, commands.y, commands.z,
+                    output_params_.saturation_mode == SATURATION_AIRMODE, outputs_);
 
   // Insert AUX Commands, and assemble combined_output_types array (Does not override mixer values)
 
@@ -237,18 +495,7 @@ void Mixer::mix_output()
     combined_output_type_[i] = aux_command_.channel[i].type;
   }
 
-  // Write to outputs
-  for (uint8_t i = 0; i < NUM_TOTAL_OUTPUTS; i++)
-  {
-    if (combined_output_type_[i] == S)
-    {
-      write_servo(i, outputs_[i]);
-    }
-    else if (combined_output_type_[i] == M)
-    {
-      write_motor(i, outputs_[i]);
-    }
-  }
+  write_outputs();
 }
 
 }
@@ -59,6 +59,11 @@ namespace rosflight_firmware
 
 Params::Params(ROSflight& _rf) :
   RF_(_rf),
+#if ROSFLIGHT_PARAM_STORE
+  store_(_rf.board_),
+#endif
+  batch_depth_(0),
+  dirty_{},
   listeners_(nullptr),
   num_listeners_(0)
 {
@@ -138,6 +143,9 @@ void Params::set_defaults(void)
 
   init_param_int(PARAM_STREAM_OUTPUT_RAW_RATE, "STRM_SERVO", 50); // Rate of raw output stream | 0 |  490
   init_param_int(PARAM_STREAM_RC_RAW_RATE, "STRM_RC", 50); // Rate of raw RC input stream | 0 | 50
+  init_param_int(PARAM_STREAM_LOOP_PROFILE_RATE, "STRM_PROFILE", 0); // Rate of main loop profiling stream, one stage per message (Hz) | 0 | 100
+  init_param_int(PARAM_STREAM_GYRO_SPECTRUM_RATE, "STRM_GYRO_FFT", 0); // Rate of gyro vibration peak stream, one axis per message (Hz) | 0 | 100
+  init_param_int(PARAM_STREAM_ALTITUDE_RATE, "STRM_ALTITUDE", 0); // Rate of estimated altitude and climb rate stream (Hz) | 0 | 200
 
   /********************************/
   /*** CONTROLLER CONFIGURATION ***/
@@ -170,6 +178,13 @@ void Params::set_defaults(void)
 
   init_param_float(PARAM_PID_TAU, "PID_TAU", 0.05f); // Dirty Derivative time constant - See controller documentation | 0.0 | 1.0
 
+  init_param_float(PARAM_PID_ALT_P, "PID_ALT_P", 1.0f); // Altitude Proportional Gain, climb rate per altitude error (1/s) | 0.0 | 100.0
+  init_param_float(PARAM_PID_CLIMB_P, "PID_CLIMB_P", 3.0f); // Climb Rate Proportional Gain, vertical acceleration per climb rate error (1/s) | 0.0 | 1000.0
+  init_param_float(PARAM_PID_CLIMB_I, "PID_CLIMB_I", 1.0f); // Climb Rate Integral Gain | 0.0 | 1000.0
+  init_param_float(PARAM_PID_CLIMB_D, "PID_CLIMB_D", 0.0f); // Climb Rate Derivative Gain | 0.0 | 1000.0
+  init_param_float(PARAM_HOVER_THROTTLE, "HOVER_THROTTLE", 0.5f); // Throttle that holds the vehicle level in a hover, used as altitude hold feedforward | 0.05 | 0.95
+  init_param_float(PARAM_ALT_MAX_CLIMB, "ALT_MAX_CLIMB", 1.0f); // Maximum climb or descent rate commanded by altitude hold (m/s) | 0.0 | 10.0
+
 
   /*************************/
   /*** PWM CONFIGURATION ***/
@@ -178,6 +193,8 @@ void Params::set_defaults(void)
   init_param_float(PARAM_MOTOR_IDLE_THROTTLE, "MOTOR_IDLE_THR", 0.1); // min throttle command sent to motors when armed (Set above 0.1 to spin when armed) | 0.0 | 1.0
   init_param_float(PARAM_FAILSAFE_THROTTLE, "FAILSAFE_THR", 0.3); // Throttle sent to motors in failsafe condition (set just below hover throttle) | 0.0 | 1.0
   init_param_int(PARAM_SPIN_MOTORS_WHEN_ARMED, "ARM_SPIN_MOTORS", true); // Enforce MOTOR_IDLE_THR | 0 | 1
+  init_param_int(PARAM_MOTOR_PROTOCOL, "MOTOR_PROTOCOL", 0); // Motor output protocol (0: PWM, 1: DShot150, 2: DShot300, 3: DShot600), falls back to PWM if unsupported | 0 | 3
+  init_param_int(PARAM_ESC_TELEMETRY, "ESC_TELEM", false); // Request telemetry from digital ESCs, one motor per frame | 0 | 1
 
   /*******************************/
   /*** ESTIMATOR CONFIGURATION ***/
@@ -186,17 +203,43 @@ void Params::set_defaults(void)
   init_param_float(PARAM_FILTER_KP_ACC, "FILTER_KP_ACC", 0.5f); // estimator proportional gain on accel-based error - See estimator documentation | 0 | 10.0
   init_param_float(PARAM_FILTER_KI, "FILTER_KI", 0.01f); // estimator integral gain - See estimator documentation | 0 | 1.0
   init_param_float(PARAM_FILTER_KP_EXT, "FILTER_KP_EXT", 1.5f); // estimator proportional gain on external attitude-based error - See estimator documentation | 0 | 10.0
+  init_param_int(PARAM_EXT_ATT_DELAY, "EXT_ATT_DELAY", 0); // Time from taking an external attitude measurement to its arrival at the flight controller (ms) | 0 | 120
   init_param_float(PARAM_FILTER_ACCEL_MARGIN, "FILTER_ACCMARGIN", 0.1f); // allowable accel norm margin around 1g to determine if accel is usable | 0 | 1.0
 
   init_param_int(PARAM_FILTER_USE_QUAD_INT, "FILTER_QUAD_INT", 1); // Perform a quadratic averaging of LPF gyro data prior to integration (adds ~20 us to estimation loop on F1 processors) | 0 | 1
   init_param_int(PARAM_FILTER_USE_MAT_EXP, "FILTER_MAT_EXP", 1); // 1 - Use matrix exponential to improve gyro integration (adds ~90 us to estimation loop in F1 processors) 0 - use euler integration | 0 | 1
   init_param_int(PARAM_FILTER_USE_ACC, "FILTER_USE_ACC", 1);  // Use accelerometer to correct gyro integration drift (adds ~70 us to estimation loop) | 0 | 1
+  init_param_int(PARAM_ATTITUDE_DIVISOR, "FILTER_ATT_DIV", 1); // Attitude estimation and angle control run on every Nth IMU sample, rate control on every sample | 1 | 16
+  init_param_int(PARAM_FILTER_USE_EKF, "FILTER_USE_EKF", false); // Estimate attitude and gyro biases with an extended Kalman filter instead of the complementary filter | 0 | 1
+  init_param_float(PARAM_EKF_GYRO_NOISE, "EKF_GYRO_NOISE", 0.005f); // EKF gyro noise density (rad/s/sqrt(Hz)) | 0 | 1.0
+  init_param_float(PARAM_EKF_GYRO_BIAS_NOISE, "EKF_GBIAS_NOISE", 0.0001f); // EKF gyro bias random walk (rad/s^2/sqrt(Hz)) | 0 | 0.1
+  init_param_float(PARAM_EKF_ACCEL_NOISE, "EKF_ACC_NOISE", 0.5f); // EKF accelerometer measurement noise, including vibration (m/s^2) | 0.001 | 10.0
+  init_param_int(PARAM_EKF_ACCEL_BIAS, "EKF_ACC_BIAS", false); // Also estimate accelerometer biases in the EKF | 0 | 1
+  init_param_float(PARAM_EKF_ACCEL_BIAS_NOISE, "EKF_ABIAS_NOISE", 0.001f); // EKF accel bias random walk (m/s^3/sqrt(Hz)) | 0 | 1.0
+  init_param_float(PARAM_EKF_ATTITUDE_NOISE, "EKF_EXT_NOISE", 0.02f); // EKF external attitude measurement noise (rad) | 0.0001 | 1.0
+  init_param_int(PARAM_FILTER_USE_MAG, "FILTER_USE_MAG", false); // Use the magnetometer to correct heading drift | 0 | 1
+  init_param_float(PARAM_FILTER_KP_MAG, "FILTER_KP_MAG", 0.3f); // estimator proportional gain on magnetometer heading error - See estimator documentation | 0 | 10.0
+  init_param_float(PARAM_FILTER_MAG_MARGIN, "FILTER_MAGMARGIN", 0.15f); // allowable deviation of the mag field strength from its running average, as a fraction, to determine if mag is usable | 0 | 1.0
+  init_param_float(PARAM_EKF_HEADING_NOISE, "EKF_MAG_NOISE", 0.05f); // EKF magnetometer heading measurement noise (rad) | 0.0001 | 1.0
+  init_param_float(PARAM_ALT_BARO_TAU, "ALT_BARO_TAU", 2.0f); // Time constant of barometer corrections to the altitude estimate, longer trusts the accelerometer more (s) | 0.1 | 100.0
+  init_param_float(PARAM_ALT_RANGE_TAU, "ALT_RANGE_TAU", 0.5f); // Time constant of range sensor corrections to the altitude estimate (s) | 0.1 | 100.0
+  init_param_float(PARAM_ALT_RANGE_MAX, "ALT_RANGE_MAX", 4.0f); // Range sensor readings up to this are used for the altitude estimate, 0 to use only the barometer (m) | 0 | 100.0
 
   init_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, "CAL_GYRO_ARM", false); // True if desired to calibrate gyros on arm | 0 | 1
 
   init_param_float(PARAM_GYRO_XY_ALPHA, "GYROXY_LPF_ALPHA", 0.3f); // Low-pass filter constant on gyro X and Y axes - See estimator documentation | 0 | 1.0
   init_param_float(PARAM_GYRO_Z_ALPHA, "GYROZ_LPF_ALPHA", 0.3f); // Low-pass filter constant on gyro Z axis - See estimator documentation | 0 | 1.0
   init_param_float(PARAM_ACC_ALPHA, "ACC_LPF_ALPHA", 0.5f); // Low-pass filter constant on all accel axes - See estimator documentation | 0 | 1.0
+  init_param_int(PARAM_FILTER_SAMPLE_RATE, "FILTER_RATE_HZ", 1000); // Starting rate for the biquad filter designs, replaced by the measured loop rate (Hz) | 100 | 8000
+  init_param_float(PARAM_GYRO_LPF_CUTOFF, "GYRO_LPF_HZ", 0.0f); // Cutoff of the Butterworth gyro low-pass filter (Hz), 0 to use GYROXY_LPF_ALPHA and GYROZ_LPF_ALPHA instead | 0 | 1000
+  init_param_int(PARAM_GYRO_LPF_STAGES, "GYRO_LPF_STAGES", 1); // Number of biquad stages in the gyro low-pass filter (1 - 2nd order, 2 - 4th order) | 1 | 2
+  init_param_float(PARAM_GYRO_NOTCH_CENTER, "GYRO_NOTCH_HZ", 0.0f); // Center frequency of the gyro notch filter (Hz), 0 to disable | 0 | 1000
+  init_param_float(PARAM_GYRO_NOTCH_Q, "GYRO_NOTCH_Q", 3.0f); // Quality factor of the gyro notch filter (center frequency over bandwidth) | 0.5 | 20.0
+  init_param_float(PARAM_ACC_LPF_CUTOFF, "ACC_LPF_HZ", 0.0f); // Cutoff of the Butterworth accel low-pass filter (Hz), 0 to use ACC_LPF_ALPHA instead | 0 | 1000
+  init_param_int(PARAM_GYRO_FFT_ENABLE, "GYRO_FFT", false); // Run the gyro vibration spectrum analyzer | 0 | 1
+  init_param_float(PARAM_GYRO_FFT_MIN_FREQ, "GYRO_FFT_MIN_HZ", 60.0f); // Lowest frequency reported as a gyro vibration peak (Hz) | 0 | 500
+  init_param_int(PARAM_DYN_NOTCH_ENABLE, "DYN_NOTCH", false); // Move the gyro notch to the largest vibration peak on each axis (requires GYRO_FFT) | 0 | 1
+  init_param_float(PARAM_DYN_NOTCH_MIN_AMP, "DYN_NOTCH_AMP", 0.02f); // Smallest vibration peak amplitude that moves the dynamic notch (rad/s) | 0 | 10.0
 
   init_param_float(PARAM_GYRO_X_BIAS, "GYRO_X_BIAS", 0.0f); // Constant x-bias of gyroscope readings | -1.0 | 1.0
   init_param_float(PARAM_GYRO_Y_BIAS, "GYRO_Y_BIAS", 0.0f); // Constant y-bias of gyroscope readings | -1.0 | 1.0
@@ -220,6 +263,7 @@ void Params::set_defaults(void)
   init_param_float(PARAM_MAG_X_BIAS,  "MAG_X_BIAS", 0.0f); // Hard iron compensation constant | -999.0 | 999.0
   init_param_float(PARAM_MAG_Y_BIAS,  "MAG_Y_BIAS", 0.0f); // Hard iron compensation constant | -999.0 | 999.0
   init_param_float(PARAM_MAG_Z_BIAS,  "MAG_Z_BIAS", 0.0f); // Hard iron compensation constant | -999.0 | 999.0
+  init_param_float(PARAM_MAG_DECLINATION, "MAG_DECLINATION", 0.0f); // Angle of magnetic north east of true north (rad) | -3.1416 | 3.1416
 
   init_param_float(PARAM_BARO_BIAS, "BARO_BIAS", 0.0f); // Barometer measurement bias (Pa) | 0 | inf
   init_param_float(PARAM_GROUND_LEVEL, "GROUND_LEVEL", 1387.0f); // Altitude of ground level (m) | -1000 | 10000
@@ -259,7 +303,8 @@ void Params::set_defaults(void)
   /***************************/
   /*** FRAME CONFIGURATION ***/
   /***************************/
-  init_param_int(PARAM_MIXER, "MIXER", Mixer::INVALID_MIXER); // Which mixer to choose - See Mixer documentation | 0 | 10
+  init_param_int(PARAM_MIXER, "MIXER", Mixer::INVALID_MIXER); // Which mixer to choose - See Mixer documentation | 0 | 12
+  init_param_int(PARAM_MIXER_SATURATION_MODE, "MIX_SAT_MODE", 0); // How saturated motor commands are fit (0: scale all, 1: keep roll/pitch then yaw, 2: as 1 with airmode) | 0 | 2
 
   init_param_int(PARAM_FIXED_WING, "FIXED_WING", false); // switches on pass-through commands for fixed-wing operation | 0 | 1
   init_param_int(PARAM_ELEVATOR_REVERSE, "ELEVATOR_REV", 0); // reverses elevator servo output | 0 | 1
@@ -270,6 +315,54 @@ void Params::set_defaults(void)
   init_param_float(PARAM_FC_PITCH, "FC_PITCH", 0.0f); // pitch angle (deg) of flight controller wrt aircraft body | 0 | 360
   init_param_float(PARAM_FC_YAW, "FC_YAW", 0.0f); // yaw angle (deg) of flight controller wrt aircraft body | 0 | 360
 
+  /********************/
+  /*** CUSTOM MIXER ***/
+  /********************/
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_0, "MIX_TYPE_0", 0); // Output type of custom mixer output 0 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_1, "MIX_TYPE_1", 0); // Output type of custom mixer output 1 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_2, "MIX_TYPE_2", 0); // Output type of custom mixer output 2 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_3, "MIX_TYPE_3", 0); // Output type of custom mixer output 3 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_4, "MIX_TYPE_4", 0); // Output type of custom mixer output 4 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_5, "MIX_TYPE_5", 0); // Output type of custom mixer output 5 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_6, "MIX_TYPE_6", 0); // Output type of custom mixer output 6 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+  init_param_int(PARAM_MIXER_CUSTOM_TYPE_7, "MIX_TYPE_7", 0); // Output type of custom mixer output 7 (0: none, 1: servo, 2: motor, 3: GPIO) | 0 | 3
+
+  init_param_float(PARAM_MIXER_CUSTOM_F_0, "MIX_F_0", 0.0f); // Custom mixer throttle gain for output 0 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_1, "MIX_F_1", 0.0f); // Custom mixer throttle gain for output 1 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_2, "MIX_F_2", 0.0f); // Custom mixer throttle gain for output 2 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_3, "MIX_F_3", 0.0f); // Custom mixer throttle gain for output 3 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_4, "MIX_F_4", 0.0f); // Custom mixer throttle gain for output 4 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_5, "MIX_F_5", 0.0f); // Custom mixer throttle gain for output 5 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_6, "MIX_F_6", 0.0f); // Custom mixer throttle gain for output 6 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_F_7, "MIX_F_7", 0.0f); // Custom mixer throttle gain for output 7 | -2.0 | 2.0
+
+  init_param_float(PARAM_MIXER_CUSTOM_X_0, "MIX_X_0", 0.0f); // Custom mixer roll gain for output 0 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_1, "MIX_X_1", 0.0f); // Custom mixer roll gain for output 1 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_2, "MIX_X_2", 0.0f); // Custom mixer roll gain for output 2 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_3, "MIX_X_3", 0.0f); // Custom mixer roll gain for output 3 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_4, "MIX_X_4", 0.0f); // Custom mixer roll gain for output 4 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_5, "MIX_X_5", 0.0f); // Custom mixer roll gain for output 5 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_6, "MIX_X_6", 0.0f); // Custom mixer roll gain for output 6 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_X_7, "MIX_X_7", 0.0f); // Custom mixer roll gain for output 7 | -2.0 | 2.0
+
+  init_param_float(PARAM_MIXER_CUSTOM_Y_0, "MIX_Y_0", 0.0f); // Custom mixer pitch gain for output 0 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_1, "MIX_Y_1", 0.0f); // Custom mixer pitch gain for output 1 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_2, "MIX_Y_2", 0.0f); // Custom mixer pitch gain for output 2 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_3, "MIX_Y_3", 0.0f); // Custom mixer pitch gain for output 3 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_4, "MIX_Y_4", 0.0f); // Custom mixer pitch gain for output 4 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_5, "MIX_Y_5", 0.0f); // Custom mixer pitch gain for output 5 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_6, "MIX_Y_6", 0.0f); // Custom mixer pitch gain for output 6 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Y_7, "MIX_Y_7", 0.0f); // Custom mixer pitch gain for output 7 | -2.0 | 2.0
+
+  init_param_float(PARAM_MIXER_CUSTOM_Z_0, "MIX_Z_0", 0.0f); // Custom mixer yaw gain for output 0 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_1, "MIX_Z_1", 0.0f); // Custom mixer yaw gain for output 1 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_2, "MIX_Z_2", 0.0f); // Custom mixer yaw gain for output 2 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_3, "MIX_Z_3", 0.0f); // Custom mixer yaw gain for output 3 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_4, "MIX_Z_4", 0.0f); // Custom mixer yaw gain for output 4 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_5, "MIX_Z_5", 0.0f); // Custom mixer yaw gain for output 5 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_6, "MIX_Z_6", 0.0f); // Custom mixer yaw gain for output 6 | -2.0 | 2.0
+  init_param_float(PARAM_MIXER_CUSTOM_Z_7, "MIX_Z_7", 0.0f); // Custom mixer yaw gain for output 7 | -2.0 | 2.0
+
 
   /********************/
   /*** ARMING SETUP ***/
@@ -288,6 +381,13 @@ void Params::set_defaults(void)
   /*** OFFBOARD CONTROL ***/
   /************************/
   init_param_int(PARAM_OFFBOARD_TIMEOUT, "OFFBOARD_TIMEOUT", 100); // Timeout in milliseconds for offboard commands, after which RC override is activated | 0 | 100000
+
+  /*****************/
+  /*** PROFILING ***/
+  /*****************/
+  init_param_int(PARAM_LOOP_BUDGET_US, "LOOP_BUDGET", 1000); // Main loop time budget used to count profiling overruns (us) | 100 | 100000
+
+  build_name_index();
 }
 
 void Params::set_listeners(ParamListenerInterface * const listeners[], size_t num_listeners)
@@ -298,6 +398,19 @@ void Params::set_listeners(ParamListenerInterface * const listeners[], size_t nu
 
 bool Params::read(void)
 {
+#if ROSFLIGHT_PARAM_STORE
+  if (store_.available(PARAMS_COUNT))
+  {
+    if (!store_.open(GIT_VERSION_HASH, PARAMS_COUNT))
+      return false;
+
+    // only values are stored; names and types come from the defaults
+    set_defaults();
+    store_.replay(reinterpret_cast<int32_t *>(params.values), persisted_, PARAMS_COUNT);
+    return true;
+  }
+#endif
+
   if (!RF_.board_.memory_read(&params, sizeof(params_t)))
     return false;
 
@@ -310,11 +423,17 @@ bool Params::read(void)
   if (compute_checksum() != params.chk)
     return false;
 
+  build_name_index();
   return true;
 }
 
 bool Params::write(void)
 {
+#if ROSFLIGHT_PARAM_STORE
+  if (store_.available(PARAMS_COUNT))
+    return store_.save(GIT_VERSION_HASH, reinterpret_cast<const int32_t *>(params.values), persisted_, PARAMS_COUNT);
+#endif
+
   params.version = GIT_VERSION_HASH;
   params.size = sizeof(params_t);
   params.magic_be = 0xBE;
@@ -338,27 +457,90 @@ void Params::change_callback(uint16_t id)
   }
 }
 
-uint16_t Params::lookup_param_id(const char name[PARAMS_NAME_LENGTH])
+void Params::change_callback_all(void)
+{
+  for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+  {
+    changed_ids_[id] = id;
+  }
+  notify_listeners(changed_ids_, PARAMS_COUNT);
+}
+
+void Params::notify_listeners(const uint16_t *ids, size_t num_ids)
+{
+  if (listeners_ != nullptr)
+  {
+    for (size_t i = 0; i < num_listeners_; i++)
+    {
+      listeners_[i]->param_change_batch_callback(ids, num_ids);
+    }
+  }
+}
+
+void Params::mark_dirty(uint16_t id)
+{
+  dirty_[id / 32] |= (1u << (id % 32));
+}
+
+void Params::begin_batch(void)
+{
+  if (batch_depth_ < UINT8_MAX)
+    batch_depth_++;
+}
+
+void Params::commit_batch(void)
 {
+  if (batch_depth_ == 0 || --batch_depth_ > 0)
+    return;
+
+  size_t num_changed = 0;
   for (uint16_t id = 0; id < PARAMS_COUNT; id++)
   {
-    bool match = true;
-    for (uint8_t i = 0; i < PARAMS_NAME_LENGTH; i++)
+    if (dirty_[id / 32] & (1u << (id % 32)))
+      changed_ids_[num_changed++] = id;
+  }
+  memset(dirty_, 0, sizeof(dirty_));
+
+  if (num_changed == 0)
+    return;
+
+  notify_listeners(changed_ids_, num_changed);
+  for (size_t i = 0; i < num_changed; i++)
+  {
+    RF_.comm_manager_.queue_param_value(changed_ids_[i]);
+  }
+}
+
+void Params::build_name_index(void)
+{
+  // insertion sort; only runs when the names are (re)loaded
+  for (uint16_t i = 0; i < PARAMS_COUNT; i++)
+  {
+    uint16_t id = i;
+    uint16_t j = i;
+    while (j > 0 && strncmp(params.names[sorted_ids_[j-1]], params.names[id], PARAMS_NAME_LENGTH) > 0)
     {
-      // compare each character
-      if (name[i] != params.names[id][i])
-      {
-        match = false;
-        break;
-      }
-
-      // stop comparing if end of string is reached
-      if (params.names[id][i] == '\0')
-        break;
+      sorted_ids_[j] = sorted_ids_[j-1];
+      j--;
     }
+    sorted_ids_[j] = id;
+  }
+}
 
-    if (match)
-      return id;
+uint16_t Params::lookup_param_id(const char name[PARAMS_NAME_LENGTH])
+{
+  uint16_t lo = 0;
+  uint16_t hi = PARAMS_COUNT;
+  while (lo < hi)
+  {
+    uint16_t mid = static_cast<uint16_t>(lo + (hi - lo)/2);
+    int cmp = strncmp(name, params.names[sorted_ids_[mid]], PARAMS_NAME_LENGTH);
+    if (cmp == 0)
+      return sorted_ids_[mid];
+    else if (cmp < 0)
+      hi = mid;
+    else
+      lo = static_cast<uint16_t>(mid + 1);
   }
 
   return PARAMS_COUNT;
@@ -382,7 +564,35 @@ bool Params::set_param_float(uint16_t id, float value)
   {
     params.values[id].fvalue = value;
     change_callback(id);
-    RF_.comm_manager_.send_parameter_list();
+    RF_.comm_manager_.send_param_value(id);
+    return true;
+  }
+  return false;
+}
+
+bool Params::stage_param_int(uint16_t id, int32_t value)
+{
+  if (!batch_active())
+    return set_param_int(id, value);
+
+  if (id < PARAMS_COUNT && value != params.values[id].ivalue)
+  {
+    params.values[id].ivalue = value;
+    mark_dirty(id);
+    return true;
+  }
+  return false;
+}
+
+bool Params::stage_param_float(uint16_t id, float value)
+{
+  if (!batch_active())
+    return set_param_float(id, value);
+
+  if (id < PARAMS_COUNT && value != params.values[id].fvalue)
+  {
+    params.values[id].fvalue = value;
+    mark_dirty(id);
     return true;
   }
   return false;
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+
+#include "board.h"
+#include "util.h"
+
+#include "param_store.h"
+
+namespace rosflight_firmware
+{
+
+ParamStore::ParamStore(Board &board) :
+  board_(board)
+{
+}
+
+bool ParamStore::available(uint16_t count)
+{
+  sector_size_ = board_.memory_sector_size();
+  // a compacted sector must leave room for at least one appended record
+  return sector_size_ >= sizeof(Header) + (count + 1u)*sizeof(Record);
+}
+
+bool ParamStore::open(uint32_t version, uint16_t count)
+{
+  active_sector_ = NO_SECTOR;
+  if (!available(count))
+    return false;
+
+  uint32_t best_sequence = 0;
+  for (uint8_t sector = 0; sector < NUM_SECTORS; sector++)
+  {
+    Header header;
+    if (!read_header(sector, &header))
+      continue;
+
+    // new sectors must be numbered past every valid one, including those of other firmware
+    if (header.sequence > sequence_)
+      sequence_ = header.sequence;
+
+    if (header.version != version || header.count != count)
+      continue;
+
+    if (active_sector_ == NO_SECTOR || header.sequence > best_sequence)
+    {
+      active_sector_ = sector;
+      best_sequence = header.sequence;
+    }
+  }
+
+  return active_sector_ != NO_SECTOR;
+}
+
+void ParamStore::replay(int32_t values[], int32_t persisted[], uint16_t count)
+{
+  if (active_sector_ == NO_SECTOR)
+    return;
+
+  Record chunk[READ_CHUNK_RECORDS];
+  size_t offset = sizeof(Header);
+  append_offset_ = sector_size_;
+  bool done = false;
+  while (!done && offset + sizeof(Record) <= sector_size_)
+  {
+    size_t num_records = (sector_size_ - offset)/sizeof(Record);
+    if (num_records > READ_CHUNK_RECORDS)
+      num_records = READ_CHUNK_RECORDS;
+    if (!board_.memory_sector_read(active_sector_, offset, chunk, num_records*sizeof(Record)))
+      break;
+
+    for (size_t i = 0; i < num_records; i++)
+    {
+      const Record &record = chunk[i];
+      if (record_erased(record))
+      {
+        // end of the log
+        append_offset_ = offset + i*sizeof(Record);
+        done = true;
+        break;
+      }
+
+      // records torn by a reset during a write fail the checksum and are skipped
+      if (record.id < count && record.chk == record_checksum(record))
+        values[record.id] = record.value;
+    }
+    offset += num_records*sizeof(Record);
+  }
+
+  memcpy(persisted, values, count*sizeof(int32_t));
+}
+
+bool ParamStore::save(uint32_t version, const int32_t values[], int32_t persisted[], uint16_t count)
+{
+  if (!available(count))
+    return false;
+
+  if (active_sector_ == NO_SECTOR)
+    return compact(version, values, persisted, count);
+
+  size_t num_changed = 0;
+  for (uint16_t id = 0; id < count; id++)
+  {
+    if (values[id] != persisted[id])
+      num_changed++;
+  }
+
+  if (num_changed == 0)
+    return true;
+
+  if (append_offset_ + num_changed*sizeof(Record) > sector_size_)
+    return compact(version, values, persisted, count);
+
+  for (uint16_t id = 0; id < count; id++)
+  {
+    if (values[id] == persisted[id])
+      continue;
+
+    Record record;
+    record.id = id;
+    record.value = values[id];
+    record.chk = record_checksum(record);
+
+    // a failed write may have programmed part of the slot, so never reuse it
+    size_t offset = append_offset_;
+    append_offset_ += sizeof(Record);
+    if (!board_.memory_sector_write(active_sector_, offset, &record, sizeof(Record)))
+      return false;
+    persisted[id] = values[id];
+  }
+  return true;
+}
+
+bool ParamStore::compact(uint32_t version, const int32_t values[], int32_t persisted[], uint16_t count)
+{
+  uint8_t target = (active_sector_ == 0) ? 1 : 0;
+  if (!board_.memory_sector_erase(target))
+    return false;
+
+  Record chunk[READ_CHUNK_RECORDS];
+  size_t offset = sizeof(Header);
+  uint16_t id = 0;
+  while (id < count)
+  {
+    size_t num_records = 0;
+    for (; num_records < READ_CHUNK_RECORDS && id < count; num_records++, id++)
+    {
+      chunk[num_records].id = id;
+      chunk[num_records].value = values[id];
+      chunk[num_records].chk = record_checksum(chunk[num_records]);
+    }
+    if (!board_.memory_sector_write(target, offset, chunk, num_records*sizeof(Record)))
+      return false;
+    offset += num_records*sizeof(Record);
+  }
+
+  // the header goes last, so the sector only becomes valid once every record is in place
+  Header header;
+  header.magic = MAGIC;
+  header.sequence = sequence_ + 1;
+  header.version = version;
+  header.count = count;
+  header.chk = header_checksum(header);
+  if (!board_.memory_sector_write(target, 0, &header, sizeof(Header)))
+    return false;
+
+  active_sector_ = target;
+  sequence_ = header.sequence;
+  append_offset_ = offset;
+  compactions_++;
+  memcpy(persisted, values, count*sizeof(int32_t));
+  return true;
+}
+
+bool ParamStore::read_header(uint8_t sector, Header *header)
+{
+  if (!board_.memory_sector_read(sector, 0, header, sizeof(Header)))
+    return false;
+  return header->magic == MAGIC && header->chk == header_checksum(*header);
+}
+
+uint16_t ParamStore::header_checksum(const Header &header)
+{
+  return checksum_fletcher16(reinterpret_cast<const uint8_t *>(&header), offsetof(Header, chk));
+}
+
+uint16_t ParamStore::record_checksum(const Record &record)
+{
+  uint16_t chk = checksum_fletcher16(reinterpret_cast<const uint8_t *>(&record.id), sizeof(record.id), false);
+  return checksum_fletcher16(reinterpret_cast<const uint8_t *>(&record.value), sizeof(record.value), true, chk);
+}
+
+bool ParamStore::record_erased(const Record &record)
+{
+  return record.id == 0xFFFF && record.chk == 0xFFFF && record.value == -1;
+}
+
+} // namespace rosflight_firmware
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+
+#include "profiler.h"
+#include "rosflight.h"
+
+namespace rosflight_firmware
+{
+
+Profiler::Profiler(ROSflight &rf) :
+  RF_(rf)
+{
+  memset(stages_, 0, sizeof(stages_));
+}
+
+void Profiler::init()
+{
+  cycles_per_us_ = RF_.board_.clock_cycles_per_us();
+  if (cycles_per_us_ == 0)
+    cycles_per_us_ = 1;
+  param_change_callback(PARAM_LOOP_BUDGET_US);
+  for (int i = 0; i < STAGE_COUNT; i++)
+    reset(static_cast<Stage>(i));
+}
+
+void Profiler::param_change_callback(uint16_t param_id)
+{
+  if (param_id == PARAM_LOOP_BUDGET_US)
+    budget_cycles_ = static_cast<uint32_t>(RF_.params_.get_param_int(PARAM_LOOP_BUDGET_US)) * cycles_per_us_;
+}
+
+void Profiler::start_loop()
+{
+  loop_start_ = RF_.board_.clock_cycles();
+  stage_start_ = loop_start_;
+  over_budget_ = false;
+}
+
+void Profiler::end_stage(Stage stage)
+{
+  uint32_t now = RF_.board_.clock_cycles();
+  record(stage, now - stage_start_);
+
+  // charge the overrun to whichever stage pushed the loop over budget
+  if (!over_budget_ && now - loop_start_ > budget_cycles_)
+  {
+    over_budget_ = true;
+    stages_[stage].overruns++;
+  }
+  stage_start_ = now;
+}
+
+void Profiler::end_loop()
+{
+  record(STAGE_LOOP, RF_.board_.clock_cycles() - loop_start_);
+  if (over_budget_)
+    stages_[STAGE_LOOP].overruns++;
+}
+
+void Profiler::record(Stage stage, uint32_t cycles)
+{
+  if (listener_ != nullptr)
+    listener_->stage_timed(stage, cycles);
+
+  StageData &s = stages_[stage];
+  if (s.count == 0 || cycles < s.min)
+    s.min = cycles;
+  if (cycles > s.max)
+    s.max = cycles;
+  s.sum += cycles;
+  s.count++;
+
+#if ROSFLIGHT_PROFILER_HISTOGRAM
+  int b = bucket(cycles);
+  if (s.histogram[b] == UINT16_MAX)
+  {
+    // keep the shape of the distribution rather than saturating
+    for (int i = 0; i < NUM_BUCKETS; i++)
+      s.histogram[i] >>= 1;
+  }
+  s.histogram[b]++;
+#endif
+}
+
+Profiler::Stats Profiler::stats(Stage stage) const
+{
+  const StageData &s = stages_[stage];
+  const float us_per_cycle = 1.0f / static_cast<float>(cycles_per_us_);
+
+  Stats out;
+  out.count = s.count;
+  out.overruns = s.overruns;
+  if (s.count == 0)
+  {
+    out.min_us = out.mean_us = out.p99_us = out.max_us = 0.0f;
+    return out;
+  }
+  out.min_us = static_cast<float>(s.min) * us_per_cycle;
+  out.max_us = static_cast<float>(s.max) * us_per_cycle;
+  out.mean_us = static_cast<float>(s.sum / s.count) * us_per_cycle;
+
+  uint32_t p99 = s.max;
+#if ROSFLIGHT_PROFILER_HISTOGRAM
+  uint32_t total = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++)
+    total += s.histogram[i];
+  uint32_t rank = total - total / 100;
+  uint32_t cumulative = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++)
+  {
+    cumulative += s.histogram[i];
+    if (cumulative >= rank)
+    {
+      uint32_t upper = bucket_upper_bound(i) - 1;
+      p99 = (upper < s.max) ? upper : s.max;
+      break;
+    }
+  }
+#endif
+  out.p99_us = static_cast<float>(p99) * us_per_cycle;
+  return out;
+}
+
+void Profiler::reset(Stage stage)
+{
+  memset(&stages_[stage], 0, sizeof(StageData));
+}
+
+const char *Profiler::stage_name(Stage stage)
+{
+  switch (stage)
+  {
+  case STAGE_SENSORS:
+    return "sens";
+  case STAGE_ESTIMATOR:
+    return "est";
+  case STAGE_CONTROLLER:
+    return "ctrl";
+  case STAGE_MIXER:
+    return "mix";
+  case STAGE_COMM_STREAM:
+    return "strm";
+  case STAGE_COMM_RECEIVE:
+    return "recv";
+  case STAGE_STATE_MANAGER:
+    return "state";
+  case STAGE_RC:
+    return "rc";
+  case STAGE_COMMAND_MANAGER:
+    return "cmd";
+  case STAGE_LOOP:
+    return "loop";
+  default:
+    return "";
+  }
+}
+
+// Buckets are log-spaced with two buckets per octave: [2, 3), [3, 4), [4, 6), [6, 8), [8, 12), ...
+int Profiler::bucket(uint32_t cycles)
+{
+  if (cycles < 2)
+    return static_cast<int>(cycles);
+  int msb = 31 - __builtin_clz(cycles);
+  int half = static_cast<int>((cycles >> (msb - 1)) & 1);
+  return 2 * msb + half;
+}
+
+uint32_t Profiler::bucket_upper_bound(int bucket)
+{
+  if (bucket < 2)
+    return static_cast<uint32_t>(bucket + 1);
+  int msb = bucket / 2;
+  uint64_t lower = static_cast<uint64_t>(2 + (bucket & 1)) << (msb - 1);
+  uint64_t upper = lower + (static_cast<uint64_t>(1) << (msb - 1));
+  return (upper > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(upper);
+}
+
+} // namespace rosflight_firmware
@@ -45,7 +45,8 @@ ROSflight::ROSflight(Board& board, CommLinkInterface& comm_link) :
   mixer_(*this),
   rc_(*this),
   sensors_(*this),
-  state_manager_(*this)
+  state_manager_(*this),
+  profiler_(*this)
 {
   comm_link.set_listener(&comm_manager_);
   params_.set_listeners(param_listeners_, num_param_listeners_);
@@ -89,6 +90,9 @@ void ROSflight::init()
   // Initialize the command muxer
   command_manager_.init();
 
+  // Initialize the main loop profiler
+  profiler_.init();
+
   /***************************/
   /***  Hardfault Recovery ***/
   /***************************/
@@ -104,12 +108,18 @@ void ROSflight::run()
   /***  Control Loop ***/
   /*********************/
   uint64_t start = board_.clock_micros();
-  if (sensors_.run())
+  profiler_.start_loop();
+  bool got_imu = sensors_.run();
+  profiler_.end_stage(Profiler::STAGE_SENSORS);
+  if (got_imu)
   {
     // If I have new IMU data, then perform control
     estimator_.run();
+    profiler_.end_stage(Profiler::STAGE_ESTIMATOR);
     controller_.run();
+    profiler_.end_stage(Profiler::STAGE_CONTROLLER);
     mixer_.mix_output();
+    profiler_.end_stage(Profiler::STAGE_MIXER);
     loop_time_us = board_.clock_micros() - start;
   }
 
@@ -118,18 +128,24 @@ void ROSflight::run()
   /*********************/
   // internal timers figure out what and when to send
   comm_manager_.stream();
+  profiler_.end_stage(Profiler::STAGE_COMM_STREAM);
 
   // receive mavlink messages
   comm_manager_.receive();
+  profiler_.end_stage(Profiler::STAGE_COMM_RECEIVE);
 
   // update the state machine, an internal timer runs this at a fixed rate
   state_manager_.run();
+  profiler_.end_stage(Profiler::STAGE_STATE_MANAGER);
 
   // get RC, an internal timer runs this every 20 ms (50 Hz)
   rc_.run();
+  profiler_.end_stage(Profiler::STAGE_RC);
 
   // update commands (internal logic tells whether or not we should do anything or not)
   command_manager_.run();
+  profiler_.end_stage(Profiler::STAGE_COMMAND_MANAGER);
+  profiler_.end_loop();
 }
 
 uint32_t ROSflight::get_loop_time_us()
@@ -68,6 +68,7 @@ void Sensors::init()
   rf_.state_manager_.clear_error(StateManager::ERROR_IMU_NOT_RESPONDING);
   rf_.board_.sensors_init();
 
+  update_calibration_params();
   init_imu();
 
   next_sensor_to_update_ = BAROMETER;
@@ -81,6 +82,7 @@ void Sensors::init()
   int_start_us_ = rf_.board_.clock_micros();
 
   this->update_battery_monitor_multipliers();
+  update_gyro_spectrum_params();
 }
 
 void Sensors::init_imu()
@@ -91,6 +93,20 @@ void Sensors::init_imu()
   float yaw = rf_.params_.get_param_float(PARAM_FC_YAW) * 0.017453293;
   data_.fcu_orientation = turbomath::Quaternion(roll, pitch, yaw);
 
+  // the same coefficients as Quaternion::rotate(), so that a batch can be rotated without
+  // going through the quaternion for every sample
+  const turbomath::Quaternion &q = data_.fcu_orientation;
+  float (&R)[3][3] = cal_.fcu_rotation;
+  R[0][0] = 1.0f - 2.0f*q.y*q.y - 2.0f*q.z*q.z;
+  R[0][1] = 2.0f*(q.x*q.y + q.w*q.z);
+  R[0][2] = 2.0f*(q.x*q.z - q.w*q.y);
+  R[1][0] = 2.0f*(q.x*q.y - q.w*q.z);
+  R[1][1] = 1.0f - 2.0f*q.x*q.x - 2.0f*q.z*q.z;
+  R[1][2] = 2.0f*(q.y*q.z + q.w*q.x);
+  R[2][0] = 2.0f*(q.x*q.z + q.w*q.y);
+  R[2][1] = 2.0f*(q.y*q.z - q.w*q.x);
+  R[2][2] = 1.0f - 2.0f*q.x*q.x - 2.0f*q.y*q.y;
+
   // See if the IMU is uncalibrated, and throw an error if it is
   if (rf_.params_.get_param_float(PARAM_ACC_X_BIAS) == 0.0 && rf_.params_.get_param_float(PARAM_ACC_Y_BIAS) == 0.0 &&
       rf_.params_.get_param_float(PARAM_ACC_Z_BIAS) == 0.0 && rf_.params_.get_param_float(PARAM_GYRO_X_BIAS) == 0.0 &&
@@ -100,29 +116,98 @@ void Sensors::init_imu()
   }
 }
 
+void Sensors::update_calibration_params(void)
+{
+  cal_.accel_bias = turbomath::Vector(rf_.params_.get_param_float(PARAM_ACC_X_BIAS),
+                                      rf_.params_.get_param_float(PARAM_ACC_Y_BIAS),
+                                      rf_.params_.get_param_float(PARAM_ACC_Z_BIAS));
+  cal_.accel_temp_comp = turbomath::Vector(rf_.params_.get_param_float(PARAM_ACC_X_TEMP_COMP),
+                                           rf_.params_.get_param_float(PARAM_ACC_Y_TEMP_COMP),
+                                           rf_.params_.get_param_float(PARAM_ACC_Z_TEMP_COMP));
+  cal_.gyro_bias = turbomath::Vector(rf_.params_.get_param_float(PARAM_GYRO_X_BIAS),
+                                     rf_.params_.get_param_float(PARAM_GYRO_Y_BIAS),
+                                     rf_.params_.get_param_float(PARAM_GYRO_Z_BIAS));
+  cal_.mag_bias = turbomath::Vector(rf_.params_.get_param_float(PARAM_MAG_X_BIAS),
+                                    rf_.params_.get_param_float(PARAM_MAG_Y_BIAS),
+                                    rf_.params_.get_param_float(PARAM_MAG_Z_BIAS));
+
+  // the soft iron params are laid out row by row, starting at A11
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      cal_.mag_soft_iron[i][j] = rf_.params_.get_param_float(static_cast<uint16_t>(PARAM_MAG_A11_COMP + 3*i + j));
+    }
+  }
+}
+
 void Sensors::param_change_callback(uint16_t param_id)
 {
-  switch (param_id)
+  param_change_batch_callback(&param_id, 1);
+}
+
+void Sensors::param_change_batch_callback(const uint16_t *param_ids, size_t num_ids)
+{
+  bool reinit_imu = false;
+  bool update_calibration = false;
+  for (size_t i = 0; i < num_ids; i++)
   {
-  case PARAM_FC_ROLL:
-  case PARAM_FC_PITCH:
-  case PARAM_FC_YAW:
-    init_imu();
-    break;
-  case PARAM_BATTERY_VOLTAGE_MULTIPLIER:
-  case PARAM_BATTERY_CURRENT_MULTIPLIER:
-    update_battery_monitor_multipliers();
-    break;
-  case PARAM_BATTERY_VOLTAGE_ALPHA:
-    battery_voltage_alpha_ = rf_.params_.get_param_float(PARAM_BATTERY_VOLTAGE_ALPHA);
-    break;
-  case PARAM_BATTERY_CURRENT_ALPHA:
-    battery_current_alpha_ = rf_.params_.get_param_float(PARAM_BATTERY_CURRENT_ALPHA);
-    break;
-  default:
-    // do nothing
-    break;
+    switch (param_ids[i])
+    {
+    case PARAM_FC_ROLL:
+    case PARAM_FC_PITCH:
+    case PARAM_FC_YAW:
+      reinit_imu = true;
+      break;
+    case PARAM_ACC_X_BIAS:
+    case PARAM_ACC_Y_BIAS:
+    case PARAM_ACC_Z_BIAS:
+    case PARAM_ACC_X_TEMP_COMP:
+    case PARAM_ACC_Y_TEMP_COMP:
+    case PARAM_ACC_Z_TEMP_COMP:
+    case PARAM_GYRO_X_BIAS:
+    case PARAM_GYRO_Y_BIAS:
+    case PARAM_GYRO_Z_BIAS:
+    case PARAM_MAG_A11_COMP:
+    case PARAM_MAG_A12_COMP:
+    case PARAM_MAG_A13_COMP:
+    case PARAM_MAG_A21_COMP:
+    case PARAM_MAG_A22_COMP:
+    case PARAM_MAG_A23_COMP:
+    case PARAM_MAG_A31_COMP:
+    case PARAM_MAG_A32_COMP:
+    case PARAM_MAG_A33_COMP:
+    case PARAM_MAG_X_BIAS:
+    case PARAM_MAG_Y_BIAS:
+    case PARAM_MAG_Z_BIAS:
+      update_calibration = true;
+      break;
+    case PARAM_BATTERY_VOLTAGE_MULTIPLIER:
+    case PARAM_BATTERY_CURRENT_MULTIPLIER:
+      update_battery_monitor_multipliers();
+      break;
+    case PARAM_BATTERY_VOLTAGE_ALPHA:
+      battery_voltage_alpha_ = rf_.params_.get_param_float(PARAM_BATTERY_VOLTAGE_ALPHA);
+      break;
+    case PARAM_BATTERY_CURRENT_ALPHA:
+      battery_current_alpha_ = rf_.params_.get_param_float(PARAM_BATTERY_CURRENT_ALPHA);
+      break;
+    case PARAM_GYRO_FFT_ENABLE:
+    case PARAM_GYRO_FFT_MIN_FREQ:
+    case PARAM_DYN_NOTCH_ENABLE:
+    case PARAM_DYN_NOTCH_MIN_AMP:
+      update_gyro_spectrum_params();
+      break;
+    default:
+      // do nothing
+      break;
+    }
   }
+
+  if (reinit_imu)
+    init_imu();
+  if (update_calibration)
+    update_calibration_params();
 }
 
 
@@ -136,11 +221,47 @@ bool Sensors::run(void)
   if (!rf_.state_manager_.state().armed)
     look_for_disabled_sensors();
 
+  if (gyro_fft_enabled_)
+    update_gyro_spectrum(got_imu);
+
   // Update other sensors
   update_other_sensors();
   return got_imu;
 }
 
+void Sensors::update_gyro_spectrum_params(void)
+{
+#if ROSFLIGHT_GYRO_SPECTRUM
+  gyro_fft_enabled_ = rf_.params_.get_param_int(PARAM_GYRO_FFT_ENABLE);
+  dyn_notch_enabled_ = rf_.params_.get_param_int(PARAM_DYN_NOTCH_ENABLE);
+  dyn_notch_min_amplitude_ = rf_.params_.get_param_float(PARAM_DYN_NOTCH_MIN_AMP);
+  gyro_spectrum_.init(rf_.params_.get_param_float(PARAM_GYRO_FFT_MIN_FREQ));
+#endif
+}
+
+void Sensors::update_gyro_spectrum(bool got_imu)
+{
+#if ROSFLIGHT_GYRO_SPECTRUM
+  // One step of the transform per loop keeps the cost per loop small and constant
+  if (got_imu)
+  {
+    float gyro[3] = {data_.gyro.x, data_.gyro.y, data_.gyro.z};
+    gyro_spectrum_.add_sample(gyro, data_.imu_time);
+  }
+  if (!gyro_spectrum_.update() || !dyn_notch_enabled_)
+    return;
+
+  for (uint8_t axis = 0; axis < SpectrumAnalyzer::NUM_AXES; axis++)
+  {
+    const SpectrumAnalyzer::Peak &peak = gyro_spectrum_.peaks(axis)[0];
+    if (peak.amplitude >= dyn_notch_min_amplitude_)
+      rf_.estimator_.set_gyro_notch_center(axis, peak.frequency_hz, gyro_spectrum_.sample_rate_hz());
+  }
+#else
+  (void)got_imu;
+#endif
+}
+
 
 void Sensors::update_other_sensors()
 {
@@ -184,6 +305,7 @@ void Sensors::update_other_sensors()
       data_.mag.x = mag[0];
       data_.mag.y = mag[1];
       data_.mag.z = mag[2];
+      data_.mag_time = rf_.board_.clock_micros();
       correct_mag();
     }
     break;
@@ -302,40 +424,17 @@ bool Sensors::gyro_calibration_complete(void)
 // local function definitions
 bool Sensors::update_imu(void)
 {
-  if (rf_.board_.new_imu_data())
+  size_t count = rf_.board_.imu_read_fifo(imu_fifo_, IMU_FIFO_SIZE);
+  if (count > 0)
   {
     rf_.state_manager_.clear_error(StateManager::ERROR_IMU_NOT_RESPONDING);
     last_imu_update_ms_ = rf_.board_.clock_millis();
-    if (!rf_.board_.imu_read(accel_, &data_.imu_temperature, gyro_, &data_.imu_time))
-      return false;
-
-    // Move data into local copy
-    data_.accel.x = accel_[0];
-    data_.accel.y = accel_[1];
-    data_.accel.z = accel_[2];
-
-    data_.accel = data_.fcu_orientation * data_.accel;
-
-    data_.gyro.x = gyro_[0];
-    data_.gyro.y = gyro_[1];
-    data_.gyro.z = gyro_[2];
-
-    data_.gyro = data_.fcu_orientation * data_.gyro;
-
-    if (calibrating_acc_flag_)
-      calibrate_accel();
-    if (calibrating_gyro_flag_)
-      calibrate_gyro();
-
-    // Apply bias correction
-    correct_imu();
 
-    // Integrate for filtered IMU
-    float dt = (data_.imu_time - prev_imu_read_time_us_) * 1e-6;
-    accel_int_ += dt * data_.accel;
-    gyro_int_ += dt * data_.gyro;
-    prev_imu_read_time_us_ = data_.imu_time;
+    if (calibrating_acc_flag_ || calibrating_gyro_flag_)
+      calibrate_imu_batch(count);
 
+    // Rotate, correct and integrate the batch; data_ gets its mean
+    correct_imu_batch(count);
     return true;
   }
   else
@@ -592,40 +691,94 @@ void Sensors::calibrate_diff_pressure()
 }
 
 
+void Sensors::calibrate_imu_batch(size_t count)
+{
+  // the calibration routines look at one rotated, uncorrected sample at a time
+  for (size_t i = 0; i < count; i++)
+  {
+    const ImuSample &sample = imu_fifo_[i];
+    data_.accel = data_.fcu_orientation * turbomath::Vector(sample.accel[0], sample.accel[1], sample.accel[2]);
+    data_.gyro = data_.fcu_orientation * turbomath::Vector(sample.gyro[0], sample.gyro[1], sample.gyro[2]);
+    data_.imu_temperature = sample.temperature;
+
+    if (calibrating_acc_flag_)
+      calibrate_accel();
+    if (calibrating_gyro_flag_)
+      calibrate_gyro();
+  }
+}
+
+
 //======================================================
 // Correction Functions (These apply calibration constants)
-void Sensors::correct_imu(void)
+void Sensors::correct_imu_batch(size_t count)
 {
-  // correct according to known biases and temperature compensation
-  data_.accel.x -= rf_.params_.get_param_float(PARAM_ACC_X_TEMP_COMP)*data_.imu_temperature
-                   + rf_.params_.get_param_float(PARAM_ACC_X_BIAS);
-  data_.accel.y -= rf_.params_.get_param_float(PARAM_ACC_Y_TEMP_COMP)*data_.imu_temperature
-                   + rf_.params_.get_param_float(PARAM_ACC_Y_BIAS);
-  data_.accel.z -= rf_.params_.get_param_float(PARAM_ACC_Z_TEMP_COMP)*data_.imu_temperature
-                   + rf_.params_.get_param_float(PARAM_ACC_Z_BIAS);
+  // Rotate into the body frame, correct according to known biases and temperature compensation,
+  // and integrate for the filtered IMU. The loop has no calls or branches so that it stays cheap
+  // for large batches.
+  const float (&R)[3][3] = cal_.fcu_rotation;
+  const turbomath::Vector &accel_bias = cal_.accel_bias;
+  const turbomath::Vector &temp_comp = cal_.accel_temp_comp;
+  const turbomath::Vector &gyro_bias = cal_.gyro_bias;
+
+  float accel_sum[3] = {0.0f, 0.0f, 0.0f};
+  float gyro_sum[3] = {0.0f, 0.0f, 0.0f};
+  float accel_int[3] = {0.0f, 0.0f, 0.0f};
+  float gyro_int[3] = {0.0f, 0.0f, 0.0f};
+  uint64_t prev_time_us = prev_imu_read_time_us_;
+  for (size_t i = 0; i < count; i++)
+  {
+    const ImuSample &sample = imu_fifo_[i];
+    const float *a = sample.accel;
+    const float *g = sample.gyro;
+    float t = sample.temperature;
+
+    float ax = R[0][0]*a[0] + R[0][1]*a[1] + R[0][2]*a[2] - (temp_comp.x*t + accel_bias.x);
+    float ay = R[1][0]*a[0] + R[1][1]*a[1] + R[1][2]*a[2] - (temp_comp.y*t + accel_bias.y);
+    float az = R[2][0]*a[0] + R[2][1]*a[1] + R[2][2]*a[2] - (temp_comp.z*t + accel_bias.z);
+    float gx = R[0][0]*g[0] + R[0][1]*g[1] + R[0][2]*g[2] - gyro_bias.x;
+    float gy = R[1][0]*g[0] + R[1][1]*g[1] + R[1][2]*g[2] - gyro_bias.y;
+    float gz = R[2][0]*g[0] + R[2][1]*g[1] + R[2][2]*g[2] - gyro_bias.z;
+
+    float dt = (sample.time_us - prev_time_us) * 1e-6f;
+    prev_time_us = sample.time_us;
+
+    accel_sum[0] += ax;
+    accel_sum[1] += ay;
+    accel_sum[2] += az;
+    gyro_sum[0] += gx;
+    gyro_sum[1] += gy;
+    gyro_sum[2] += gz;
+    accel_int[0] += dt * ax;
+    accel_int[1] += dt * ay;
+    accel_int[2] += dt * az;
+    gyro_int[0] += dt * gx;
+    gyro_int[1] += dt * gy;
+    gyro_int[2] += dt * gz;
+  }
+
+  accel_int_ += turbomath::Vector(accel_int[0], accel_int[1], accel_int[2]);
+  gyro_int_ += turbomath::Vector(gyro_int[0], gyro_int[1], gyro_int[2]);
+  prev_imu_read_time_us_ = prev_time_us;
 
-  data_.gyro.x -= rf_.params_.get_param_float(PARAM_GYRO_X_BIAS);
-  data_.gyro.y -= rf_.params_.get_param_float(PARAM_GYRO_Y_BIAS);
-  data_.gyro.z -= rf_.params_.get_param_float(PARAM_GYRO_Z_BIAS);
+  // Oversampled batches are averaged down to the loop rate
+  float inv_count = 1.0f / static_cast<float>(count);
+  data_.accel = turbomath::Vector(accel_sum[0], accel_sum[1], accel_sum[2]) * inv_count;
+  data_.gyro = turbomath::Vector(gyro_sum[0], gyro_sum[1], gyro_sum[2]) * inv_count;
+  data_.imu_temperature = imu_fifo_[count - 1].temperature;
+  data_.imu_time = imu_fifo_[count - 1].time_us;
 }
 
 void Sensors::correct_mag(void)
 {
   // correct according to known hard iron bias
-  float mag_hard_x = data_.mag.x - rf_.params_.get_param_float(PARAM_MAG_X_BIAS);
-  float mag_hard_y = data_.mag.y - rf_.params_.get_param_float(PARAM_MAG_Y_BIAS);
-  float mag_hard_z = data_.mag.z - rf_.params_.get_param_float(PARAM_MAG_Z_BIAS);
+  turbomath::Vector mag_hard = data_.mag - cal_.mag_bias;
 
   // correct according to known soft iron bias - converts to nT
-  data_.mag.x = rf_.params_.get_param_float(PARAM_MAG_A11_COMP)*mag_hard_x + rf_.params_.get_param_float(
-                  PARAM_MAG_A12_COMP)*mag_hard_y +
-                rf_.params_.get_param_float(PARAM_MAG_A13_COMP)*mag_hard_z;
-  data_.mag.y = rf_.params_.get_param_float(PARAM_MAG_A21_COMP)*mag_hard_x + rf_.params_.get_param_float(
-                  PARAM_MAG_A22_COMP)*mag_hard_y +
-                rf_.params_.get_param_float(PARAM_MAG_A23_COMP)*mag_hard_z;
-  data_.mag.z = rf_.params_.get_param_float(PARAM_MAG_A31_COMP)*mag_hard_x + rf_.params_.get_param_float(
-                  PARAM_MAG_A32_COMP)*mag_hard_y +
-                rf_.params_.get_param_float(PARAM_MAG_A33_COMP)*mag_hard_z;
+  const float (&A)[3][3] = cal_.mag_soft_iron;
+  data_.mag.x = A[0][0]*mag_hard.x + A[0][1]*mag_hard.y + A[0][2]*mag_hard.z;
+  data_.mag.y = A[1][0]*mag_hard.x + A[1][1]*mag_hard.y + A[1][2]*mag_hard.z;
+  data_.mag.z = A[2][0]*mag_hard.x + A[2][1]*mag_hard.y + A[2][2]*mag_hard.z;
 }
 
 void Sensors::correct_baro(void)
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+
+#include "serial_tx_buffer.h"
+
+namespace rosflight_firmware
+{
+
+constexpr size_t SerialTxBuffer::CAPACITY;
+constexpr size_t SerialTxBuffer::LIMIT_QUARTERS[SerialTxBuffer::PRIORITY_COUNT];
+
+uint8_t *SerialTxBuffer::reserve(size_t max_len, Priority priority)
+{
+  size_t limit = CAPACITY/4*LIMIT_QUARTERS[priority];
+  if (len_ + max_len > limit)
+  {
+    dropped_[priority]++;
+    reserved_ = 0;
+    return nullptr;
+  }
+
+  reserved_ = max_len;
+  return buf_ + len_;
+}
+
+void SerialTxBuffer::commit(size_t len)
+{
+  len_ += (len < reserved_) ? len : reserved_;
+  reserved_ = 0;
+}
+
+bool SerialTxBuffer::push(const uint8_t *src, size_t len, Priority priority)
+{
+  uint8_t *dest = reserve(len, priority);
+  if (dest == nullptr)
+    return false;
+
+  memcpy(dest, src, len);
+  commit(len);
+  return true;
+}
+
+} // namespace rosflight_firmware
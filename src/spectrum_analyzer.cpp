@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+#include "spectrum_analyzer.h"
+
+namespace rosflight_firmware
+{
+
+constexpr size_t SpectrumAnalyzer::FFT_SIZE;
+constexpr size_t SpectrumAnalyzer::NUM_BINS;
+constexpr uint8_t SpectrumAnalyzer::NUM_AXES;
+constexpr uint8_t SpectrumAnalyzer::NUM_PEAKS;
+constexpr uint8_t SpectrumAnalyzer::STEPS_PER_FRAME;
+constexpr size_t SpectrumAnalyzer::HALF_SIZE;
+constexpr uint8_t SpectrumAnalyzer::LOG2_HALF_SIZE;
+constexpr size_t SpectrumAnalyzer::RING_SIZE;
+
+namespace
+{
+constexpr float PI = 3.14159265f;
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+{
+  for (size_t k = 0; k <= HALF_SIZE; k++)
+    cos_table_[k] = cosf(2.0f * PI * static_cast<float>(k) / static_cast<float>(FFT_SIZE));
+  for (size_t n = 0; n < HALF_SIZE; n++)
+  {
+    uint8_t reversed = 0;
+    for (uint8_t bit = 0; bit < LOG2_HALF_SIZE; bit++)
+      reversed = static_cast<uint8_t>(reversed | (((n >> bit) & 1) << (LOG2_HALF_SIZE - 1 - bit)));
+    bit_reverse_[n] = reversed;
+  }
+  init(0.0f);
+}
+
+void SpectrumAnalyzer::init(float min_frequency_hz)
+{
+  min_frequency_hz_ = min_frequency_hz;
+  input_next_ = 0;
+  input_count_ = 0;
+  step_ = STEP_IDLE;
+  axis_ = 0;
+  result_sample_rate_hz_ = 0.0f;
+  num_results_ = 0;
+  memset(peaks_, 0, sizeof(peaks_));
+}
+
+void SpectrumAnalyzer::add_sample(const float value[NUM_AXES], uint64_t time_us)
+{
+  // after a skipped frame, the ring has no room until the frame being processed is done
+  if (input_count_ == 0 && step_ != STEP_IDLE)
+    return;
+
+  for (uint8_t axis = 0; axis < NUM_AXES; axis++)
+    input_[axis][input_next_] = value[axis];
+  if (++input_next_ == RING_SIZE)
+    input_next_ = 0;
+
+  if (input_count_ == 0)
+    input_start_us_ = time_us;
+  else if (input_count_ == HALF_SIZE)
+    input_half_us_ = time_us;
+
+  if (++input_count_ == FFT_SIZE)
+  {
+    if (step_ == STEP_IDLE)
+    {
+      start_frame(time_us);
+      // the newest half starts the next, overlapping frame
+      input_count_ = HALF_SIZE;
+      input_start_us_ = input_half_us_;
+    }
+    else
+    {
+      // the next sample would overwrite the frame being processed
+      input_count_ = 0;
+    }
+  }
+}
+
+void SpectrumAnalyzer::start_frame(uint64_t last_us)
+{
+  if (last_us <= input_start_us_)
+    return;
+
+  frame_start_ = (input_next_ + RING_SIZE - FFT_SIZE) % RING_SIZE;
+  frame_sample_rate_hz_ = static_cast<float>(FFT_SIZE - 1) * 1e6f / static_cast<float>(last_us - input_start_us_);
+  axis_ = 0;
+  step_ = STEP_WINDOW;
+}
+
+float SpectrumAnalyzer::sin_table(size_t k) const
+{
+  // sin(2*pi*k/N) = cos(2*pi*(N/4 - k)/N), for k up to N/2
+  return cos_table_[(k <= FFT_SIZE / 4) ? FFT_SIZE / 4 - k : k - FFT_SIZE / 4];
+}
+
+float SpectrumAnalyzer::window(size_t n) const
+{
+  // Hann window, symmetric about the middle of the frame
+  return 0.5f - 0.5f * cos_table_[(n <= HALF_SIZE) ? n : FFT_SIZE - n];
+}
+
+bool SpectrumAnalyzer::update()
+{
+  if (step_ == STEP_IDLE)
+    return false;
+
+  if (step_ == STEP_WINDOW)
+    window_and_pack();
+  else if (step_ < STEP_SPLIT)
+    fft_stage(static_cast<uint8_t>(step_ - STEP_FFT_STAGE));
+  else if (step_ == STEP_SPLIT)
+    split_spectrum();
+  else
+    find_peaks();
+
+  if (++step_ <= STEP_PEAKS)
+    return false;
+
+  if (++axis_ < NUM_AXES)
+  {
+    step_ = STEP_WINDOW;
+    return false;
+  }
+
+  memcpy(peaks_, frame_peaks_, sizeof(peaks_));
+  result_sample_rate_hz_ = frame_sample_rate_hz_;
+  num_results_++;
+  step_ = STEP_IDLE;
+  return true;
+}
+
+void SpectrumAnalyzer::window_and_pack()
+{
+  // even samples go in the real part and odd samples in the imaginary part, in bit-reversed order
+  const float *x = input_[axis_];
+  size_t j = frame_start_;
+  for (size_t n = 0; n < HALF_SIZE; n++)
+  {
+    uint8_t i = bit_reverse_[n];
+    re_[i] = x[j] * window(2 * n);
+    if (++j == RING_SIZE)
+      j = 0;
+    im_[i] = x[j] * window(2 * n + 1);
+    if (++j == RING_SIZE)
+      j = 0;
+  }
+}
+
+void SpectrumAnalyzer::fft_stage(uint8_t stage)
+{
+  // radix-2 decimation-in-time butterflies with twiddles exp(-2*pi*i*k/span)
+  const size_t half_span = static_cast<size_t>(1) << stage;
+  const size_t span = 2 * half_span;
+  const size_t twiddle_step = FFT_SIZE / span;
+  for (size_t start = 0; start < HALF_SIZE; start += span)
+  {
+    for (size_t k = 0; k < half_span; k++)
+    {
+      float wr = cos_table_[k * twiddle_step];
+      float wi = -sin_table(k * twiddle_step);
+      size_t a = start + k;
+      size_t b = a + half_span;
+      float tr = wr * re_[b] - wi * im_[b];
+      float ti = wr * im_[b] + wi * re_[b];
+      re_[b] = re_[a] - tr;
+      im_[b] = im_[a] - ti;
+      re_[a] += tr;
+      im_[a] += ti;
+    }
+  }
+}
+
+void SpectrumAnalyzer::split_spectrum()
+{
+  // With Z the FFT of the packed samples, the spectrum of the real frame is
+  // X[k] = E[k] + exp(-2*pi*i*k/N)*O[k], where E[k] = (Z[k] + conj(Z[N/2-k]))/2 and
+  // O[k] = (Z[k] - conj(Z[N/2-k]))/2i are the spectra of the even and odd samples
+  for (size_t k = 0; k < NUM_BINS; k++)
+  {
+    size_t a = k % HALF_SIZE;
+    size_t b = (HALF_SIZE - k) % HALF_SIZE;
+    float er = 0.5f * (re_[a] + re_[b]);
+    float ei = 0.5f * (im_[a] - im_[b]);
+    float orr = 0.5f * (im_[a] + im_[b]);
+    float oi = -0.5f * (re_[a] - re_[b]);
+    float wr = cos_table_[k];
+    float wi = -sin_table(k);
+    float xr = er + wr * orr - wi * oi;
+    float xi = ei + wr * oi + wi * orr;
+    power_[k] = xr * xr + xi * xi;
+  }
+}
+
+void SpectrumAnalyzer::find_peaks()
+{
+  Peak *peaks = frame_peaks_[axis_];
+  for (uint8_t i = 0; i < NUM_PEAKS; i++)
+  {
+    peaks[i].frequency_hz = 0.0f;
+    peaks[i].amplitude = 0.0f;
+  }
+
+  const float bin_hz = frame_sample_rate_hz_ / static_cast<float>(FFT_SIZE);
+  size_t first_bin = static_cast<size_t>(ceilf(min_frequency_hz_ / bin_hz));
+  if (first_bin < 1)
+    first_bin = 1;
+
+  size_t bins[NUM_PEAKS] = {0, 0, 0};
+  for (size_t k = first_bin; k < NUM_BINS - 1; k++)
+  {
+    float p = power_[k];
+    if (p <= power_[k - 1] || p < power_[k + 1])
+      continue;
+
+    // insert into the largest few, which are kept sorted
+    uint8_t i = NUM_PEAKS;
+    while (i > 0 && (bins[i - 1] == 0 || power_[bins[i - 1]] < p))
+    {
+      if (i < NUM_PEAKS)
+        bins[i] = bins[i - 1];
+      i--;
+    }
+    if (i < NUM_PEAKS)
+      bins[i] = k;
+  }
+
+  // A Hann-windowed sinusoid has a nearly Gaussian main lobe, so a parabola through the log
+  // magnitudes of the three bins around the peak locates it to a small fraction of a bin. A unit
+  // sinusoid has a peak magnitude of N/4.
+  for (uint8_t i = 0; i < NUM_PEAKS && bins[i] != 0; i++)
+  {
+    size_t k = bins[i];
+    float left = 0.5f * logf(power_[k - 1] + 1e-24f);
+    float center = 0.5f * logf(power_[k]);
+    float right = 0.5f * logf(power_[k + 1] + 1e-24f);
+    float curvature = left - 2.0f * center + right;
+    float offset = (curvature < 0.0f) ? 0.5f * (left - right) / curvature : 0.0f;
+    peaks[i].frequency_hz = (static_cast<float>(k) + offset) * bin_hz;
+    peaks[i].amplitude = expf(center - 0.25f * (left - right) * offset) * 4.0f / static_cast<float>(FFT_SIZE);
+  }
+}
+
+} // namespace rosflight_firmware
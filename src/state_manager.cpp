@@ -117,8 +117,13 @@ void StateManager::set_event(StateManager::Event event)
       fsm_state_ = FSM_STATE_ERROR;
       break;
     case EVENT_REQUEST_ARM:
+      // parameters the ground station is still changing haven't taken effect yet
+      if (RF_.comm_manager_.param_batch_open())
+      {
+        RF_.comm_manager_.log(CommLinkInterface::LogSeverity::LOG_ERROR, "Unable to arm: parameter batch open");
+      }
       // require low RC throttle to arm
-      if (RF_.rc_.stick(RC::Stick::STICK_F) < RF_.params_.get_param_float(PARAM_ARM_THRESHOLD))
+      else if (RF_.rc_.stick(RC::Stick::STICK_F) < RF_.params_.get_param_float(PARAM_ARM_THRESHOLD))
       {
         // require either min throttle to be enabled or throttle override switch to be on
         if (RF_.params_.get_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE)
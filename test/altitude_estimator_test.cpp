@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cmath>
+#include <random>
+
+#include "common.h"
+#include "altitude_estimator.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+constexpr float DT = 0.001f;
+constexpr int BARO_DIVISOR = 20; // 50 Hz
+
+// A vehicle climbing at 0.5 m/s while bobbing up and down by 2 m
+struct Trajectory
+{
+  static float altitude(float t) { return 0.5f * t + 2.0f * std::sin(0.5f * t); }
+  static float climb_rate(float t) { return 0.5f + std::cos(0.5f * t); }
+  static float accel(float t) { return -0.5f * std::sin(0.5f * t); }
+};
+} // namespace
+
+TEST(AltitudeEstimatorTest, StartsAtTheFirstMeasurement)
+{
+  AltitudeEstimator estimator;
+  estimator.predict(3.0f, 0.1f);
+  EXPECT_FALSE(estimator.initialized());
+  EXPECT_EQ(estimator.altitude(), 0.0f);
+
+  estimator.correct_baro(12.0f, DT);
+  EXPECT_TRUE(estimator.initialized());
+  EXPECT_EQ(estimator.altitude(), 12.0f);
+  EXPECT_EQ(estimator.climb_rate(), 0.0f);
+
+  estimator.reset();
+  EXPECT_FALSE(estimator.initialized());
+}
+
+TEST(AltitudeEstimatorTest, TracksClimbWithNoisyBaroAndAccelBias)
+{
+  AltitudeEstimator estimator;
+  std::mt19937 rng(42);
+  std::normal_distribution<float> baro_noise(0.0f, 0.3f);
+  std::normal_distribution<float> accel_noise(0.0f, 0.2f);
+  const float accel_bias = 0.3f;
+
+  float baro = 0.0f;
+  float max_altitude_error = 0.0f;
+  float max_climb_error = 0.0f;
+  for (int i = 0; i < 60000; i++)
+  {
+    const float t = i * DT;
+    if (i % BARO_DIVISOR == 0)
+      baro = Trajectory::altitude(t) + baro_noise(rng);
+    estimator.predict(Trajectory::accel(t) + accel_bias + accel_noise(rng), DT);
+    estimator.correct_baro(baro, DT);
+
+    if (t > 30.0f)
+    {
+      max_altitude_error = std::max(max_altitude_error, std::abs(estimator.altitude() - Trajectory::altitude(t + DT)));
+      max_climb_error = std::max(max_climb_error, std::abs(estimator.climb_rate() - Trajectory::climb_rate(t + DT)));
+    }
+  }
+  EXPECT_LT(max_altitude_error, 0.3f);
+  EXPECT_LT(max_climb_error, 0.2f);
+  EXPECT_NEAR(estimator.accel_bias(), accel_bias, 0.05f);
+}
+
+TEST(AltitudeEstimatorTest, RangeToBaroHandoverDoesNotJump)
+{
+  AltitudeEstimator estimator;
+  // the barometer reads 10 m more than the range sensor's height above ground
+  const float baro_offset = 10.0f;
+
+  float max_error = 0.0f;
+  for (int i = 0; i < 40000; i++)
+  {
+    const float t = i * DT;
+    const float altitude = 1.0f + 0.5f * std::sin(0.5f * t);
+    estimator.predict(-0.125f * std::sin(0.5f * t), DT);
+    if (t < 30.0f)
+    {
+      estimator.correct_range(altitude, DT);
+      estimator.track_baro(altitude + baro_offset, DT);
+    }
+    else
+    {
+      estimator.correct_baro(altitude + baro_offset, DT);
+      max_error = std::max(max_error, std::abs(estimator.altitude() - altitude));
+    }
+  }
+  // what's left of the offset after six of its time constants, rather than a 10 m jump
+  EXPECT_LT(max_error, 0.05f);
+}
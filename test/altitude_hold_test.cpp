@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "sil_board.h"
+
+using namespace rosflight_firmware;
+
+// Closed-loop altitude hold: the full stack flies a SILBoard whose altitude follows the motor
+// outputs, while the attitude keeps rocking a little on its script.
+class AltitudeHoldTest : public ::testing::Test
+{
+public:
+  static constexpr uint32_t TICK_US = 1000; // one IMU sample per loop
+  static constexpr float MODEL_HOVER_THROTTLE = 0.55f; // a bit above HOVER_THROTTLE, left to the integrator
+
+  SILBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+  float max_altitude = 0.0f;
+  bool baro_present = true;
+
+  AltitudeHoldTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.init_board();
+    board.set_baro_present(baro_present);
+    rf.init();
+    rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+    rf.params_.set_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, false);
+    rf.params_.set_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE, true);
+    rf.params_.set_param_float(PARAM_GROUND_LEVEL, 0.0f); // the board's barometer starts at sea level
+    rf.sensors_.init();
+    rf.state_manager_.clear_error(StateManager::ERROR_UNCALIBRATED_IMU);
+    board.set_vertical_dynamics(true, MODEL_HOVER_THROTTLE);
+
+    // let the barometer calibrate on the ground
+    run(8.0f);
+    ASSERT_EQ(rf.sensors_.baro_calibration_complete(), baro_present);
+    rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+    ASSERT_TRUE(rf.state_manager_.state().armed);
+  }
+
+  void set_throttle_stick(uint16_t pwm)
+  {
+    uint16_t rc[8] = {1500, 1500, pwm, 1500, 1000, 1000, 1000, 1000};
+    board.set_rc(rc);
+  }
+
+  // Runs the main loop, sending a level altitude command when altitude_c is given
+  void run(float seconds, const float *altitude_c = nullptr)
+  {
+    uint64_t end_us = board.clock_micros() + static_cast<uint64_t>(seconds * 1e6f);
+    while (board.clock_micros() < end_us)
+    {
+      if (altitude_c != nullptr)
+      {
+        control_t command = {board.clock_millis(),
+                             {true, ANGLE, 0.0f},
+                             {true, ANGLE, 0.0f},
+                             {true, RATE, 0.0f},
+                             {true, ALTITUDE, *altitude_c}};
+        rf.command_manager_.set_new_offboard_command(command);
+      }
+      board.advance_time(TICK_US);
+      rf.run();
+      if (board.altitude() > max_altitude)
+        max_altitude = board.altitude();
+    }
+  }
+};
+
+TEST_F(AltitudeHoldTest, ClimbsToAndHoldsTargetAltitude)
+{
+  set_throttle_stick(2000);
+  float target = 2.0f;
+  run(15.0f, &target);
+
+  EXPECT_EQ(rf.command_manager_.combined_control().F.type, ALTITUDE);
+  EXPECT_TRUE(rf.estimator_.altitude_valid());
+  EXPECT_NEAR(board.altitude(), target, 0.15f);
+  EXPECT_NEAR(board.climb_rate(), 0.0f, 0.1f);
+  EXPECT_LT(max_altitude, target + 0.3f);
+  // the integrator found the hover throttle that the feedforward got wrong
+  EXPECT_NEAR(rf.controller_.output().F, MODEL_HOVER_THROTTLE, 0.05f);
+
+  // and follows a step down
+  target = 1.0f;
+  run(10.0f, &target);
+  EXPECT_NEAR(board.altitude(), target, 0.15f);
+}
+
+TEST_F(AltitudeHoldTest, ThrottleStickLimitDoesNotWindUp)
+{
+  // The throttle stick is below hover, so the vehicle can't take off however long it is asked to
+  set_throttle_stick(1300);
+  float target = 2.0f;
+  run(10.0f, &target);
+  EXPECT_LT(board.altitude(), 0.05f);
+  EXPECT_LE(rf.controller_.output().F, 0.3f + 1e-6f);
+
+  // Once the limit is lifted, it climbs without overshooting from a wound-up integrator
+  set_throttle_stick(2000);
+  run(15.0f, &target);
+  EXPECT_NEAR(board.altitude(), target, 0.15f);
+  EXPECT_LT(max_altitude, target + 0.3f);
+}
+
+TEST_F(AltitudeHoldTest, OutOfRangeHoverThrottleIsClamped)
+{
+  set_throttle_stick(2000);
+  float target = 2.0f;
+
+  // Above full throttle, altitude hold still flies on the clamped feedforward
+  rf.params_.set_param_float(PARAM_HOVER_THROTTLE, 1.5f);
+  run(15.0f, &target);
+  EXPECT_NEAR(board.altitude(), target, 0.15f);
+
+  // and at zero, which would divide by zero and scale the output to nothing
+  rf.params_.set_param_float(PARAM_HOVER_THROTTLE, 0.0f);
+  run(1.0f, &target);
+  float F = rf.controller_.output().F;
+  EXPECT_TRUE(std::isfinite(F));
+  EXPECT_GT(F, 0.0f);
+}
+
+// Without a barometer or sonar there is no altitude to hold, and the pilot keeps the throttle
+class AltitudeHoldNoSourceTest : public AltitudeHoldTest
+{
+public:
+  AltitudeHoldNoSourceTest() { baro_present = false; }
+};
+
+TEST_F(AltitudeHoldNoSourceTest, ThrottleStickFliesWithoutAltitudeEstimate)
+{
+  float target = 2.0f;
+  set_throttle_stick(1000);
+  run(3.0f, &target);
+  EXPECT_FALSE(rf.estimator_.altitude_valid());
+  EXPECT_EQ(rf.command_manager_.combined_control().F.type, ALTITUDE);
+  EXPECT_LT(rf.controller_.output().F, 1e-3f);
+  EXPECT_LT(max_altitude, 1e-3f);
+
+  set_throttle_stick(1400);
+  run(1.0f, &target);
+  EXPECT_NEAR(rf.controller_.output().F, 0.4f, 1e-3f);
+  EXPECT_LT(max_altitude, 1e-3f);
+
+  // above the model's hover throttle it climbs, on the stick alone
+  set_throttle_stick(1700);
+  run(2.0f, &target);
+  EXPECT_NEAR(rf.controller_.output().F, 0.7f, 1e-3f);
+  EXPECT_GT(board.altitude(), 0.5f);
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+#include "common.h"
+#include "attitude_ekf.h"
+#include "sym_matrix.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+const float GRAVITY = 9.80665f;
+
+template <uint8_t N>
+Eigen::Matrix<double, N, N> dense(const SymMatrix<N> &M)
+{
+  Eigen::Matrix<double, N, N> out;
+  for (uint8_t i = 0; i < N; i++)
+    for (uint8_t j = 0; j < N; j++)
+      out(i, j) = M(i, j);
+  return out;
+}
+
+template <int N>
+Eigen::Matrix<double, N, N> covariance(const AttitudeEkf &ekf)
+{
+  Eigen::Matrix<double, N, N> P;
+  for (uint8_t i = 0; i < N; i++)
+    for (uint8_t j = 0; j < N; j++)
+      P(i, j) = ekf.covariance(i, j);
+  return P;
+}
+
+AttitudeEkf::Params default_params(bool accel_bias)
+{
+  AttitudeEkf::Params params;
+  params.gyro_noise = 0.005f;
+  params.gyro_bias_noise = 1e-4f;
+  params.accel_noise = 0.5f;
+  params.accel_bias_noise = 1e-3f;
+  params.attitude_noise = 0.02f;
+  params.heading_noise = 0.05f;
+  params.estimate_accel_bias = accel_bias;
+  return params;
+}
+
+// Transition matrix of the attitude error over one step, see AttitudeEkf::propagate_covariance
+template <int N>
+Eigen::Matrix<double, N, N> transition(const turbomath::Vector &rate, double dt)
+{
+  Eigen::Matrix<double, N, N> F = Eigen::Matrix<double, N, N>::Identity();
+  Eigen::Matrix3d skew;
+  skew << 0, -rate.z, rate.y,
+          rate.z, 0, -rate.x,
+          -rate.y, rate.x, 0;
+  F.template block<3, 3>(0, 0) -= skew * dt;
+  F.template block<3, 3>(0, 3) = -dt * Eigen::Matrix3d::Identity();
+  return F;
+}
+
+// Gives the filter a full covariance by fusing a few accel measurements at different attitudes
+void excite(AttitudeEkf &ekf)
+{
+  for (int i = 0; i < 50; i++)
+  {
+    ekf.predict(turbomath::Vector(0.3f, -0.2f, 0.5f), 0.01f);
+    ekf.update_accel(turbomath::Vector(0.5f, -0.3f, -GRAVITY));
+  }
+}
+
+template <int N>
+void check_propagation(bool accel_bias)
+{
+  AttitudeEkf ekf;
+  AttitudeEkf::Params params = default_params(accel_bias);
+  ekf.set_params(params);
+  excite(ekf);
+
+  const turbomath::Vector gyro(1.0f, -2.0f, 0.5f);
+  const float dt = 0.002f;
+  Eigen::Matrix<double, N, N> P = covariance<N>(ekf);
+  turbomath::Vector rate = gyro - ekf.gyro_bias();
+  ekf.predict(gyro, dt);
+
+  Eigen::Matrix<double, N, N> F = transition<N>(rate, dt);
+  Eigen::Matrix<double, N, N> expected = F * P * F.transpose();
+  for (int i = 0; i < 3; i++)
+  {
+    expected(i, i) += params.gyro_noise * params.gyro_noise * dt;
+    expected(3 + i, 3 + i) += params.gyro_bias_noise * params.gyro_bias_noise * dt;
+    if (N > 6)
+      expected((6 + i) % N, (6 + i) % N) += params.accel_bias_noise * params.accel_bias_noise * dt;
+  }
+
+  Eigen::Matrix<double, N, N> actual = covariance<N>(ekf);
+  for (int i = 0; i < N; i++)
+  {
+    for (int j = 0; j < N; j++)
+    {
+      EXPECT_NEAR(actual(i, j), expected(i, j), 1e-6 * (1.0 + std::abs(expected(i, j)))) << i << ", " << j;
+    }
+  }
+}
+
+} // namespace
+
+TEST(SymMatrixTest, PackedLowerTriangle)
+{
+  EXPECT_EQ(SymMatrix<9>::SIZE, 45);
+  EXPECT_EQ(SymMatrix<9>::index(0, 0), 0);
+  EXPECT_EQ(SymMatrix<9>::index(2, 1), 4);
+  EXPECT_EQ(SymMatrix<9>::index(1, 2), 4);
+  EXPECT_EQ(SymMatrix<9>::index(8, 8), 44);
+
+  // the leading 6x6 block of a 9x9 matrix is stored exactly like a 6x6 matrix
+  for (uint8_t i = 0; i < 6; i++)
+    for (uint8_t j = 0; j < 6; j++)
+      EXPECT_EQ(SymMatrix<9>::index(i, j), SymMatrix<6>::index(i, j));
+}
+
+TEST(SymMatrixTest, MatchesDenseArithmetic)
+{
+  SymMatrix<6> M;
+  for (uint8_t i = 0; i < 6; i++)
+    for (uint8_t j = 0; j <= i; j++)
+      M(i, j) = 0.1f * (i + 1) + 0.01f * j + ((i == j) ? 2.0f : 0.0f);
+  Eigen::Matrix<double, 6, 6> D = dense(M);
+  EXPECT_TRUE(D.isApprox(D.transpose()));
+
+  const float x[6] = {1.0f, -2.0f, 0.5f, 0.0f, 3.0f, -1.5f};
+  Eigen::Matrix<double, 6, 1> xd;
+  for (int i = 0; i < 6; i++)
+    xd(i) = x[i];
+
+  float out[6];
+  M.multiply(x, out);
+  Eigen::Matrix<double, 6, 1> expected = D * xd;
+  for (int i = 0; i < 6; i++)
+    EXPECT_NEAR(out[i], expected(i), 1e-5);
+
+  M.rank_one_update(x, -0.25f);
+  Eigen::Matrix<double, 6, 6> updated = D - 0.25 * xd * xd.transpose();
+  EXPECT_LE((dense(M) - updated).cwiseAbs().maxCoeff(), 1e-5);
+
+  M.scale_row(4, 0.5f);
+  Eigen::Matrix<double, 6, 6> S = Eigen::Matrix<double, 6, 6>::Identity();
+  S(4, 4) = 0.5;
+  EXPECT_LE((dense(M) - S * updated * S).cwiseAbs().maxCoeff(), 1e-5);
+
+  M.reset_row(2, 7.0f);
+  for (uint8_t j = 0; j < 6; j++)
+    EXPECT_EQ(M(2, j), (j == 2) ? 7.0f : 0.0f);
+}
+
+TEST(AttitudeEkfTest, PropagationMatchesDenseCovariance)
+{
+  check_propagation<6>(false);
+  check_propagation<9>(true);
+}
+
+TEST(AttitudeEkfTest, AccelCorrectsTiltButNotYaw)
+{
+  AttitudeEkf ekf;
+  ekf.set_params(default_params(false));
+
+  // the vehicle is rolled by 0.2 rad and the filter starts level
+  turbomath::Quaternion truth(0.2f, 0.0f, 0.0f);
+  turbomath::Vector accel = truth.rotate(turbomath::Vector(0.0f, 0.0f, -GRAVITY));
+  for (int i = 0; i < 2000; i++)
+  {
+    ekf.predict(turbomath::Vector(), 0.001f);
+    ekf.update_accel(accel);
+  }
+
+  float roll, pitch, yaw;
+  ekf.attitude().get_RPY(&roll, &pitch, &yaw);
+  EXPECT_NEAR(roll, 0.2f, 1e-3);
+  EXPECT_NEAR(pitch, 0.0f, 1e-3);
+  EXPECT_NEAR(yaw, 0.0f, 1e-3);
+
+  // tilt is now well known, rotation about gravity is not (the converging estimate makes it look a
+  // little observable, so it does shrink from its initial 0.25)
+  turbomath::Vector down = accel.normalized();
+  Eigen::Vector3d d(down.x, down.y, down.z);
+  Eigen::Matrix3d P = covariance<6>(ekf).block<3, 3>(0, 0);
+  double about_gravity = d.transpose() * P * d;
+  EXPECT_LT(P.trace() - about_gravity, 1e-4);
+  EXPECT_GT(about_gravity, 0.01);
+}
+
+TEST(AttitudeEkfTest, ExternalAttitudeUpdate)
+{
+  AttitudeEkf ekf;
+  AttitudeEkf::Params params = default_params(false);
+  params.attitude_noise = 1e-3f;
+  ekf.set_params(params);
+
+  turbomath::Quaternion truth(0.1f, -0.2f, 0.3f);
+  ekf.update_attitude(truth);
+  EXPECT_LT((ekf.attitude() - truth).norm(), 1e-4);
+  EXPECT_LT(ekf.covariance(2, 2), 2e-6);
+
+  // a constant rate with a gyro bias: the bias shows up as the measurements drift from the
+  // propagated attitude
+  const turbomath::Vector rate(0.2f, 0.1f, -0.3f);
+  const turbomath::Vector bias(0.02f, -0.01f, 0.03f);
+  for (int i = 0; i < 20000; i++)
+  {
+    truth = turbomath::Quaternion::exp_map(rate, 0.001f) * truth;
+    truth.normalize();
+    ekf.predict(rate + bias, 0.001f);
+    if (i % 10 == 0)
+      ekf.update_attitude(truth);
+  }
+  EXPECT_LT((ekf.attitude() - truth).norm(), 1e-4);
+  EXPECT_NEAR(ekf.gyro_bias().x, bias.x, 1e-3);
+  EXPECT_NEAR(ekf.gyro_bias().y, bias.y, 1e-3);
+  EXPECT_NEAR(ekf.gyro_bias().z, bias.z, 1e-3);
+}
+
+TEST(AttitudeEkfTest, TogglingAccelBiasKeepsAttitudeCovariance)
+{
+  AttitudeEkf ekf;
+  ekf.set_params(default_params(false));
+  excite(ekf);
+  Eigen::Matrix<double, 6, 6> P6 = covariance<6>(ekf);
+
+  ekf.set_params(default_params(true));
+  Eigen::Matrix<double, 9, 9> P9 = covariance<9>(ekf);
+  Eigen::Matrix<double, 6, 6> leading = P9.block<6, 6>(0, 0);
+  EXPECT_TRUE(leading == P6);
+  EXPECT_TRUE((P9.block<6, 3>(0, 6).isZero()));
+  EXPECT_GT(P9(6, 6), 0.0);
+
+  ekf.set_params(default_params(false));
+  EXPECT_TRUE(covariance<6>(ekf) == P6);
+  EXPECT_EQ(ekf.covariance(7, 7), 0.0f);
+}
+
+TEST(AttitudeEkfTest, LongUpdateRunsKeepCovariancePositive)
+{
+  // Alternating long stretches of prediction and of accel updates with no process noise between
+  // them used to round variances below zero and blow the filter up.
+  AttitudeEkf ekf;
+  ekf.set_params(default_params(true));
+  const turbomath::Vector rate(0.1f, 0.2f, -0.3f);
+  const turbomath::Vector accel(0.3f, -0.2f, -9.7f);
+  for (int rep = 0; rep < 4; rep++)
+  {
+    for (int i = 0; i < 100000; i++)
+      ekf.predict(rate, 0.001f);
+    for (int i = 0; i < 100000; i++)
+      ekf.update_accel(accel);
+  }
+  for (uint8_t i = 0; i < AttitudeEkf::NUM_STATES; i++)
+  {
+    EXPECT_GT(ekf.covariance(i, i), 0.0f);
+  }
+  const turbomath::Quaternion q = ekf.attitude();
+  EXPECT_NEAR(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z, 1.0f, 1e-5);
+  EXPECT_LT(ekf.gyro_bias().norm(), 0.5f);
+}
+
+TEST(AttitudeEkfTest, HeadingUpdateCorrectsOnlyHeading)
+{
+  AttitudeEkf ekf;
+  ekf.set_params(default_params(false));
+  turbomath::Quaternion start;
+  start.from_RPY(0.2f, -0.1f, 0.0f);
+  ekf.reset(start, turbomath::Vector());
+
+  const float yaw = 0.3f;
+  for (int i = 0; i < 200; i++)
+  {
+    float roll, pitch, yaw_estimate;
+    ekf.attitude().get_RPY(&roll, &pitch, &yaw_estimate);
+    ekf.update_heading(yaw - yaw_estimate);
+  }
+
+  float roll, pitch, yaw_estimate;
+  ekf.attitude().get_RPY(&roll, &pitch, &yaw_estimate);
+  EXPECT_NEAR(roll, 0.2f, 1e-4);
+  EXPECT_NEAR(pitch, -0.1f, 1e-4);
+  EXPECT_NEAR(yaw_estimate, yaw, 1e-3);
+  // the variance about the vertical shrinks, the tilt variance doesn't
+  const turbomath::Vector down = ekf.attitude().rotate(turbomath::Vector(0.0f, 0.0f, 1.0f));
+  const Eigen::Vector3d v(down.x, down.y, down.z);
+  const Eigen::Matrix3d P = covariance<6>(ekf).block<3, 3>(0, 0);
+  EXPECT_LT(v.dot(P * v), 1e-4);
+  EXPECT_GT(ekf.covariance(0, 0), 0.2f);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <turbomath/turbomath.h>
+
+#include "attitude_history.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+// Attitude of a vehicle yawing at 1 rad/s
+turbomath::Quaternion yawed(uint64_t time_us)
+{
+  return turbomath::Quaternion(0.0f, 0.0f, static_cast<float>(time_us)*1e-6f);
+}
+} // namespace
+
+TEST(AttitudeHistoryTest, InterpolatesBetweenEntries)
+{
+  AttitudeHistory history;
+  for (uint64_t t = 0; t <= 100000; t += 1000)
+    history.record(t, yawed(t));
+
+  turbomath::Quaternion q;
+  for (uint64_t t = 0; t <= 100000; t += 700)
+  {
+    ASSERT_TRUE(history.lookup(t, &q)) << t;
+    float roll, pitch, yaw;
+    q.get_RPY(&roll, &pitch, &yaw);
+    EXPECT_NEAR(yaw, static_cast<float>(t)*1e-6f, 1e-4f) << t;
+  }
+
+  // later times get the newest attitude
+  ASSERT_TRUE(history.lookup(200000, &q));
+  float roll, pitch, yaw;
+  q.get_RPY(&roll, &pitch, &yaw);
+  EXPECT_NEAR(yaw, 0.1f, 1e-4f);
+}
+
+TEST(AttitudeHistoryTest, ForgetsTimesOlderThanTheBuffer)
+{
+  AttitudeHistory history;
+  turbomath::Quaternion q;
+  EXPECT_FALSE(history.lookup(0, &q));
+
+  const uint64_t end_us = 1000000;
+  for (uint64_t t = 0; t <= end_us; t += 500)
+    history.record(t, yawed(t));
+  EXPECT_EQ(history.count(), AttitudeHistory::SIZE);
+
+  // the buffer spans a little over (SIZE - 1) periods
+  const uint64_t span_us = (AttitudeHistory::SIZE - 1)*AttitudeHistory::PERIOD_US;
+  EXPECT_TRUE(history.lookup(end_us - span_us, &q));
+  EXPECT_FALSE(history.lookup(end_us - span_us - 2*AttitudeHistory::PERIOD_US, &q));
+
+  history.reset();
+  EXPECT_FALSE(history.lookup(end_us, &q));
+}
+
+TEST(AttitudeHistoryTest, CoversLargestDelayWithMargin)
+{
+  // updates a little slower than the period leave the newest kept entries furthest apart in time
+  for (uint64_t step_us : {500u, 1000u, 2000u, 3000u, AttitudeHistory::PERIOD_US + 1})
+  {
+    SCOPED_TRACE(step_us);
+    AttitudeHistory history;
+    turbomath::Quaternion q;
+    const uint64_t end_us = 1000000;
+    for (uint64_t t = 0; t <= end_us; t += step_us)
+      history.record(t, yawed(t));
+    const uint64_t newest_us = end_us - end_us % step_us;
+    EXPECT_TRUE(history.lookup(newest_us - AttitudeHistory::MAX_DELAY_US - AttitudeHistory::MARGIN_US, &q));
+  }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file bench_timer.h
+ * @brief Wall-clock timing helpers shared by the host-side benchmarks
+ */
+
+#ifndef ROSFLIGHT_FIRMWARE_BENCH_TIMER_H
+#define ROSFLIGHT_FIRMWARE_BENCH_TIMER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace rosflight_firmware
+{
+
+class Stopwatch
+{
+public:
+  void start() { start_ = std::chrono::steady_clock::now(); }
+  uint32_t ns() const
+  {
+    return static_cast<uint32_t>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief Collects nanosecond samples for one stage and prints summary statistics and a
+ * log2-spaced histogram
+ */
+class StageTimer
+{
+public:
+  explicit StageTimer(const char *name) : name_(name)
+  {
+    samples_.reserve(1 << 20);
+  }
+
+  void add(uint32_t ns)
+  {
+    samples_.push_back(ns);
+    sorted_ = false;
+  }
+
+  size_t count() const { return samples_.size(); }
+
+  uint32_t mean()
+  {
+    if (samples_.empty())
+      return 0;
+    uint64_t sum = 0;
+    for (uint32_t s : samples_)
+      sum += s;
+    return static_cast<uint32_t>(sum / samples_.size());
+  }
+
+  uint32_t percentile(double p)
+  {
+    if (samples_.empty())
+      return 0;
+    sort();
+    size_t idx = static_cast<size_t>(p * static_cast<double>(samples_.size() - 1));
+    return samples_[idx];
+  }
+
+  void summary()
+  {
+    if (samples_.empty())
+    {
+      printf("%-24s no samples\n", name_);
+      return;
+    }
+    sort();
+    printf("%-24s n=%-8zu min=%-7u mean=%-7u p50=%-7u p99=%-7u max=%u (ns)\n", name_, samples_.size(),
+           samples_.front(), mean(), percentile(0.50), percentile(0.99), samples_.back());
+  }
+
+  void report()
+  {
+    summary();
+    if (samples_.empty())
+    {
+      printf("\n");
+      return;
+    }
+
+    size_t counts[32] = {};
+    for (uint32_t s : samples_)
+    {
+      int bucket = 0;
+      while (bucket < 31 && (1u << (bucket + 1)) <= s)
+        bucket++;
+      counts[bucket]++;
+    }
+    size_t peak = *std::max_element(counts, counts + 32);
+    for (int i = 0; i < 32; i++)
+    {
+      if (counts[i] == 0)
+        continue;
+      int width = static_cast<int>((50 * counts[i] + peak - 1) / peak);
+      printf("  [%8u, %8u) %8zu |%.*s\n", 1u << i, (i < 31) ? (1u << (i + 1)) : UINT32_MAX, counts[i], width,
+             "##################################################");
+    }
+    printf("\n");
+  }
+
+private:
+  void sort()
+  {
+    if (!sorted_)
+    {
+      std::sort(samples_.begin(), samples_.end());
+      sorted_ = true;
+    }
+  }
+
+  const char *name_;
+  std::vector<uint32_t> samples_;
+  bool sorted_ = false;
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_BENCH_TIMER_H
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <cmath>
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+#include "biquad_filter.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+const double PI = 3.14159265358979;
+const float SAMPLE_HZ = 1000.0f;
+typedef FixedBiquadFilterBank<BiquadFilterBank::MAX_STAGES> FilterBank;
+
+// Steady-state amplitude of the filter's response to a unit sinusoid on axis 0, found by correlating
+// the output with sin and cos over one second (a whole number of periods). The other axes are driven
+// at different frequencies to check that the lanes don't mix.
+float measured_gain(BiquadFilterBank &filter, float freq_hz)
+{
+  float zero[3] = {0.0f, 0.0f, 0.0f};
+  filter.reset(zero);
+  const int settle = 3000;
+  const int n = static_cast<int>(SAMPLE_HZ);
+  double in_phase = 0.0;
+  double quadrature = 0.0;
+  for (int i = 0; i < settle + n; i++)
+  {
+    double phase = 2.0 * PI * freq_hz * i / SAMPLE_HZ;
+    double t = i / static_cast<double>(SAMPLE_HZ);
+    float in[3] = {static_cast<float>(sin(phase)),
+                   static_cast<float>(sin(2.0 * PI * 7.0 * t)),
+                   static_cast<float>(cos(2.0 * PI * 311.0 * t))};
+    float out[3];
+    filter.apply(in, out);
+    if (i >= settle)
+    {
+      in_phase += out[0] * sin(phase);
+      quadrature += out[0] * cos(phase);
+    }
+  }
+  return static_cast<float>(2.0 / n * sqrt(in_phase * in_phase + quadrature * quadrature));
+}
+
+// |H(e^jw)| of a single section
+double analytic_gain(const BiquadFilterBank::Coefficients &c, float freq_hz)
+{
+  double w = 2.0 * PI * freq_hz / SAMPLE_HZ;
+  double num_re = c.b0 + c.b1 * cos(w) + c.b2 * cos(2.0 * w);
+  double num_im = -c.b1 * sin(w) - c.b2 * sin(2.0 * w);
+  double den_re = 1.0 + c.a1 * cos(w) + c.a2 * cos(2.0 * w);
+  double den_im = -c.a1 * sin(w) - c.a2 * sin(2.0 * w);
+  return sqrt((num_re * num_re + num_im * num_im) / (den_re * den_re + den_im * den_im));
+}
+} // namespace
+
+TEST(BiquadFilterTest, LowpassMatchesAnalyticResponse)
+{
+  BiquadFilterBank::Coefficients c = BiquadFilterBank::lowpass(100.0f, SAMPLE_HZ, BiquadFilterBank::butterworth_q(0, 1));
+  FilterBank filter;
+  filter.add_stage(c);
+
+  EXPECT_NEAR(analytic_gain(c, 0.0f), 1.0, 1e-5);
+  EXPECT_NEAR(analytic_gain(c, 100.0f), 1.0 / sqrt(2.0), 1e-3);
+
+  const float freqs[] = {5.0f, 50.0f, 100.0f, 200.0f, 400.0f};
+  for (float f : freqs)
+    EXPECT_NEAR(measured_gain(filter, f), analytic_gain(c, f), 0.01) << f << " Hz";
+}
+
+TEST(BiquadFilterTest, CascadedButterworthIsFourthOrder)
+{
+  FilterBank filter;
+  filter.add_stage(BiquadFilterBank::lowpass(50.0f, SAMPLE_HZ, BiquadFilterBank::butterworth_q(0, 2)));
+  filter.add_stage(BiquadFilterBank::lowpass(50.0f, SAMPLE_HZ, BiquadFilterBank::butterworth_q(1, 2)));
+
+  EXPECT_NEAR(BiquadFilterBank::butterworth_q(0, 2), 0.5412f, 1e-3);
+  EXPECT_NEAR(BiquadFilterBank::butterworth_q(1, 2), 1.3066f, 1e-3);
+
+  // -3 dB at the cutoff, and about 24 dB per octave above it
+  EXPECT_NEAR(measured_gain(filter, 50.0f), 1.0 / sqrt(2.0), 0.01);
+  EXPECT_NEAR(measured_gain(filter, 5.0f), 1.0, 0.01);
+  EXPECT_LT(measured_gain(filter, 200.0f), 0.01f);
+}
+
+TEST(BiquadFilterTest, NotchRemovesCenterFrequency)
+{
+  BiquadFilterBank::Coefficients c = BiquadFilterBank::notch(150.0f, SAMPLE_HZ, 3.0f);
+  FilterBank filter;
+  filter.add_stage(c);
+
+  EXPECT_LT(measured_gain(filter, 150.0f), 0.01f);
+  EXPECT_NEAR(measured_gain(filter, 10.0f), 1.0, 0.01);
+  EXPECT_NEAR(measured_gain(filter, 400.0f), analytic_gain(c, 400.0f), 0.01);
+  // -3 dB at the edges of the center/Q bandwidth
+  float half_bandwidth = 0.5f * 150.0f / 3.0f;
+  EXPECT_NEAR(measured_gain(filter, 150.0f + half_bandwidth), analytic_gain(c, 150.0f + half_bandwidth), 0.01);
+  EXPECT_NEAR(analytic_gain(c, 150.0f + half_bandwidth), 1.0 / sqrt(2.0), 0.05);
+}
+
+TEST(BiquadFilterTest, NotchCenterSetPerAxis)
+{
+  FilterBank filter;
+  uint8_t stage = filter.add_stage(BiquadFilterBank::notch(100.0f, SAMPLE_HZ, 3.0f));
+  filter.set_coefficients(stage, 1, BiquadFilterBank::notch(250.0f, SAMPLE_HZ, 3.0f));
+
+  float zero[3] = {0.0f, 0.0f, 0.0f};
+  filter.reset(zero);
+  float peak[3] = {0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 4000; i++)
+  {
+    float x = static_cast<float>(sin(2.0 * PI * 250.0 * i / SAMPLE_HZ));
+    float in[3] = {x, x, x};
+    float out[3];
+    filter.apply(in, out);
+    for (int axis = 0; axis < 3 && i >= 3000; axis++)
+      peak[axis] = std::max(peak[axis], std::fabs(out[axis]));
+  }
+  EXPECT_GT(peak[0], 0.9f);
+  EXPECT_LT(peak[1], 0.01f);
+  EXPECT_GT(peak[2], 0.9f);
+}
+
+TEST(BiquadFilterTest, ResetStartsAtSteadyState)
+{
+  FilterBank filter;
+  filter.add_stage(BiquadFilterBank::lowpass(80.0f, SAMPLE_HZ, 0.5412f));
+  filter.add_stage(BiquadFilterBank::lowpass(80.0f, SAMPLE_HZ, 1.3066f));
+  filter.add_stage(BiquadFilterBank::notch(200.0f, SAMPLE_HZ, 3.0f));
+
+  float value[3] = {0.5f, -2.0f, 9.8f};
+  filter.reset(value);
+  for (int i = 0; i < 10; i++)
+  {
+    float out[3];
+    filter.apply(value, out);
+    for (int axis = 0; axis < 3; axis++)
+      EXPECT_NEAR(out[axis], value[axis], 1e-4f);
+  }
+}
+
+TEST(BiquadFilterTest, OutOfRangeDesignsPassThrough)
+{
+  FilterBank filter;
+  filter.add_stage(BiquadFilterBank::lowpass(0.0f, SAMPLE_HZ, 0.7071f));
+  filter.add_stage(BiquadFilterBank::notch(600.0f, SAMPLE_HZ, 3.0f));
+  float in[3] = {1.0f, 2.0f, 3.0f};
+  float out[3];
+  filter.apply(in, out);
+  for (int axis = 0; axis < 3; axis++)
+    EXPECT_EQ(out[axis], in[axis]);
+
+  for (int i = 0; i < BiquadFilterBank::MAX_STAGES; i++)
+    filter.add_stage(BiquadFilterBank::passthrough());
+  EXPECT_EQ(filter.num_stages(), BiquadFilterBank::MAX_STAGES);
+}
+
+class EstimatorFilterTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+  uint64_t time_us = 0;
+
+  EstimatorFilterTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+    rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+    rf.params_.set_param_int(PARAM_FILTER_SAMPLE_RATE, static_cast<int32_t>(SAMPLE_HZ));
+  }
+
+  // Peak filtered roll rate over the last quarter of a run with a sinusoidal roll rate
+  float roll_rate_peak(float freq_hz, uint64_t period_us = 1000)
+  {
+    float peak = 0.0f;
+    for (int i = 0; i < 2000; i++)
+    {
+      time_us += period_us;
+      float acc[3] = {0.0f, 0.0f, -9.80665f};
+      float gyro[3] = {static_cast<float>(sin(2.0 * PI * freq_hz * time_us * 1e-6)), 0.0f, 0.0f};
+      board.set_imu(acc, gyro, time_us);
+      board.set_time(time_us);
+      rf.run();
+      if (i >= 1500)
+        peak = std::max(peak, std::fabs(rf.estimator_.gyroLPF().x));
+    }
+    return peak;
+  }
+};
+
+TEST_F(EstimatorFilterTest, NotchParamFiltersGyro)
+{
+  EXPECT_GT(roll_rate_peak(200.0f), 0.5f);
+
+  rf.params_.set_param_float(PARAM_GYRO_NOTCH_CENTER, 200.0f);
+  EXPECT_LT(roll_rate_peak(200.0f), 0.02f);
+  EXPECT_GT(roll_rate_peak(20.0f), 0.9f);
+}
+
+TEST_F(EstimatorFilterTest, FiltersAreDesignedForMeasuredLoopRate)
+{
+  // FILTER_RATE_HZ says 1000 Hz but the loop runs at 500 Hz. Designed for 1000 Hz, the notch would
+  // sit at 50 Hz and leave the 100 Hz vibration through.
+  rf.params_.set_param_float(PARAM_GYRO_NOTCH_CENTER, 100.0f);
+  EXPECT_LT(roll_rate_peak(100.0f, 2000), 0.02f);
+  EXPECT_GT(roll_rate_peak(20.0f, 2000), 0.9f);
+}
+
+TEST_F(EstimatorFilterTest, DynamicNotchTracksCenter)
+{
+  EXPECT_FALSE(rf.estimator_.set_gyro_notch_center(0, 120.0f, 1000.0f));
+
+  rf.params_.set_param_float(PARAM_GYRO_LPF_CUTOFF, 300.0f);
+  rf.params_.set_param_float(PARAM_GYRO_NOTCH_CENTER, 200.0f);
+  EXPECT_GT(roll_rate_peak(120.0f), 0.5f);
+
+  EXPECT_TRUE(rf.estimator_.set_gyro_notch_center(0, 120.0f, 1000.0f));
+  EXPECT_LT(roll_rate_peak(120.0f), 0.02f);
+
+  // a change to an estimator param that isn't a filter param keeps the notch where it was moved
+  rf.params_.set_param_float(PARAM_FILTER_KP_ACC, 1.0f);
+  EXPECT_LT(roll_rate_peak(120.0f), 0.02f);
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+class StreamSchedulerTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+
+  StreamSchedulerTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    board.set_time(0);
+    rf.init();
+
+    rf.params_.set_param_int(PARAM_STREAM_HEARTBEAT_RATE, 1);
+    rf.params_.set_param_int(PARAM_STREAM_STATUS_RATE, 10);
+    rf.params_.set_param_int(PARAM_STREAM_ATTITUDE_RATE, 0);
+    rf.params_.set_param_int(PARAM_STREAM_IMU_RATE, 250);
+    rf.params_.set_param_int(PARAM_STREAM_RC_RAW_RATE, 50);
+    rf.params_.set_param_int(PARAM_STREAM_OUTPUT_RAW_RATE, 0);
+    rf.params_.set_param_int(PARAM_STREAM_LOOP_PROFILE_RATE, 0);
+  }
+
+  // runs the stream scheduler once per millisecond for the given time
+  void run_streams(uint32_t duration_ms)
+  {
+    for (uint32_t i = 0; i < duration_ms; i++)
+    {
+      board.set_time(board.clock_micros() + 1000);
+      rf.comm_manager_.stream();
+    }
+  }
+};
+
+// sizes of the streams used here, as charged by the scheduler
+static const float HEARTBEAT_BYTES = 17.0f;
+static const float STATUS_BYTES = 18.0f;
+static const float IMU_BYTES = 44.0f;
+static const float RC_RAW_BYTES = 50.0f;
+
+TEST_F(StreamSchedulerTest, FastLinkSendsEverything)
+{
+  rf.params_.set_param_int(PARAM_BAUD_RATE, 921600);
+  run_streams(3000);
+
+  CommManager::StreamStats imu = rf.comm_manager_.stream_stats(CommManager::STREAM_ID_IMU);
+  CommManager::StreamStats rc_raw = rf.comm_manager_.stream_stats(CommManager::STREAM_ID_RC_RAW);
+  EXPECT_EQ(imu.requested_rate_hz, 250u);
+  EXPECT_NEAR(imu.achieved_rate_hz, 250.0f, 1.0f);
+  EXPECT_EQ(imu.deferred, 0u);
+  EXPECT_NEAR(rc_raw.achieved_rate_hz, 50.0f, 1.0f);
+  EXPECT_EQ(rc_raw.deferred, 0u);
+  EXPECT_LE(rf.comm_manager_.link_load_bytes_per_s(), rf.comm_manager_.link_capacity_bytes_per_s());
+}
+
+TEST_F(StreamSchedulerTest, SlowLinkThrottlesByPriority)
+{
+  // 5760 bytes/s, well short of the ~13.7 kB/s requested
+  rf.params_.set_param_int(PARAM_BAUD_RATE, 57600);
+  EXPECT_EQ(rf.comm_manager_.link_capacity_bytes_per_s(), 5760u);
+  EXPECT_GT(rf.comm_manager_.link_load_bytes_per_s(), rf.comm_manager_.link_capacity_bytes_per_s());
+  run_streams(3000);
+
+  CommManager::StreamStats heartbeat = rf.comm_manager_.stream_stats(CommManager::STREAM_ID_HEARTBEAT);
+  CommManager::StreamStats status = rf.comm_manager_.stream_stats(CommManager::STREAM_ID_STATUS);
+  CommManager::StreamStats imu = rf.comm_manager_.stream_stats(CommManager::STREAM_ID_IMU);
+  CommManager::StreamStats rc_raw = rf.comm_manager_.stream_stats(CommManager::STREAM_ID_RC_RAW);
+
+  // heartbeat and status are never held back
+  EXPECT_NEAR(heartbeat.achieved_rate_hz, 1.0f, 0.01f);
+  EXPECT_NEAR(status.achieved_rate_hz, 10.0f, 0.1f);
+  EXPECT_EQ(heartbeat.deferred, 0u);
+  EXPECT_EQ(status.deferred, 0u);
+
+  // the IMU gets what is left, and the low priority RC stream is starved
+  EXPECT_GT(imu.deferred, 0u);
+  EXPECT_GT(imu.achieved_rate_hz, 100.0f);
+  EXPECT_LT(imu.achieved_rate_hz, 250.0f);
+  EXPECT_GT(rc_raw.deferred, 0u);
+  EXPECT_LT(rc_raw.achieved_rate_hz, 5.0f);
+
+  float bytes_per_s = heartbeat.achieved_rate_hz * HEARTBEAT_BYTES + status.achieved_rate_hz * STATUS_BYTES
+                      + imu.achieved_rate_hz * IMU_BYTES + rc_raw.achieved_rate_hz * RC_RAW_BYTES;
+  EXPECT_LE(bytes_per_s, 5760.0f);
+  EXPECT_GT(bytes_per_s, 0.95f * 5760.0f);
+}
+
+TEST_F(StreamSchedulerTest, RecoversWhenRatesReduced)
+{
+  rf.params_.set_param_int(PARAM_BAUD_RATE, 57600);
+  run_streams(1000);
+  rf.params_.set_param_int(PARAM_STREAM_IMU_RATE, 100);
+  rf.params_.set_param_int(PARAM_STREAM_RC_RAW_RATE, 10);
+  EXPECT_LE(rf.comm_manager_.link_load_bytes_per_s(), rf.comm_manager_.link_capacity_bytes_per_s());
+  run_streams(3000);
+
+  EXPECT_NEAR(rf.comm_manager_.stream_stats(CommManager::STREAM_ID_IMU).achieved_rate_hz, 100.0f, 1.0f);
+  EXPECT_NEAR(rf.comm_manager_.stream_stats(CommManager::STREAM_ID_RC_RAW).achieved_rate_hz, 10.0f, 0.5f);
+}
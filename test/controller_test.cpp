@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+class ControllerTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+  uint64_t time_us = 0;
+
+  ControllerTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+    rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+    rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+  }
+
+  void step(float roll_rate)
+  {
+    time_us += 1000;
+    float acc[3] = {0.0f, 0.0f, -9.80665f};
+    float gyro[3] = {roll_rate, 0.0f, 0.0f};
+    board.set_imu(acc, gyro, time_us);
+    board.set_time(time_us);
+    rf.run();
+  }
+};
+
+TEST_F(ControllerTest, AngleLoopDampedAtGyroRateBetweenAttitudeUpdates)
+{
+  rf.params_.set_param_int(PARAM_ATTITUDE_DIVISOR, 4);
+  for (int i = 0; i < 100; i++)
+    step(0.0f);
+
+  float kd = rf.params_.get_param_float(PARAM_PID_ROLL_ANGLE_D);
+  float prev_rate = 0.0f;
+  float prev_output = rf.controller_.output().x;
+  int held_samples = 0;
+  for (int i = 1; i <= 16; i++)
+  {
+    float rate = 0.02f * ((i % 3) - 1);
+    step(rate);
+    float output = rf.controller_.output().x;
+    if (!rf.estimator_.attitude_updated())
+    {
+      // only the derivative term follows the gyro
+      EXPECT_NEAR(output - prev_output, -kd * (rate - prev_rate), 1e-6f) << "sample " << i;
+      held_samples++;
+    }
+    prev_rate = rate;
+    prev_output = output;
+  }
+  EXPECT_EQ(held_samples, 12);
+}
+
+TEST_F(ControllerTest, DivisorOfOneRunsAngleLoopEverySample)
+{
+  step(0.0f); // starts the estimator clock
+  for (int i = 0; i < 100; i++)
+  {
+    step(0.01f * (i % 5));
+    EXPECT_TRUE(rf.estimator_.attitude_updated());
+  }
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file esc_bench.cpp
+ * @brief Microbenchmark of the digital ESC output path
+ *
+ * Times the per-loop cost of DShot output for eight motors: encoding the frames, expanding them
+ * into the timer compare buffer a DMA driver would send, and Mixer::mix_output with MOTOR_PROTOCOL
+ * set to PWM and to DShot600 on the test board.
+ *
+ * Usage: esc_bench [passes]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "esc_protocol.h"
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "test_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr int NUM_LOOPS = 1024;
+constexpr size_t NUM_MOTORS = 8;
+
+// DShot600 on a 72 MHz timer: 120 ticks per bit
+constexpr uint16_t ONE_TICKS = 90;
+constexpr uint16_t ZERO_TICKS = 45;
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long passes = (argc > 1) ? atol(argv[1]) : 200;
+
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+  rf.state_manager_.clear_error(rf.state_manager_.state().error_codes);
+  rf.params_.set_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, false);
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::OCTO_PLUS);
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+
+  static float throttle[NUM_LOOPS][NUM_MOTORS];
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  for (int i = 0; i < NUM_LOOPS; i++)
+    for (size_t j = 0; j < NUM_MOTORS; j++)
+      throttle[i][j] = distribution(generator);
+
+  StageTimer encode("encode_throttles");
+  StageTimer pulses("  + frame_to_pulses");
+  StageTimer mix_pwm("mix_output, PWM");
+  StageTimer mix_dshot("mix_output, DShot600");
+  Stopwatch timer;
+  uint16_t frames[NUM_MOTORS];
+  uint16_t dma_buffer[NUM_MOTORS][dshot::FRAME_BITS];
+  volatile uint16_t sink = 0;
+
+  for (long pass = 0; pass < passes; pass++)
+  {
+    timer.start();
+    for (int i = 0; i < NUM_LOOPS; i++)
+    {
+      dshot::encode_throttles(throttle[i], NUM_MOTORS, i % NUM_MOTORS, frames);
+      sink = sink + frames[i % NUM_MOTORS];
+    }
+    encode.add(timer.ns() / NUM_LOOPS);
+
+    timer.start();
+    for (int i = 0; i < NUM_LOOPS; i++)
+    {
+      dshot::encode_throttles(throttle[i], NUM_MOTORS, i % NUM_MOTORS, frames);
+      for (size_t j = 0; j < NUM_MOTORS; j++)
+        dshot::frame_to_pulses(frames[j], ONE_TICKS, ZERO_TICKS, dma_buffer[j]);
+      sink = sink + dma_buffer[i % NUM_MOTORS][i % dshot::FRAME_BITS];
+    }
+    pulses.add(timer.ns() / NUM_LOOPS);
+
+    rf.params_.set_param_int(PARAM_MOTOR_PROTOCOL, ESC_PROTOCOL_PWM);
+    timer.start();
+    for (int i = 0; i < NUM_LOOPS; i++)
+      rf.mixer_.mix_output();
+    mix_pwm.add(timer.ns() / NUM_LOOPS);
+
+    rf.params_.set_param_int(PARAM_MOTOR_PROTOCOL, ESC_PROTOCOL_DSHOT600);
+    timer.start();
+    for (int i = 0; i < NUM_LOOPS; i++)
+      rf.mixer_.mix_output();
+    mix_dshot.add(timer.ns() / NUM_LOOPS);
+  }
+
+  printf("ESC output benchmark: %zu motors, %d loops per sample, %ld passes\n\n", NUM_MOTORS, NUM_LOOPS, passes);
+  encode.summary();
+  pulses.summary();
+  mix_pwm.summary();
+  mix_dshot.summary();
+  return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "common.h"
+#include "esc_protocol.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+TEST(DshotTest, EncodesKnownFrame)
+{
+  // 1046 without telemetry is the usual worked example: 0x82C payload, checksum 6
+  EXPECT_EQ(dshot::encode_frame(1046, false), 0x82C6);
+  EXPECT_EQ(dshot::encode_frame(0, false), 0x0000);
+  EXPECT_EQ(dshot::encode_frame(0, true) & 0x0010, 0x0010);
+}
+
+TEST(DshotTest, DecodeRoundTripsAndRejectsCorruptFrames)
+{
+  for (uint16_t value = 0; value <= dshot::THROTTLE_MAX; value++)
+  {
+    for (int telemetry = 0; telemetry < 2; telemetry++)
+    {
+      uint16_t frame = dshot::encode_frame(value, telemetry);
+      uint16_t decoded_value;
+      bool decoded_telemetry;
+      ASSERT_TRUE(dshot::decode_frame(frame, &decoded_value, &decoded_telemetry));
+      ASSERT_EQ(decoded_value, value);
+      ASSERT_EQ(decoded_telemetry, telemetry == 1);
+
+      // any single flipped bit breaks the checksum
+      for (uint8_t bit = 0; bit < dshot::FRAME_BITS; bit++)
+        ASSERT_FALSE(dshot::decode_frame(frame ^ (1 << bit), &decoded_value, &decoded_telemetry));
+    }
+  }
+}
+
+TEST(DshotTest, MapsThrottleAboveCommandRange)
+{
+  EXPECT_EQ(dshot::throttle_value(-0.5f), 0);
+  EXPECT_EQ(dshot::throttle_value(0.0f), 0);
+  EXPECT_EQ(dshot::throttle_value(0.0001f), dshot::THROTTLE_MIN);
+  EXPECT_EQ(dshot::throttle_value(0.5f), 1048);
+  EXPECT_EQ(dshot::throttle_value(1.0f), dshot::THROTTLE_MAX);
+  EXPECT_EQ(dshot::throttle_value(1.5f), dshot::THROTTLE_MAX);
+}
+
+TEST(DshotTest, EncodesThrottlesWithOneTelemetryRequest)
+{
+  float throttle[4] = {0.0f, 0.25f, 0.5f, 1.0f};
+  uint16_t frames[4];
+  dshot::encode_throttles(throttle, 4, 2, frames);
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    uint16_t value;
+    bool telemetry;
+    ASSERT_TRUE(dshot::decode_frame(frames[i], &value, &telemetry));
+    EXPECT_EQ(value, dshot::throttle_value(throttle[i]));
+    EXPECT_EQ(telemetry, i == 2);
+  }
+}
+
+TEST(DshotTest, ExpandsFrameToPulsesMsbFirst)
+{
+  uint16_t pulses[dshot::FRAME_BITS];
+  dshot::frame_to_pulses(0x82C6, 90, 45, pulses);
+  const uint8_t bits[dshot::FRAME_BITS] = {1,0,0,0, 0,0,1,0, 1,1,0,0, 0,1,1,0};
+  for (uint8_t i = 0; i < dshot::FRAME_BITS; i++)
+    EXPECT_EQ(pulses[i], bits[i] ? 90 : 45) << "bit " << static_cast<int>(i);
+
+  EXPECT_EQ(dshot::bit_rate(ESC_PROTOCOL_DSHOT600), 600000u);
+  EXPECT_EQ(dshot::bit_rate(ESC_PROTOCOL_PWM), 0u);
+}
+
+class EscOutputTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+
+  EscOutputTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+    rf.state_manager_.clear_error(rf.state_manager_.state().error_codes);
+    rf.params_.set_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, false);
+    rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+  }
+};
+
+TEST_F(EscOutputTest, SendsMotorFramesTogether)
+{
+  rf.params_.set_param_int(PARAM_MOTOR_PROTOCOL, ESC_PROTOCOL_DSHOT600);
+  ASSERT_TRUE(rf.mixer_.esc_digital());
+  EXPECT_EQ(board.esc_protocol(), ESC_PROTOCOL_DSHOT600);
+  EXPECT_EQ(board.esc_channel_mask(), 0x000F);
+
+  // disarmed motors are stopped
+  uint32_t writes = board.esc_writes();
+  rf.mixer_.mix_output();
+  EXPECT_EQ(board.esc_writes(), writes + 1);
+  for (uint8_t i = 0; i < 4; i++)
+    EXPECT_EQ(board.esc_frame(i), dshot::encode_frame(0, false));
+  // and left out of the PWM batch
+  for (uint8_t i = 0; i < 4; i++)
+    EXPECT_EQ(board.pwm_type(i), Mixer::NONE);
+
+  // armed motors spin at least at idle
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+  ASSERT_TRUE(rf.state_manager_.state().armed);
+  rf.mixer_.mix_output();
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    uint16_t value;
+    bool telemetry;
+    ASSERT_TRUE(dshot::decode_frame(board.esc_frame(i), &value, &telemetry));
+    EXPECT_GE(value, dshot::THROTTLE_MIN);
+    EXPECT_FALSE(telemetry);
+  }
+}
+
+TEST_F(EscOutputTest, RequestsTelemetryFromEachMotorInTurn)
+{
+  rf.params_.set_param_int(PARAM_MOTOR_PROTOCOL, ESC_PROTOCOL_DSHOT300);
+  rf.params_.set_param_int(PARAM_ESC_TELEMETRY, true);
+
+  uint16_t requested = 0;
+  for (int frame = 0; frame < 4; frame++)
+  {
+    rf.mixer_.mix_output();
+    int requests = 0;
+    for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    {
+      uint16_t value;
+      bool telemetry;
+      dshot::decode_frame(board.esc_frame(i), &value, &telemetry);
+      if (telemetry)
+      {
+        requests++;
+        requested |= (1 << i);
+      }
+    }
+    EXPECT_EQ(requests, 1);
+  }
+  EXPECT_EQ(requested, 0x000F);
+}
+
+TEST_F(EscOutputTest, FallsBackToPwmWhenUnsupported)
+{
+  board.set_esc_supported(false);
+  rf.params_.set_param_int(PARAM_MOTOR_PROTOCOL, ESC_PROTOCOL_DSHOT600);
+  EXPECT_FALSE(rf.mixer_.esc_digital());
+
+  uint32_t writes = board.esc_writes();
+  rf.mixer_.mix_output();
+  EXPECT_EQ(board.esc_writes(), writes);
+}
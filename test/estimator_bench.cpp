@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file estimator_bench.cpp
+ * @brief Cost and accuracy of Estimator::run() with the complementary filter and the EKF
+ *
+ * Feeds the estimator a 1 kHz IMU stream from a rotating, otherwise unaccelerated vehicle, so the
+ * accelerometer correction runs on every sample, and times each Estimator::run() call (including
+ * the low-pass filters, which are the same for every mode). Runs the complementary filter, the
+ * 6-state EKF and the 9-state EKF with accel bias, and reports the worst attitude error of each
+ * after the first second.
+ *
+ * Usage: estimator_bench [seconds]
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "test_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr uint64_t PERIOD_US = 1000;
+constexpr float GRAVITY = 9.80665f;
+
+struct Mode
+{
+  const char *name;
+  bool use_ekf;
+  bool accel_bias;
+};
+
+// Runs one mode for the given number of samples and returns the worst attitude error (rad)
+float run_mode(const Mode &mode, long samples, StageTimer &timer)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  board.set_time(0);
+  rf.init();
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, mode.use_ekf);
+  rf.params_.set_param_int(PARAM_EKF_ACCEL_BIAS, mode.accel_bias);
+  rf.params_.set_param_float(PARAM_ACC_ALPHA, 0.0f);
+  rf.params_.set_param_float(PARAM_GYRO_XY_ALPHA, 0.0f);
+  rf.params_.set_param_float(PARAM_GYRO_Z_ALPHA, 0.0f);
+  rf.params_.set_param_int(PARAM_INIT_TIME, 0);
+
+  turbomath::Quaternion truth;
+  Stopwatch stopwatch;
+  float max_error = 0.0f;
+  for (long i = 1; i <= samples; i++)
+  {
+    const float t = i * PERIOD_US * 1e-6f;
+    turbomath::Vector rate(0.8f * sinf(1.3f * t), 0.6f * sinf(0.7f * t), 0.5f * sinf(0.2f * t));
+    truth = turbomath::Quaternion::exp_map(rate, PERIOD_US * 1e-6f) * truth;
+    truth.normalize();
+    turbomath::Vector accel = truth.rotate(turbomath::Vector(0.0f, 0.0f, -GRAVITY));
+
+    float acc[3] = {accel.x, accel.y, accel.z};
+    float gyro[3] = {rate.x, rate.y, rate.z};
+    board.set_imu(acc, gyro, i * PERIOD_US);
+    board.set_time(i * PERIOD_US);
+    rf.sensors_.run();
+
+    stopwatch.start();
+    rf.estimator_.run();
+    timer.add(stopwatch.ns());
+
+    if (i > 1000)
+    {
+      float error = (rf.estimator_.state().attitude - truth).norm();
+      if (error > max_error)
+        max_error = error;
+    }
+  }
+  return max_error;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long seconds = (argc > 1) ? atol(argv[1]) : 60;
+  const long samples = seconds * static_cast<long>(1000000 / PERIOD_US);
+
+  const Mode modes[] = {{"complementary", false, false},
+                        {"EKF, 6 states", true, false},
+                        {"EKF, 9 states", true, true}};
+
+  printf("Estimator benchmark: %ld s at 1 kHz per mode (time per Estimator::run() call)\n\n", seconds);
+  float errors[3];
+  for (int m = 0; m < 3; m++)
+  {
+    StageTimer timer(modes[m].name);
+    errors[m] = run_mode(modes[m], samples, timer);
+    timer.summary();
+  }
+
+  printf("\nworst attitude error after 1 s\n");
+  for (int m = 0; m < 3; m++)
+    printf("%-16s %10.2e rad\n", modes[m].name, errors[m]);
+  return 0;
+}
@@ -5,6 +5,7 @@
 #include "test_board.h"
 #include "eigen3/unsupported/Eigen/MatrixFunctions"
 #include <cmath>
+#include <deque>
 #include <fstream>
 
 // #define DEBUG
@@ -30,10 +31,21 @@ public:
   double x_gyro_bias_;
   double y_gyro_bias_;
   double z_gyro_bias_;
+  double x_acc_bias_;
+  double y_acc_bias_;
+  double z_acc_bias_;
   double t_, dt_;
   int oversampling_factor_;
   int ext_att_update_rate_;
   int ext_att_count_;
+  double ext_att_delay_;      // external attitudes arrive this late
+  bool ext_att_stamped_;      // and are stamped with the time they were taken, not their arrival
+  std::deque<std::pair<double, Quaterniond>> truth_history_;
+  bool simulate_mag_;
+  Vector3d mag_field_;        // world frame
+  Vector3d mag_disturbance_;  // body frame, added between these times
+  double mag_disturbance_start_, mag_disturbance_end_;
+  double settle_time_;        // run() returns the max error after this time
 
   EstimatorTest() :
     mavlink(board),
@@ -62,10 +74,23 @@ public:
     x_gyro_bias_ = 0.0;
     y_gyro_bias_ = 0.0;
     z_gyro_bias_ = 0.0;
+    x_acc_bias_ = 0.0;
+    y_acc_bias_ = 0.0;
+    z_acc_bias_ = 0.0;
     oversampling_factor_ = 10;
 
     ext_att_update_rate_ = 0;
     ext_att_count_ = 0;
+    ext_att_delay_ = 0.0;
+    ext_att_stamped_ = true;
+    truth_history_.clear();
+
+    simulate_mag_ = false;
+    mag_field_ = Vector3d(0.2, 0.0, 0.45);
+    mag_disturbance_.setZero();
+    mag_disturbance_start_ = 0.0;
+    mag_disturbance_end_ = 0.0;
+    settle_time_ = 0.0;
 
     rf.init();
   }
@@ -94,6 +119,7 @@ public:
       }
 
       simulateIMU(acc, gyro);
+      simulateMag();
       extAttUpdate();
       board.set_imu(acc, gyro, t_*1e6);
       board.set_time(t_*1e6);
@@ -105,7 +131,8 @@ public:
       {
         err_norm = std::abs(err_norm - 2.0*M_PI);
       }
-      max_error = (err_norm > max_error) ? err_norm : max_error;
+      if (t_ >= settle_time_)
+        max_error = (err_norm > max_error) ? err_norm : max_error;
     }
     return max_error;
   }
@@ -140,9 +167,9 @@ public:
   void simulateIMU(float* acc, float* gyro)
   {
     Vector3d y_acc  = q_.inverse() * gravity;
-    acc[0] = y_acc.x();
-    acc[1] = y_acc.y();
-    acc[2] = y_acc.z();
+    acc[0] = y_acc.x() + x_acc_bias_;
+    acc[1] = y_acc.y() + y_acc_bias_;
+    acc[2] = y_acc.z() + z_acc_bias_;
 
     // Create gyro measurement
     gyro[0] = x_amp_*sin(x_freq_/(2.0*M_PI)*t_) + x_gyro_bias_;
@@ -150,18 +177,48 @@ public:
     gyro[2] = z_amp_*sin(z_freq_/(2.0*M_PI)*t_) + z_gyro_bias_;
   }
 
+  void simulateMag()
+  {
+    if (!simulate_mag_)
+      return;
+    Vector3d y_mag = q_.inverse() * mag_field_;
+    if (t_ >= mag_disturbance_start_ && t_ < mag_disturbance_end_)
+      y_mag += mag_disturbance_;
+    float mag[3] = {float(y_mag.x()), float(y_mag.y()), float(y_mag.z())};
+    board.set_mag(mag);
+  }
+
+  // Points the simulated field's horizontal part declination rad east of north
+  void setMagDeclination(double declination)
+  {
+    double horizontal = mag_field_.head<2>().norm();
+    mag_field_.x() = horizontal*std::cos(declination);
+    mag_field_.y() = horizontal*std::sin(declination);
+    rf.params_.set_param_float(PARAM_MAG_DECLINATION, declination);
+  }
+
   void extAttUpdate()
   {
-    if (ext_att_update_rate_ && ++ext_att_count_ >= ext_att_update_rate_)
+    if (!ext_att_update_rate_)
+      return;
+
+    // the measurement that arrives now was taken ext_att_delay_ ago
+    truth_history_.emplace_back(t_, q_);
+    while (truth_history_.size() > 1 && truth_history_[1].first <= t_ - ext_att_delay_ + 1e-9)
+      truth_history_.pop_front();
+
+    if (++ext_att_count_ >= ext_att_update_rate_)
     {
       ext_att_count_ = 0;
+      const Quaterniond &q = truth_history_.front().second;
       turbomath::Quaternion q_ext;
-      q_ext.w = q_.w();
-      q_ext.x = q_.x();
-      q_ext.y = q_.y();
-      q_ext.z = q_.z();
+      q_ext.w = q.w();
+      q_ext.x = q.x();
+      q_ext.y = q.y();
+      q_ext.z = q.z();
 
-      rf.estimator_.set_external_attitude_update(q_ext);
+      double stamp = ext_att_stamped_ ? truth_history_.front().first : t_;
+      rf.estimator_.set_external_attitude_update(q_ext, static_cast<uint64_t>(stamp*1e6));
     }
   }
 
@@ -231,6 +288,17 @@ public:
     return std::sqrt(xerr*xerr + yerr*yerr + zerr*zerr);
   }
 
+  // Bias error without the component about gravity, which the accelerometer can't observe (the
+  // complementary filter never corrects z, so on a nearly level vehicle it doesn't have one)
+  double observableBiasError()
+  {
+    Vector3d err(x_gyro_bias_ - rf.estimator_.bias().x,
+                 y_gyro_bias_ - rf.estimator_.bias().y,
+                 z_gyro_bias_ - rf.estimator_.bias().z);
+    Vector3d down = (q_.inverse() * gravity).normalized();
+    return (err - err.dot(down) * down).norm();
+  }
+
   Vector3d getTrueRPY()
   {
     Vector3d rpy;
@@ -531,3 +599,490 @@ TEST_F(EstimatorTest, MovingExtAtt)
  std::cout << "biasError = " << biasError() << std::endl;
 #endif
 }
+
+// Mocap at 100 Hz that arrives 60 ms late while the vehicle rotates. Compared with the estimate at
+// the time it was taken, it agrees with the estimate; compared with the current one it would pull
+// the estimate back along the motion (about 5e-2 rad of error here, against 9e-3 with no delay).
+TEST_F(EstimatorTest, DelayedExtAtt)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAT_EXP, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_INIT_TIME, 0.0f);
+
+  x_freq_ = 2.0;
+  y_freq_ = 3.0;
+  z_freq_ = 0.5;
+  x_amp_ = 0.5;
+  y_amp_ = 0.5;
+  z_amp_ = -0.5;
+
+  tmax_ = 60.0;
+  settle_time_ = 30.0;
+  x_gyro_bias_ = 0.01;
+  y_gyro_bias_ = -0.03;
+  z_gyro_bias_ = 0.01;
+
+  oversampling_factor_ = 1;
+
+  ext_att_update_rate_ = 10;
+  ext_att_delay_ = 0.06;
+
+  double error = run();
+  EXPECT_LE(error, 1.5e-2);
+  EXPECT_LE(biasError(), 3e-2);
+#ifdef DEBUG
+  std::cout << "stateError = " << error << std::endl;
+  std::cout << "biasError = " << biasError() << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, ExtAttOlderThanHistoryIsDropped)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+  rf.params_.set_param_int(PARAM_INIT_TIME, 0.0f);
+
+  turbomath::Quaternion q_tweaked;
+  q_tweaked.from_RPY(0.2, 0.1, 0.0);
+  q_.w() = q_tweaked.w;
+  q_.x() = q_tweaked.x;
+  q_.y() = q_tweaked.y;
+  q_.z() = q_tweaked.z;
+
+  x_amp_ = 0.0;
+  y_amp_ = 0.0;
+  z_amp_ = 0.0;
+  tmax_ = 5.0;
+  oversampling_factor_ = 1;
+
+  ext_att_update_rate_ = 10;
+  ext_att_delay_ = 0.2;
+  run();
+
+  // the estimate never moved from level toward the measurements
+  EXPECT_NEAR(rf.estimator_.state().roll, 0.0f, 1e-3f);
+  EXPECT_NEAR(rf.estimator_.state().pitch, 0.0f, 1e-3f);
+  EXPECT_GT(rf.estimator_.extatt_dropped(), 40u);
+}
+
+TEST_F(EstimatorTest, DividedAttitudeRate)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, false);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAT_EXP, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_ATTITUDE_DIVISOR, 4);
+
+#ifdef DEBUG
+  initFile("dividedAttitude.bin");
+#endif
+  // the error is also measured between attitude updates, when the estimate is up to 3 ms old
+  double error = run();
+  EXPECT_LE(error, 1e-2);
+
+#ifdef DEBUG
+  std::cout << "error = " << error << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, RateUpdatedEverySampleAttitudeEveryNth)
+{
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_ATTITUDE_DIVISOR, 3);
+
+  float acc[3] = {0.0f, 0.0f, -9.80665f};
+  int updates = 0;
+  for (int i = 1; i <= 30; i++)
+  {
+    float gyro[3] = {0.01f * i, 0.0f, 0.0f};
+    board.set_imu(acc, gyro, i * 1000);
+    board.set_time(i * 1000);
+    rf.run();
+    if (i > 1)
+    {
+      EXPECT_FLOAT_EQ(rf.estimator_.state().angular_velocity.x, gyro[0] - rf.estimator_.bias().x);
+    }
+    if (rf.estimator_.attitude_updated())
+      updates++;
+  }
+  // the first sample only starts the clock
+  EXPECT_EQ(updates, 9);
+}
+
+TEST_F(EstimatorTest, MagHeadingDrift)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAG, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAT_EXP, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_INIT_TIME, 0.0f);
+
+  // the estimate starts level and pointing north, the vehicle doesn't
+  turbomath::Quaternion q_tweaked;
+  q_tweaked.from_RPY(0.2, 0.1, 0.8);
+  q_.w() = q_tweaked.w;
+  q_.x() = q_tweaked.x;
+  q_.y() = q_tweaked.y;
+  q_.z() = q_tweaked.z;
+
+  x_freq_ = 2.0;
+  y_freq_ = 3.0;
+  z_freq_ = 0.5;
+  x_amp_ = 0.1;
+  y_amp_ = 0.2;
+  z_amp_ = -0.1;
+
+  tmax_ = 150.0;
+  x_gyro_bias_ = 0.01;
+  y_gyro_bias_ = -0.03;
+  z_gyro_bias_ = 0.02; // heading drift the accelerometer can't see
+
+  oversampling_factor_ = 1;
+
+  simulate_mag_ = true;
+  setMagDeclination(0.2);
+
+#ifdef DEBUG
+  initFile("magHeading.bin");
+#endif
+  run();
+
+  double error = computeError().norm();
+  EXPECT_LE(error, 5e-3);
+  EXPECT_LE(std::abs(eulerError()(2)), 5e-3);
+  EXPECT_LE(biasError(), 2e-3);
+#ifdef DEBUG
+  std::cout << "stateError = " << error << std::endl;
+  std::cout << "biasError = " << biasError() << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, MagRejectsFieldDisturbance)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAG, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAT_EXP, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  x_freq_ = 2.0;
+  y_freq_ = 3.0;
+  z_freq_ = 0.5;
+  x_amp_ = 0.1;
+  y_amp_ = 0.2;
+  z_amp_ = -0.1;
+
+  tmax_ = 40.0;
+  oversampling_factor_ = 1;
+
+  // a field about as strong as the Earth's, e.g. from motor currents, that would turn the heading
+  // by about 1 rad if it were used
+  simulate_mag_ = true;
+  mag_disturbance_ = Vector3d(0.0, 0.3, 0.3);
+  mag_disturbance_start_ = 25.0;
+  mag_disturbance_end_ = 30.0;
+  settle_time_ = 20.0;
+
+#ifdef DEBUG
+  initFile("magDisturbance.bin");
+#endif
+  double error = run();
+  EXPECT_LE(error, 5e-3);
+#ifdef DEBUG
+  std::cout << "error = " << error << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, AltitudeFromTiltedRange)
+{
+  turbomath::Quaternion q_tweaked;
+  q_tweaked.from_RPY(0.2, 0.1, 0.0);
+  q_.w() = q_tweaked.w;
+  q_.x() = q_tweaked.x;
+  q_.y() = q_tweaked.y;
+  q_.z() = q_tweaked.z;
+
+  x_freq_ = 0.0;
+  y_freq_ = 0.0;
+  z_freq_ = 0.0;
+  x_amp_ = 0.0;
+  y_amp_ = 0.0;
+  z_amp_ = 0.0;
+  tmax_ = 10.0;
+  oversampling_factor_ = 1;
+
+  // the range sensor looks along the tilted body z axis
+  const double height = 1.5;
+  const double cos_tilt = 1.0 - 2.0*(q_.x()*q_.x() + q_.y()*q_.y());
+  board.set_sonar(height / cos_tilt);
+
+  EXPECT_FALSE(rf.estimator_.altitude_valid());
+  run();
+
+  EXPECT_TRUE(rf.estimator_.altitude_valid());
+  EXPECT_NEAR(rf.estimator_.state().altitude, height, 1e-2);
+  EXPECT_NEAR(rf.estimator_.state().climb_rate, 0.0, 1e-2);
+}
+
+TEST_F(EstimatorTest, AltitudeFromBaroAfterCalibration)
+{
+  x_amp_ = 0.0;
+  y_amp_ = 0.0;
+  z_amp_ = 0.0;
+  tmax_ = 10.0;
+
+  // the pressure at GROUND_LEVEL, which the baro outlier filter starts from
+  const double ground_level = rf.params_.get_param_float(PARAM_GROUND_LEVEL);
+  board.set_baro(101325.0*std::pow(1.0 - 2.25694e-5*ground_level, 5.2553));
+  run();
+
+  // the baro calibrates to read zero at the ground
+  EXPECT_TRUE(rf.sensors_.baro_calibration_complete());
+  EXPECT_TRUE(rf.estimator_.altitude_valid());
+  EXPECT_NEAR(rf.estimator_.state().altitude, 0.0, 0.1);
+  EXPECT_NEAR(rf.estimator_.state().climb_rate, 0.0, 0.05);
+}
+
+TEST_F(EstimatorTest, EkfGyro)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  // no corrections, so this is the same propagation as MatrixExpQuadInt
+  double error = run();
+  EXPECT_LE(error, 2e-3);
+
+#ifdef DEBUG
+  std::cout << "error = " << error << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, EkfAccel)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  double error = run();
+  EXPECT_LE(error, 2e-3);
+
+#ifdef DEBUG
+  std::cout << "error = " << error << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, EkfEstimateBiasAccel)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  turbomath::Quaternion q_tweaked;
+  q_tweaked.from_RPY(0.2, 0.1, 0.0);
+  q_.w() = q_tweaked.w;
+  q_.x() = q_tweaked.x;
+  q_.y() = q_tweaked.y;
+  q_.z() = q_tweaked.z;
+
+  x_freq_ = 0.0;
+  y_freq_ = 0.0;
+  z_freq_ = 0.0;
+  x_amp_ = 0.0;
+  y_amp_ = 0.0;
+  z_amp_ = 0.0;
+
+  tmax_ = 150.0;
+  x_gyro_bias_ = 0.01;
+  y_gyro_bias_ = -0.03;
+  z_gyro_bias_ = 0.00;
+
+  oversampling_factor_ = 1;
+
+  run();
+
+  // yaw and the bias about gravity are unobservable
+  double rp_err = eulerError().head<2>().norm();
+  EXPECT_LE(rp_err, 1e-3);
+  EXPECT_LE(observableBiasError(), 1e-3);
+#ifdef DEBUG
+  std::cout << "rp_err = " << rp_err << std::endl;
+  std::cout << "observableBiasError = " << observableBiasError() << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, EkfMovingExtAtt)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  turbomath::Quaternion q_tweaked;
+  q_tweaked.from_RPY(0.2, 0.1, 0.0);
+  q_.w() = q_tweaked.w;
+  q_.x() = q_tweaked.x;
+  q_.y() = q_tweaked.y;
+  q_.z() = q_tweaked.z;
+
+  x_freq_ = 2.0;
+  y_freq_ = 3.0;
+  z_freq_ = 0.5;
+  x_amp_ = 0.1;
+  y_amp_ = 0.2;
+  z_amp_ = -0.1;
+
+  tmax_ = 150.0;
+  x_gyro_bias_ = 0.01;
+  y_gyro_bias_ = -0.03;
+  z_gyro_bias_ = 0.01;
+
+  oversampling_factor_ = 1;
+
+  ext_att_update_rate_ = 3;
+
+  run();
+
+  double error = computeError().norm();
+  EXPECT_LE(error, 1e-4);
+  EXPECT_LE(biasError(), 1e-4);
+#ifdef DEBUG
+  std::cout << "stateError = " << error << std::endl;
+  std::cout << "biasError = " << biasError() << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, EkfDelayedExtAtt)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  x_freq_ = 2.0;
+  y_freq_ = 3.0;
+  z_freq_ = 0.5;
+  x_amp_ = 0.5;
+  y_amp_ = 0.5;
+  z_amp_ = -0.5;
+
+  tmax_ = 60.0;
+  settle_time_ = 30.0;
+  x_gyro_bias_ = 0.01;
+  y_gyro_bias_ = -0.03;
+  z_gyro_bias_ = 0.01;
+
+  oversampling_factor_ = 1;
+
+  ext_att_update_rate_ = 10;
+  ext_att_delay_ = 0.06;
+
+  double error = run();
+  EXPECT_LE(error, 1e-3);
+  EXPECT_LE(biasError(), 1e-3);
+#ifdef DEBUG
+  std::cout << "stateError = " << error << std::endl;
+  std::cout << "biasError = " << biasError() << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, EkfAccelBias)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_EKF_ACCEL_BIAS, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  x_acc_bias_ = 0.2;
+  y_acc_bias_ = -0.15;
+  z_acc_bias_ = 0.1;
+  tmax_ = 60.0;
+
+  // the rotations make the accel bias distinguishable from tilt
+  run();
+  double error = computeError().norm();
+  EXPECT_LE(error, 1e-3);
+  const turbomath::Vector &acc_bias = rf.estimator_.ekf().accel_bias();
+  EXPECT_NEAR(acc_bias.x, x_acc_bias_, 5e-3);
+  EXPECT_NEAR(acc_bias.y, y_acc_bias_, 5e-3);
+  EXPECT_NEAR(acc_bias.z, z_acc_bias_, 5e-3);
+#ifdef DEBUG
+  std::cout << "error = " << error << std::endl;
+#endif
+}
+
+TEST_F(EstimatorTest, EkfMagHeadingDrift)
+{
+  rf.params_.set_param_int(PARAM_FILTER_USE_EKF, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_ACC, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_MAG, true);
+  rf.params_.set_param_int(PARAM_FILTER_USE_QUAD_INT, true);
+  rf.params_.set_param_int(PARAM_ACC_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_XY_ALPHA, 0);
+  rf.params_.set_param_int(PARAM_GYRO_Z_ALPHA, 0);
+
+  turbomath::Quaternion q_tweaked;
+  q_tweaked.from_RPY(0.2, 0.1, 0.8);
+  q_.w() = q_tweaked.w;
+  q_.x() = q_tweaked.x;
+  q_.y() = q_tweaked.y;
+  q_.z() = q_tweaked.z;
+
+  x_freq_ = 2.0;
+  y_freq_ = 3.0;
+  z_freq_ = 0.5;
+  x_amp_ = 0.1;
+  y_amp_ = 0.2;
+  z_amp_ = -0.1;
+
+  tmax_ = 60.0;
+  x_gyro_bias_ = 0.01;
+  y_gyro_bias_ = -0.03;
+  z_gyro_bias_ = 0.02;
+
+  oversampling_factor_ = 1;
+
+  simulate_mag_ = true;
+  setMagDeclination(-0.3);
+
+#ifdef DEBUG
+  initFile("ekfMagHeading.bin");
+#endif
+  run();
+
+  double error = computeError().norm();
+  EXPECT_LE(error, 5e-3);
+  EXPECT_LE(std::abs(eulerError()(2)), 5e-3);
+  EXPECT_LE(biasError(), 2e-3);
+#ifdef DEBUG
+  std::cout << "stateError = " << error << std::endl;
+  std::cout << "biasError = " << biasError() << std::endl;
+#endif
+}
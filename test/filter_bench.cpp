@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file filter_bench.cpp
+ * @brief Microbenchmark of the estimator's gyro filters
+ *
+ * Times one three-axis gyro sample through the single-pole alpha filter and through biquad banks of
+ * one, three (4th-order low-pass and a notch) and four stages, plus the cost of redesigning one
+ * axis of a notch, which is what a frequency tracker pays per update.
+ *
+ * Usage: filter_bench [passes]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "biquad_filter.h"
+
+#include "bench_timer.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr int NUM_SAMPLES = 4096;
+constexpr float SAMPLE_HZ = 1000.0f;
+
+void make_bank(BiquadFilterBank &bank, uint8_t num_stages)
+{
+  const uint8_t num_lowpass = (num_stages >= 3) ? 2 : 1;
+  for (uint8_t i = 0; i < num_lowpass; i++)
+    bank.add_stage(BiquadFilterBank::lowpass(100.0f, SAMPLE_HZ, BiquadFilterBank::butterworth_q(i, num_lowpass)));
+  for (uint8_t i = num_lowpass; i < num_stages; i++)
+    bank.add_stage(BiquadFilterBank::notch(150.0f + 50.0f * i, SAMPLE_HZ, 3.0f));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long passes = (argc > 1) ? atol(argv[1]) : 500;
+
+  static float gyro[NUM_SAMPLES][3];
+  std::mt19937 generator(1);
+  std::normal_distribution<float> distribution(0.0f, 1.0f);
+  for (int i = 0; i < NUM_SAMPLES; i++)
+    for (int j = 0; j < 3; j++)
+      gyro[i][j] = distribution(generator);
+
+  FixedBiquadFilterBank<1> one_stage;
+  FixedBiquadFilterBank<3> three_stages;
+  FixedBiquadFilterBank<4> four_stages;
+  make_bank(one_stage, 1);
+  make_bank(three_stages, 3);
+  make_bank(four_stages, 4);
+
+  StageTimer alpha_timer("alpha LPF");
+  StageTimer one_timer("biquad, 1 stage");
+  StageTimer three_timer("biquad, 3 stages");
+  StageTimer four_timer("biquad, 4 stages");
+  StageTimer notch_timer("notch redesign, 1 axis");
+  Stopwatch timer;
+  float out[3] = {0.0f, 0.0f, 0.0f};
+  volatile float sink = 0.0f;
+
+  for (long pass = 0; pass < passes; pass++)
+  {
+    // same arithmetic as Estimator::run_alpha_LPF_gyro()
+    const float alpha_xy = 0.3f;
+    const float alpha_z = 0.3f;
+    timer.start();
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+      out[0] = (1.0f - alpha_xy) * gyro[i][0] + alpha_xy * out[0];
+      out[1] = (1.0f - alpha_xy) * gyro[i][1] + alpha_xy * out[1];
+      out[2] = (1.0f - alpha_z) * gyro[i][2] + alpha_z * out[2];
+      sink = out[i % 3];
+    }
+    alpha_timer.add(timer.ns() / NUM_SAMPLES);
+
+    timer.start();
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+      one_stage.apply(gyro[i], out);
+      sink = out[i % 3];
+    }
+    one_timer.add(timer.ns() / NUM_SAMPLES);
+
+    timer.start();
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+      three_stages.apply(gyro[i], out);
+      sink = out[i % 3];
+    }
+    three_timer.add(timer.ns() / NUM_SAMPLES);
+
+    timer.start();
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+      four_stages.apply(gyro[i], out);
+      sink = out[i % 3];
+    }
+    four_timer.add(timer.ns() / NUM_SAMPLES);
+
+    timer.start();
+    for (int i = 0; i < NUM_SAMPLES; i++)
+      three_stages.set_coefficients(2, static_cast<uint8_t>(i % 3),
+                                    BiquadFilterBank::notch(100.0f + 0.05f * i, SAMPLE_HZ, 3.0f));
+    notch_timer.add(timer.ns() / NUM_SAMPLES);
+  }
+  (void) sink;
+
+  printf("Gyro filter benchmark: %d samples per measurement, %ld passes\n\n", NUM_SAMPLES, passes);
+  alpha_timer.summary();
+  one_timer.summary();
+  three_timer.summary();
+  four_timer.summary();
+  notch_timer.summary();
+  return 0;
+}
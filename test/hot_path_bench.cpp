@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file hot_path_bench.cpp
+ * @brief Microbenchmark of the per-IMU-sample stages of the main loop
+ *
+ * Feeds a new SILBoard IMU sample on every iteration and times Sensors::run,
+ * Estimator::run, Controller::run and Mixer::mix_output individually.
+ *
+ * Usage: hot_path_bench [iterations]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "sil_board.h"
+
+using namespace rosflight_firmware;
+
+int main(int argc, char **argv)
+{
+  long iterations = (argc > 1) ? atol(argv[1]) : 200000;
+
+  SILBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  board.init_board();
+  rf.init();
+
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+  rf.params_.set_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, false);
+  rf.params_.set_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE, true);
+  rf.params_.set_param_float(PARAM_ACC_Z_BIAS, 0.01f);
+  rf.state_manager_.clear_error(StateManager::ERROR_UNCALIBRATED_IMU);
+
+  // settle, arm and apply hover throttle
+  for (int i = 0; i < 5000; i++)
+  {
+    board.advance_time(1000);
+    rf.run();
+  }
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+  uint16_t hover[8] = {1500, 1500, 1500, 1500, 1000, 1000, 1000, 1000};
+  board.set_rc(hover);
+  for (int i = 0; i < 100; i++)
+  {
+    board.advance_time(1000);
+    rf.run();
+  }
+
+  StageTimer sensors("Sensors::run");
+  StageTimer estimator("Estimator::run");
+  StageTimer controller("Controller::run");
+  StageTimer mixer("Mixer::mix_output");
+  Stopwatch stage;
+
+  board.set_imu_period_us(1000);
+  for (long i = 0; i < iterations; i++)
+  {
+    board.advance_time(1000);
+
+    stage.start();
+    rf.sensors_.run();
+    sensors.add(stage.ns());
+
+    stage.start();
+    rf.estimator_.run();
+    estimator.add(stage.ns());
+
+    stage.start();
+    rf.controller_.run();
+    controller.add(stage.ns());
+
+    stage.start();
+    rf.mixer_.mix_output();
+    mixer.add(stage.ns());
+
+    // keep RC and the state machine alive
+    rf.rc_.run();
+    rf.command_manager_.run();
+  }
+
+  printf("hot path benchmark: %ld IMU samples, armed: %s\n\n", iterations,
+         rf.state_manager_.state().armed ? "yes" : "no");
+  sensors.summary();
+  estimator.summary();
+  controller.summary();
+  mixer.summary();
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file imu_bench.cpp
+ * @brief Cost of oversampling the IMU, one sample per loop against FIFO batches
+ *
+ * Runs the control loop on a SILBoard with the IMU at 8 kHz, first reading one sample per loop
+ * (the loop runs at the IMU rate) and then reading the IMU FIFO once per 1 kHz loop. Both are
+ * reported as time per IMU sample, for Sensors::run alone and for the control loop (sensors
+ * through mixer).
+ *
+ * Usage: imu_bench [duration_s]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "sil_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr uint32_t IMU_PERIOD_US = 125; // 8 kHz
+constexpr uint32_t FIFO_LOOP_PERIOD_US = 1000;
+constexpr uint32_t SETTLE_TIME_US = 1000000;
+
+void run(bool fifo, double duration_s)
+{
+  SILBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  board.init_board();
+  board.set_imu_period_us(IMU_PERIOD_US);
+  board.set_imu_fifo(fifo);
+  rf.init();
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+
+  uint32_t loop_period_us = fifo ? FIFO_LOOP_PERIOD_US : IMU_PERIOD_US;
+  uint64_t settle_end_us = board.clock_micros() + SETTLE_TIME_US;
+  while (board.clock_micros() < settle_end_us)
+  {
+    board.advance_time(loop_period_us);
+    rf.run();
+  }
+
+  StageTimer sensors(fifo ? "Sensors::run, FIFO" : "Sensors::run, 1/loop");
+  StageTimer control(fifo ? "control loop, FIFO" : "control loop, 1/loop");
+  Stopwatch stage;
+  Stopwatch loop;
+  uint64_t end_us = board.clock_micros() + static_cast<uint64_t>(duration_s * 1e6);
+  while (board.clock_micros() < end_us)
+  {
+    board.advance_time(loop_period_us);
+    uint32_t samples_before = board.imu_samples();
+
+    loop.start();
+    stage.start();
+    bool got_imu = rf.sensors_.run();
+    uint32_t sensors_ns = stage.ns();
+    if (got_imu)
+    {
+      rf.estimator_.run();
+      rf.controller_.run();
+      rf.mixer_.mix_output();
+    }
+    uint32_t loop_ns = loop.ns();
+
+    uint32_t samples = board.imu_samples() - samples_before;
+    if (samples > 0)
+    {
+      sensors.add(sensors_ns / samples);
+      control.add(loop_ns / samples);
+    }
+
+    rf.comm_manager_.stream();
+    rf.state_manager_.run();
+  }
+
+  sensors.summary();
+  control.summary();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  double duration_s = (argc > 1) ? atof(argv[1]) : 10.0;
+
+  printf("IMU oversampling benchmark: %u Hz IMU, %.1f s virtual time, times per IMU sample\n\n",
+         1000000 / IMU_PERIOD_US, duration_s);
+  run(false, duration_s);
+  run(true, duration_s);
+  return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file mavlink_rx_bench.cpp
+ * @brief Receive-path benchmark: replays a MAVLink byte stream through Mavlink::receive
+ *
+ * The stream is either read from a raw capture file or synthesized as a mix of heartbeat,
+ * timesync, PARAM_SET and PARAM_REQUEST_READ messages. It is fed to the parser through
+ * SILBoard::serial_read_bulk, and decoded messages are counted by a listener that does
+ * nothing else, so the numbers reflect reading and parsing only.
+ *
+ * Usage: mavlink_rx_bench [passes] [capture_file]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "mavlink.h"
+
+#include "bench_timer.h"
+#include "sil_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+class CountingListener : public CommLinkInterface::ListenerInterface
+{
+public:
+  void param_request_list_callback(uint8_t) override { count++; }
+  void param_request_read_callback(uint8_t, const char *const, int16_t) override { count++; }
+  void param_set_int_callback(uint8_t, const char *const, int32_t) override { count++; }
+  void param_set_float_callback(uint8_t, const char *const, float) override { count++; }
+  void command_callback(CommLinkInterface::Command) override { count++; }
+  void norobo_command_callback(const CommLinkInterface::NoroboCustomCommand &) override { count++; }
+  void timesync_callback(int64_t, int64_t) override { count++; }
+  void offboard_control_callback(const CommLinkInterface::OffboardControl &) override { count++; }
+  void aux_command_callback(const CommLinkInterface::AuxCommand &) override { count++; }
+  void external_attitude_callback(const turbomath::Quaternion &) override { count++; }
+  void heartbeat_callback() override { count++; }
+
+  uint64_t count = 0;
+};
+
+void append(std::vector<uint8_t> &stream, const mavlink_message_t &msg)
+{
+  uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+  uint16_t len = mavlink_msg_to_send_buffer(buf, &msg);
+  stream.insert(stream.end(), buf, buf + len);
+}
+
+std::vector<uint8_t> synthesize(size_t num_messages)
+{
+  std::vector<uint8_t> stream;
+  mavlink_message_t msg;
+  for (size_t i = 0; i < num_messages; i++)
+  {
+    switch (i % 4)
+    {
+    case 0:
+      mavlink_msg_heartbeat_pack(1, 1, &msg, MAV_TYPE_QUADROTOR, 0, 0, 0, 0);
+      break;
+    case 1:
+      mavlink_msg_timesync_pack(1, 1, &msg, 0, static_cast<int64_t>(i)*1000);
+      break;
+    case 2:
+      mavlink_msg_param_set_pack(1, 1, &msg, 1, 1, "PID_ROLL_RATE_P", 0.07f, MAV_PARAM_TYPE_REAL32);
+      break;
+    default:
+      mavlink_msg_param_request_read_pack(1, 1, &msg, 1, 1, "MIXER", -1);
+      break;
+    }
+    append(stream, msg);
+  }
+  return stream;
+}
+
+std::vector<uint8_t> load(const char *filename)
+{
+  std::vector<uint8_t> stream;
+  FILE *f = fopen(filename, "rb");
+  if (f == nullptr)
+    return stream;
+  uint8_t buf[4096];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+    stream.insert(stream.end(), buf, buf + len);
+  fclose(f);
+  return stream;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long passes = (argc > 1) ? atol(argv[1]) : 200;
+  std::vector<uint8_t> stream = (argc > 2) ? load(argv[2]) : synthesize(4000);
+  if (stream.empty())
+  {
+    fprintf(stderr, "no data to replay\n");
+    return 1;
+  }
+
+  SILBoard board;
+  Mavlink mavlink(board);
+  CountingListener listener;
+  mavlink.set_listener(&listener);
+  mavlink.init(921600, 0);
+
+  StageTimer pass_timer("replay pass");
+  StageTimer call_timer("Mavlink::receive");
+  Stopwatch pass_watch;
+  Stopwatch call_watch;
+  uint64_t calls = 0;
+
+  for (long pass = 0; pass < passes; pass++)
+  {
+    board.set_serial_rx(stream.data(), stream.size());
+    pass_watch.start();
+    while (board.serial_rx_remaining() > 0)
+    {
+      call_watch.start();
+      mavlink.receive();
+      call_timer.add(call_watch.ns());
+      calls++;
+    }
+    pass_timer.add(pass_watch.ns());
+  }
+
+  double seconds = 1e-9*static_cast<double>(pass_timer.mean())*static_cast<double>(passes);
+  double bytes = static_cast<double>(stream.size())*static_cast<double>(passes);
+  printf("mavlink receive benchmark: %zu bytes per pass, %ld passes\n", stream.size(), passes);
+  printf("  %llu messages decoded, %.0f messages/s, %.1f MB/s\n",
+         static_cast<unsigned long long>(listener.count),
+         static_cast<double>(listener.count)/seconds, 1e-6*bytes/seconds);
+  printf("  %.1f receive() calls per pass, %.0f bytes per call\n\n",
+         static_cast<double>(calls)/static_cast<double>(passes), bytes/static_cast<double>(calls));
+  pass_timer.summary();
+  call_timer.summary();
+  return 0;
+}
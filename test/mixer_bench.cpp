@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file mixer_bench.cpp
+ * @brief Microbenchmark of the mixing kernel against the previous per-output loop
+ *
+ * For every built-in mixer, mixes a fixed set of random commands with the branching loop the
+ * mixer used before (reimplemented here as a reference), with Mixer::mix, and with the airmode
+ * allocation in Mixer::mix_prioritized, and reports the time per mix. Only the mixing and
+ * desaturation are timed, not the output writes. The random commands saturate most of the time;
+ * mix_prioritized is also timed on gentler commands, where few outputs saturate.
+ *
+ * Usage: mixer_bench [passes]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "test_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr int NUM_COMMANDS = 1024;
+
+// the mixing loop as it was before the branch-free kernel
+void reference_mix(const Mixer::mixer_t &mixer, float F, float x, float y, float z,
+                   float outputs[Mixer::NUM_MIXER_OUTPUTS])
+{
+  float max_output = 1.0f;
+  for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+  {
+    if (mixer.output_type[i] != Mixer::NONE)
+    {
+      outputs[i] = (F*mixer.F[i] + x*mixer.x[i] + y*mixer.y[i] + z*mixer.z[i]);
+      if (outputs[i] > max_output)
+        max_output = outputs[i];
+    }
+  }
+
+  float scale_factor = 1.0;
+  if (max_output > 1.0)
+    scale_factor = 1.0/max_output;
+
+  for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    outputs[i] *= scale_factor;
+}
+
+struct Command
+{
+  float F, x, y, z;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long passes = (argc > 1) ? atol(argv[1]) : 200;
+
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+
+  static Command commands[NUM_COMMANDS];
+  static Command gentle_commands[NUM_COMMANDS];
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> throttle(0.0f, 1.5f);
+  std::uniform_real_distribution<float> torque(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> hover_throttle(0.3f, 0.7f);
+  std::uniform_real_distribution<float> small_torque(-0.2f, 0.2f);
+  for (int i = 0; i < NUM_COMMANDS; i++)
+  {
+    commands[i] = {throttle(generator), torque(generator), torque(generator), torque(generator)};
+    gentle_commands[i] = {hover_throttle(generator), small_torque(generator), small_torque(generator),
+                          small_torque(generator)};
+  }
+
+  StageTimer reference("reference loop");
+  StageTimer kernel("Mixer::mix");
+  StageTimer prioritized("mix_prioritized");
+  StageTimer prioritized_gentle("  gentle commands");
+  Stopwatch timer;
+  alignas(16) float outputs[Mixer::NUM_MIXER_OUTPUTS] = {0};
+  volatile float sink = 0.0f;
+
+  for (long pass = 0; pass < passes; pass++)
+  {
+    // multirotor mixers only; ESC calibration and passthrough don't mix
+    for (uint8_t id = Mixer::QUADCOPTER_PLUS; id <= Mixer::TRICOPTER; id++)
+    {
+      const Mixer::mixer_t &mixer = *rf.mixer_.get_mixer(id);
+      Mixer::MixingMatrix matrix;
+      Mixer::load_matrix(mixer, matrix);
+
+      timer.start();
+      for (int i = 0; i < NUM_COMMANDS; i++)
+      {
+        reference_mix(mixer, commands[i].F, commands[i].x, commands[i].y, commands[i].z, outputs);
+        sink = sink + outputs[i % Mixer::NUM_MIXER_OUTPUTS];
+      }
+      reference.add(timer.ns() / NUM_COMMANDS);
+
+      timer.start();
+      for (int i = 0; i < NUM_COMMANDS; i++)
+      {
+        Mixer::mix(matrix, commands[i].F, commands[i].x, commands[i].y, commands[i].z, outputs);
+        sink = sink + outputs[i % Mixer::NUM_MIXER_OUTPUTS];
+      }
+      kernel.add(timer.ns() / NUM_COMMANDS);
+
+      timer.start();
+      for (int i = 0; i < NUM_COMMANDS; i++)
+      {
+        Mixer::mix_prioritized(matrix, commands[i].F, commands[i].x, commands[i].y, commands[i].z, true, outputs);
+        sink = sink + outputs[i % Mixer::NUM_MIXER_OUTPUTS];
+      }
+      prioritized.add(timer.ns() / NUM_COMMANDS);
+
+      timer.start();
+      for (int i = 0; i < NUM_COMMANDS; i++)
+      {
+        const Command &command = gentle_commands[i];
+        Mixer::mix_prioritized(matrix, command.F, command.x, command.y, command.z, true, outputs);
+        sink = sink + outputs[i % Mixer::NUM_MIXER_OUTPUTS];
+      }
+      prioritized_gentle.add(timer.ns() / NUM_COMMANDS);
+    }
+  }
+
+  printf("mixer benchmark: %d commands per sample, %ld passes over %d mixers\n\n",
+         NUM_COMMANDS, passes, Mixer::TRICOPTER - Mixer::QUADCOPTER_PLUS + 1);
+  reference.summary();
+  kernel.summary();
+  prioritized.summary();
+  prioritized_gentle.summary();
+  return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <random>
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+// the mixing loop as it was before the branch-free kernel
+void reference_mix(const Mixer::mixer_t &mixer, float F, float x, float y, float z,
+                   float outputs[Mixer::NUM_MIXER_OUTPUTS])
+{
+  float max_output = 1.0f;
+  for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+  {
+    if (mixer.output_type[i] != Mixer::NONE)
+    {
+      outputs[i] = (F*mixer.F[i] + x*mixer.x[i] + y*mixer.y[i] + z*mixer.z[i]);
+      if (outputs[i] > max_output)
+        max_output = outputs[i];
+    }
+  }
+
+  float scale_factor = 1.0;
+  if (max_output > 1.0)
+    scale_factor = 1.0/max_output;
+
+  for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    outputs[i] *= scale_factor;
+}
+
+} // namespace
+
+class MixerTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+
+  MixerTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+  }
+
+  // compares the kernel against the reference loop on the outputs the mixer uses
+  void expect_equivalent(const Mixer::mixer_t &mixer)
+  {
+    Mixer::MixingMatrix matrix;
+    Mixer::load_matrix(mixer, matrix);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> throttle(0.0f, 1.5f);
+    std::uniform_real_distribution<float> torque(-1.0f, 1.0f);
+    for (int sample = 0; sample < 1000; sample++)
+    {
+      float F = throttle(generator);
+      float x = torque(generator);
+      float y = torque(generator);
+      float z = torque(generator);
+
+      float expected[Mixer::NUM_MIXER_OUTPUTS] = {0};
+      float actual[Mixer::NUM_MIXER_OUTPUTS];
+      reference_mix(mixer, F, x, y, z, expected);
+      Mixer::mix(matrix, F, x, y, z, actual);
+
+      for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+      {
+        if (mixer.output_type[i] != Mixer::NONE)
+          ASSERT_FLOAT_EQ(actual[i], expected[i]) << "output " << static_cast<int>(i) << ", sample " << sample;
+        else
+          ASSERT_EQ(actual[i], 0.0f);
+      }
+    }
+  }
+};
+
+TEST_F(MixerTest, KernelMatchesReferenceForEveryMixer)
+{
+  for (uint8_t id = 0; id < Mixer::NUM_MIXERS; id++)
+  {
+    SCOPED_TRACE(static_cast<int>(id));
+    const Mixer::mixer_t *mixer = rf.mixer_.get_mixer(id);
+    ASSERT_NE(mixer, nullptr);
+    expect_equivalent(*mixer);
+  }
+  EXPECT_EQ(rf.mixer_.get_mixer(Mixer::NUM_MIXERS), nullptr);
+}
+
+TEST_F(MixerTest, CustomMixerLoadsFromParams)
+{
+  // configure the custom mixer as a hex X and check that it mixes identically
+  const Mixer::mixer_t &hex = *rf.mixer_.get_mixer(Mixer::HEX_X);
+  for (uint16_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+  {
+    rf.params_.set_param_int(PARAM_MIXER_CUSTOM_TYPE_0 + i, hex.output_type[i]);
+    rf.params_.set_param_float(PARAM_MIXER_CUSTOM_F_0 + i, hex.F[i]);
+    rf.params_.set_param_float(PARAM_MIXER_CUSTOM_X_0 + i, hex.x[i]);
+    rf.params_.set_param_float(PARAM_MIXER_CUSTOM_Y_0 + i, hex.y[i]);
+    rf.params_.set_param_float(PARAM_MIXER_CUSTOM_Z_0 + i, hex.z[i]);
+  }
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::CUSTOM);
+  EXPECT_FALSE(rf.state_manager_.state().error_codes & StateManager::ERROR_INVALID_MIXER);
+
+  const Mixer::mixer_t &custom = *rf.mixer_.get_mixer(Mixer::CUSTOM);
+  EXPECT_EQ(custom.default_pwm_rate, 490u);
+
+  Mixer::MixingMatrix hex_matrix, custom_matrix;
+  Mixer::load_matrix(hex, hex_matrix);
+  Mixer::load_matrix(custom, custom_matrix);
+  float expected[Mixer::NUM_MIXER_OUTPUTS];
+  float actual[Mixer::NUM_MIXER_OUTPUTS];
+  Mixer::mix(hex_matrix, 0.9f, 0.3f, -0.2f, 0.1f, expected);
+  Mixer::mix(custom_matrix, 0.9f, 0.3f, -0.2f, 0.1f, actual);
+  for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    EXPECT_FLOAT_EQ(actual[i], expected[i]);
+
+  // out of range output types fall back to unused
+  rf.params_.set_param_int(PARAM_MIXER_CUSTOM_TYPE_0, 7);
+  EXPECT_EQ(rf.mixer_.get_mixer(Mixer::CUSTOM)->output_type[0], Mixer::NONE);
+}
+
+TEST_F(MixerTest, CustomOutputTypeChangeReinitializesEscs)
+{
+  rf.params_.set_param_int(PARAM_MOTOR_PROTOCOL, ESC_PROTOCOL_DSHOT600);
+  for (uint16_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    rf.params_.set_param_int(PARAM_MIXER_CUSTOM_TYPE_0 + i, i < 4 ? Mixer::M : Mixer::NONE);
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::CUSTOM);
+  EXPECT_EQ(board.esc_channel_mask(), 0x000F);
+
+  // turning another output into a motor has to reach the ESC driver without a PARAM_MIXER change
+  rf.params_.set_param_int(PARAM_MIXER_CUSTOM_TYPE_5, Mixer::M);
+  EXPECT_EQ(board.esc_channel_mask(), 0x002F);
+  rf.params_.set_param_int(PARAM_MIXER_CUSTOM_TYPE_0, Mixer::S);
+  EXPECT_EQ(board.esc_channel_mask(), 0x002E);
+}
+
+TEST_F(MixerTest, BatchedCustomMixerUploadInitializesOutputsOnce)
+{
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::CUSTOM);
+  const Mixer::mixer_t &hex = *rf.mixer_.get_mixer(Mixer::HEX_X);
+
+  uint32_t inits = board.pwm_inits();
+  rf.params_.begin_batch();
+  for (uint16_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+  {
+    rf.params_.stage_param_int(PARAM_MIXER_CUSTOM_TYPE_0 + i, hex.output_type[i]);
+    rf.params_.stage_param_float(PARAM_MIXER_CUSTOM_F_0 + i, hex.F[i]);
+    rf.params_.stage_param_float(PARAM_MIXER_CUSTOM_X_0 + i, hex.x[i]);
+    rf.params_.stage_param_float(PARAM_MIXER_CUSTOM_Y_0 + i, hex.y[i]);
+    rf.params_.stage_param_float(PARAM_MIXER_CUSTOM_Z_0 + i, hex.z[i]);
+  }
+  rf.params_.stage_param_int(PARAM_MOTOR_PWM_SEND_RATE, 400);
+  rf.params_.commit_batch();
+  EXPECT_EQ(board.pwm_inits(), inits + 1);
+  EXPECT_EQ(rf.mixer_.get_mixer(Mixer::CUSTOM)->output_type[5], Mixer::M);
+
+  // reloading every param goes through the same path
+  inits = board.pwm_inits();
+  rf.params_.change_callback_all();
+  EXPECT_EQ(board.pwm_inits(), inits + 1);
+}
+
+TEST_F(MixerTest, SaturationScalesUniformly)
+{
+  Mixer::MixingMatrix matrix;
+  Mixer::load_matrix(*rf.mixer_.get_mixer(Mixer::QUADCOPTER_X), matrix);
+
+  float outputs[Mixer::NUM_MIXER_OUTPUTS];
+  Mixer::mix(matrix, 1.0f, 0.5f, 0.0f, 0.0f, outputs);
+  // roll right: 0.5 on the left motors, 1.5 on the right, scaled by 1/1.5
+  EXPECT_FLOAT_EQ(outputs[0], 0.5f/1.5f);
+  EXPECT_FLOAT_EQ(outputs[2], 1.0f);
+  for (uint8_t i = 4; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    EXPECT_EQ(outputs[i], 0.0f);
+}
+
+TEST_F(MixerTest, WritesAllOutputsInOneBatch)
+{
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+  Mixer::aux_command_t aux = {};
+  aux.channel[9].type = Mixer::S;
+  aux.channel[9].value = 2.0f;
+  aux.channel[10].type = Mixer::S;
+  aux.channel[10].value = -0.5f;
+  rf.mixer_.set_new_aux_command(aux);
+
+  uint32_t batches = board.pwm_batches();
+  rf.mixer_.mix_output();
+  EXPECT_EQ(board.pwm_batches(), batches + 1);
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    EXPECT_EQ(board.pwm_type(i), Mixer::M);
+    EXPECT_EQ(board.pwm_value(i), 0.0f); // disarmed
+  }
+  for (uint8_t i = 4; i < 9; i++)
+    EXPECT_EQ(board.pwm_type(i), Mixer::NONE);
+  EXPECT_EQ(board.pwm_type(9), Mixer::S);
+  EXPECT_FLOAT_EQ(board.pwm_value(9), 1.0f);
+  EXPECT_FLOAT_EQ(board.pwm_value(10), 0.25f);
+
+  // armed motors stay between idle and full throttle
+  rf.state_manager_.clear_error(rf.state_manager_.state().error_codes);
+  rf.params_.set_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, false);
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+  ASSERT_TRUE(rf.state_manager_.state().armed);
+  rf.mixer_.mix_output();
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    EXPECT_GE(board.pwm_value(i), rf.params_.get_param_float(PARAM_MOTOR_IDLE_THROTTLE));
+    EXPECT_LE(board.pwm_value(i), 1.0f);
+  }
+}
+
+class MixerPriorityTest : public MixerTest
+{
+public:
+  Mixer::MixingMatrix hex;
+  float outputs[Mixer::NUM_MIXER_OUTPUTS];
+
+  void SetUp() override
+  {
+    MixerTest::SetUp();
+    Mixer::load_matrix(*rf.mixer_.get_mixer(Mixer::HEX_X), hex);
+  }
+
+  void expect_in_range()
+  {
+    for (uint8_t i = 0; i < 6; i++)
+    {
+      EXPECT_GE(outputs[i], -1e-6f) << "output " << static_cast<int>(i);
+      EXPECT_LE(outputs[i], 1.0f + 1e-6f) << "output " << static_cast<int>(i);
+    }
+  }
+};
+
+TEST_F(MixerPriorityTest, UnsaturatedMatchesPlainMix)
+{
+  float expected[Mixer::NUM_MIXER_OUTPUTS];
+  Mixer::mix(hex, 0.5f, 0.1f, -0.1f, 0.05f, expected);
+  Mixer::mix_prioritized(hex, 0.5f, 0.1f, -0.1f, 0.05f, false, outputs);
+  for (uint8_t i = 0; i < Mixer::NUM_MIXER_OUTPUTS; i++)
+    EXPECT_FLOAT_EQ(outputs[i], expected[i]);
+}
+
+TEST_F(MixerPriorityTest, ThrustGivesWayToRoll)
+{
+  // hex X roll gains are -0.5, -1, -0.5, 0.5, 1, 0.5
+  Mixer::mix_prioritized(hex, 0.95f, 0.4f, 0.0f, 0.0f, false, outputs);
+  expect_in_range();
+  EXPECT_NEAR(outputs[4] - outputs[1], 0.8f, 1e-5f);
+  EXPECT_NEAR(outputs[4], 1.0f, 1e-5f);
+
+  // uniform scaling loses roll authority for the same command
+  Mixer::mix(hex, 0.95f, 0.4f, 0.0f, 0.0f, outputs);
+  EXPECT_LT(outputs[4] - outputs[1], 0.6f);
+}
+
+TEST_F(MixerPriorityTest, YawGivesWayBeforeRoll)
+{
+  // roll needs 0.8 of the range, yaw would need another 1.0
+  Mixer::mix_prioritized(hex, 0.5f, 0.4f, 0.0f, 0.5f, false, outputs);
+  expect_in_range();
+
+  // motors 0 and 4 spin the same way, so their difference is roll alone
+  EXPECT_NEAR(outputs[0] - outputs[4], -0.6f, 1e-5f);
+
+  // motors 0 and 1 differ by 0.2 of roll plus the yaw that was kept
+  float yaw_kept = outputs[0] - outputs[1] - 0.2f;
+  EXPECT_GT(yaw_kept, 0.0f);
+  EXPECT_LT(yaw_kept, 0.5f);
+}
+
+TEST_F(MixerPriorityTest, RollPitchScaledOnlyWhenTheyCannotFit)
+{
+  Mixer::mix_prioritized(hex, 0.5f, 2.0f, 0.0f, 1.0f, false, outputs);
+  expect_in_range();
+  EXPECT_NEAR(outputs[4] - outputs[1], 1.0f, 1e-5f);
+  EXPECT_NEAR(outputs[0] - outputs[2], 0.0f, 1e-5f);
+}
+
+TEST_F(MixerPriorityTest, AirmodeRaisesThrust)
+{
+  // at low throttle, priority mode leaves the slow motors below zero rather than adding thrust
+  Mixer::mix_prioritized(hex, 0.05f, 0.2f, 0.0f, 0.0f, false, outputs);
+  EXPECT_LT(outputs[1], 0.0f);
+  EXPECT_NEAR(outputs[4] - outputs[1], 0.4f, 1e-5f);
+
+  // airmode raises thrust until the differential fits
+  Mixer::mix_prioritized(hex, 0.05f, 0.2f, 0.0f, 0.0f, true, outputs);
+  expect_in_range();
+  EXPECT_NEAR(outputs[1], 0.0f, 1e-5f);
+  EXPECT_NEAR(outputs[4] - outputs[1], 0.4f, 1e-5f);
+}
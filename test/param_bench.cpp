@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file param_bench.cpp
+ * @brief Microbenchmark of parameter name lookup during a full-table bulk set
+ *
+ * Mimics a ground station pushing a complete parameter file: every parameter is looked up by name
+ * and set, in table order. Each pass is timed with the previous linear scan (reimplemented here as
+ * a reference), with lookup_param_id, and end-to-end through set_param_by_name_*, which also runs
+ * the change callbacks and queues the PARAM_VALUE reply.
+ *
+ * Usage: param_bench [passes]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "test_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+// the lookup as it was before the sorted name index
+uint16_t linear_lookup(const Params &params, const char name[Params::PARAMS_NAME_LENGTH])
+{
+  for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+  {
+    if (strncmp(name, params.get_param_name(id), Params::PARAMS_NAME_LENGTH) == 0)
+      return id;
+  }
+  return PARAMS_COUNT;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long passes = (argc > 1) ? atol(argv[1]) : 2000;
+
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+
+  // copy the names out so the buffers look like they came off the wire
+  static char names[PARAMS_COUNT][Params::PARAMS_NAME_LENGTH];
+  for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+    strncpy(names[id], rf.params_.get_param_name(id), Params::PARAMS_NAME_LENGTH);
+
+  StageTimer linear("linear scan");
+  StageTimer indexed("lookup_param_id");
+  StageTimer bulk_set("set_param_by_name");
+  Stopwatch timer;
+  uint32_t misses = 0;
+
+  for (long pass = 0; pass < passes; pass++)
+  {
+    timer.start();
+    for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+      misses += (linear_lookup(rf.params_, names[id]) != id);
+    linear.add(timer.ns());
+
+    timer.start();
+    for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+      misses += (rf.params_.lookup_param_id(names[id]) != id);
+    indexed.add(timer.ns());
+
+    // write back the current values so the configuration does not change
+    timer.start();
+    for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+    {
+      if (rf.params_.get_param_type(id) == PARAM_TYPE_FLOAT)
+        rf.params_.set_param_by_name_float(names[id], rf.params_.get_param_float(id));
+      else
+        rf.params_.set_param_by_name_int(names[id], rf.params_.get_param_int(id));
+    }
+    bulk_set.add(timer.ns());
+  }
+
+  printf("parameter bulk set benchmark: %d parameters, %ld passes, %u lookup misses\n\n",
+         static_cast<int>(PARAMS_COUNT), passes, misses);
+  linear.summary();
+  indexed.summary();
+  bulk_set.summary();
+  return 0;
+}
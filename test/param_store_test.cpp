@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include "test_board.h"
+#include "mavlink.h"
+#include "param_store.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+TEST(ParamStore, ValuesSurviveReboot)
+{
+  testBoard board;
+  {
+    Mavlink mavlink(board);
+    ROSflight rf(board, mavlink);
+    rf.init();
+
+    rf.params_.set_param_float(PARAM_PID_ROLL_RATE_P, 0.123f);
+    rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+    EXPECT_TRUE(rf.params_.write());
+  }
+
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+  EXPECT_FLOAT_EQ(rf.params_.get_param_float(PARAM_PID_ROLL_RATE_P), 0.123f);
+  EXPECT_EQ(rf.params_.get_param_int(PARAM_MIXER), Mixer::QUADCOPTER_X);
+  EXPECT_STREQ(rf.params_.get_param_name(PARAM_MIXER), "MIXER");
+}
+
+TEST(ParamStore, SaveAppendsOnlyChangedRecords)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+
+  // nothing changed since the defaults were written at init
+  size_t written = board.flash_bytes_written();
+  EXPECT_TRUE(rf.params_.write());
+  EXPECT_EQ(board.flash_bytes_written(), written);
+
+  rf.params_.set_param_float(PARAM_PID_ROLL_RATE_P, 0.2f);
+  rf.params_.set_param_float(PARAM_PID_PITCH_RATE_P, 0.2f);
+  EXPECT_TRUE(rf.params_.write());
+  EXPECT_EQ(board.flash_bytes_written() - written, 16u); // two 8-byte records
+  EXPECT_EQ(board.flash_erases(0) + board.flash_erases(1), 1u);
+}
+
+TEST(ParamStore, CompactsIntoOtherSectorWhenFull)
+{
+  testBoard board;
+  {
+    Mavlink mavlink(board);
+    ROSflight rf(board, mavlink);
+    rf.init();
+
+    // enough single-value saves to fill a sector several times over
+    for (int i = 0; i < 1000; i++)
+    {
+      rf.params_.set_param_int(PARAM_INIT_TIME, 1000 + i);
+      ASSERT_TRUE(rf.params_.write());
+    }
+    EXPECT_EQ(rf.params_.get_param_int(PARAM_INIT_TIME), 1999);
+  }
+
+  // erases alternate between the sectors
+  EXPECT_GT(board.flash_erases(0), 2u);
+  EXPECT_LE(board.flash_erases(0) - board.flash_erases(1), 1u);
+
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+  EXPECT_EQ(rf.params_.get_param_int(PARAM_INIT_TIME), 1999);
+  EXPECT_FLOAT_EQ(rf.params_.get_param_float(PARAM_MOTOR_IDLE_THROTTLE), 0.1f);
+}
+
+TEST(ParamStore, TornRecordIsSkipped)
+{
+  testBoard board;
+  {
+    Mavlink mavlink(board);
+    ROSflight rf(board, mavlink);
+    rf.init();
+
+    rf.params_.set_param_int(PARAM_INIT_TIME, 2000);
+    EXPECT_TRUE(rf.params_.write());
+
+    // reset halfway through the next record
+    rf.params_.set_param_int(PARAM_INIT_TIME, 3000);
+    board.set_flash_write_limit(4);
+    EXPECT_FALSE(rf.params_.write());
+    board.set_flash_write_limit(SIZE_MAX);
+  }
+
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+  EXPECT_EQ(rf.params_.get_param_int(PARAM_INIT_TIME), 2000);
+
+  // the log stays writable after the torn record
+  rf.params_.set_param_int(PARAM_INIT_TIME, 4000);
+  EXPECT_TRUE(rf.params_.write());
+  ROSflight rf2(board, mavlink);
+  rf2.init();
+  EXPECT_EQ(rf2.params_.get_param_int(PARAM_INIT_TIME), 4000);
+}
+
+TEST(ParamStore, InterruptedCompactionKeepsPreviousSector)
+{
+  testBoard board;
+  ParamStore store(board);
+  static constexpr uint16_t COUNT = 100;
+  int32_t values[COUNT] = {};
+  int32_t persisted[COUNT] = {};
+
+  ASSERT_FALSE(store.open(1, COUNT));
+  ASSERT_TRUE(store.save(1, values, persisted, COUNT));
+  EXPECT_EQ(store.compactions(), 1u);
+
+  // fill the sector with appends
+  int32_t last = 0;
+  while (store.bytes_free() >= 8)
+  {
+    values[7] = ++last;
+    ASSERT_TRUE(store.save(1, values, persisted, COUNT));
+  }
+  EXPECT_EQ(store.compactions(), 1u);
+
+  // the next save has to compact, and is cut off before the new header is written
+  values[7] = ++last;
+  board.set_flash_write_limit(COUNT*8);
+  EXPECT_FALSE(store.save(1, values, persisted, COUNT));
+  board.set_flash_write_limit(SIZE_MAX);
+
+  int32_t replayed[COUNT] = {};
+  ParamStore reopened(board);
+  ASSERT_TRUE(reopened.open(1, COUNT));
+  reopened.replay(replayed, persisted, COUNT);
+  EXPECT_EQ(replayed[7], last - 1);
+
+  // a log written by other firmware is ignored
+  ParamStore other(board);
+  EXPECT_FALSE(other.open(2, COUNT));
+}
+
+TEST(ParamStore, ReadDiscardsUnsavedChanges)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  rf.init();
+
+  rf.params_.set_param_int(PARAM_INIT_TIME, 1234);
+  EXPECT_TRUE(rf.params_.read());
+  EXPECT_EQ(rf.params_.get_param_int(PARAM_INIT_TIME), 3000);
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
 #include <gtest/gtest.h>
 #include "test_board.h"
 #include "mavlink.h"
@@ -5,9 +8,48 @@
 
 using namespace rosflight_firmware;
 
+class CountingListener : public ParamListenerInterface
+{
+public:
+  void param_change_callback(uint16_t param_id) override
+  {
+    single_calls++;
+    last_id = param_id;
+  }
+
+  void param_change_batch_callback(const uint16_t *param_ids, size_t num_ids) override
+  {
+    batch_calls++;
+    batch_ids.assign(param_ids, param_ids + num_ids);
+  }
+
+  int single_calls = 0;
+  int batch_calls = 0;
+  uint16_t last_id = PARAMS_COUNT;
+  std::vector<uint16_t> batch_ids;
+};
+
 #define EXPECT_PARAM_EQ_INT(id, value) EXPECT_EQ(value, rf.params_.get_param_int(id))
 #define EXPECT_PARAM_EQ_FLOAT(id, value) EXPECT_EQ(value, rf.params_.get_param_float(id))
 
+// Records the PARAM_VALUE messages that reach the link
+class ParamValueLink : public Mavlink
+{
+public:
+  explicit ParamValueLink(Board &board) : Mavlink(board) {}
+
+  void send_param_value_int(uint8_t, uint16_t index, const char *const, int32_t, uint16_t) override
+  {
+    sent.push_back(index);
+  }
+  void send_param_value_float(uint8_t, uint16_t index, const char *const, float, uint16_t) override
+  {
+    sent.push_back(index);
+  }
+
+  std::vector<uint16_t> sent;
+};
+
 TEST(Parameters, DefaultParameters)
 {
   testBoard board;
@@ -74,3 +116,223 @@ TEST(Parameters, DefaultParameters)
   EXPECT_PARAM_EQ_INT(PARAM_FC_YAW, 0);
   EXPECT_PARAM_EQ_FLOAT(PARAM_ARM_THRESHOLD, 0.15f);
 }
+
+TEST(Parameters, ChangesReachCachedCalibration)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  rf.init();
+
+  float acc[3] = {0.0f, 0.0f, -9.80665f};
+  float gyro[3] = {0.0f, 0.0f, 0.0f};
+  board.set_imu(acc, gyro, 1000);
+  rf.run();
+  EXPECT_FLOAT_EQ(rf.sensors_.data().accel.x, 0.0f);
+  EXPECT_FLOAT_EQ(rf.sensors_.data().gyro.z, 0.0f);
+
+  // calibration params are cached by the sensors module, so a change must show up on the next sample
+  rf.params_.set_param_float(PARAM_ACC_X_BIAS, 0.5f);
+  rf.params_.set_param_float(PARAM_GYRO_Z_BIAS, 0.25f);
+  board.set_imu(acc, gyro, 2000);
+  rf.run();
+  EXPECT_FLOAT_EQ(rf.sensors_.data().accel.x, -0.5f);
+  EXPECT_FLOAT_EQ(rf.sensors_.data().gyro.z, -0.25f);
+}
+
+TEST(Parameters, LookupParamIdByName)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  rf.init();
+
+  for (uint16_t id = 0; id < PARAMS_COUNT; id++)
+  {
+    EXPECT_EQ(rf.params_.lookup_param_id(rf.params_.get_param_name(id)), id) << rf.params_.get_param_name(id);
+  }
+
+  // names coming off the wire fill all 16 characters and are not terminated when they are that long
+  char name[Params::PARAMS_NAME_LENGTH];
+  memset(name, 'X', sizeof(name));
+  EXPECT_EQ(rf.params_.lookup_param_id(name), PARAMS_COUNT);
+  EXPECT_EQ(rf.params_.lookup_param_id("NOT_A_PARAM"), PARAMS_COUNT);
+  EXPECT_EQ(rf.params_.lookup_param_id(""), PARAMS_COUNT);
+  EXPECT_EQ(rf.params_.lookup_param_id("BAUD_RAT"), PARAMS_COUNT);
+  EXPECT_EQ(rf.params_.lookup_param_id("BAUD_RATE"), PARAM_BAUD_RATE);
+
+  EXPECT_TRUE(rf.params_.set_param_by_name_int("MIXER", Mixer::QUADCOPTER_X));
+  EXPECT_PARAM_EQ_INT(PARAM_MIXER, Mixer::QUADCOPTER_X);
+  EXPECT_FALSE(rf.params_.set_param_by_name_int("NOT_A_PARAM", 1));
+}
+
+TEST(Parameters, BatchDefersListenersUntilCommit)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  rf.init();
+
+  CountingListener listener;
+  ParamListenerInterface *const listeners[] = {&listener};
+  rf.params_.set_listeners(listeners, 1);
+
+  // outside a batch every set notifies immediately
+  EXPECT_TRUE(rf.params_.set_param_float(PARAM_PID_ROLL_RATE_P, 0.5f));
+  EXPECT_EQ(listener.single_calls, 1);
+  EXPECT_EQ(listener.last_id, PARAM_PID_ROLL_RATE_P);
+
+  rf.params_.begin_batch();
+  EXPECT_TRUE(rf.params_.batch_active());
+  EXPECT_TRUE(rf.params_.stage_param_float(PARAM_PID_ROLL_RATE_I, 0.1f));
+  EXPECT_TRUE(rf.params_.stage_param_float(PARAM_PID_PITCH_RATE_P, 0.2f));
+  EXPECT_TRUE(rf.params_.stage_param_float(PARAM_PID_PITCH_RATE_P, 0.3f));
+  EXPECT_TRUE(rf.params_.stage_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X));
+  EXPECT_FALSE(rf.params_.stage_param_float(PARAM_PID_ROLL_RATE_P, 0.5f)); // unchanged
+
+  // values are visible right away, but nobody has been told yet
+  EXPECT_PARAM_EQ_FLOAT(PARAM_PID_PITCH_RATE_P, 0.3f);
+  EXPECT_EQ(listener.single_calls, 1);
+  EXPECT_EQ(listener.batch_calls, 0);
+
+  // the firmware's own writes are never deferred
+  EXPECT_TRUE(rf.params_.set_param_float(PARAM_X_EQ_TORQUE, 0.01f));
+  EXPECT_EQ(listener.single_calls, 2);
+  EXPECT_EQ(listener.last_id, PARAM_X_EQ_TORQUE);
+
+  // nested batches only take effect at the outermost commit
+  rf.params_.begin_batch();
+  rf.params_.commit_batch();
+  EXPECT_EQ(listener.batch_calls, 0);
+
+  rf.params_.commit_batch();
+  EXPECT_FALSE(rf.params_.batch_active());
+  EXPECT_EQ(listener.single_calls, 2);
+  EXPECT_EQ(listener.batch_calls, 1);
+  std::vector<uint16_t> expected = {PARAM_PID_ROLL_RATE_I, PARAM_PID_PITCH_RATE_P, PARAM_MIXER};
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(listener.batch_ids, expected);
+
+  // an empty batch notifies nobody
+  rf.params_.begin_batch();
+  rf.params_.commit_batch();
+  EXPECT_EQ(listener.batch_calls, 1);
+}
+
+TEST(Parameters, BatchFromGroundStationCommands)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  rf.init();
+  uint8_t sysid = static_cast<uint8_t>(rf.params_.get_param_int(PARAM_SYSTEM_ID));
+  CommLinkInterface::ListenerInterface &link = rf.comm_manager_;
+
+  link.command_callback(CommLinkInterface::Command::COMMAND_PARAM_BATCH_BEGIN);
+  link.param_set_float_callback(sysid, "ACC_X_BIAS", 0.5f);
+  link.param_set_float_callback(sysid, "GYRO_Z_BIAS", 0.25f);
+  EXPECT_TRUE(rf.params_.batch_active());
+  EXPECT_PARAM_EQ_FLOAT(PARAM_ACC_X_BIAS, 0.5f);
+
+  // the sensors keep using the old calibration until the batch is committed
+  float acc[3] = {0.0f, 0.0f, -9.80665f};
+  float gyro[3] = {0.0f, 0.0f, 0.0f};
+  board.set_imu(acc, gyro, 1000);
+  rf.run();
+  EXPECT_FLOAT_EQ(rf.sensors_.data().accel.x, 0.0f);
+
+  link.command_callback(CommLinkInterface::Command::COMMAND_PARAM_BATCH_COMMIT);
+  EXPECT_FALSE(rf.params_.batch_active());
+  board.set_imu(acc, gyro, 2000);
+  rf.run();
+  EXPECT_FLOAT_EQ(rf.sensors_.data().accel.x, -0.5f);
+  EXPECT_FLOAT_EQ(rf.sensors_.data().gyro.z, -0.25f);
+
+  // a stray commit does not close anything
+  link.command_callback(CommLinkInterface::Command::COMMAND_PARAM_BATCH_COMMIT);
+  EXPECT_FALSE(rf.params_.batch_active());
+}
+
+TEST(Parameters, OpenBatchBlocksArmingAndTimesOut)
+{
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  rf.init();
+  rf.state_manager_.clear_error(rf.state_manager_.state().error_codes);
+  uint8_t sysid = static_cast<uint8_t>(rf.params_.get_param_int(PARAM_SYSTEM_ID));
+  CommLinkInterface::ListenerInterface &link = rf.comm_manager_;
+  float acc[3] = {0.0f, 0.0f, -9.80665f};
+  float gyro[3] = {0.0f, 0.0f, 0.0f};
+
+  link.command_callback(CommLinkInterface::Command::COMMAND_PARAM_BATCH_BEGIN);
+  link.param_set_float_callback(sysid, "ACC_X_BIAS", 0.5f);
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+  EXPECT_FALSE(rf.state_manager_.state().armed);
+
+  // a write the firmware makes itself while the batch is open takes effect right away
+  rf.params_.set_param_float(PARAM_GYRO_Z_BIAS, 0.25f);
+  board.set_imu(acc, gyro, 500000);
+  rf.run();
+  EXPECT_TRUE(rf.params_.batch_active());
+  EXPECT_FLOAT_EQ(rf.sensors_.data().gyro.z, -0.25f);
+
+  // the ground station went quiet without committing, so the batch is committed for it
+  board.set_imu(acc, gyro, 1100000);
+  rf.run();
+  EXPECT_FALSE(rf.params_.batch_active());
+  board.set_imu(acc, gyro, 1101000);
+  rf.run();
+  EXPECT_FLOAT_EQ(rf.sensors_.data().accel.x, -0.5f);
+
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+  EXPECT_TRUE(rf.state_manager_.state().armed);
+}
+
+TEST(Parameters, FirmwareFloatSetSendsOnlyItsValue)
+{
+  testBoard board;
+  ParamValueLink link(board);
+  ROSflight rf(board, link);
+
+  rf.init();
+  float acc[3] = {0.0f, 0.0f, -9.80665f};
+  float gyro[3] = {0.0f, 0.0f, 0.0f};
+  uint64_t time_us = 0;
+  auto run_for = [&](uint64_t duration_us)
+  {
+    for (uint64_t end_us = time_us + duration_us; time_us < end_us;)
+    {
+      time_us += 1000;
+      board.set_time(time_us);
+      board.set_imu(acc, gyro, time_us);
+      rf.run();
+    }
+  };
+  run_for(100000);
+
+  // a calibration-style write is echoed once and doesn't start the parameter list over
+  link.sent.clear();
+  rf.params_.set_param_float(PARAM_GYRO_Z_BIAS, 0.25f);
+  ASSERT_EQ(link.sent.size(), 1u);
+  EXPECT_EQ(link.sent[0], PARAM_GYRO_Z_BIAS);
+  run_for(2000000);
+  EXPECT_EQ(link.sent.size(), 1u);
+
+  // a list in progress carries on from where it was
+  static_cast<CommLinkInterface::ListenerInterface &>(rf.comm_manager_).param_request_list_callback(
+    static_cast<uint8_t>(rf.params_.get_param_int(PARAM_SYSTEM_ID)));
+  while (link.sent.size() < 11)
+    run_for(1000);
+  link.sent.clear();
+  rf.params_.set_param_float(PARAM_GYRO_X_BIAS, 0.5f);
+  run_for(10000000);
+  std::vector<uint16_t> list(link.sent.begin() + 1, link.sent.end());
+  ASSERT_EQ(list.size(), PARAMS_COUNT - 10u);
+  EXPECT_EQ(list.front(), 10u);
+}
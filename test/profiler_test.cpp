@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+class ProfilerTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+
+  ProfilerTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+    rf.params_.set_param_int(PARAM_LOOP_BUDGET_US, 1000);
+    board.set_time(0);
+    for (int i = 0; i < Profiler::STAGE_COUNT; i++)
+      rf.profiler_.reset(static_cast<Profiler::Stage>(i));
+  }
+
+  // runs one fake main loop in which the sensors and estimator take the given times
+  void fake_loop(uint32_t sensors_us, uint32_t estimator_us)
+  {
+    rf.profiler_.start_loop();
+    board.set_time(board.clock_micros() + sensors_us);
+    rf.profiler_.end_stage(Profiler::STAGE_SENSORS);
+    board.set_time(board.clock_micros() + estimator_us);
+    rf.profiler_.end_stage(Profiler::STAGE_ESTIMATOR);
+    rf.profiler_.end_loop();
+  }
+};
+
+TEST_F(ProfilerTest, MinMaxMean)
+{
+  fake_loop(10, 100);
+  fake_loop(20, 200);
+  fake_loop(30, 300);
+
+  Profiler::Stats sensors = rf.profiler_.stats(Profiler::STAGE_SENSORS);
+  EXPECT_EQ(sensors.count, 3u);
+  EXPECT_FLOAT_EQ(sensors.min_us, 10.0f);
+  EXPECT_FLOAT_EQ(sensors.max_us, 30.0f);
+  EXPECT_FLOAT_EQ(sensors.mean_us, 20.0f);
+
+  Profiler::Stats loop = rf.profiler_.stats(Profiler::STAGE_LOOP);
+  EXPECT_EQ(loop.count, 3u);
+  EXPECT_FLOAT_EQ(loop.min_us, 110.0f);
+  EXPECT_FLOAT_EQ(loop.max_us, 330.0f);
+  EXPECT_EQ(loop.overruns, 0u);
+}
+
+TEST_F(ProfilerTest, Percentile)
+{
+  // a single slow loop out of a thousand should not move the p99
+  for (int i = 0; i < 999; i++)
+    fake_loop(10, 100);
+  fake_loop(10, 5000);
+
+  Profiler::Stats estimator = rf.profiler_.stats(Profiler::STAGE_ESTIMATOR);
+  EXPECT_EQ(estimator.count, 1000u);
+  EXPECT_FLOAT_EQ(estimator.max_us, 5000.0f);
+  // two histogram buckets per octave, so the percentile is within 50% of the true value
+  EXPECT_GE(estimator.p99_us, 100.0f);
+  EXPECT_LT(estimator.p99_us, 150.0f);
+
+  // enough slow samples pull the p99 up
+  for (int i = 0; i < 20; i++)
+    fake_loop(10, 5000);
+  estimator = rf.profiler_.stats(Profiler::STAGE_ESTIMATOR);
+  EXPECT_GT(estimator.p99_us, 4000.0f);
+  EXPECT_LE(estimator.p99_us, 5000.0f);
+}
+
+TEST_F(ProfilerTest, OverrunChargedToStage)
+{
+  // the estimator pushes the loop over budget
+  fake_loop(10, 2000);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_SENSORS).overruns, 0u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_ESTIMATOR).overruns, 1u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_LOOP).overruns, 1u);
+
+  // the sensors push the loop over budget, so the estimator is not charged again
+  fake_loop(1500, 10);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_SENSORS).overruns, 1u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_ESTIMATOR).overruns, 1u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_LOOP).overruns, 2u);
+
+  // raising the budget stops counting overruns
+  rf.params_.set_param_int(PARAM_LOOP_BUDGET_US, 5000);
+  fake_loop(1500, 2000);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_LOOP).overruns, 2u);
+}
+
+TEST_F(ProfilerTest, Reset)
+{
+  fake_loop(10, 2000);
+  rf.profiler_.reset(Profiler::STAGE_ESTIMATOR);
+
+  Profiler::Stats estimator = rf.profiler_.stats(Profiler::STAGE_ESTIMATOR);
+  EXPECT_EQ(estimator.count, 0u);
+  EXPECT_EQ(estimator.overruns, 0u);
+  EXPECT_FLOAT_EQ(estimator.max_us, 0.0f);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_SENSORS).count, 1u);
+}
+
+TEST_F(ProfilerTest, MainLoopIsProfiled)
+{
+  float acc[3] = {0, 0, -9.80665f};
+  float gyro[3] = {0, 0, 0};
+  for (int i = 0; i < 10; i++)
+  {
+    board.set_imu(acc, gyro, board.clock_micros() + 1000);
+    rf.run();
+  }
+  rf.run(); // no new IMU data
+
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_SENSORS).count, 11u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_ESTIMATOR).count, 10u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_MIXER).count, 10u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_COMMAND_MANAGER).count, 11u);
+  EXPECT_EQ(rf.profiler_.stats(Profiler::STAGE_LOOP).count, 11u);
+}
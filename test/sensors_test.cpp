@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+
+using namespace rosflight_firmware;
+
+class SensorsImuTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+
+  SensorsImuTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+  }
+
+  static ImuSample sample(float gyro_x, float accel_z, uint64_t time_us)
+  {
+    ImuSample s = {{0.0f, 0.0f, accel_z}, {gyro_x, 0.1f, -0.2f}, 25.0f, time_us};
+    return s;
+  }
+
+  // reads one sample and restarts the filtered IMU integration after it
+  void start(uint64_t time_us)
+  {
+    board.push_imu_fifo(sample(0.0f, -9.8f, time_us));
+    ASSERT_TRUE(rf.sensors_.run());
+    turbomath::Vector accel, gyro;
+    uint64_t stamp_us;
+    rf.sensors_.get_filtered_IMU(accel, gyro, stamp_us);
+  }
+};
+
+TEST_F(SensorsImuTest, BatchIsAveragedAndIntegrated)
+{
+  start(10000);
+  for (int i = 1; i <= 4; i++)
+    board.push_imu_fifo(sample(0.1f * i, -9.0f - 0.2f * i, 10000 + 250 * i));
+  ASSERT_TRUE(rf.sensors_.run());
+
+  const Sensors::Data &data = rf.sensors_.data();
+  EXPECT_EQ(data.imu_time, 11000u);
+  EXPECT_FLOAT_EQ(data.gyro.x, 0.25f);
+  EXPECT_FLOAT_EQ(data.gyro.y, 0.1f);
+  EXPECT_FLOAT_EQ(data.accel.z, -9.5f);
+
+  // evenly spaced samples, so the filtered IMU is the same mean
+  turbomath::Vector accel, gyro;
+  uint64_t stamp_us;
+  rf.sensors_.get_filtered_IMU(accel, gyro, stamp_us);
+  EXPECT_EQ(stamp_us, 11000u);
+  EXPECT_NEAR(gyro.x, 0.25f, 1e-5f);
+  EXPECT_NEAR(accel.z, -9.5f, 1e-4f);
+}
+
+TEST_F(SensorsImuTest, BatchMatchesSingleSampleCorrection)
+{
+  rf.params_.set_param_float(PARAM_FC_ROLL, 10.0f);
+  rf.params_.set_param_float(PARAM_FC_YAW, 90.0f);
+  rf.params_.set_param_float(PARAM_ACC_X_BIAS, 0.1f);
+  rf.params_.set_param_float(PARAM_ACC_Z_TEMP_COMP, 0.01f);
+  rf.params_.set_param_float(PARAM_GYRO_Y_BIAS, 0.02f);
+
+  float acc[3] = {0.3f, -0.2f, -9.7f};
+  float gyro[3] = {0.5f, -0.4f, 0.3f};
+  board.set_imu(acc, gyro, 1000);
+  ASSERT_TRUE(rf.sensors_.run());
+
+  // the previous rotate-then-correct path for one sample
+  const Sensors::Data &data = rf.sensors_.data();
+  turbomath::Vector expected_accel = data.fcu_orientation * turbomath::Vector(acc[0], acc[1], acc[2]);
+  expected_accel.x -= 0.1f;
+  expected_accel.z -= 0.01f * 25.0f;
+  turbomath::Vector expected_gyro = data.fcu_orientation * turbomath::Vector(gyro[0], gyro[1], gyro[2]);
+  expected_gyro.y -= 0.02f;
+
+  EXPECT_FLOAT_EQ(data.accel.x, expected_accel.x);
+  EXPECT_FLOAT_EQ(data.accel.y, expected_accel.y);
+  EXPECT_FLOAT_EQ(data.accel.z, expected_accel.z);
+  EXPECT_FLOAT_EQ(data.gyro.x, expected_gyro.x);
+  EXPECT_FLOAT_EQ(data.gyro.y, expected_gyro.y);
+  EXPECT_FLOAT_EQ(data.gyro.z, expected_gyro.z);
+}
+
+TEST_F(SensorsImuTest, LargeBacklogIsReadOverSeveralLoops)
+{
+  for (int i = 1; i <= 20; i++)
+    board.push_imu_fifo(sample(0.0f, -9.8f, 125 * i));
+
+  ASSERT_TRUE(rf.sensors_.run());
+  EXPECT_EQ(rf.sensors_.data().imu_time, 125u * 16);
+  ASSERT_TRUE(rf.sensors_.run());
+  EXPECT_EQ(rf.sensors_.data().imu_time, 125u * 20);
+}
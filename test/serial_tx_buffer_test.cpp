@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <cstring>
+
+#include "serial_tx_buffer.h"
+
+using namespace rosflight_firmware;
+
+TEST(SerialTxBuffer, ReserveAndCommitAreContiguous)
+{
+  SerialTxBuffer buf;
+  uint8_t *first = buf.reserve(40, SerialTxBuffer::PRIORITY_NORMAL);
+  ASSERT_NE(first, nullptr);
+  memset(first, 0xAA, 30);
+  buf.commit(30);
+
+  uint8_t msg[20];
+  memset(msg, 0x55, sizeof(msg));
+  EXPECT_TRUE(buf.push(msg, sizeof(msg), SerialTxBuffer::PRIORITY_NORMAL));
+
+  ASSERT_EQ(buf.size(), 50u);
+  EXPECT_EQ(buf.data(), first);
+  EXPECT_EQ(buf.data()[29], 0xAA);
+  EXPECT_EQ(buf.data()[30], 0x55);
+
+  buf.clear();
+  EXPECT_EQ(buf.size(), 0u);
+  EXPECT_EQ(buf.reserve(40, SerialTxBuffer::PRIORITY_LOW), first);
+}
+
+TEST(SerialTxBuffer, DropsLowPriorityFirst)
+{
+  SerialTxBuffer buf;
+  uint8_t msg[32] = {};
+  const size_t per_buffer = SerialTxBuffer::CAPACITY/sizeof(msg);
+
+  // low priority traffic may only fill half of the buffer
+  size_t low = 0;
+  while (buf.push(msg, sizeof(msg), SerialTxBuffer::PRIORITY_LOW))
+    low++;
+  EXPECT_EQ(low, per_buffer/2);
+  EXPECT_EQ(buf.dropped(SerialTxBuffer::PRIORITY_LOW), 1u);
+
+  // normal traffic gets the next quarter
+  size_t normal = 0;
+  while (buf.push(msg, sizeof(msg), SerialTxBuffer::PRIORITY_NORMAL))
+    normal++;
+  EXPECT_EQ(normal, per_buffer/4);
+
+  // and high priority traffic the rest
+  size_t high = 0;
+  while (buf.push(msg, sizeof(msg), SerialTxBuffer::PRIORITY_HIGH))
+    high++;
+  EXPECT_EQ(high, per_buffer/4);
+  EXPECT_EQ(buf.size(), SerialTxBuffer::CAPACITY);
+
+  EXPECT_EQ(buf.dropped(SerialTxBuffer::PRIORITY_NORMAL), 1u);
+  EXPECT_EQ(buf.dropped(SerialTxBuffer::PRIORITY_HIGH), 1u);
+  EXPECT_EQ(buf.reserve(1, SerialTxBuffer::PRIORITY_HIGH), nullptr);
+}
+
+TEST(SerialTxBuffer, CommitClampsToReservation)
+{
+  SerialTxBuffer buf;
+  ASSERT_NE(buf.reserve(10, SerialTxBuffer::PRIORITY_HIGH), nullptr);
+  buf.commit(100);
+  EXPECT_EQ(buf.size(), 10u);
+
+  // committing without a reservation adds nothing
+  buf.commit(10);
+  EXPECT_EQ(buf.size(), 10u);
+}
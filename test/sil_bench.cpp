@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file sil_bench.cpp
+ * @brief Software-in-the-loop loop-time benchmark
+ *
+ * Runs the full flight stack on a SILBoard for a fixed amount of virtual time and reports
+ * wall-clock timing histograms for each stage of the main loop, so that loop-time
+ * regressions can be caught on a desktop machine before flashing a flight controller. The loop is
+ * ROSflight::run() itself; the stage times are the ones its profiler records, taken from a wall
+ * clock that stands in for the board's cycle counter.
+ *
+ * Usage: sil_bench [duration_s] [control_budget_us] [mixer_saturation_mode] [batch_outputs]
+ *                  [attitude_divisor]
+ *
+ * If a control budget is given, the benchmark exits with a non-zero status when the 99th
+ * percentile of the control loop (sensors through mixer) exceeds it. The saturation mode sets
+ * MIX_SAT_MODE, so the motor allocation modes can be compared. The output latency (IMU read to
+ * the last output update) and skew (first to last output update in one mix) are also reported;
+ * setting batch_outputs to 0 writes the outputs one channel at a time for comparison. The attitude
+ * divisor sets FILTER_ATT_DIV, so the estimator and angle loops run on every Nth IMU sample.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "sil_board.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr uint32_t MAIN_LOOP_TICK_US = 50; // virtual time that passes between calls to the main loop
+constexpr uint32_t SETTLE_TIME_US = 5000000; // let calibration and the estimator settle before measuring
+
+const char *const STAGE_NAMES[Profiler::STAGE_COUNT] =
+{
+  "Sensors::run",
+  "Estimator::run",
+  "Controller::run",
+  "Mixer::mix_output",
+  "CommManager::stream",
+  "CommManager::receive",
+  "StateManager::run",
+  "RC::run",
+  "CommandManager::run",
+  "main loop",
+};
+
+// The virtual clock stays deterministic, but the profiler's cycle counter is a nanosecond wall clock
+class BenchBoard : public SILBoard
+{
+public:
+  uint32_t clock_cycles() override
+  {
+    return static_cast<uint32_t>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+  uint32_t clock_cycles_per_us() override { return 1000; }
+};
+
+// Collects every stage time the profiler records
+class StageTimers : public Profiler::Listener
+{
+public:
+  StageTimers() : control_loop("control loop")
+  {
+    for (int i = 0; i < Profiler::STAGE_COUNT; i++)
+      stages.emplace_back(STAGE_NAMES[i]);
+  }
+
+  void stage_timed(Profiler::Stage stage, uint32_t ns) override
+  {
+    stages[stage].add(ns);
+
+    // the control loop is sensors through mixer, on the loops that got an IMU sample
+    if (stage == Profiler::STAGE_SENSORS)
+      control_ns_ = ns;
+    else if (stage <= Profiler::STAGE_MIXER)
+      control_ns_ += ns;
+    if (stage == Profiler::STAGE_MIXER)
+    {
+      control_loop.add(control_ns_);
+      mixed = true;
+    }
+  }
+
+  bool mixed = false;
+  std::vector<StageTimer> stages;
+  StageTimer control_loop;
+
+private:
+  uint32_t control_ns_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  double duration_s = (argc > 1) ? atof(argv[1]) : 60.0;
+  double budget_us = (argc > 2) ? atof(argv[2]) : 0.0;
+  int saturation_mode = (argc > 3) ? atoi(argv[3]) : Mixer::SATURATION_SCALE;
+  bool batch_outputs = (argc > 4) ? atoi(argv[4]) != 0 : true;
+  int attitude_divisor = (argc > 5) ? atoi(argv[5]) : 1;
+
+  BenchBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+
+  board.init_board();
+  board.set_batch_outputs(batch_outputs);
+  rf.init();
+
+  // Configure a quadcopter that is allowed to arm
+  rf.params_.set_param_int(PARAM_MIXER, Mixer::QUADCOPTER_X);
+  rf.params_.set_param_int(PARAM_MIXER_SATURATION_MODE, saturation_mode);
+  rf.params_.set_param_int(PARAM_ATTITUDE_DIVISOR, attitude_divisor);
+  rf.params_.set_param_int(PARAM_CALIBRATE_GYRO_ON_ARM, false);
+  rf.params_.set_param_int(PARAM_RC_OVERRIDE_TAKE_MIN_THROTTLE, true);
+  rf.params_.set_param_float(PARAM_ACC_Z_BIAS, 0.01f);
+  rf.state_manager_.clear_error(StateManager::ERROR_UNCALIBRATED_IMU);
+
+  uint64_t settle_end_us = board.clock_micros() + SETTLE_TIME_US;
+  while (board.clock_micros() < settle_end_us)
+  {
+    board.advance_time(MAIN_LOOP_TICK_US);
+    rf.run();
+  }
+
+  rf.state_manager_.set_event(StateManager::EVENT_REQUEST_ARM);
+  uint16_t hover[8] = {1500, 1500, 1500, 1500, 1000, 1000, 1000, 1000};
+  board.set_rc(hover);
+
+  StageTimers timers;
+  StageTimer output_latency("output latency");
+  StageTimer output_skew("output skew");
+  rf.profiler_.set_listener(&timers);
+
+  Stopwatch total;
+  uint32_t imu_start = board.imu_samples();
+  uint64_t end_us = board.clock_micros() + static_cast<uint64_t>(duration_s * 1e6);
+  total.start();
+  while (board.clock_micros() < end_us)
+  {
+    board.advance_time(MAIN_LOOP_TICK_US);
+    timers.mixed = false;
+    rf.run();
+    if (timers.mixed && board.outputs_written())
+    {
+      output_latency.add(board.output_latency_ns());
+      output_skew.add(board.output_skew_ns());
+    }
+  }
+  double wall_s = static_cast<double>(total.ns()) * 1e-9;
+
+  printf("SIL benchmark: %.1f s virtual time, %u IMU samples, %.3f s wall time (%.1fx real time)\n",
+         duration_s, board.imu_samples() - imu_start, wall_s, duration_s / wall_s);
+  printf("armed: %s, serial bytes written: %llu, outputs: %s, attitude divisor: %d\n\n",
+         rf.state_manager_.state().armed ? "yes" : "no", static_cast<unsigned long long>(board.serial_bytes_written()),
+         batch_outputs ? "batched" : "per channel", attitude_divisor);
+
+  for (StageTimer &stage : timers.stages)
+    stage.report();
+  timers.control_loop.report();
+  output_latency.report();
+  output_skew.report();
+
+  if (budget_us > 0.0 && timers.control_loop.percentile(0.99) > budget_us * 1e3)
+  {
+    printf("FAIL: control loop p99 of %.2f us exceeds budget of %.2f us\n",
+           timers.control_loop.percentile(0.99) * 1e-3, budget_us);
+    return 1;
+  }
+  return 0;
+}
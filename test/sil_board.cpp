@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "sil_board.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "turbomath/turbomath.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+namespace rosflight_firmware
+{
+
+namespace
+{
+constexpr float TWO_PI = 6.283185307f;
+constexpr float GRAVITY = 9.80665f;
+
+// Synthetic trajectory: the vehicle rocks gently in roll and pitch while slowly yawing and
+// bobbing up and down about 10 m above the ground
+constexpr float ROLL_AMPLITUDE = 0.1f; // rad
+constexpr float ROLL_FREQUENCY = 0.5f; // Hz
+constexpr float PITCH_AMPLITUDE = 0.05f; // rad
+constexpr float PITCH_FREQUENCY = 0.3f; // Hz
+constexpr float YAW_RATE = 0.1f; // rad/s
+constexpr float ALTITUDE = 10.0f; // m
+constexpr float ALTITUDE_AMPLITUDE = 0.5f; // m
+constexpr float ALTITUDE_FREQUENCY = 0.2f; // Hz
+
+constexpr float VERTICAL_DRAG = 0.3f; // 1/s, for vertical dynamics
+
+// Inertial magnetic field (Gauss, NED)
+constexpr float MAG_NORTH = 0.2f;
+constexpr float MAG_EAST = 0.05f;
+constexpr float MAG_DOWN = 0.45f;
+} // namespace
+
+SILBoard::SILBoard()
+{
+  gnss_.fix_type = GNSS_FIX_TYPE_FIX;
+  gnss_.lat = 402466670; // deg*10^-7
+  gnss_.lon = -1116488890; // deg*10^-7
+  gnss_.height = 1387000; // mm
+  gnss_.h_acc = 1500;
+  gnss_.v_acc = 2500;
+}
+
+float SILBoard::noise(float amplitude)
+{
+  // xorshift32, so that every run produces the same sequence
+  noise_state_ ^= noise_state_ << 13;
+  noise_state_ ^= noise_state_ >> 17;
+  noise_state_ ^= noise_state_ << 5;
+  return amplitude * (static_cast<float>(noise_state_) / 4294967295.0f * 2.0f - 1.0f);
+}
+
+void SILBoard::synthesize_imu(uint64_t time_us)
+{
+  float t = static_cast<float>(time_us) * 1e-6f;
+  float roll = ROLL_AMPLITUDE * std::sin(TWO_PI * ROLL_FREQUENCY * t);
+  float pitch = PITCH_AMPLITUDE * std::sin(TWO_PI * PITCH_FREQUENCY * t);
+
+  gyro_[0] = TWO_PI * ROLL_FREQUENCY * ROLL_AMPLITUDE * std::cos(TWO_PI * ROLL_FREQUENCY * t) + noise(0.005f);
+  gyro_[1] = TWO_PI * PITCH_FREQUENCY * PITCH_AMPLITUDE * std::cos(TWO_PI * PITCH_FREQUENCY * t) + noise(0.005f);
+  gyro_[2] = YAW_RATE + noise(0.005f);
+
+  // Specific force, which in a climb or descent is larger or smaller than gravity
+  float f = GRAVITY;
+  if (vertical_dynamics_)
+    f += step_vertical_dynamics(time_us, std::cos(roll) * std::cos(pitch));
+
+  acc_[0] = f * std::sin(pitch) + noise(0.05f);
+  acc_[1] = -f * std::cos(pitch) * std::sin(roll) + noise(0.05f);
+  acc_[2] = -f * std::cos(pitch) * std::cos(roll) + noise(0.05f);
+
+  imu_time_us_ = time_us;
+  imu_samples_++;
+}
+
+float SILBoard::step_vertical_dynamics(uint64_t time_us, float cos_tilt)
+{
+  float dt = (time_us > dynamics_time_us_) ? static_cast<float>(time_us - dynamics_time_us_) * 1e-6f : 0.0f;
+  dynamics_time_us_ = time_us;
+
+  // Thrust proportional to the mean motor output, plus linear drag
+  float accel = GRAVITY * (motor_output_ / hover_throttle_ * cos_tilt - 1.0f) - VERTICAL_DRAG * climb_rate_;
+  if (altitude_ <= 0.0f && accel <= 0.0f && climb_rate_ <= 0.0f)
+  {
+    // resting on the ground
+    altitude_ = 0.0f;
+    climb_rate_ = 0.0f;
+    return 0.0f;
+  }
+  climb_rate_ += accel * dt;
+  altitude_ += climb_rate_ * dt;
+  return accel;
+}
+
+void SILBoard::set_vertical_dynamics(bool enabled, float hover_throttle)
+{
+  vertical_dynamics_ = enabled;
+  hover_throttle_ = hover_throttle;
+  altitude_ = 0.0f;
+  climb_rate_ = 0.0f;
+  dynamics_time_us_ = time_us_;
+}
+
+// setup
+void SILBoard::init_board()
+{
+  backup_memory_clear(BACKUP_MEMORY_SIZE);
+}
+void SILBoard::board_reset(bool bootloader) {}
+
+// clock
+uint32_t SILBoard::clock_millis() { return static_cast<uint32_t>(time_us_ / 1000); }
+uint64_t SILBoard::clock_micros() { return time_us_; }
+void SILBoard::clock_delay(uint32_t milliseconds) { time_us_ += static_cast<uint64_t>(milliseconds) * 1000; }
+
+void SILBoard::set_time(uint64_t time_us)
+{
+  time_us_ = time_us;
+}
+
+void SILBoard::advance_time(uint32_t us)
+{
+  time_us_ += us;
+}
+
+// serial
+void SILBoard::serial_init(uint32_t baud_rate, uint32_t dev) {}
+void SILBoard::serial_write(const uint8_t *src, size_t len)
+{
+  serial_bytes_written_ += len;
+}
+uint16_t SILBoard::serial_bytes_available()
+{
+  size_t remaining = serial_rx_remaining();
+  return static_cast<uint16_t>((remaining > UINT16_MAX) ? UINT16_MAX : remaining);
+}
+uint8_t SILBoard::serial_read()
+{
+  return (rx_pos_ < rx_len_) ? rx_data_[rx_pos_++] : 0;
+}
+void SILBoard::serial_flush() {}
+size_t SILBoard::serial_read_bulk(uint8_t *dest, size_t len)
+{
+  if (len > serial_rx_remaining())
+    len = serial_rx_remaining();
+  memcpy(dest, rx_data_ + rx_pos_, len);
+  rx_pos_ += len;
+  return len;
+}
+
+void SILBoard::set_serial_rx(const uint8_t *data, size_t len)
+{
+  rx_data_ = data;
+  rx_len_ = len;
+  rx_pos_ = 0;
+}
+
+// sensors
+void SILBoard::sensors_init()
+{
+  next_imu_us_ = time_us_;
+}
+uint16_t SILBoard::num_sensor_errors() { return 0; }
+
+bool SILBoard::new_imu_data()
+{
+  if (time_us_ >= next_imu_us_)
+  {
+    synthesize_imu(next_imu_us_);
+    next_imu_us_ += imu_period_us_;
+    return true;
+  }
+  return false;
+}
+
+bool SILBoard::imu_read(float accel[3], float *temperature, float gyro[3], uint64_t *time)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    accel[i] = acc_[i];
+    gyro[i] = gyro_[i];
+  }
+  *temperature = 25.0f;
+  *time = imu_time_us_;
+  imu_read_ns_ = host_ns();
+  outputs_written_ = false;
+  return true;
+}
+
+size_t SILBoard::imu_read_fifo(ImuSample *samples, size_t max_samples)
+{
+  if (!imu_fifo_)
+    return Board::imu_read_fifo(samples, max_samples);
+
+  size_t count = 0;
+  while (count < max_samples && new_imu_data())
+  {
+    ImuSample &sample = samples[count++];
+    imu_read(sample.accel, &sample.temperature, sample.gyro, &sample.time_us);
+  }
+  return count;
+}
+
+void SILBoard::imu_not_responding_error() {}
+
+bool SILBoard::mag_present() { return true; }
+void SILBoard::mag_update()
+{
+  float t = static_cast<float>(time_us_ - time_us_ % MAG_PERIOD_US) * 1e-6f;
+  float roll = ROLL_AMPLITUDE * std::sin(TWO_PI * ROLL_FREQUENCY * t);
+  float pitch = PITCH_AMPLITUDE * std::sin(TWO_PI * PITCH_FREQUENCY * t);
+  float yaw = YAW_RATE * t;
+
+  turbomath::Quaternion q(roll, pitch, yaw);
+  turbomath::Vector m = q.rotate(turbomath::Vector(MAG_NORTH, MAG_EAST, MAG_DOWN));
+  mag_[0] = m.x + noise(0.002f);
+  mag_[1] = m.y + noise(0.002f);
+  mag_[2] = m.z + noise(0.002f);
+}
+void SILBoard::mag_read(float mag[3])
+{
+  for (int i = 0; i < 3; i++)
+    mag[i] = mag_[i];
+}
+
+bool SILBoard::baro_present() { return baro_present_; }
+void SILBoard::baro_update()
+{
+  float t = static_cast<float>(time_us_ - time_us_ % BARO_PERIOD_US) * 1e-6f;
+  float altitude = vertical_dynamics_ ? altitude_
+                                     : ALTITUDE + ALTITUDE_AMPLITUDE * std::sin(TWO_PI * ALTITUDE_FREQUENCY * t);
+  // Linearized standard atmosphere near sea level (~12 Pa/m)
+  baro_pressure_ = 101325.0f - 12.0f * altitude + noise(1.0f);
+}
+void SILBoard::baro_read(float *pressure, float *temperature)
+{
+  *pressure = baro_pressure_;
+  *temperature = 25.0f;
+}
+
+bool SILBoard::diff_pressure_present() { return false; }
+void SILBoard::diff_pressure_update() {}
+void SILBoard::diff_pressure_read(float *diff_pressure, float *temperature) {}
+
+bool SILBoard::sonar_present() { return false; }
+void SILBoard::sonar_update() {}
+float SILBoard::sonar_read() { return 0.0f; }
+
+bool SILBoard::gnss_present() { return true; }
+void SILBoard::gnss_update()
+{
+  last_gnss_us_ = time_us_ - time_us_ % GNSS_PERIOD_US;
+  gnss_.time_of_week = static_cast<uint32_t>(last_gnss_us_ / 1000);
+  gnss_.time = last_gnss_us_ / 1000000;
+  gnss_.nanos = (last_gnss_us_ % 1000000) * 1000;
+  gnss_.rosflight_timestamp = last_gnss_us_;
+}
+GNSSData SILBoard::gnss_read() { return gnss_; }
+bool SILBoard::gnss_has_new_data() { return time_us_ >= last_gnss_us_ + GNSS_PERIOD_US; }
+GNSSRaw SILBoard::gnss_raw_read()
+{
+  GNSSRaw raw;
+  raw.time_of_week = gnss_.time_of_week;
+  raw.fix_type = 3; // 3D fix
+  raw.num_sat = 12;
+  raw.lat = gnss_.lat;
+  raw.lon = gnss_.lon;
+  raw.height = gnss_.height;
+  raw.h_acc = gnss_.h_acc;
+  raw.v_acc = gnss_.v_acc;
+  raw.rosflight_timestamp = gnss_.rosflight_timestamp;
+  return raw;
+}
+
+bool SILBoard::battery_voltage_present() const { return false; }
+float SILBoard::battery_voltage_read() const { return 0.0f; }
+void SILBoard::battery_voltage_set_multiplier(double multiplier) {}
+
+bool SILBoard::battery_current_present() const { return false; }
+float SILBoard::battery_current_read() const { return 0.0f; }
+void SILBoard::battery_current_set_multiplier(double multiplier) {}
+
+// RC
+void SILBoard::rc_init(rc_type_t rc_type) {}
+bool SILBoard::rc_lost() { return false; }
+float SILBoard::rc_read(uint8_t channel)
+{
+  return static_cast<float>(rc_values_[channel] - 1000) / 1000.0f;
+}
+
+void SILBoard::set_rc(const uint16_t values[8])
+{
+  for (int i = 0; i < 8; i++)
+    rc_values_[i] = values[i];
+}
+
+// PWM
+void SILBoard::pwm_init(uint32_t refresh_rate, uint16_t idle_pwm) {}
+void SILBoard::pwm_disable()
+{
+  for (size_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+    pwm_[i] = 0.0f;
+  motor_output_ = 0.0f;
+}
+void SILBoard::pwm_write(uint8_t channel, float value)
+{
+  if (channel < NUM_PWM_OUTPUTS)
+    pwm_[channel] = value;
+  record_output();
+}
+
+void SILBoard::pwm_write_all(const float *values, const Mixer::output_type_t *types, size_t count)
+{
+  float motor_sum = 0.0f;
+  int motors = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (types[i] == Mixer::M)
+    {
+      motor_sum += values[i];
+      motors++;
+    }
+  }
+  motor_output_ = (motors > 0) ? motor_sum / static_cast<float>(motors) : 0.0f;
+
+  if (!batch_outputs_)
+  {
+    Board::pwm_write_all(values, types, count);
+    return;
+  }
+
+  for (size_t i = 0; i < count && i < NUM_PWM_OUTPUTS; i++)
+  {
+    if (types[i] == Mixer::S || types[i] == Mixer::M)
+      pwm_[i] = values[i];
+  }
+  record_output();
+}
+
+uint64_t SILBoard::host_ns() const
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void SILBoard::record_output()
+{
+  uint32_t ns = static_cast<uint32_t>(host_ns() - imu_read_ns_);
+  if (!outputs_written_)
+  {
+    first_output_ns_ = ns;
+    outputs_written_ = true;
+  }
+  last_output_ns_ = ns;
+}
+
+float SILBoard::pwm_output(uint8_t channel) const
+{
+  return (channel < NUM_PWM_OUTPUTS) ? pwm_[channel] : 0.0f;
+}
+
+// non-volatile memory
+void SILBoard::memory_init() {}
+bool SILBoard::memory_read(void *dest, size_t len)
+{
+  if (len > memory_len_)
+    return false;
+  memcpy(dest, memory_, len);
+  return true;
+}
+bool SILBoard::memory_write(const void *src, size_t len)
+{
+  if (len > MEMORY_SIZE)
+    return false;
+  memcpy(memory_, src, len);
+  memory_len_ = len;
+  return true;
+}
+
+// LEDs
+void SILBoard::led0_on() {}
+void SILBoard::led0_off() {}
+void SILBoard::led0_toggle() {}
+
+void SILBoard::led1_on() {}
+void SILBoard::led1_off() {}
+void SILBoard::led1_toggle() {}
+
+// Backup memory
+void SILBoard::backup_memory_init() {}
+bool SILBoard::backup_memory_read(void *dest, size_t len)
+{
+  bool success = true;
+  if (len > BACKUP_MEMORY_SIZE)
+  {
+    len = BACKUP_MEMORY_SIZE;
+    success = false;
+  }
+  memcpy(dest, backup_memory_, len);
+  return success;
+}
+void SILBoard::backup_memory_write(const void *src, size_t len)
+{
+  if (len > BACKUP_MEMORY_SIZE)
+    len = BACKUP_MEMORY_SIZE;
+  memcpy(backup_memory_, src, len);
+}
+void SILBoard::backup_memory_clear(size_t len)
+{
+  if (len > BACKUP_MEMORY_SIZE)
+    len = BACKUP_MEMORY_SIZE;
+  memset(backup_memory_, 0, len);
+}
+
+} // namespace rosflight_firmware
+
+#pragma GCC diagnostic pop
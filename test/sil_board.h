@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ROSFLIGHT_FIRMWARE_SIL_BOARD_H
+#define ROSFLIGHT_FIRMWARE_SIL_BOARD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "board.h"
+#include "sensors.h"
+
+namespace rosflight_firmware
+{
+
+/**
+ * @brief Software-in-the-loop board with a deterministic virtual clock
+ *
+ * Time only moves when the owner calls advance_time() or set_time(), so every run of the
+ * firmware on top of this board sees exactly the same sensor samples at exactly the same
+ * timestamps. IMU, barometer, magnetometer and GNSS data are synthesized from a slow,
+ * smooth rocking motion about a level hover with a small amount of repeatable noise. The
+ * altitude either bobs up and down on a script or, with vertical dynamics on, follows the
+ * motor outputs.
+ */
+class SILBoard : public Board
+{
+
+public:
+  SILBoard();
+
+// setup
+  void init_board() override;
+  void board_reset(bool bootloader) override;
+
+// clock
+  uint32_t clock_millis() override;
+  uint64_t clock_micros() override;
+  void clock_delay(uint32_t milliseconds) override;
+
+// serial
+  void serial_init(uint32_t baud_rate, uint32_t dev) override;
+  void serial_write(const uint8_t *src, size_t len) override;
+  uint16_t serial_bytes_available() override;
+  uint8_t serial_read() override;
+  void serial_flush() override;
+  size_t serial_read_bulk(uint8_t *dest, size_t len) override;
+
+// sensors
+  void sensors_init() override;
+  uint16_t num_sensor_errors() override;
+
+  bool new_imu_data() override;
+  bool imu_read(float accel[3], float *temperature, float gyro[3], uint64_t *time) override;
+  size_t imu_read_fifo(ImuSample *samples, size_t max_samples) override;
+  void imu_not_responding_error() override;
+
+  bool mag_present() override;
+  void mag_update() override;
+  void mag_read(float mag[3]) override;
+
+  bool baro_present() override;
+  void baro_update() override;
+  void baro_read(float *pressure, float *temperature) override;
+
+  bool diff_pressure_present() override;
+  void diff_pressure_update() override;
+  void diff_pressure_read(float *diff_pressure, float *temperature) override;
+
+  bool sonar_present() override;
+  void sonar_update() override;
+  float sonar_read() override;
+
+  bool gnss_present() override;
+  void gnss_update() override;
+  GNSSData gnss_read() override;
+  bool gnss_has_new_data() override;
+  GNSSRaw gnss_raw_read() override;
+
+  bool battery_voltage_present() const override;
+  float battery_voltage_read() const override;
+  void battery_voltage_set_multiplier(double multiplier) override;
+
+  bool battery_current_present() const override;
+  float battery_current_read() const override;
+  void battery_current_set_multiplier(double multiplier) override;
+
+// RC
+  void rc_init(rc_type_t rc_type) override;
+  bool rc_lost() override;
+  float rc_read(uint8_t channel) override;
+
+// PWM
+  void pwm_init(uint32_t refresh_rate, uint16_t idle_pwm) override;
+  void pwm_disable() override;
+  void pwm_write(uint8_t channel, float value) override;
+  void pwm_write_all(const float *values, const Mixer::output_type_t *types, size_t count) override;
+
+// non-volatile memory
+  void memory_init() override;
+  bool memory_read(void *dest, size_t len) override;
+  bool memory_write(const void *src, size_t len) override;
+
+// LEDs
+  void led0_on() override;
+  void led0_off() override;
+  void led0_toggle() override;
+
+  void led1_on() override;
+  void led1_off() override;
+  void led1_toggle() override;
+
+// Backup memory
+  void backup_memory_init() override;
+  bool backup_memory_read(void *dest, size_t len) override;
+  void backup_memory_write(const void *src, size_t len) override;
+  void backup_memory_clear(size_t len) override;
+
+// simulation control
+  void set_time(uint64_t time_us);
+  void advance_time(uint32_t us);
+
+  void set_imu_period_us(uint32_t period_us) { imu_period_us_ = period_us; }
+  // With the FIFO on, every sample due since the last read is returned by imu_read_fifo at once
+  void set_imu_fifo(bool fifo) { imu_fifo_ = fifo; }
+  void set_rc(const uint16_t values[8]);
+  void set_baro_present(bool present) { baro_present_ = present; }
+
+  // Closed-loop vertical flight: the vehicle starts on the ground and climbs with the mean motor
+  // output, which holds it steady at hover_throttle when level. The IMU and barometer see the
+  // resulting motion. The attitude keeps following the script.
+  void set_vertical_dynamics(bool enabled, float hover_throttle);
+  float altitude() const { return altitude_; }
+  float climb_rate() const { return climb_rate_; }
+
+  float pwm_output(uint8_t channel) const;
+  uint64_t serial_bytes_written() const { return serial_bytes_written_; }
+  // Bytes to be "received" over serial. The buffer is not copied and must outlive its use.
+  void set_serial_rx(const uint8_t *data, size_t len);
+  size_t serial_rx_remaining() const { return rx_len_ - rx_pos_; }
+  uint32_t imu_samples() const { return imu_samples_; }
+
+  // Output timing, in host nanoseconds since the last IMU read. Batched writes latch every output
+  // at once; with batching off, pwm_write_all falls back to one pwm_write per channel, as on boards
+  // that don't override it, and the skew is the time from the first to the last channel update.
+  void set_batch_outputs(bool batch) { batch_outputs_ = batch; }
+  bool outputs_written() const { return outputs_written_; }
+  uint32_t output_latency_ns() const { return last_output_ns_; }
+  uint32_t output_skew_ns() const { return last_output_ns_ - first_output_ns_; }
+
+  static constexpr size_t NUM_PWM_OUTPUTS = 14;
+
+private:
+  static constexpr uint32_t BARO_PERIOD_US = 20000;  // 50 Hz
+  static constexpr uint32_t MAG_PERIOD_US = 20000;   // 50 Hz
+  static constexpr uint32_t GNSS_PERIOD_US = 100000; // 10 Hz
+  static constexpr size_t MEMORY_SIZE = 8192;
+  static constexpr size_t BACKUP_MEMORY_SIZE = 1024;
+
+  float noise(float amplitude);
+  uint64_t host_ns() const;
+  void record_output();
+  void synthesize_imu(uint64_t time_us);
+  float step_vertical_dynamics(uint64_t time_us, float cos_tilt);
+
+  uint64_t time_us_ = 0;
+
+  uint32_t imu_period_us_ = 1000; // 1 kHz
+  bool imu_fifo_ = false;
+  uint64_t next_imu_us_ = 0;
+  uint32_t imu_samples_ = 0;
+  float acc_[3] = {0.0f, 0.0f, -9.80665f};
+  float gyro_[3] = {0.0f, 0.0f, 0.0f};
+  uint64_t imu_time_us_ = 0;
+
+  bool vertical_dynamics_ = false;
+  float hover_throttle_ = 0.5f;
+  float motor_output_ = 0.0f;
+  float altitude_ = 0.0f;
+  float climb_rate_ = 0.0f;
+  uint64_t dynamics_time_us_ = 0;
+
+  bool baro_present_ = true;
+  float baro_pressure_ = 101325.0f;
+  float mag_[3] = {0.0f, 0.0f, 0.0f};
+  uint64_t last_gnss_us_ = 0;
+  GNSSData gnss_;
+
+  uint32_t noise_state_ = 0x12345678;
+
+  uint16_t rc_values_[8] = {1500, 1500, 1000, 1500, 1000, 1000, 1000, 1000};
+  float pwm_[NUM_PWM_OUTPUTS] = {};
+  bool batch_outputs_ = true;
+  bool outputs_written_ = false;
+  uint64_t imu_read_ns_ = 0;
+  uint32_t first_output_ns_ = 0;
+  uint32_t last_output_ns_ = 0;
+  uint64_t serial_bytes_written_ = 0;
+  const uint8_t *rx_data_ = nullptr;
+  size_t rx_len_ = 0;
+  size_t rx_pos_ = 0;
+
+  uint8_t memory_[MEMORY_SIZE] = {};
+  size_t memory_len_ = 0;
+  uint8_t backup_memory_[BACKUP_MEMORY_SIZE] = {};
+};
+
+} // namespace rosflight_firmware
+
+#endif // ROSFLIGHT_FIRMWARE_SIL_BOARD_H
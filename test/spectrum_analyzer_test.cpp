@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <cmath>
+
+#include "common.h"
+#include "mavlink.h"
+#include "test_board.h"
+#include "rosflight.h"
+#include "spectrum_analyzer.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+const double PI = 3.14159265358979;
+
+struct Tone
+{
+  double frequency_hz;
+  double amplitude;
+};
+
+// Feeds samples at sample_hz, starting from sample number first_sample, with the given tones on
+// each axis, calling update() once per sample the way the main loop does. Returns the number of
+// results produced.
+uint32_t run(SpectrumAnalyzer &analyzer, double sample_hz, int first_sample, int num_samples, const Tone tones[3][2],
+             int *max_steps_per_frame = nullptr)
+{
+  uint32_t results = 0;
+  int steps = 0;
+  for (int i = first_sample; i < first_sample + num_samples; i++)
+  {
+    double t = i / sample_hz;
+    float value[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      double x = 0.1; // constant offset, like an uncorrected gyro bias
+      for (int j = 0; j < 2; j++)
+        x += tones[axis][j].amplitude * sin(2.0 * PI * tones[axis][j].frequency_hz * t + axis);
+      value[axis] = static_cast<float>(x);
+    }
+    analyzer.add_sample(value, static_cast<uint64_t>(t * 1e6 + 0.5) + 1000);
+
+    steps++;
+    if (analyzer.update())
+    {
+      results++;
+      if (max_steps_per_frame && steps > *max_steps_per_frame)
+        *max_steps_per_frame = steps;
+      steps = 0;
+    }
+  }
+  return results;
+}
+} // namespace
+
+TEST(SpectrumAnalyzerTest, FindsSingleTonePerAxis)
+{
+  SpectrumAnalyzer analyzer;
+  analyzer.init(20.0f);
+  const Tone tones[3][2] = {{{173.0, 0.5}, {0.0, 0.0}},
+                            {{61.3, 2.0}, {0.0, 0.0}},
+                            {{402.7, 0.05}, {0.0, 0.0}}};
+  EXPECT_GT(run(analyzer, 1000.0, 0, 1000, tones), 10u);
+
+  EXPECT_NEAR(analyzer.sample_rate_hz(), 1000.0f, 0.5f);
+  const float bin_hz = 1000.0f / SpectrumAnalyzer::FFT_SIZE;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const SpectrumAnalyzer::Peak &peak = analyzer.peaks(axis)[0];
+    EXPECT_NEAR(peak.frequency_hz, tones[axis][0].frequency_hz, 0.1f * bin_hz) << "axis " << axis;
+    EXPECT_NEAR(peak.amplitude, tones[axis][0].amplitude, 0.05 * tones[axis][0].amplitude) << "axis " << axis;
+  }
+}
+
+TEST(SpectrumAnalyzerTest, OrdersPeaksByAmplitude)
+{
+  SpectrumAnalyzer analyzer;
+  analyzer.init(20.0f);
+  const Tone tones[3][2] = {{{95.0, 0.3}, {260.0, 1.0}},
+                            {{95.0, 1.0}, {260.0, 0.3}},
+                            {{0.0, 0.0}, {0.0, 0.0}}};
+  run(analyzer, 2000.0, 0, 2000, tones);
+
+  EXPECT_NEAR(analyzer.peaks(0)[0].frequency_hz, 260.0f, 1.0f);
+  EXPECT_NEAR(analyzer.peaks(0)[1].frequency_hz, 95.0f, 1.0f);
+  EXPECT_NEAR(analyzer.peaks(1)[0].frequency_hz, 95.0f, 1.0f);
+  EXPECT_NEAR(analyzer.peaks(1)[1].frequency_hz, 260.0f, 1.0f);
+  EXPECT_GT(analyzer.peaks(0)[0].amplitude, 3.0f * analyzer.peaks(0)[1].amplitude);
+
+  // a constant signal only leaves rounding noise above the minimum frequency
+  for (int i = 0; i < SpectrumAnalyzer::NUM_PEAKS; i++)
+    EXPECT_LT(analyzer.peaks(2)[i].amplitude, 1e-5f);
+}
+
+TEST(SpectrumAnalyzerTest, IgnoresPeaksBelowMinimumFrequency)
+{
+  SpectrumAnalyzer analyzer;
+  analyzer.init(100.0f);
+  const Tone tones[3][2] = {{{30.0, 5.0}, {150.0, 0.2}},
+                            {{0.0, 0.0}, {0.0, 0.0}},
+                            {{0.0, 0.0}, {0.0, 0.0}}};
+  run(analyzer, 1000.0, 0, 1000, tones);
+  EXPECT_NEAR(analyzer.peaks(0)[0].frequency_hz, 150.0f, 1.0f);
+}
+
+TEST(SpectrumAnalyzerTest, WorkIsSpreadOverLoopIterations)
+{
+  SpectrumAnalyzer analyzer;
+  analyzer.init(20.0f);
+  const Tone tones[3][2] = {{{200.0, 1.0}, {0.0, 0.0}},
+                            {{0.0, 0.0}, {0.0, 0.0}},
+                            {{0.0, 0.0}, {0.0, 0.0}}};
+
+  // no result until the first frame is full and all of its steps have run
+  const int first_result = SpectrumAnalyzer::FFT_SIZE + SpectrumAnalyzer::STEPS_PER_FRAME - 1;
+  EXPECT_EQ(run(analyzer, 1000.0, 0, first_result - 1, tones), 0u);
+  EXPECT_EQ(run(analyzer, 1000.0, first_result - 1, 1, tones), 1u);
+  EXPECT_EQ(analyzer.num_results(), 1u);
+
+  // afterwards one result per half frame
+  int max_steps = 0;
+  EXPECT_EQ(run(analyzer, 1000.0, first_result, 10 * SpectrumAnalyzer::FFT_SIZE / 2, tones, &max_steps), 10u);
+  EXPECT_EQ(max_steps, static_cast<int>(SpectrumAnalyzer::FFT_SIZE / 2));
+}
+
+TEST(SpectrumAnalyzerTest, SkipsFramesWhenSamplesOutrunTheWork)
+{
+  // Several samples per call to update(), as when the IMU FIFO is drained in batches: frames fill
+  // faster than they are processed, so some are skipped, but those that finish are intact
+  SpectrumAnalyzer analyzer;
+  analyzer.init(20.0f);
+  const float bin_hz = 1000.0f / SpectrumAnalyzer::FFT_SIZE;
+  const int batch = 8;
+  uint32_t results = 0;
+  for (int i = 0; i < 10000; i++)
+  {
+    double t = i / 1000.0;
+    float value[3] = {static_cast<float>(sin(2.0 * PI * 173.0 * t)), static_cast<float>(0.5 * sin(2.0 * PI * 61.3 * t)), 0.0f};
+    analyzer.add_sample(value, static_cast<uint64_t>(t * 1e6 + 0.5));
+    if (i % batch == batch - 1 && analyzer.update())
+    {
+      results++;
+      EXPECT_NEAR(analyzer.sample_rate_hz(), 1000.0f, 0.5f);
+      EXPECT_NEAR(analyzer.peaks(0)[0].frequency_hz, 173.0f, 0.1f * bin_hz);
+      EXPECT_NEAR(analyzer.peaks(0)[0].amplitude, 1.0f, 0.05f);
+      EXPECT_NEAR(analyzer.peaks(1)[0].frequency_hz, 61.3f, 0.1f * bin_hz);
+    }
+  }
+  // a frame takes STEPS_PER_FRAME batches, and collection starts over after each skipped frame
+  EXPECT_GE(results, 10000u / (batch * SpectrumAnalyzer::STEPS_PER_FRAME + SpectrumAnalyzer::FFT_SIZE));
+}
+
+class GyroSpectrumTest : public ::testing::Test
+{
+public:
+  testBoard board;
+  Mavlink mavlink;
+  ROSflight rf;
+  uint64_t time_us = 0;
+
+  GyroSpectrumTest() :
+    mavlink(board),
+    rf(board, mavlink)
+  {}
+
+  void SetUp() override
+  {
+    board.backup_memory_clear();
+    rf.init();
+    rf.params_.set_param_int(PARAM_FILTER_USE_ACC, false);
+    rf.params_.set_param_int(PARAM_GYRO_FFT_ENABLE, true);
+    rf.params_.set_param_float(PARAM_GYRO_LPF_CUTOFF, 400.0f);
+  }
+
+  // Runs the main loop, at 1 kHz unless given another period, with a roll rate vibration and
+  // returns the peak filtered roll rate over the last quarter of the run
+  float run(float vibration_hz, int loops, uint64_t period_us = 1000)
+  {
+    float peak = 0.0f;
+    for (int i = 0; i < loops; i++)
+    {
+      time_us += period_us;
+      float acc[3] = {0.0f, 0.0f, -9.80665f};
+      float gyro[3] = {static_cast<float>(0.5 * sin(2.0 * PI * vibration_hz * time_us * 1e-6)), 0.0f, 0.0f};
+      board.set_imu(acc, gyro, time_us);
+      board.set_time(time_us);
+      rf.run();
+      if (i >= 3 * loops / 4)
+        peak = std::max(peak, std::fabs(rf.estimator_.gyroLPF().x));
+    }
+    return peak;
+  }
+};
+
+TEST_F(GyroSpectrumTest, ReportsGyroVibration)
+{
+  run(145.0f, 1000);
+  ASSERT_GT(rf.sensors_.gyro_spectrum().num_results(), 0u);
+  EXPECT_NEAR(rf.sensors_.gyro_spectrum().peaks(0)[0].frequency_hz, 145.0f, 1.0f);
+  EXPECT_NEAR(rf.sensors_.gyro_spectrum().peaks(0)[0].amplitude, 0.5f, 0.05f);
+  EXPECT_LT(rf.sensors_.gyro_spectrum().peaks(1)[0].amplitude, 0.01f);
+}
+
+TEST_F(GyroSpectrumTest, DynamicNotchFollowsVibration)
+{
+  EXPECT_GT(run(145.0f, 1000), 0.4f);
+
+  rf.params_.set_param_int(PARAM_DYN_NOTCH_ENABLE, true);
+  EXPECT_LT(run(145.0f, 1000), 0.05f);
+
+  // and moves when the motors speed up
+  EXPECT_LT(run(210.0f, 1000), 0.05f);
+}
+
+TEST_F(GyroSpectrumTest, DynamicNotchUsesMeasuredSampleRate)
+{
+  // The loop runs at 500 Hz while FILTER_RATE_HZ is left at 1000. A notch designed for the param
+  // would sit at twice the vibration frequency.
+  rf.params_.set_param_float(PARAM_GYRO_LPF_CUTOFF, 0.0f);
+  rf.params_.set_param_int(PARAM_DYN_NOTCH_ENABLE, true);
+  EXPECT_LT(run(110.0f, 1000, 2000), 0.05f);
+  EXPECT_NEAR(rf.sensors_.gyro_spectrum().sample_rate_hz(), 500.0f, 0.5f);
+}
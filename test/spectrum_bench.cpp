@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file spectrum_bench.cpp
+ * @brief Microbenchmark of the gyro vibration spectrum analyzer
+ *
+ * Feeds a 1 kHz three-axis signal with two tones per axis and white noise, calling
+ * SpectrumAnalyzer::update() once per sample as the main loop does. Reports the cost of adding a
+ * sample, of each update() call (the per-loop cost the analyzer adds), and of a whole frame, then
+ * the worst frequency error of the largest peak over a sweep of tone frequencies. Every call is
+ * timed on its own, so the per-frame total includes the timer overhead of all 64 calls.
+ *
+ * Usage: spectrum_bench [frames]
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "spectrum_analyzer.h"
+
+#include "bench_timer.h"
+
+using namespace rosflight_firmware;
+
+namespace
+{
+
+constexpr double PI = 3.14159265358979;
+constexpr double SAMPLE_HZ = 1000.0;
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long frames = (argc > 1) ? atol(argv[1]) : 2000;
+
+  std::mt19937 generator(1);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+
+  SpectrumAnalyzer analyzer;
+  analyzer.init(60.0f);
+
+  StageTimer add_timer("add_sample");
+  StageTimer step_timer("update, per call");
+  StageTimer frame_timer("update, per frame");
+  Stopwatch timer;
+  uint32_t frame_ns = 0;
+
+  const long num_samples = frames * static_cast<long>(SpectrumAnalyzer::FFT_SIZE / 2);
+  for (long i = 0; i < num_samples; i++)
+  {
+    double t = i / SAMPLE_HZ;
+    float value[3];
+    for (int axis = 0; axis < 3; axis++)
+      value[axis] = static_cast<float>(0.3 * sin(2.0 * PI * (120.0 + 40.0 * axis) * t)
+                                       + 0.1 * sin(2.0 * PI * (300.0 + 20.0 * axis) * t)) + noise(generator);
+
+    timer.start();
+    analyzer.add_sample(value, static_cast<uint64_t>(t * 1e6));
+    add_timer.add(timer.ns());
+
+    timer.start();
+    bool done = analyzer.update();
+    uint32_t ns = timer.ns();
+    step_timer.add(ns);
+    frame_ns += ns;
+    if (done)
+    {
+      frame_timer.add(frame_ns);
+      frame_ns = 0;
+    }
+  }
+
+  // accuracy of the largest peak for tones swept across the bins
+  float max_error_hz = 0.0f;
+  float max_amplitude_error = 0.0f;
+  for (double f = 70.0; f < 450.0; f += 0.73)
+  {
+    analyzer.init(60.0f);
+    for (long i = 0; analyzer.num_results() < 2; i++)
+    {
+      double t = i / SAMPLE_HZ;
+      float x = static_cast<float>(0.5 * sin(2.0 * PI * f * t));
+      float value[3] = {x, x, x};
+      analyzer.add_sample(value, static_cast<uint64_t>(t * 1e6));
+      analyzer.update();
+    }
+    const SpectrumAnalyzer::Peak &peak = analyzer.peaks(0)[0];
+    max_error_hz = std::max(max_error_hz, static_cast<float>(std::fabs(peak.frequency_hz - f)));
+    max_amplitude_error = std::max(max_amplitude_error, std::fabs(peak.amplitude - 0.5f) / 0.5f);
+  }
+
+  printf("Gyro spectrum benchmark: %zu-point FFT, %d update() calls per frame, %ld frames\n\n",
+         SpectrumAnalyzer::FFT_SIZE, SpectrumAnalyzer::STEPS_PER_FRAME, frames);
+  add_timer.summary();
+  step_timer.report();
+  frame_timer.summary();
+  printf("\nlargest peak over a 70-450 Hz sweep at %.0f Hz (bins of %.2f Hz):\n", SAMPLE_HZ,
+         SAMPLE_HZ / SpectrumAnalyzer::FFT_SIZE);
+  printf("  max frequency error %.3f Hz, max amplitude error %.1f%%\n", max_error_hz, 100.0f * max_amplitude_error);
+  return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file stream_bench.cpp
+ * @brief Microbenchmark of CommManager::stream(), the telemetry scheduler polled every main loop
+ *
+ * Runs the scheduler with the default stream rates against a simulated clock that advances by a
+ * fixed loop period per call, and times every call. Most calls find nothing due, so the summary
+ * shows both the idle cost and the cost of calls that send.
+ *
+ * Usage: stream_bench [calls] [loop period us]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mavlink.h"
+#include "rosflight.h"
+
+#include "bench_timer.h"
+#include "test_board.h"
+
+using namespace rosflight_firmware;
+
+int main(int argc, char **argv)
+{
+  long calls = (argc > 1) ? atol(argv[1]) : 1000000;
+  uint32_t period_us = (argc > 2) ? static_cast<uint32_t>(atol(argv[2])) : 250;
+
+  testBoard board;
+  Mavlink mavlink(board);
+  ROSflight rf(board, mavlink);
+  board.set_time(0);
+  rf.init();
+
+  StageTimer stream("stream()");
+  Stopwatch timer;
+  uint64_t now_us = 0;
+
+  for (long i = 0; i < calls; i++)
+  {
+    now_us += period_us;
+    board.set_time(now_us);
+    timer.start();
+    rf.comm_manager_.stream();
+    stream.add(timer.ns());
+  }
+
+  printf("stream scheduler benchmark: %ld calls, %u us loop period\n\n", calls, period_us);
+  stream.summary();
+  return 0;
+}
@@ -29,6 +29,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstring>
+
 #include "test_board.h"
 
 #pragma GCC diagnostic push
@@ -66,6 +68,30 @@ void testBoard::set_imu(float *acc, float *gyro, uint64_t time_us)
   new_imu_ = true;
 }
 
+void testBoard::set_mag(const float *mag)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    mag_[i] = mag[i];
+  }
+  mag_present_ = true;
+}
+void testBoard::set_baro(float pressure)
+{
+  baro_pressure_ = pressure;
+  baro_present_ = true;
+}
+
+void testBoard::set_sonar(float range)
+{
+  sonar_range_ = range;
+  sonar_present_ = true;
+}
+
+testBoard::testBoard()
+{
+  memset(flash_, 0xFF, sizeof(flash_));
+}
 
 // setup
 void testBoard::init_board() 
@@ -113,6 +139,24 @@ bool testBoard::imu_read(float accel[3], float *temperature, float gyro[3], uint
   return true;
 }
 
+size_t testBoard::imu_read_fifo(ImuSample *samples, size_t max_samples)
+{
+  if (imu_fifo_count_ == 0)
+    return Board::imu_read_fifo(samples, max_samples);
+
+  size_t count = (imu_fifo_count_ < max_samples) ? imu_fifo_count_ : max_samples;
+  memcpy(samples, imu_fifo_, count * sizeof(ImuSample));
+  memmove(imu_fifo_, imu_fifo_ + count, (imu_fifo_count_ - count) * sizeof(ImuSample));
+  imu_fifo_count_ -= count;
+  return count;
+}
+
+void testBoard::push_imu_fifo(const ImuSample &sample)
+{
+  if (imu_fifo_count_ < IMU_FIFO_SIZE)
+    imu_fifo_[imu_fifo_count_++] = sample;
+}
+
 bool testBoard::backup_memory_read(void *dest, size_t len)
 {
   bool success = true;
@@ -142,21 +186,31 @@ void testBoard::backup_memory_clear()
 
 void testBoard::imu_not_responding_error() {}
 
-bool testBoard::mag_present() { return false; }
+bool testBoard::mag_present() { return mag_present_; }
 void testBoard::mag_update() {}
-void testBoard::mag_read(float mag[3]) {}
+void testBoard::mag_read(float mag[3])
+{
+  for (int i = 0; i < 3; i++)
+  {
+    mag[i] = mag_[i];
+  }
+}
 
-bool testBoard::baro_present() { return false; }
+bool testBoard::baro_present() { return baro_present_; }
 void testBoard::baro_update() {}
-void testBoard::baro_read(float *pressure, float *temperature) {}
+void testBoard::baro_read(float *pressure, float *temperature)
+{
+  *pressure = baro_pressure_;
+  *temperature = 25.0f;
+}
 
 bool testBoard::diff_pressure_present() { return false; }
 void testBoard::diff_pressure_update() {}
 void testBoard::diff_pressure_read(float *diff_pressure, float *temperature) {}
 
-bool testBoard::sonar_present() { return false; }
+bool testBoard::sonar_present() { return sonar_present_; }
 void testBoard::sonar_update() {}
-float testBoard::sonar_read() { return 0; }
+float testBoard::sonar_read() { return sonar_range_; }
 
 bool testBoard::battery_voltage_present() const
 {
@@ -203,13 +257,70 @@ float testBoard::rc_read(uint8_t channel)
   return static_cast<float>(rc_values[channel] - 1000)/1000.0 ;
 }
 void testBoard::pwm_write(uint8_t channel, float value) {}
-void testBoard::pwm_init(uint32_t refresh_rate, uint16_t idle_pwm) {}
+void testBoard::pwm_init(uint32_t refresh_rate, uint16_t idle_pwm)
+{
+  pwm_inits_++;
+}
 void testBoard::pwm_disable() {}
+void testBoard::pwm_write_all(const float *values, const Mixer::output_type_t *types, size_t count)
+{
+  for (size_t i = 0; i < count && i < sizeof(pwm_values_) / sizeof(pwm_values_[0]); i++)
+  {
+    pwm_values_[i] = values[i];
+    pwm_types_[i] = types[i];
+  }
+  pwm_batches_++;
+}
+bool testBoard::esc_init(EscProtocol protocol, uint16_t channel_mask)
+{
+  if (!esc_supported_)
+    return false;
+  esc_protocol_ = protocol;
+  esc_channel_mask_ = channel_mask;
+  return true;
+}
+void testBoard::esc_write(const uint16_t *frames, size_t count)
+{
+  for (size_t i = 0; i < count && i < sizeof(esc_frames_) / sizeof(esc_frames_[0]); i++)
+    esc_frames_[i] = frames[i];
+  esc_writes_++;
+}
 
 // non-volatile memory
 void testBoard::memory_init() {}
 bool testBoard::memory_read(void *dest, size_t len) { return false; }
 bool testBoard::memory_write(const void *src, size_t len) { return false; }
+size_t testBoard::memory_sector_size() { return FLASH_SECTOR_SIZE; }
+bool testBoard::memory_sector_read(uint8_t sector, size_t offset, void *dest, size_t len)
+{
+  if (sector >= FLASH_NUM_SECTORS || offset + len > FLASH_SECTOR_SIZE)
+    return false;
+  memcpy(dest, &flash_[sector][offset], len);
+  return true;
+}
+bool testBoard::memory_sector_write(uint8_t sector, size_t offset, const void *src, size_t len)
+{
+  if (sector >= FLASH_NUM_SECTORS || offset + len > FLASH_SECTOR_SIZE)
+    return false;
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < len; i++)
+  {
+    if (flash_write_limit_ == 0)
+      return false;
+    flash_write_limit_--;
+    flash_[sector][offset + i] &= bytes[i]; // programming can only clear bits
+    flash_bytes_written_++;
+  }
+  return true;
+}
+bool testBoard::memory_sector_erase(uint8_t sector)
+{
+  if (sector >= FLASH_NUM_SECTORS)
+    return false;
+  memset(flash_[sector], 0xFF, FLASH_SECTOR_SIZE);
+  flash_erases_[sector]++;
+  return true;
+}
 
 // LEDs
 void testBoard::led0_on() {}
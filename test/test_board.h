@@ -32,6 +32,8 @@
 #ifndef ROSFLIGHT_FIRMWARE_TEST_BOARD_H
 #define ROSFLIGHT_FIRMWARE_TEST_BOARD_H
 
+#include <cstdint>
+
 #include "board.h"
 #include "sensors.h"
 
@@ -48,10 +50,42 @@ private:
   float acc_[3] = {0, 0, 0};
   float gyro_[3] = {0, 0, 0};
   bool new_imu_ = false;
+  float mag_[3] = {0, 0, 0};
+  bool mag_present_ = false;
+  float baro_pressure_ = 0;
+  bool baro_present_ = false;
+  float sonar_range_ = 0;
+  bool sonar_present_ = false;
+  static constexpr size_t IMU_FIFO_SIZE{32};
+  ImuSample imu_fifo_[IMU_FIFO_SIZE];
+  size_t imu_fifo_count_ = 0;
   static constexpr size_t BACKUP_MEMORY_SIZE{1024};
   uint8_t backup_memory_[BACKUP_MEMORY_SIZE];
 
+  // RAM stand-in for two flash sectors
+  static constexpr size_t FLASH_SECTOR_SIZE{2048};
+  static constexpr uint8_t FLASH_NUM_SECTORS{2};
+  uint8_t flash_[FLASH_NUM_SECTORS][FLASH_SECTOR_SIZE];
+  uint32_t flash_erases_[FLASH_NUM_SECTORS] = {0, 0};
+  size_t flash_bytes_written_ = 0;
+  size_t flash_write_limit_ = SIZE_MAX;
+
+  // digital ESC outputs
+  bool esc_supported_ = true;
+  EscProtocol esc_protocol_ = ESC_PROTOCOL_PWM;
+  uint16_t esc_channel_mask_ = 0;
+  uint16_t esc_frames_[14] = {0};
+  uint32_t esc_writes_ = 0;
+
+  // last batched output write
+  float pwm_values_[14] = {0};
+  Mixer::output_type_t pwm_types_[14] = {};
+  uint32_t pwm_batches_ = 0;
+  uint32_t pwm_inits_ = 0;
+
 public:
+  testBoard();
+
 // setup
   void init_board() override;
   void board_reset(bool bootloader) override;
@@ -74,6 +108,7 @@ public:
 
   bool new_imu_data() override;
   bool imu_read(float accel[3], float *temperature, float gyro[3], uint64_t *time) override;
+  size_t imu_read_fifo(ImuSample *samples, size_t max_samples) override;
   void imu_not_responding_error() override;
 
   bool mag_present() override;
@@ -115,11 +150,18 @@ public:
   void pwm_init(uint32_t refresh_rate, uint16_t idle_pwm) override;
   void pwm_disable() override;
   void pwm_write(uint8_t channel, float value) override;
+  void pwm_write_all(const float *values, const Mixer::output_type_t *types, size_t count) override;
+  bool esc_init(EscProtocol protocol, uint16_t channel_mask) override;
+  void esc_write(const uint16_t *frames, size_t count) override;
 
 // non-volatile memory
   void memory_init() override;
   bool memory_read(void *dest, size_t len) override;
   bool memory_write(const void *src, size_t len) override;
+  size_t memory_sector_size() override;
+  bool memory_sector_read(uint8_t sector, size_t offset, void *dest, size_t len) override;
+  bool memory_sector_write(uint8_t sector, size_t offset, const void *src, size_t len) override;
+  bool memory_sector_erase(uint8_t sector) override;
 
 // LEDs
   void led0_on() override;
@@ -138,10 +180,32 @@ public:
   void backup_memory_clear(); // Not an override
 
   void set_imu(float *acc, float *gyro, uint64_t time_us);
+  // Makes the magnetometer present and sets what it reads
+  void set_mag(const float *mag);
+  // Make the barometer (Pa) and sonar (m) present and set what they read
+  void set_baro(float pressure);
+  void set_sonar(float range);
+  // Queues a sample in the simulated IMU FIFO; while it isn't empty, imu_read_fifo drains it
+  void push_imu_fifo(const ImuSample &sample);
   void set_rc(uint16_t *values);
   void set_time(uint64_t time_us);
   void set_pwm_lost(bool lost);
 
+  uint32_t flash_erases(uint8_t sector) const { return flash_erases_[sector]; }
+  size_t flash_bytes_written() const { return flash_bytes_written_; }
+  // Simulates a reset during a write: only this many more bytes get programmed, then writes fail
+  void set_flash_write_limit(size_t bytes) { flash_write_limit_ = bytes; }
+
+  void set_esc_supported(bool supported) { esc_supported_ = supported; }
+  EscProtocol esc_protocol() const { return esc_protocol_; }
+  uint16_t esc_channel_mask() const { return esc_channel_mask_; }
+  uint16_t esc_frame(uint8_t channel) const { return esc_frames_[channel]; }
+  uint32_t esc_writes() const { return esc_writes_; }
+  float pwm_value(uint8_t channel) const { return pwm_values_[channel]; }
+  Mixer::output_type_t pwm_type(uint8_t channel) const { return pwm_types_[channel]; }
+  uint32_t pwm_batches() const { return pwm_batches_; }
+  uint32_t pwm_inits() const { return pwm_inits_; }
+
 };
 
 } // namespace rosflight_firmware
@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2017, James Jackson and Daniel Koch, BYU MAGICC Lab
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file turbomath_bench.cpp
+ * @brief Speed and accuracy of the turbomath trig functions
+ *
+ * Compares the polynomial turbomath::sin/cos/atan/atan2/asin with the lookup-table versions they
+ * replaced (copied below) and with the float libm functions. Reports the time per 1000 calls over a
+ * buffer of inputs, and the maximum error in ulps (units in the last place of the correctly rounded
+ * float result) against double-precision libm.
+ *
+ * Also times one 1 kHz attitude propagation step with Quaternion::exp_map against the sinf/cosf
+ * matrix exponential update the estimator used before, with and without the quaternion product and
+ * normalization.
+ *
+ * Usage: turbomath_bench [passes]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <turbomath/turbomath.h>
+
+#include "bench_timer.h"
+
+using namespace rosflight_firmware;
+
+namespace legacy
+{
+
+// The lookup-table implementations from before the polynomial kernels, kept for comparison
+
+#define M_PI_LEGACY 3.14159265359
+
+float cos(float x);
+float sin(float x);
+float asin(float x);
+float atan2(float y, float x);
+float atan(float x);
+
+static const float atan_max_x = 1.000000;
+static const float atan_min_x = 0.000000;
+static const float atan_scale_factor = 41720.240162;
+static const int16_t atan_num_entries = 125;
+static const int16_t atan_lookup_table[125] = {
+0,	334,	667,	1001,	1335,	1668,	2001,	2334,	2666,	2999,
+3331,	3662,	3993,	4323,	4653,	4983,	5311,	5639,	5967,	6293,
+6619,	6944,	7268,	7592,	7914,	8235,	8556,	8875,	9194,	9511,
+9827,	10142,	10456,	10768,	11080,	11390,	11699,	12006,	12313,	12617,
+12921,	13223,	13524,	13823,	14120,	14417,	14711,	15005,	15296,	15586,
+15875,	16162,	16447,	16731,	17013,	17293,	17572,	17849,	18125,	18399,
+18671,	18941,	19210,	19477,	19742,	20006,	20268,	20528,	20786,	21043,
+21298,	21551,	21802,	22052,	22300,	22546,	22791,	23034,	23275,	23514,
+23752,	23988,	24222,	24454,	24685,	24914,	25142,	25367,	25591,	25814,
+26034,	26253,	26471,	26686,	26900,	27113,	27324,	27533,	27740,	27946,
+28150,	28353,	28554,	28754,	28952,	29148,	29343,	29537,	29728,	29919,
+30108,	30295,	30481,	30665,	30848,	31030,	31210,	31388,	31566,	31741,
+31916,	32089,	32260,	32431,	32599,	};
+
+
+static const float asin_max_x = 1.000000;
+static const float asin_min_x = 0.000000;
+static const float asin_scale_factor = 20860.120081;
+static const int16_t asin_num_entries = 200;
+static const int16_t asin_lookup_table[200] = {
+0,	104,	209,	313,	417,	522,	626,	730,	835,	939,
+1043,	1148,	1252,	1357,	1461,	1566,	1671,	1775,	1880,	1985,
+2090,	2194,	2299,	2404,	2509,	2614,	2720,	2825,	2930,	3035,
+3141,	3246,	3352,	3458,	3564,	3669,	3775,	3881,	3988,	4094,
+4200,	4307,	4413,	4520,	4627,	4734,	4841,	4948,	5056,	5163,
+5271,	5379,	5487,	5595,	5703,	5811,	5920,	6029,	6138,	6247,
+6356,	6465,	6575,	6685,	6795,	6905,	7015,	7126,	7237,	7348,
+7459,	7570,	7682,	7794,	7906,	8019,	8131,	8244,	8357,	8471,
+8584,	8698,	8812,	8927,	9042,	9157,	9272,	9388,	9504,	9620,
+9737,	9854,	9971,	10089,	10207,	10325,	10444,	10563,	10682,	10802,
+10922,	11043,	11164,	11285,	11407,	11530,	11652,	11776,	11899,	12024,
+12148,	12273,	12399,	12525,	12652,	12779,	12907,	13035,	13164,	13293,
+13424,	13554,	13686,	13817,	13950,	14083,	14217,	14352,	14487,	14623,
+14760,	14898,	15036,	15176,	15316,	15457,	15598,	15741,	15885,	16029,
+16175,	16321,	16469,	16618,	16767,	16918,	17070,	17224,	17378,	17534,
+17691,	17849,	18009,	18170,	18333,	18497,	18663,	18830,	19000,	19171,
+19343,	19518,	19695,	19874,	20055,	20239,	20424,	20613,	20803,	20997,
+21194,	21393,	21596,	21802,	22012,	22225,	22443,	22664,	22891,	23122,
+23359,	23601,	23849,	24104,	24366,	24637,	24916,	25204,	25504,	25816,
+26143,	26485,	26847,	27232,	27644,	28093,	28588,	29149,	29814,	30680,
+};
+
+
+static const float sin_max_x = 3.141593;
+static const float sin_min_x = 0.000000;
+static const float sin_scale_factor = 32767.000000;
+static const int16_t sin_num_entries = 125;
+static const int16_t sin_lookup_table[125] = {
+0,	823,	1646,	2468,	3289,	4107,	4922,	5735,	6544,	7349,
+8149,	8944,	9733,	10516,	11293,	12062,	12824,	13578,	14323,	15059,
+15786,	16502,	17208,	17904,	18588,	19260,	19920,	20568,	21202,	21823,
+22431,	23024,	23602,	24166,	24715,	25247,	25764,	26265,	26749,	27216,
+27666,	28099,	28513,	28910,	29289,	29648,	29990,	30312,	30615,	30899,
+31163,	31408,	31633,	31837,	32022,	32187,	32331,	32454,	32558,	32640,
+32702,	32744,	32764,	32764,	32744,	32702,	32640,	32558,	32454,	32331,
+32187,	32022,	31837,	31633,	31408,	31163,	30899,	30615,	30312,	29990,
+29648,	29289,	28910,	28513,	28099,	27666,	27216,	26749,	26265,	25764,
+25247,	24715,	24166,	23602,	23024,	22431,	21823,	21202,	20568,	19920,
+19260,	18588,	17904,	17208,	16502,	15786,	15059,	14323,	13578,	12824,
+12062,	11293,	10516,	9733,	8944,	8149,	7349,	6544,	5735,	4922,
+4107,	3289,	2468,	1646,	823
+};
+
+float cos(float x)
+{
+  return sin(M_PI_LEGACY/2.0 - x);
+}
+
+float sin(float x)
+{
+  // wrap down to +/x PI
+  while (x > M_PI_LEGACY)
+    x -= 2.0*M_PI_LEGACY;
+
+  while (x <= -M_PI_LEGACY)
+    x += 2.0*M_PI_LEGACY;
+
+  // sin is symmetric
+  if (x < 0)
+    return -1.0*sin(-x);
+
+  // wrap onto (0, PI)
+  if (x > M_PI_LEGACY)
+    return -1.0*sin(x - M_PI_LEGACY);
+
+  // Now, all we have left is the range 0 to PI, use the lookup table
+  float t = (x - sin_min_x)/(sin_max_x - sin_min_x) * static_cast<float>(sin_num_entries);
+  int16_t index = static_cast<int16_t>(t);
+  float delta_x = t - index;
+
+  if (index >= sin_num_entries)
+      return sin_lookup_table[sin_num_entries - 1]/sin_scale_factor;
+  else if (index < sin_num_entries - 1)
+      return sin_lookup_table[index]/sin_scale_factor + delta_x * (sin_lookup_table[index + 1] - sin_lookup_table[index])/sin_scale_factor;
+  else
+      return sin_lookup_table[index]/sin_scale_factor + delta_x * (sin_lookup_table[index] - sin_lookup_table[index - 1])/sin_scale_factor;
+}
+
+
+float atan(float x)
+{
+  // atan is symmetric
+  if (x < 0)
+  {
+    return -1.0*atan(-1.0*x);
+  }
+  // This uses a sweet identity to wrap the domain of atan onto (0,1)
+  if (x > 1.0)
+  {
+    return M_PI_LEGACY/2.0 - atan(1.0/x);
+  }
+
+  float t = (x - atan_min_x)/(atan_max_x - atan_min_x) * static_cast<float>(atan_num_entries);
+  int16_t index = static_cast<int16_t>(t);
+  float delta_x = t - index;
+
+  if (index >= atan_num_entries)
+      return atan_lookup_table[atan_num_entries-1]/atan_scale_factor;
+  else if (index < atan_num_entries - 1)
+      return atan_lookup_table[index]/atan_scale_factor + delta_x * (atan_lookup_table[index + 1] - atan_lookup_table[index])/atan_scale_factor;
+  else
+      return atan_lookup_table[index]/atan_scale_factor + delta_x * (atan_lookup_table[index] - atan_lookup_table[index - 1])/atan_scale_factor;
+}
+
+
+float atan2(float y, float x)
+{
+  // algorithm from wikipedia: https://en.wikipedia.org/wiki/Atan2
+  if (x == 0.0)
+  {
+    if (y < 0.0)
+    {
+      return - M_PI_LEGACY/2.0;
+    }
+    else if ( y > 0.0)
+    {
+      return M_PI_LEGACY/2.0;
+    }
+    else
+    {
+      return 0.0;
+    }
+  }
+
+  float arctan = atan(y/x);
+
+  if (x < 0.0)
+  {
+    if ( y < 0)
+    {
+      return arctan - M_PI_LEGACY;
+    }
+    else
+    {
+      return arctan + M_PI_LEGACY;
+    }
+  }
+
+  else
+  {
+      return arctan;
+  }
+}
+
+
+float asin(float x)
+{
+  if (x < 0.0)
+  {
+    return -1.0*asin(-1.0*x);
+  }
+
+  float t = (x - asin_min_x)/(asin_max_x - asin_min_x) * static_cast<float>(asin_num_entries);
+  int16_t index = static_cast<int16_t>(t);
+  float delta_x = t - index;
+
+  if (index >= asin_num_entries)
+      return asin_lookup_table[asin_num_entries - 1]/asin_scale_factor;
+  else if (index < asin_num_entries - 1)
+      return asin_lookup_table[index]/asin_scale_factor + delta_x * (asin_lookup_table[index + 1] - asin_lookup_table[index])/asin_scale_factor;
+  else
+      return asin_lookup_table[index]/asin_scale_factor + delta_x * (asin_lookup_table[index] - asin_lookup_table[index - 1])/asin_scale_factor;
+}
+
+#undef M_PI_LEGACY
+
+// The matrix exponential attitude update Estimator::integrate_angular_rate used before exp_map
+void propagate(turbomath::Quaternion &quat, const turbomath::Vector &omega, float dt)
+{
+  const float &p = omega.x, &q = omega.y, &r = omega.z;
+  float norm_w = sqrtf(omega.sqrd_norm());
+  float t1 = cosf((norm_w*dt)/2.0f);
+  float t2 = 1.0f/norm_w * sinf((norm_w*dt)/2.0f);
+  quat.w = t1*quat.w + t2*(-p*quat.x - q*quat.y - r*quat.z);
+  quat.x = t1*quat.x + t2*( p*quat.w + r*quat.y - q*quat.z);
+  quat.y = t1*quat.y + t2*( q*quat.w - r*quat.x + p*quat.z);
+  quat.z = t1*quat.z + t2*( r*quat.w + q*quat.x - p*quat.y);
+  quat.normalize();
+}
+
+} // namespace legacy
+
+namespace
+{
+
+constexpr int NUM_INPUTS = 4096;
+
+double ulps(float value, double reference)
+{
+  float rounded = static_cast<float>(reference);
+  float spacing = std::nextafter(std::fabs(rounded), INFINITY) - std::fabs(rounded);
+  return std::fabs(value - reference) / spacing;
+}
+
+struct Inputs
+{
+  float x[NUM_INPUTS];
+  float y[NUM_INPUTS];
+};
+
+// Times f over the inputs, one call per input, and records the time per 1000 calls
+template <typename F>
+void time_unary(StageTimer &timer, const float *x, F f)
+{
+  Stopwatch stopwatch;
+  volatile float sink = 0.0f;
+  stopwatch.start();
+  float sum = 0.0f;
+  for (int i = 0; i < NUM_INPUTS; i++)
+    sum += f(x[i]);
+  uint32_t ns = stopwatch.ns();
+  sink = sum;
+  (void) sink;
+  timer.add(ns * 1000 / NUM_INPUTS);
+}
+
+template <typename F>
+void time_binary(StageTimer &timer, const float *y, const float *x, F f)
+{
+  Stopwatch stopwatch;
+  volatile float sink = 0.0f;
+  stopwatch.start();
+  float sum = 0.0f;
+  for (int i = 0; i < NUM_INPUTS; i++)
+    sum += f(y[i], x[i]);
+  uint32_t ns = stopwatch.ns();
+  sink = sum;
+  (void) sink;
+  timer.add(ns * 1000 / NUM_INPUTS);
+}
+
+// Propagates one attitude through all the rates and records the time per 1000 steps
+template <typename F>
+void time_propagation(StageTimer &timer, const turbomath::Vector *omega, F f)
+{
+  turbomath::Quaternion quat;
+  Stopwatch stopwatch;
+  volatile float sink = 0.0f;
+  stopwatch.start();
+  for (int i = 0; i < NUM_INPUTS; i++)
+    f(quat, omega[i]);
+  uint32_t ns = stopwatch.ns();
+  sink = quat.w;
+  (void) sink;
+  timer.add(ns * 1000 / NUM_INPUTS);
+}
+
+struct Row
+{
+  const char *name;
+  double legacy_ulps;
+  double turbomath_ulps;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  long passes = (argc > 1) ? atol(argv[1]) : 1000;
+
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> wide(-20.0f, 20.0f);
+  static Inputs angles, units, wides;
+  for (int i = 0; i < NUM_INPUTS; i++)
+  {
+    angles.x[i] = angle(generator);
+    units.x[i] = unit(generator);
+    units.y[i] = unit(generator);
+    wides.x[i] = wide(generator);
+  }
+
+  // body rates up to 10 rad/s, propagated at 1 kHz
+  constexpr float DT = 0.001f;
+  std::uniform_real_distribution<float> rate(-10.0f, 10.0f);
+  static turbomath::Vector rates[NUM_INPUTS];
+  for (int i = 0; i < NUM_INPUTS; i++)
+    rates[i] = turbomath::Vector(rate(generator), rate(generator), rate(generator));
+
+  StageTimer sin_legacy("sin, table");
+  StageTimer sin_new("sin, polynomial");
+  StageTimer sin_libm("sinf");
+  StageTimer sincos_new("sin_cos, polynomial");
+  StageTimer atan_legacy("atan, table");
+  StageTimer atan_new("atan, polynomial");
+  StageTimer atan_libm("atanf");
+  StageTimer atan2_legacy("atan2, table");
+  StageTimer atan2_new("atan2, polynomial");
+  StageTimer atan2_libm("atan2f");
+  StageTimer asin_legacy("asin, table");
+  StageTimer asin_new("asin, polynomial");
+  StageTimer asin_libm("asinf");
+  StageTimer rotation_legacy("rotation, sinf/cosf");
+  StageTimer rotation_new("rotation, exp_map");
+  StageTimer propagate_legacy("propagate, sinf/cosf");
+  StageTimer propagate_new("propagate, exp_map");
+
+  for (long pass = 0; pass < passes; pass++)
+  {
+    time_unary(sin_legacy, angles.x, [](float x) { return legacy::sin(x); });
+    time_unary(sin_new, angles.x, [](float x) { return turbomath::sin(x); });
+    time_unary(sin_libm, angles.x, [](float x) { return sinf(x); });
+    time_unary(sincos_new, angles.x, [](float x) { float s, c; turbomath::sin_cos(x, &s, &c); return s + c; });
+    time_unary(atan_legacy, wides.x, [](float x) { return legacy::atan(x); });
+    time_unary(atan_new, wides.x, [](float x) { return turbomath::atan(x); });
+    time_unary(atan_libm, wides.x, [](float x) { return atanf(x); });
+    time_binary(atan2_legacy, units.y, units.x, [](float y, float x) { return legacy::atan2(y, x); });
+    time_binary(atan2_new, units.y, units.x, [](float y, float x) { return turbomath::atan2(y, x); });
+    time_binary(atan2_libm, units.y, units.x, [](float y, float x) { return atan2f(y, x); });
+    time_unary(asin_legacy, units.x, [](float x) { return legacy::asin(x); });
+    time_unary(asin_new, units.x, [](float x) { return turbomath::asin(x); });
+    time_unary(asin_libm, units.x, [](float x) { return asinf(x); });
+    time_propagation(rotation_legacy, rates, [=](turbomath::Quaternion &q, const turbomath::Vector &w)
+    {
+      float norm_w = sqrtf(w.sqrd_norm());
+      float s = 1.0f/norm_w * sinf((norm_w*DT)/2.0f);
+      q.w += cosf((norm_w*DT)/2.0f) + s*(w.x + w.y + w.z);
+    });
+    time_propagation(rotation_new, rates, [=](turbomath::Quaternion &q, const turbomath::Vector &w)
+    {
+      turbomath::Quaternion dq = turbomath::Quaternion::exp_map(w, DT);
+      q.w += dq.w + dq.x + dq.y + dq.z;
+    });
+    time_propagation(propagate_legacy, rates, [=](turbomath::Quaternion &q, const turbomath::Vector &w)
+    {
+      legacy::propagate(q, w, DT);
+    });
+    time_propagation(propagate_new, rates, [=](turbomath::Quaternion &q, const turbomath::Vector &w)
+    {
+      q = turbomath::Quaternion::exp_map(w, DT) * q;
+      q.normalize();
+    });
+  }
+
+  // accuracy, swept densely over each domain
+  Row rows[] = {{"sin  [-pi, pi]", 0, 0}, {"cos  [-pi, pi]", 0, 0}, {"atan [-20, 20]", 0, 0},
+                {"atan2 (circle)", 0, 0}, {"asin [-1, 1]", 0, 0}};
+  for (double x = -M_PI; x <= M_PI; x += 1e-5)
+  {
+    float xf = static_cast<float>(x);
+    rows[0].legacy_ulps = std::max(rows[0].legacy_ulps, ulps(legacy::sin(xf), std::sin(static_cast<double>(xf))));
+    rows[0].turbomath_ulps = std::max(rows[0].turbomath_ulps, ulps(turbomath::sin(xf), std::sin(static_cast<double>(xf))));
+    rows[1].legacy_ulps = std::max(rows[1].legacy_ulps, ulps(legacy::cos(xf), std::cos(static_cast<double>(xf))));
+    rows[1].turbomath_ulps = std::max(rows[1].turbomath_ulps, ulps(turbomath::cos(xf), std::cos(static_cast<double>(xf))));
+  }
+  for (double x = -20.0; x <= 20.0; x += 1e-5)
+  {
+    float xf = static_cast<float>(x);
+    double reference = std::atan(static_cast<double>(xf));
+    rows[2].legacy_ulps = std::max(rows[2].legacy_ulps, ulps(legacy::atan(xf), reference));
+    rows[2].turbomath_ulps = std::max(rows[2].turbomath_ulps, ulps(turbomath::atan(xf), reference));
+  }
+  for (double a = -M_PI; a <= M_PI; a += 1e-5)
+  {
+    float y = static_cast<float>(2.0 * std::sin(a));
+    float x = static_cast<float>(2.0 * std::cos(a));
+    if (x == 0.0f)
+      continue; // the table version special-cases this exactly
+    double reference = std::atan2(static_cast<double>(y), static_cast<double>(x));
+    rows[3].legacy_ulps = std::max(rows[3].legacy_ulps, ulps(legacy::atan2(y, x), reference));
+    rows[3].turbomath_ulps = std::max(rows[3].turbomath_ulps, ulps(turbomath::atan2(y, x), reference));
+  }
+  for (double x = -1.0; x <= 1.0; x += 1e-6)
+  {
+    float xf = static_cast<float>(x);
+    double reference = std::asin(static_cast<double>(xf));
+    rows[4].legacy_ulps = std::max(rows[4].legacy_ulps, ulps(legacy::asin(xf), reference));
+    rows[4].turbomath_ulps = std::max(rows[4].turbomath_ulps, ulps(turbomath::asin(xf), reference));
+  }
+
+  printf("turbomath trig benchmark: %d inputs per measurement, %ld passes (times per 1000 calls)\n\n",
+         NUM_INPUTS, passes);
+  sin_legacy.summary();
+  sin_new.summary();
+  sin_libm.summary();
+  sincos_new.summary();
+  atan_legacy.summary();
+  atan_new.summary();
+  atan_libm.summary();
+  atan2_legacy.summary();
+  atan2_new.summary();
+  atan2_libm.summary();
+  asin_legacy.summary();
+  asin_new.summary();
+  asin_libm.summary();
+  rotation_legacy.summary();
+  rotation_new.summary();
+  propagate_legacy.summary();
+  propagate_new.summary();
+
+  printf("\nmax error against double-precision libm (ulp)\n");
+  printf("%-16s %12s %12s\n", "", "table", "polynomial");
+  for (const Row &row : rows)
+    printf("%-16s %12.1f %12.2f\n", row.name, row.legacy_ulps, row.turbomath_ulps);
+  return 0;
+}
@@ -138,6 +138,34 @@ TEST(TurboMath, asin)
   }
 }
 
+TEST(TurboMath, sinCosAccuracy)
+{
+  for (float i = -200.0; i <= 200.0; i += 0.001)
+  {
+    float s, c;
+    turbomath::sin_cos(i, &s, &c);
+    EXPECT_EQ(s, turbomath::sin(i));
+    EXPECT_EQ(c, turbomath::cos(i));
+    EXPECT_NEAR(s, sin(static_cast<double>(i)), 2e-7);
+    EXPECT_NEAR(c, cos(static_cast<double>(i)), 2e-7);
+  }
+}
+
+TEST(TurboMath, inverseTrigAccuracy)
+{
+  for (float i = -1.0; i <= 1.0; i += 0.0001)
+  {
+    EXPECT_NEAR(turbomath::asin(i), asin(static_cast<double>(i)), 4e-7);
+    EXPECT_NEAR(turbomath::atan(i), atan(static_cast<double>(i)), 2e-7);
+    EXPECT_NEAR(turbomath::atan2(i, -0.3f), atan2(static_cast<double>(i), -0.3), 8e-7);
+  }
+  EXPECT_NEAR(turbomath::asin(1.001f), M_PI/2.0, 1e-7);
+  EXPECT_NEAR(turbomath::asin(-1.001f), -M_PI/2.0, 1e-7);
+  EXPECT_NEAR(turbomath::atan2(0.0f, -1.0f), M_PI, 1e-7);
+  EXPECT_NEAR(turbomath::atan2(-1.0f, 0.0f), -M_PI/2.0, 1e-7);
+  EXPECT_EQ(turbomath::atan2(0.0f, 1.0f), 0.0f);
+}
+
 TEST(TurboMath, fastAlt)
 {
 
@@ -266,6 +294,99 @@ TEST(TurboMath, Quaternion)
   }
 }
 
+TEST(TurboMath, QuaternionExpMap)
+{
+  // rates from 1e-3 to 1e2 rad/s over one 1 kHz step and one 20 Hz step, which covers both the
+  // Taylor series and the sin_cos branches
+  const float dts[] = {0.001f, 0.05f};
+  for (int i = 0; i < 24; i++)
+  {
+    for (float dt : dts)
+    {
+      for (float scale = 1e-3f; scale <= 1e2f; scale *= 10.0f)
+      {
+        turbomath::Vector omega = random_vectors[i] * scale;
+        turbomath::Quaternion dq = turbomath::Quaternion::exp_map(omega, dt);
+
+        float angle = omega.norm() * dt;
+        Eigen::Vector3f axis(omega.x, omega.y, omega.z);
+        axis.normalize();
+        Eigen::Quaternionf eig(Eigen::AngleAxisf(angle, axis));
+        EXPECT_NEAR(dq.w, eig.w(), 1e-6);
+        EXPECT_NEAR(dq.x, eig.x(), 1e-6);
+        EXPECT_NEAR(dq.y, eig.y(), 1e-6);
+        EXPECT_NEAR(dq.z, eig.z(), 1e-6);
+        EXPECT_NEAR(dq.w*dq.w + dq.x*dq.x + dq.y*dq.y + dq.z*dq.z, 1.0f, 1e-6);
+
+        // matches the hand-written matrix exponential update the estimator used before
+        turbomath::Quaternion q = random_quaternions[i];
+        q.normalize();
+        const float &p = omega.x, &qr = omega.y, &r = omega.z;
+        float norm_w = omega.norm();
+        float t1 = cosf(norm_w*dt/2.0f);
+        float t2 = sinf(norm_w*dt/2.0f) / norm_w;
+        turbomath::Quaternion expected(t1*q.w + t2*(-p*q.x - qr*q.y - r*q.z),
+                                       t1*q.x + t2*( p*q.w + r*q.y - qr*q.z),
+                                       t1*q.y + t2*( qr*q.w - r*q.x + p*q.z),
+                                       t1*q.z + t2*( r*q.w + qr*q.x - p*q.y));
+        turbomath::Quaternion propagated = dq * q;
+        EXPECT_NEAR(propagated.w, expected.w, 1e-6);
+        EXPECT_NEAR(propagated.x, expected.x, 1e-6);
+        EXPECT_NEAR(propagated.y, expected.y, 1e-6);
+        EXPECT_NEAR(propagated.z, expected.z, 1e-6);
+      }
+    }
+  }
+
+  // no rotation
+  turbomath::Quaternion identity = turbomath::Quaternion::exp_map(turbomath::Vector(0, 0, 0), 0.001f);
+  EXPECT_EQ(identity.w, 1.0f);
+  EXPECT_EQ(identity.x, 0.0f);
+  EXPECT_EQ(identity.y, 0.0f);
+  EXPECT_EQ(identity.z, 0.0f);
+
+  // the Taylor series and sin_cos branches agree where they meet (half angle 0.1)
+  turbomath::Vector omega(0.0f, 0.0f, 1.0f);
+  const float edge_dts[] = {0.2f * 0.99999f, 0.2f * 1.00001f};
+  for (float dt : edge_dts)
+  {
+    turbomath::Quaternion dq = turbomath::Quaternion::exp_map(omega, dt);
+    EXPECT_NEAR(dq.w, cos(dt / 2.0), 1e-7);
+    EXPECT_NEAR(dq.z, sin(dt / 2.0), 1e-7);
+  }
+}
+
+TEST(TurboMath, QuaternionBoxplus)
+{
+  for (int i = 0; i < 24; i++)
+  {
+    turbomath::Quaternion q1 = random_quaternions[i];
+    turbomath::Quaternion q2 = random_quaternions[i+1];
+    q1.normalize();
+    q2.normalize();
+
+    // q2 + (q1 - q2) == q1
+    turbomath::Vector delta = q1 - q2;
+    turbomath::Quaternion q3 = q2 + delta;
+    ASSERT_TURBOQUAT_SUPERCLOSE(q1, q3);
+
+    // (q1 + delta) - q1 == delta for rotations under pi
+    turbomath::Vector small = random_vectors[i] * (1.0f / (random_vectors[i].norm() + 1.0f));
+    turbomath::Vector recovered = q1.boxplus(small) - q1;
+    EXPECT_NEAR(recovered.x, small.x, 1e-5);
+    EXPECT_NEAR(recovered.y, small.y, 1e-5);
+    EXPECT_NEAR(recovered.z, small.z, 1e-5);
+
+    // the quaternion product is unchanged by the in-place operator
+    turbomath::Quaternion product = q1 * q2;
+    q1 *= q2;
+    EXPECT_EQ(q1.w, product.w);
+    EXPECT_EQ(q1.x, product.x);
+    EXPECT_EQ(q1.y, product.y);
+    EXPECT_EQ(q1.z, product.z);
+  }
+}
+
 TEST(TurboMath, QuatFromTwoVectors)
 {
   // Test the "quat_from_two_vectors"